@@ -0,0 +1,203 @@
+// Arduino core stand-in for running the tiny84 sketch on a simulated chip - Definitions
+//=================================================================================================
+
+#ifndef ArduinoSim_Arduino_h
+#define ArduinoSim_Arduino_h
+
+#include <cstdint>
+#include <cstring>
+#include "../NrfSim.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: Just enough of the Arduino core (ATTinyCore, ATTiny84 at 8MHz) for the sensor
+* sketch in /Software/tiny84/tiny84_SensorAsSlave to compile and run on a PC, with its nRF24L01+
+* being an NrfSim (NrfSim.h). digitalWrite() on the CSN and CE pins and SPI.transfer() go to the
+* chip; everything else (LEDs, the charge pins) goes nowhere. The sketch's own code is not
+* changed: RadioComms, Nrf24Lite, Dispatcher and CapSensor run as they are.
+*
+*    Time is the sensor CPU's. Every core call costs the cycles in the ARDUINO_SIM_ defines,
+* delay()/delayMicroseconds() cost what they ask for, and millis()/micros() read that back.
+* Each time the CPU's clock moves, the air (VirtualAir) is run up to it, so a driver that
+* spins on STATUS waiting for TX_DS sees the chip carry on underneath it, as on the bench.
+*
+*    USAGE:
+*    1. Build with -IArduinoSim so the sketch's #include "Arduino.h", <SPI.h> and "RF24.h"
+*  come here. Include this before the sketch, and the sketch's .ino files inside a namespace.
+*  See RPi_RadioSim.cpp.
+*    2. Make an ArduinoBoard for the chip and the pins the sketch wires it to, and point
+*  arduinoBoard at it before calling into the sketch.
+*    3. Call spend() between passes of loop() for the time the rest of loop() would take.
+*    4. The board's counters (SPI transactions, bytes, cycles spent in SPI) are what a
+*  logic analyser on the bus would show.
+*
+*    NOTE:
+*    1. The cycle costs are estimates for ATTinyCore's digitalWrite() and USI SPI.transfer(),
+*  not measurements. They are the same for every driver, so they are fair for comparing one
+*  driver against another; the code between the calls isn't counted at all.
+*    2. The ADC is stubbed: analogRead() and the bandgap conversion return the board's
+*  analogValue and bandgapValue after the 13 ADC clocks a conversion takes.
+*    3. DIAGNOSTIC_BUILD isn't supported (no MCUSR, __heap_start or stack painting).
+*/
+
+#define ARDUINO_SIM_F_CPU 8000000UL
+#define ARDUINO_SIM_CYCLES_PER_MICRO (ARDUINO_SIM_F_CPU / 1000000UL)
+#define ARDUINO_SIM_PIN_CYCLES 40         // digitalWrite()/pinMode(): pin to port and bit, SREG save.
+#define ARDUINO_SIM_SPI_CYCLES 36         // SPI.transfer(): 8 bits clocked out of the USI by hand.
+#define ARDUINO_SIM_MILLIS_CYCLES 24      // millis(): interrupts off, copy, back on.
+#define ARDUINO_SIM_ADC_MICROS 104        // 13 ADC clocks at 125kHz (prescaler 64).
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+    /* ATTinyCore's ATTiny84 pin numbers (clockwise pin mapping). */
+#define PIN_PA0 0
+#define PIN_PA1 1
+#define PIN_PA2 2
+#define PIN_PA3 3
+#define PIN_PA4 4
+#define PIN_PA5 5
+#define PIN_PA6 6
+#define PIN_PA7 7
+#define PIN_PB2 8
+#define PIN_PB1 9
+#define PIN_PB0 10
+#define PIN_PB3 11
+#define A0 PIN_PA0
+#define A1 PIN_PA1
+#define A2 PIN_PA2
+#define A3 PIN_PA3
+#define A4 PIN_PA4
+#define A5 PIN_PA5
+#define A6 PIN_PA6
+#define A7 PIN_PA7
+
+    /* avr-libc. */
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define MUX0 0
+#define MUX5 5
+#define ADSC 6
+
+
+    /* One sensor's board: the CPU's clock and the chip on its SPI bus. */
+struct ArduinoBoard {
+    VirtualAir* air;
+    NrfSim* chip;
+    uint8_t cePin, csnPin;
+    uint64_t bootMicros;                // Air time the CPU came out of reset.
+    uint64_t cycles = 0;                // CPU cycles since.
+    uint16_t analogValue = 512;         // What analogRead() reads.
+    uint16_t bandgapValue = 341;        // What the bandgap reads: 1023 * 1.1V / 3.3V.
+
+        /* What went over the bus. */
+    unsigned long spiTransactions = 0;  // CSN low -> high.
+    unsigned long spiBytes = 0;
+    uint64_t spiCycles = 0;             // Cycles in SPI.transfer() and on the CSN pin.
+    bool selected = false;
+
+    ArduinoBoard(VirtualAir& a, NrfSim& c, uint8_t ce, uint8_t csn)
+        : air(&a), chip(&c), cePin(ce), csnPin(csn), bootMicros(a.now()) {}
+
+    uint64_t micros() const { return bootMicros + cycles / ARDUINO_SIM_CYCLES_PER_MICRO; }
+
+          /*    PURPOSE: The CPU spends some cycles; the air catches up. */
+    void spend(uint64_t c) {
+        cycles += c;
+        uint64_t t = micros();
+        if (t > air->now()) air->runUntil(t);
+    }
+};
+
+inline ArduinoBoard* arduinoBoard = nullptr;
+
+
+inline void pinMode(uint8_t, uint8_t) {
+    arduinoBoard->spend(ARDUINO_SIM_PIN_CYCLES);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+    ArduinoBoard* b = arduinoBoard;
+    b->spend(ARDUINO_SIM_PIN_CYCLES);
+    if (pin == b->csnPin) {
+        b->spiCycles += ARDUINO_SIM_PIN_CYCLES;
+        if (value) {
+            b->chip->csnHigh();
+            if (b->selected) b->spiTransactions++;
+        } else {
+            b->chip->csnLow();
+        }
+        b->selected = !value;
+    } else if (pin == b->cePin) {
+        b->chip->ce(value != 0);
+    }
+}
+
+inline unsigned long millis() {
+    arduinoBoard->spend(ARDUINO_SIM_MILLIS_CYCLES);
+    return (unsigned long)((arduinoBoard->micros() - arduinoBoard->bootMicros) / 1000);
+}
+
+inline unsigned long micros() {
+    arduinoBoard->spend(ARDUINO_SIM_MILLIS_CYCLES);
+    return (unsigned long)(arduinoBoard->micros() - arduinoBoard->bootMicros);
+}
+
+inline void delayMicroseconds(unsigned int us) {
+    arduinoBoard->spend((uint64_t)us * ARDUINO_SIM_CYCLES_PER_MICRO);
+}
+
+inline void delay(unsigned long ms) {
+    arduinoBoard->spend((uint64_t)ms * 1000 * ARDUINO_SIM_CYCLES_PER_MICRO);
+}
+
+inline int analogRead(uint8_t) {
+    arduinoBoard->spend(ARDUINO_SIM_ADC_MICROS * ARDUINO_SIM_CYCLES_PER_MICRO);
+    return arduinoBoard->analogValue;
+}
+
+
+    /* ADCSRA: setting ADSC runs the conversion there and then, so the sketch's
+       wait on ADSC falls straight through and ADC holds the bandgap reading. */
+struct ArduinoSimAdcsra {
+    uint8_t value = 0;
+    operator uint8_t() const { return value; }
+    ArduinoSimAdcsra& operator|=(uint8_t bits) {
+        if (bits & _BV(ADSC)) {
+            arduinoBoard->spend(ARDUINO_SIM_ADC_MICROS * ARDUINO_SIM_CYCLES_PER_MICRO);
+            bits &= ~_BV(ADSC);
+        }
+        value |= bits;
+        return *this;
+    }
+};
+
+struct ArduinoSimAdc {
+    operator uint16_t() const { return arduinoBoard->bandgapValue; }
+};
+
+inline uint8_t ADMUX = 0;
+inline ArduinoSimAdcsra ADCSRA;
+inline ArduinoSimAdc ADC;
+
+
+    /* SPI.h */
+class SPIClass {
+  public:
+    void begin() {}
+    uint8_t transfer(uint8_t b) {
+        ArduinoBoard* board = arduinoBoard;
+        board->spend(ARDUINO_SIM_SPI_CYCLES);
+        board->spiCycles += ARDUINO_SIM_SPI_CYCLES;
+        board->spiBytes++;
+        return board->chip->transfer(b);
+    }
+};
+
+inline SPIClass SPI;
+
+#endif
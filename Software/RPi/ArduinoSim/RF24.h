@@ -0,0 +1,279 @@
+// RF24 library stand-in - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef ArduinoSim_RF24_h
+#define ArduinoSim_RF24_h
+
+#include "Arduino.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: The part of the RF24 library (TMRh20, 1.4.x) that the sketch's RadioComms calls,
+* for running the sketch against NrfSim without NRF24_LITE. The library itself isn't in this
+* tree, and it needs its own Arduino port, so this is a stand-in: each function puts the same
+* commands on the bus, in the same order, as the 1.4.x source does for an ATTiny84 (RF24_TINY).
+* That way the SPI traffic and time compared against Nrf24Lite (-F in RPi_RadioSim) is the
+* library's, not ours.
+*
+*    NOTE:
+*    1. Only what RadioComms uses. Error checks the library does that don't touch the bus
+*  (e.g., argument range checks) are left out.
+*    2. get_status() is the 1 byte NOP, and available() reads STATUS's RX_P_NO, as in 1.4.x.
+*  Older versions read FIFO_STATUS instead (2 bytes).
+*/
+
+typedef enum { RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR } rf24_pa_dbm_e;
+
+class RF24 {
+
+  public:
+
+    RF24(uint16_t cePin, uint16_t csnPin) : _cePin(cePin), _csnPin(csnPin) {}
+
+    bool begin();
+    bool write(const void* buf, uint8_t len);
+    uint8_t getARC() { return read_register(OBSERVE_TX) & 0x0F; }
+    bool available(uint8_t* pipe);
+    void read(void* buf, uint8_t len);
+    void setPALevel(uint8_t level, bool lnaEnable = true);
+    void openWritingPipe(const uint8_t* address);
+    void openReadingPipe(uint8_t child, const uint8_t* address);
+    void powerUp();
+    void powerDown();
+    uint8_t flush_tx() { return spiTrans(FLUSH_TX); }
+    uint8_t flush_rx() { return spiTrans(FLUSH_RX); }
+    void enableDynamicPayloads();
+    void enableAckPayload();
+    void stopListening();
+
+  private:
+    enum {
+        CONFIG = 0x00, EN_AA = 0x01, EN_RXADDR = 0x02, SETUP_AW = 0x03, SETUP_RETR = 0x04,
+        RF_CH = 0x05, RF_SETUP = 0x06, STATUS = 0x07, OBSERVE_TX = 0x08, RX_ADDR_P0 = 0x0A,
+        TX_ADDR = 0x10, RX_PW_P0 = 0x11, DYNPD = 0x1C, FEATURE = 0x1D,
+        R_REGISTER = 0x00, W_REGISTER = 0x20, R_RX_PAYLOAD = 0x61, W_TX_PAYLOAD = 0xA0,
+        FLUSH_TX = 0xE1, FLUSH_RX = 0xE2, ACTIVATE = 0x50, RF24_NOP = 0xFF,
+        EN_CRC = 0x08, CRCO = 0x04, PWR_UP = 0x02, PRIM_RX = 0x01,
+        RX_DR = 0x40, TX_DS = 0x20, MAX_RT = 0x10, EN_DPL = 0x04, EN_ACK_PAY = 0x02,
+    };
+    static const unsigned int POWERUP_DELAY = 5000; // us, RF24_POWERUP_DELAY.
+    static const unsigned int TX_DELAY = 280;       // us, setDataRate(RF24_1MBPS) on AVR.
+
+    uint16_t _cePin, _csnPin;
+    uint8_t _configReg = 0;
+    uint8_t _payloadSize = 32;
+    uint8_t _addrWidth = 5;
+    bool _dynamicPayloads = false;
+    bool _ackPayloads = false;
+
+    void csn(bool mode) { digitalWrite(_csnPin, mode); }
+    void ce(bool level) { digitalWrite(_cePin, level); }
+    uint8_t spiTrans(uint8_t cmd);
+    uint8_t read_register(uint8_t reg);
+    uint8_t write_register(uint8_t reg, uint8_t value);
+    uint8_t write_register(uint8_t reg, const uint8_t* buf, uint8_t len);
+    uint8_t get_status() { return spiTrans(RF24_NOP); }
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline uint8_t RF24::spiTrans(uint8_t cmd) {
+    csn(LOW);
+    uint8_t status = SPI.transfer(cmd);
+    csn(HIGH);
+    return status;
+}
+
+
+inline uint8_t RF24::read_register(uint8_t reg) {
+    csn(LOW);
+    SPI.transfer(R_REGISTER | reg);
+    uint8_t result = SPI.transfer(RF24_NOP);
+    csn(HIGH);
+    return result;
+}
+
+
+inline uint8_t RF24::write_register(uint8_t reg, uint8_t value) {
+    csn(LOW);
+    uint8_t status = SPI.transfer(W_REGISTER | reg);
+    SPI.transfer(value);
+    csn(HIGH);
+    return status;
+}
+
+
+inline uint8_t RF24::write_register(uint8_t reg, const uint8_t* buf, uint8_t len) {
+    csn(LOW);
+    uint8_t status = SPI.transfer(W_REGISTER | reg);
+    while (len--) SPI.transfer(*buf++);
+    csn(HIGH);
+    return status;
+}
+
+
+inline bool RF24::begin() {
+    pinMode(_cePin, OUTPUT);
+    pinMode(_csnPin, OUTPUT);
+    ce(LOW);
+    csn(HIGH);
+    SPI.begin();
+    delay(5);
+
+    write_register(SETUP_RETR, (5 << 4) | 15);         // setRetries(5, 15)
+    write_register(RF_SETUP, read_register(RF_SETUP) & ~0x28);     // setDataRate(RF24_1MBPS) ...
+    read_register(RF_SETUP);                            // ... and its read back.
+
+        /* toggle_features(), then FEATURE/DYNPD off. */
+    csn(LOW);
+    SPI.transfer(ACTIVATE);
+    SPI.transfer(0x73);
+    csn(HIGH);
+    write_register(FEATURE, 0);
+    write_register(DYNPD, 0);
+    _dynamicPayloads = false;
+    _ackPayloads = false;
+
+    write_register(EN_AA, 0x3F);
+    write_register(EN_RXADDR, 3);
+    for (uint8_t i = 0; i < 6; i++) write_register(RX_PW_P0 + i, _payloadSize);    // setPayloadSize(32)
+    write_register(SETUP_AW, _addrWidth - 2);           // setAddressWidth(5)
+    write_register(RF_CH, 76);                          // setChannel(76)
+    write_register(STATUS, RX_DR | TX_DS | MAX_RT);
+    flush_rx();
+    flush_tx();
+
+    write_register(CONFIG, EN_CRC | CRCO);
+    _configReg = read_register(CONFIG);
+    powerUp();
+    return _configReg == (EN_CRC | CRCO | PWR_UP);
+}
+
+
+inline bool RF24::write(const void* buf, uint8_t len) {
+        /* startFastWrite(): write_payload(), then CE high. */
+    const uint8_t* p = (const uint8_t*)buf;
+    uint8_t dataLen = len < _payloadSize ? len : _payloadSize;
+    uint8_t blankLen = _dynamicPayloads ? 0 : _payloadSize - dataLen;
+    csn(LOW);
+    SPI.transfer(W_TX_PAYLOAD);
+    while (dataLen--) SPI.transfer(*p++);
+    while (blankLen--) SPI.transfer(0);
+    csn(HIGH);
+    ce(HIGH);
+
+    unsigned long timer = millis();
+    while (!(get_status() & (TX_DS | MAX_RT))) {
+        if (millis() - timer > 95) {
+            ce(LOW);
+            return false;
+        }
+    }
+    ce(LOW);
+
+    uint8_t status = write_register(STATUS, RX_DR | TX_DS | MAX_RT);
+    if (status & MAX_RT) {
+        flush_tx();
+        return false;
+    }
+    return true;
+}
+
+
+inline bool RF24::available(uint8_t* pipe) {
+    uint8_t p = (get_status() >> 1) & 0x07;
+    if (p > 5) return false;
+    if (pipe) *pipe = p;
+    return true;
+}
+
+
+inline void RF24::read(void* buf, uint8_t len) {
+        /* read_payload(): len bytes, padded out to the payload size unless dynamic. */
+    uint8_t* p = (uint8_t*)buf;
+    uint8_t dataLen = len < _payloadSize ? len : _payloadSize;
+    uint8_t blankLen = _dynamicPayloads ? 0 : _payloadSize - dataLen;
+    csn(LOW);
+    SPI.transfer(R_RX_PAYLOAD);
+    while (dataLen--) *p++ = SPI.transfer(0xFF);
+    while (blankLen--) SPI.transfer(0xFF);
+    csn(HIGH);
+    write_register(STATUS, RX_DR);
+}
+
+
+inline void RF24::setPALevel(uint8_t level, bool lnaEnable) {
+    uint8_t setup = read_register(RF_SETUP) & 0xF8;
+    if (level > RF24_PA_MAX) level = RF24_PA_MAX;
+    setup |= (level << 1) | (lnaEnable ? 1 : 0);
+    write_register(RF_SETUP, setup);
+}
+
+
+inline void RF24::openWritingPipe(const uint8_t* address) {
+    write_register(RX_ADDR_P0, address, _addrWidth);
+    write_register(TX_ADDR, address, _addrWidth);
+    write_register(RX_PW_P0, _payloadSize);
+}
+
+
+inline void RF24::openReadingPipe(uint8_t child, const uint8_t* address) {
+    if (child == 0 || child > 5) return;                // Pipe 0 is only cached by the library until startListening().
+    write_register(RX_ADDR_P0 + child, address, child < 2 ? _addrWidth : 1);
+    write_register(RX_PW_P0 + child, _payloadSize);
+    write_register(EN_RXADDR, read_register(EN_RXADDR) | (1 << child));
+}
+
+
+inline void RF24::powerUp() {
+    if (!(_configReg & PWR_UP)) {
+        _configReg |= PWR_UP;
+        write_register(CONFIG, _configReg);
+        delayMicroseconds(POWERUP_DELAY);
+    }
+}
+
+
+inline void RF24::powerDown() {
+    ce(LOW);
+    _configReg &= ~PWR_UP;
+    write_register(CONFIG, _configReg);
+}
+
+
+inline void RF24::enableDynamicPayloads() {
+    write_register(FEATURE, read_register(FEATURE) | EN_DPL);
+    write_register(DYNPD, read_register(DYNPD) | 0x3F);
+    _dynamicPayloads = true;
+}
+
+
+inline void RF24::enableAckPayload() {
+    if (!_ackPayloads) {
+        write_register(FEATURE, read_register(FEATURE) | EN_ACK_PAY | EN_DPL);
+        write_register(DYNPD, read_register(DYNPD) | 0x03);
+        _dynamicPayloads = true;
+        _ackPayloads = true;
+    }
+}
+
+
+inline void RF24::stopListening() {
+    ce(LOW);
+    delayMicroseconds(TX_DELAY);
+    if (read_register(FEATURE) & EN_ACK_PAY) {
+        delayMicroseconds(TX_DELAY);
+        flush_tx();
+    }
+    _configReg &= ~PRIM_RX;
+    write_register(CONFIG, _configReg);
+    write_register(EN_RXADDR, read_register(EN_RXADDR) | 1);
+}
+
+#endif
@@ -0,0 +1,9 @@
+// SPI library stand-in - see Arduino.h here.
+//=================================================================================================
+
+#ifndef ArduinoSim_SPI_h
+#define ArduinoSim_SPI_h
+
+#include "Arduino.h"                // SPIClass and SPI live there, with the rest of the board.
+
+#endif
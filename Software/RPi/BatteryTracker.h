@@ -0,0 +1,127 @@
+// Class: BatteryTracker - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef BatteryTracker_h
+#define BatteryTracker_h
+
+#include <cstdint>
+#include <ctime>
+
+/************************************************************************************************
+*
+*    PURPOSE: Follows each sensor's supply voltage (vccMillivolts in the payload) over time and
+* projects when its battery will be too low to run on. Readings come in every 15 minutes or so
+* and the bandgap measurement on the tiny84 is noisy, so readings are averaged into one 'curve
+* point' per BATT_POINT_SECONDS. A least squares line through the last BATT_CURVE_POINTS points
+* gives the discharge rate, and from that the hours left until BATT_EMPTY_MV.
+*
+*    USAGE:
+*    1. Keep one BatteryState per sensor (it lives in SensorState, see SensorRegistry.h).
+*    2. Call BatteryTracker::update() with each reading's time and voltage.
+*    3. BatteryState.mvPerDay and .hoursToEmpty hold the current projection. hoursToEmpty is
+*  negative when there is no projection - too few points yet, or the voltage isn't falling
+*  (e.g., a sensor on a wall-wart).
+*
+*    NOTE:
+*    1. A reading of 0 means the sensor had no measurement; it is ignored.
+*/
+
+#define BATT_POINT_SECONDS (60 * 60 * 6)    // One curve point per 6 hours ...
+#define BATT_CURVE_POINTS 28                // ... 7 days of them.
+#define BATT_MIN_POINTS 4                   // Points needed before we project anything.
+#define BATT_EMPTY_MV 2700                  // ATTiny84 at 8MHz needs 2.7V.
+
+
+struct BatteryState {
+    uint16_t lastMillivolts;
+    uint16_t points;                        // Curve points held, up to BATT_CURVE_POINTS.
+    uint16_t head;                          // Where the next curve point goes.
+    uint16_t bucketCount;                   // Readings in the point being accumulated.
+    uint32_t bucketSum;
+    time_t bucketStart;
+    time_t pointTime[BATT_CURVE_POINTS];
+    uint16_t pointMillivolts[BATT_CURVE_POINTS];
+    float mvPerDay;                         // Discharge rate; negative when discharging.
+    float hoursToEmpty;                     // < 0 if no projection.
+};
+
+
+class BatteryTracker {
+
+  public:
+
+          /*    PURPOSE: Add a voltage reading to a sensor's discharge curve and
+           *  re-project the time to empty when a new curve point is completed. */
+    static void update(BatteryState& st, time_t now, uint16_t millivolts);
+
+  private:
+    static void project(BatteryState& st);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline void BatteryTracker::update(BatteryState& st, time_t now, uint16_t millivolts) {
+    if (millivolts == 0) return;
+    st.lastMillivolts = millivolts;
+
+    if (st.bucketCount == 0) {
+        st.bucketStart = now;
+        if (st.points == 0) st.hoursToEmpty = -1;
+    }
+    st.bucketSum += millivolts;
+    st.bucketCount++;
+    if (now - st.bucketStart < BATT_POINT_SECONDS) return;
+
+        /* Point is complete. Time-stamp it at the middle of its span. */
+    st.pointTime[st.head] = st.bucketStart + (now - st.bucketStart) / 2;
+    st.pointMillivolts[st.head] = st.bucketSum / st.bucketCount;
+    st.head = (st.head + 1) % BATT_CURVE_POINTS;
+    if (st.points < BATT_CURVE_POINTS) st.points++;
+    st.bucketSum = 0;
+    st.bucketCount = 0;
+    project(st);
+}
+
+
+inline void BatteryTracker::project(BatteryState& st) {
+    st.hoursToEmpty = -1;
+    if (st.points < BATT_MIN_POINTS) return;
+
+        /* Least squares fit of millivolts against days, with days measured from
+           the oldest point to keep the numbers small. */
+    unsigned int oldest = (st.head + BATT_CURVE_POINTS - st.points) % BATT_CURVE_POINTS;
+    time_t t0 = st.pointTime[oldest];
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (unsigned int k = 0; k < st.points; k++) {
+        unsigned int i = (oldest + k) % BATT_CURVE_POINTS;
+        double x = (st.pointTime[i] - t0) / 86400.0;
+        double y = st.pointMillivolts[i];
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    double n = st.points;
+    double denom = n * sumXX - sumX * sumX;
+    if (denom <= 0) return;
+    double slope = (n * sumXY - sumX * sumY) / denom;
+    double intercept = (sumY - slope * sumX) / n;
+    st.mvPerDay = slope;
+    if (slope >= 0) return;
+
+        /* Project from the fitted line's value at the newest point, not the raw
+           reading, so one noisy reading doesn't swing the projection. */
+    unsigned int newest = (st.head + BATT_CURVE_POINTS - 1) % BATT_CURVE_POINTS;
+    double xNow = (st.pointTime[newest] - t0) / 86400.0;
+    double mvNow = intercept + slope * xNow;
+    double days = (mvNow - BATT_EMPTY_MV) / -slope;
+    st.hoursToEmpty = (days > 0) ? days * 24.0 : 0;
+}
+
+#endif
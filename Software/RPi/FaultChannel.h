@@ -0,0 +1,199 @@
+// Class: FaultChannel - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef FaultChannel_h
+#define FaultChannel_h
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "NrfSim.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: Repeatable radio trouble for the simulated air (NrfSim.h). A FaultChannel plugs
+* into VirtualAir::channel and decides, frame by frame and chip by chip, what goes wrong. The
+* kinds of trouble can be mixed:
+*    > Random loss (Bernoulli): every frame has the same chance of being lost.
+*    > Burst loss (Gilbert-Elliott): the channel flips between a 'good' and a 'bad' state, each
+*      with its own loss rate. This is closer to what WiFi or a microwave oven does to us.
+*    > ACK-only loss: only ACKs are lost. The sensor retransmits a reading the RPi already has.
+*    > Bit corruption: a bit is flipped; the chip's CRC check throws the frame out.
+*    > Duplication: a frame is heard twice.
+*    > Delay: a fixed delay plus random jitter on every frame.
+*
+*    Everything comes from the channel's own seeded generator, so the same seed and the same
+* traffic gives the same faults every run.
+*
+*    USAGE:
+*    1. Construct with a seed, then parse() a profile string, or set the fields directly.
+*    2. attach() it to the VirtualAir.
+*    3. Profile strings are comma separated name=value items, e.g.:
+*           "loss=0.05"                 5% random loss
+*           "ge=0.01/0.2/0.0/0.8"       Gilbert-Elliott: P(good->bad)/P(bad->good)/loss good/loss bad
+*           "ackloss=0.1,dup=0.01"      10% of ACKs lost, 1% of frames duplicated
+*           "corrupt=0.02"              2% of frames get a bit flipped
+*           "delay=200/100"             200us + up to 100us jitter
+*       "clean" (or "") is no faults.
+*
+*    NOTE:
+*    1. The Gilbert-Elliott state steps once per frame heard (per chip), not per unit of time.
+*    2. parse() returns false on anything it doesn't understand; the channel is left as it was.
+*/
+
+class FaultChannel {
+
+  public:
+
+    double loss = 0;                    // Bernoulli loss, all frames.
+    double geGoodToBad = 0;             // Gilbert-Elliott. Off while both are 0.
+    double geBadToGood = 1;
+    double geLossGood = 0;
+    double geLossBad = 0;
+    double ackLoss = 0;                 // ACKs only.
+    double corrupt = 0;
+    double duplicate = 0;
+    uint32_t duplicateMicros = 50;
+    uint32_t delayMicros = 0;
+    uint32_t jitterMicros = 0;
+
+        /* What it has done. */
+    unsigned long dropped = 0;
+    unsigned long ackDropped = 0;
+    unsigned long corrupted = 0;
+    unsigned long duplicated = 0;
+    unsigned long badFrames = 0;        // Frames heard while Gilbert-Elliott was 'bad'.
+
+          /*    PURPOSE: Constructor. */
+    FaultChannel(uint64_t seed = 1) : _rng(seed ? seed : 1) {}
+
+          /*    PURPOSE: Set up from a profile string. RETURNS: False if it
+           *  couldn't be parsed. */
+    bool parse(const std::string& profile);
+
+          /*    PURPOSE: Become the air's channel hook. */
+    void attach(VirtualAir& air);
+
+          /*    PURPOSE: The hook itself. Every receiver is treated alike, so
+           *  which chip the frame is for isn't looked at. */
+    void decide(AirFrame& frame, const NrfSim*, FrameFate& fate);
+
+  private:
+    uint64_t _rng;
+    bool _bad = false;
+
+    double random();
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline double FaultChannel::random() {
+    _rng ^= _rng << 13;                 // xorshift64
+    _rng ^= _rng >> 7;
+    _rng ^= _rng << 17;
+    return (_rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+inline bool FaultChannel::parse(const std::string& profile) {
+    FaultChannel f(_rng);
+    if (profile.empty() || profile == "clean") {
+        *this = f;
+        return true;
+    }
+    size_t pos = 0;
+    while (pos <= profile.size()) {
+        size_t end = profile.find(',', pos);
+        if (end == std::string::npos) end = profile.size();
+        std::string item = profile.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) return false;
+        std::string name = item.substr(0, eq);
+        double v[4] = {0, 0, 0, 0};
+        int n = 0;
+        const char* p = item.c_str() + eq + 1;
+        while (n < 4) {
+            char* next;
+            v[n] = strtod(p, &next);
+            if (next == p) return false;
+            n++;
+            if (*next != '/') {
+                if (*next != '\0') return false;
+                break;
+            }
+            p = next + 1;
+        }
+
+        if (name == "loss" && n == 1) f.loss = v[0];
+        else if (name == "ackloss" && n == 1) f.ackLoss = v[0];
+        else if (name == "corrupt" && n == 1) f.corrupt = v[0];
+        else if (name == "dup" && n <= 2) { f.duplicate = v[0]; if (n == 2) f.duplicateMicros = v[1]; }
+        else if (name == "delay" && n <= 2) { f.delayMicros = v[0]; f.jitterMicros = v[1]; }
+        else if (name == "ge" && n == 4) {
+            f.geGoodToBad = v[0];
+            f.geBadToGood = v[1];
+            f.geLossGood = v[2];
+            f.geLossBad = v[3];
+        }
+        else return false;
+    }
+    *this = f;
+    return true;
+}
+
+
+inline void FaultChannel::attach(VirtualAir& air) {
+    air.channel = [this](AirFrame& frame, const NrfSim* to, FrameFate& fate) { decide(frame, to, fate); };
+}
+
+
+inline void FaultChannel::decide(AirFrame& frame, const NrfSim*, FrameFate& fate) {
+        /* Draw every number every time, whether it is used or not, so that turning
+           one kind of fault on doesn't shift the random sequence of the others. */
+    double rLoss = random(), rGeStep = random(), rGeLoss = random(), rAck = random();
+    double rCorrupt = random(), rBit = random(), rDup = random(), rJitter = random();
+
+    if (geGoodToBad > 0 || geBadToGood < 1) {
+        _bad = _bad ? (rGeStep >= geBadToGood) : (rGeStep < geGoodToBad);
+        if (_bad) badFrames++;
+        if (rGeLoss < (_bad ? geLossBad : geLossGood)) {
+            fate.drop = true;
+            dropped++;
+            return;
+        }
+    }
+    if (rLoss < loss) {
+        fate.drop = true;
+        dropped++;
+        return;
+    }
+    if (frame.isAck && rAck < ackLoss) {
+        fate.drop = true;
+        ackDropped++;
+        return;
+    }
+    if (rCorrupt < corrupt) {
+        unsigned int bits = 8 * (frame.len ? frame.len : 1);
+        unsigned int bit = (unsigned int)(rBit * bits);
+        if (frame.len) frame.payload[bit / 8] ^= (1 << (bit % 8));
+        fate.corrupt = true;
+        corrupted++;
+    }
+    if (rDup < duplicate) {
+        fate.duplicate = true;
+        fate.duplicateMicros = duplicateMicros;
+        duplicated++;
+    }
+    fate.delayMicros = delayMicros + (uint32_t)(rJitter * jitterMicros);
+}
+
+#endif
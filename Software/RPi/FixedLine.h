@@ -0,0 +1,116 @@
+// Class: FixedLine - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef FixedLine_h
+#define FixedLine_h
+
+#include <charconv>    // std::to_chars
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+/************************************************************************************************
+*
+*    PURPOSE: Builds a line of text in a fixed buffer, for the places where an ostringstream
+* would go to the heap on every packet. Numbers go in with std::to_chars, which never allocates
+* and never looks at the locale.
+*
+*    USAGE:
+*    1. Keep a FixedLine around (a member, a static); clear() it and add() pieces.
+*    2. add() takes C strings, chars, any integer type, and floating point (printed like
+*  ostream's default, i.e. %g with 6 significant digits, unless a precision is given).
+*    3. c_str() / size() for the result.
+*
+*    NOTE:
+*    1. A line that would overflow is cut short at FIXEDLINE_SIZE - 1 characters and
+*  truncated() is set; it is never written past the end.
+*    2. Floating point to_chars needs GCC 11 or later (Raspberry Pi OS Bookworm has 12).
+*/
+
+#define FIXEDLINE_SIZE 512
+
+
+class FixedLine {
+
+  public:
+
+    FixedLine() { clear(); }
+
+    void clear() { _len = 0; _buf[0] = '\0'; _truncated = false; }
+
+    FixedLine& add(const char* s);
+    FixedLine& add(char c);
+    FixedLine& add(double v, int precision = 6);
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, char>::value &&
+                                                  !std::is_same<T, bool>::value, int>::type = 0>
+    FixedLine& add(T v, int base = 10);
+
+    const char* c_str() const { return _buf; }
+    size_t size() const { return _len; }
+    bool truncated() const { return _truncated; }
+
+  private:
+    char _buf[FIXEDLINE_SIZE];
+    size_t _len;
+    bool _truncated;
+
+    char* end() { return _buf + FIXEDLINE_SIZE - 1; }      // Room kept for the '\0'.
+    FixedLine& finish(char* p, bool ok);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline FixedLine& FixedLine::add(const char* s) {
+    size_t n = strlen(s);
+    size_t room = FIXEDLINE_SIZE - 1 - _len;
+    if (n > room) {
+        n = room;
+        _truncated = true;
+    }
+    memcpy(_buf + _len, s, n);
+    _len += n;
+    _buf[_len] = '\0';
+    return *this;
+}
+
+
+inline FixedLine& FixedLine::add(char c) {
+    if (_len >= FIXEDLINE_SIZE - 1) {
+        _truncated = true;
+        return *this;
+    }
+    _buf[_len++] = c;
+    _buf[_len] = '\0';
+    return *this;
+}
+
+
+inline FixedLine& FixedLine::add(double v, int precision) {
+    std::to_chars_result r = std::to_chars(_buf + _len, end(), v, std::chars_format::general, precision);
+    return finish(r.ptr, r.ec == std::errc());
+}
+
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, char>::value &&
+                                              !std::is_same<T, bool>::value, int>::type>
+inline FixedLine& FixedLine::add(T v, int base) {
+    std::to_chars_result r = std::to_chars(_buf + _len, end(), v, base);
+    return finish(r.ptr, r.ec == std::errc());
+}
+
+
+inline FixedLine& FixedLine::finish(char* p, bool ok) {
+    if (ok) _len = p - _buf;
+    else _truncated = true;
+    _buf[_len] = '\0';
+    return *this;
+}
+
+#endif
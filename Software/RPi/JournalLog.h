@@ -0,0 +1,375 @@
+// Class: JournalLog - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef JournalLog_h
+#define JournalLog_h
+
+#include <cerrno>
+#include <charconv>         // std::to_chars
+#include <cstddef>          // offsetof
+#include <cstdint>
+#include <cstdio>           // sscanf()
+#include <cstdlib>          // getenv()
+#include <cstring>
+#include <ostream>
+#include <syslog.h>         // LOG_ERR, LOG_WARNING, LOG_NOTICE, LOG_INFO
+#include <sys/socket.h>     // socket(), sendmmsg()
+#include <sys/stat.h>       // fstat()
+#include <sys/un.h>         // sockaddr_un
+#include <time.h>           // clock_gettime()
+#include <type_traits>
+#include <unistd.h>         // close()
+
+/************************************************************************************************
+*
+*    PURPOSE: Writes events to the systemd journal as structured entries - the message, plus
+* fields such as SENSOR_ID=12, PA_FROM=1, PA_TO=2 - over the journal's native protocol, so they
+* can be picked out with e.g. journalctl EVENT=pa-change SENSOR_ID=12. Each event type has its
+* own rate limit, so a storm of one kind can't flood the journal or the CPU. Entries are built
+* straight into a queue and sent, a batch at a time, with one non-blocking sendmmsg().
+*
+*    When the journal isn't there - run by hand in a terminal - just the message goes to a
+* console stream, without the flush that endl does.
+*
+*    USAGE:
+*    1. Construct with the identifier (SYSLOG_IDENTIFIER), and addType() each event type with
+*  its rate limit, in the order of the type numbers you will use.
+*    2. openIfJournal() uses the journal if stdout is the journal's (JOURNAL_STREAM), as it is
+*  for a systemd service; open() a given socket, e.g. a stand-in for a test.
+*    3. For each event: if (start(type, priority)) { field() as many as wanted; send(message); }
+*  start() returns false if the type is over its limit; that is counted, and the next entry of
+*  the type that gets through says how many were suppressed (SUPPRESSED=n).
+*    4. flush() when idle, e.g. from the main loop's nap. send() also flushes when
+*  JOURNAL_BATCH entries are queued or the oldest has waited JOURNAL_FLUSH_MICROS - but not
+*  for JOURNAL_BUSY_MICROS after the journal's socket was full.
+*
+*    NOTE:
+*    1. Nothing here allocates, and a send never waits: if the journal isn't keeping up the
+*  entries stay queued until the next flush; if the queue is full as well, the new entry is
+*  dropped and counted.
+*    2. Field names must be upper case letters, digits and underscores, not starting with '_'.
+*    3. A path starting with '@' is in the abstract namespace.
+*    4. One thread.
+*/
+
+#define JOURNAL_SOCKET "/run/systemd/journal/socket"
+#define JOURNAL_QUEUE 64                // Entries waiting to be sent.
+#define JOURNAL_BATCH 16                // Send once this many are queued ...
+#define JOURNAL_FLUSH_MICROS 100000     // ... or the oldest has waited this long.
+#define JOURNAL_BUSY_MICROS 5000        // After the journal said EAGAIN, send() leaves it alone this long.
+#define JOURNAL_ENTRY_BYTES 1024
+#define JOURNAL_MAX_TYPES 16
+
+
+class JournalLog {
+
+  public:
+
+          /*    PURPOSE: Constructor. identifier goes in every entry's SYSLOG_IDENTIFIER. */
+    JournalLog(const char* identifier);
+    ~JournalLog();
+
+    JournalLog(const JournalLog&) = delete;
+    JournalLog& operator=(const JournalLog&) = delete;
+
+          /*    PURPOSE: Add an event type, allowed burst entries at once and
+           *  perMinute after that. perMinute 0 = no limit.
+           *    RETURNS: Its type number: 0, 1, 2 ... in the order added. */
+    int addType(const char* name, unsigned int burst, unsigned int perMinute);
+
+          /*    PURPOSE: Send to the journal if stdout goes to it.
+           *    RETURNS: True if it does. */
+    bool openIfJournal();
+
+          /*    PURPOSE: Send to the given datagram socket.
+           *    RETURNS: False if no socket could be made. */
+    bool open(const char* path);
+
+    bool isOpen() const { return _fd >= 0; }
+
+          /*    PURPOSE: Entries waiting to be sent. */
+    unsigned int queued() const { return _count; }
+
+          /*    PURPOSE: Begin an entry.
+           *    RETURNS: False if the type is over its limit or the queue is
+           *  full: don't go on with it. */
+    bool start(int type, int priority = LOG_INFO);
+
+    JournalLog& field(const char* name, const char* value);
+    JournalLog& field(const char* name, double value);
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    JournalLog& field(const char* name, T value);
+
+          /*    PURPOSE: Finish the entry with its message, and queue it. */
+    void send(const char* message);
+
+          /*    PURPOSE: Send whatever is queued, without waiting. */
+    void flush();
+
+    std::ostream* console = NULL;       // Without the journal, messages go here (if set).
+    uint64_t (*clock)() = monotonicMicros;
+
+        /* Counts. */
+    unsigned long entries = 0;          // Queued to go.
+    unsigned long suppressed = 0;       // Over their type's limit.
+    unsigned long dropped = 0;          // Queue full, or the journal refused them.
+    unsigned long batches = 0;          // sendmmsg() calls.
+
+    static uint64_t monotonicMicros();
+
+  private:
+    struct Type {
+        const char* name;
+        double tokens;
+        double burst;
+        double perMicro;
+        uint64_t last;
+        unsigned long suppressed;       // Since the last one that got through.
+    };
+    struct Entry {
+        uint32_t len;
+        uint64_t queued;
+        char data[JOURNAL_ENTRY_BYTES];
+    };
+
+    const char* _identifier;
+    int _fd = -1;
+    sockaddr_un _addr;
+    socklen_t _addrLen = 0;
+    Type _types[JOURNAL_MAX_TYPES];
+    int _numTypes = 0;
+    Entry _queue[JOURNAL_QUEUE];
+    unsigned int _head = 0;             // Oldest queued.
+    unsigned int _count = 0;
+    uint64_t _busyUntil = 0;
+    Entry* _entry = NULL;               // Being built; NULL if none, or to the console.
+    int _type = -1;                     // Of the entry being built; -1 if none.
+
+    bool allow(Type& t, uint64_t now);
+    void append(const char* name, const char* value, size_t len);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline JournalLog::JournalLog(const char* identifier) : _identifier(identifier) {
+    memset(&_addr, 0, sizeof(_addr));
+}
+
+
+inline JournalLog::~JournalLog() {
+    flush();
+    if (_fd >= 0) close(_fd);
+}
+
+
+inline uint64_t JournalLog::monotonicMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);         // A few ms resolution is plenty; no system call.
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+
+inline int JournalLog::addType(const char* name, unsigned int burst, unsigned int perMinute) {
+    if (_numTypes >= JOURNAL_MAX_TYPES) return -1;
+    Type& t = _types[_numTypes];
+    t.name = name;
+    t.burst = burst;
+    t.tokens = burst;
+    t.perMicro = perMinute / 60e6;
+    t.last = 0;
+    t.suppressed = 0;
+    if (perMinute == 0) t.burst = 0;                    // 0 = no limit.
+    return _numTypes++;
+}
+
+
+inline bool JournalLog::openIfJournal() {
+    const char* stream = getenv("JOURNAL_STREAM");
+    if (!stream) return false;
+    unsigned long long dev = 0, ino = 0;
+    if (sscanf(stream, "%llu:%llu", &dev, &ino) != 2) return false;
+    struct stat sb;
+    if (fstat(STDOUT_FILENO, &sb) != 0 || sb.st_dev != (dev_t)dev || sb.st_ino != (ino_t)ino) return false;
+    return open(JOURNAL_SOCKET);
+}
+
+
+inline bool JournalLog::open(const char* path) {
+    size_t len = strlen(path);
+    if (len >= sizeof(_addr.sun_path)) return false;
+    if (_fd >= 0) close(_fd);
+    memset(&_addr, 0, sizeof(_addr));
+    _fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (_fd < 0) return false;
+    _addr.sun_family = AF_UNIX;
+    memcpy(_addr.sun_path, path, len);
+    if (path[0] == '@') _addr.sun_path[0] = '\0';           // Abstract: no terminating '\0' in the length.
+    _addrLen = offsetof(sockaddr_un, sun_path) + len + (path[0] == '@' ? 0 : 1);
+    return true;
+}
+
+
+    /* Token bucket: burst entries at once, refilled at perMinute. */
+inline bool JournalLog::allow(Type& t, uint64_t now) {
+    if (t.burst == 0) return true;
+    if (now > t.last) {
+        t.tokens += (now - t.last) * t.perMicro;
+        if (t.tokens > t.burst) t.tokens = t.burst;
+    }
+    t.last = now;
+    if (t.tokens < 1) return false;
+    t.tokens -= 1;
+    return true;
+}
+
+
+inline bool JournalLog::start(int type, int priority) {
+    _entry = NULL;
+    _type = -1;
+    if (type < 0 || type >= _numTypes) return false;
+    Type& t = _types[type];
+    uint64_t now = clock();
+    if (!allow(t, now)) {
+        t.suppressed++;
+        suppressed++;
+        return false;
+    }
+    if (_fd < 0) {                                      // Console: only the message.
+        _type = type;
+        return true;
+    }
+    if (_count == JOURNAL_QUEUE && now >= _busyUntil) flush();
+    if (_count == JOURNAL_QUEUE) {
+        dropped++;
+        return false;
+    }
+    _type = type;
+    _entry = &_queue[(_head + _count) % JOURNAL_QUEUE];
+    _entry->len = 0;
+    _entry->queued = now;
+
+    char p = '0' + (priority & 7);
+    append("PRIORITY", &p, 1);
+    append("SYSLOG_IDENTIFIER", _identifier, strlen(_identifier));
+    append("EVENT", t.name, strlen(t.name));
+    return true;
+}
+
+
+    /* NAME=value\n, or if the value has a newline in it, the binary form:
+       NAME\n, 64-bit little-endian length, value, \n. A field that won't
+       fit is left out. */
+inline void JournalLog::append(const char* name, const char* value, size_t len) {
+    if (!_entry) return;
+    size_t nameLen = strlen(name);
+    bool binary = memchr(value, '\n', len) != NULL;
+    size_t need = nameLen + 1 + (binary ? 8 : 0) + len + 1;
+    if (_entry->len + need > JOURNAL_ENTRY_BYTES) return;
+    char* p = _entry->data + _entry->len;
+    memcpy(p, name, nameLen);
+    p += nameLen;
+    if (binary) {
+        *p++ = '\n';
+        uint64_t n = len;
+        for (int k = 0; k < 8; k++) *p++ = (char)(n >> (8 * k));
+    } else {
+        *p++ = '=';
+    }
+    memcpy(p, value, len);
+    p += len;
+    *p++ = '\n';
+    _entry->len = p - _entry->data;
+}
+
+
+inline JournalLog& JournalLog::field(const char* name, const char* value) {
+    append(name, value, strlen(value));
+    return *this;
+}
+
+
+inline JournalLog& JournalLog::field(const char* name, double value) {
+    char buf[32];
+    std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::general, 6);
+    if (r.ec == std::errc()) append(name, buf, r.ptr - buf);
+    return *this;
+}
+
+
+template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type>
+inline JournalLog& JournalLog::field(const char* name, T value) {
+    char buf[24];
+    std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), value);
+    if (r.ec == std::errc()) append(name, buf, r.ptr - buf);
+    return *this;
+}
+
+
+inline void JournalLog::send(const char* message) {
+    if (_type < 0) return;
+    Type& t = _types[_type];
+    unsigned long skipped = t.suppressed;
+    t.suppressed = 0;
+    _type = -1;
+
+    if (!_entry) {
+        if (!console) return;
+        *console << message;
+        if (skipped) *console << " (" << skipped << " more suppressed)";
+        *console << '\n';
+        entries++;
+        return;
+    }
+
+    if (skipped) field("SUPPRESSED", skipped);
+    append("MESSAGE", message, strlen(message));
+    _entry = NULL;
+    _count++;
+    entries++;
+    uint64_t now = clock();
+    if (now < _busyUntil) return;
+    if (_count >= JOURNAL_BATCH || now - _queue[_head].queued >= JOURNAL_FLUSH_MICROS) flush();
+}
+
+
+inline void JournalLog::flush() {
+    if (_fd < 0) {
+        if (console) console->flush();
+        return;
+    }
+    while (_count > 0) {
+        mmsghdr msgs[JOURNAL_QUEUE];
+        iovec iov[JOURNAL_QUEUE];
+        unsigned int n = 0;
+        for (unsigned int k = 0; k < _count && _head + k < JOURNAL_QUEUE; k++, n++) {   // Up to the end of the ring.
+            Entry& e = _queue[_head + k];
+            iov[n].iov_base = e.data;
+            iov[n].iov_len = e.len;
+            memset(&msgs[n], 0, sizeof(mmsghdr));
+            msgs[n].msg_hdr.msg_name = &_addr;
+            msgs[n].msg_hdr.msg_namelen = _addrLen;
+            msgs[n].msg_hdr.msg_iov = &iov[n];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+        }
+        batches++;
+        int sent = sendmmsg(_fd, msgs, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {   // Journal busy: later.
+                _busyUntil = clock() + JOURNAL_BUSY_MICROS;
+                return;
+            }
+            sent = 1;                                   // Refused (e.g. journald restarting): drop this one.
+            dropped++;
+        }
+        _head = (_head + sent) % JOURNAL_QUEUE;
+        _count -= sent;
+    }
+}
+
+#endif
@@ -0,0 +1,135 @@
+// Class: LatencyHistogram - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef LatencyHistogram_h
+#define LatencyHistogram_h
+
+#include <cstdint>
+#include <cstring>
+
+/************************************************************************************************
+*
+*    PURPOSE: Counts how long something took, in nanoseconds, without keeping the samples. Values
+* are put in log-linear buckets the way HDR histograms do it: below LATHIST_SUB every value has
+* its own bucket, above that each power of two is split into LATHIST_SUB buckets. So any value
+* is known to within 1/LATHIST_SUB (about 3%) from 1ns up to the full range of a uint64_t, in a
+* fixed 15KB table. Recording is a couple of shifts and an increment.
+*
+*    USAGE:
+*    1. Declare one per thing being timed. record() each time in nanoseconds.
+*    2. percentile(50), percentile(99.9) etc., plus count(), min(), max(), mean().
+*    3. add() folds one histogram into another, e.g. to total up per-thread histograms.
+*
+*    NOTE:
+*    1. percentile() reports the top of the bucket the percentile falls in, so it may be up to
+*  ~3% high, never low.
+*    2. Not thread safe. Give each thread its own and add() them up.
+*/
+
+#define LATHIST_SUB_BITS 5
+#define LATHIST_SUB (1 << LATHIST_SUB_BITS)                    // Buckets per power of two.
+#define LATHIST_BUCKETS ((64 - LATHIST_SUB_BITS + 1) * LATHIST_SUB)
+
+
+class LatencyHistogram {
+
+  public:
+
+          /*    PURPOSE: Constructor. Starts empty. */
+    LatencyHistogram() { reset(); }
+
+          /*    PURPOSE: Count one value. */
+    void record(uint64_t nanos);
+
+          /*    PURPOSE: Fold another histogram's counts into this one. */
+    void add(const LatencyHistogram& other);
+
+          /*    PURPOSE: Empty it. */
+    void reset();
+
+          /*    PURPOSE: The value that pct percent of the values are at or under.
+           *  RETURNS: 0 if nothing has been recorded. */
+    uint64_t percentile(double pct) const;
+
+    uint64_t count() const { return _count; }
+    uint64_t min() const { return _count ? _min : 0; }
+    uint64_t max() const { return _max; }
+    double mean() const { return _count ? (double)_sum / _count : 0; }
+
+  private:
+    uint64_t _buckets[LATHIST_BUCKETS];
+    uint64_t _count;
+    uint64_t _sum;
+    uint64_t _min;
+    uint64_t _max;
+
+    static unsigned int bucket(uint64_t v);
+    static uint64_t bucketTop(unsigned int b);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline unsigned int LatencyHistogram::bucket(uint64_t v) {
+    if (v < LATHIST_SUB) return v;
+    unsigned int shift = (63 - __builtin_clzll(v)) - LATHIST_SUB_BITS;
+    return (shift + 1) * LATHIST_SUB + (unsigned int)((v >> shift) - LATHIST_SUB);
+}
+
+
+inline uint64_t LatencyHistogram::bucketTop(unsigned int b) {
+    if (b < LATHIST_SUB) return b;
+    unsigned int shift = b / LATHIST_SUB - 1;
+    uint64_t top = ((uint64_t)(b % LATHIST_SUB + LATHIST_SUB + 1) << shift) - 1;
+    return top;
+}
+
+
+inline void LatencyHistogram::record(uint64_t nanos) {
+    _buckets[bucket(nanos)]++;
+    _count++;
+    _sum += nanos;
+    if (nanos < _min) _min = nanos;
+    if (nanos > _max) _max = nanos;
+}
+
+
+inline void LatencyHistogram::add(const LatencyHistogram& other) {
+    for (unsigned int b = 0; b < LATHIST_BUCKETS; b++) _buckets[b] += other._buckets[b];
+    _count += other._count;
+    _sum += other._sum;
+    if (other._count && other._min < _min) _min = other._min;
+    if (other._max > _max) _max = other._max;
+}
+
+
+inline void LatencyHistogram::reset() {
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _sum = 0;
+    _min = UINT64_MAX;
+    _max = 0;
+}
+
+
+inline uint64_t LatencyHistogram::percentile(double pct) const {
+    if (_count == 0) return 0;
+    uint64_t want = (uint64_t)(pct / 100.0 * _count + 0.5);
+    if (want < 1) want = 1;
+    uint64_t seen = 0;
+    for (unsigned int b = 0; b < LATHIST_BUCKETS; b++) {
+        seen += _buckets[b];
+        if (seen >= want) {
+            uint64_t top = bucketTop(b);
+            return top < _max ? top : _max;
+        }
+    }
+    return _max;
+}
+
+#endif
@@ -0,0 +1,241 @@
+// Class: LatencyTrace - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef LatencyTrace_h
+#define LatencyTrace_h
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <iomanip>
+#include <time.h>      // clock_gettime()
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc()
+#endif
+#include "LatencyHistogram.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: Follows each packet from the air to the disk. Each frame carries a TraceStamps with
+* a time stamp for every point on the way that it reached:
+*       available     the radio said it had a packet
+*       read          the payload is off the radio
+*       ack re-armed  the next ACK payload is loaded (with batched SPI, the same ioctl as read)
+*       dequeued      the main thread has popped it off the queue from the radio thread
+*       decoded       loaded into its struct and tracked
+*       displayed     verbose display (only with -v)
+*       formatted     log line built (only packets that get logged)
+*       written       log line written
+*       fsynced       log line is on the disk
+* When the packet is done, record() puts the time between each point and the one before it that
+* the packet reached into that point's histogram, the time from available to the last point into
+* an end-to-end histogram, and for packets that made it to the disk, into an air-to-disk one.
+*
+*    Only 1 packet in LATENCY_TRACE_EVERY is traced. TRACE_CLEAR() decides, on the thread that
+* takes the packet off the radio; the rest get no stamps and record() passes them by, so they
+* cost a count and a few branches. That keeps the trace under 1% of the CPU a packet takes, which
+* stamping every packet doesn't (note #2). At 1024 sensors every 15 minutes that is still a
+* couple of samples a minute.
+*
+*    Stamps are the CPU's own cycle/tick counter where there is one user space can read (TSC on
+* x86, CNTVCT on ARMv7 and later, i.e. every Pi from the Pi 2 on, 32 or 64 bit), a few ns each;
+* elsewhere (Pi 1 and Zero) clock_gettime(). They are turned into nanoseconds in record().
+*
+*    USAGE:
+*    1. Compiled in unless LATENCY_TRACE is defined as 0 (e.g. -DLATENCY_TRACE=0), in which case
+*  TRACE_STAMP(), TRACE_SAME() and TRACE_CLEAR() compile to nothing and nothing is ever recorded.
+*  -DLATENCY_TRACE_EVERY=1 traces every packet.
+*    2. TRACE_CLEAR() a frame's stamps when it is started, TRACE_STAMP() each point as it is
+*  reached (TRACE_SAME() for a point reached by the same operation as another), and record()
+*  the stamps on the thread that owns the LatencyTrace.
+*    3. dump() writes out the table; stage(), endToEnd(), airToDisk() give the histograms.
+*
+*    NOTE:
+*    1. The counter has to run at the same rate on every core; it does on the Pi (CNTVCT is the
+*  system counter) and on x86 with an invariant TSC.
+*    2. The stamps and record() are the trace's whole cost. RPi_GatewaySoak -t measures them
+*  against the CPU time of a packet - taken off a simulated chip through NrfSpiBatch, queued and
+*  tracked - in a -DLATENCY_TRACE=0 build: on an x86 PC ~90ns for a traced packet against
+*  ~1.25us, 7%, so tracing every packet is well over 1%; sampled 1 in 32 it is ~4ns, 0.3%.
+*  The 47 bytes on the SPI bus (37.6us at 10MHz) aren't counted: the ioctl waits them out, but
+*  they aren't CPU. Built with -DLATENCY_TRACE=0 there is no trace.
+*    3. One LatencyTrace belongs to one thread. Stamps can be taken on any thread.
+*/
+
+#ifndef LATENCY_TRACE
+#define LATENCY_TRACE 1
+#endif
+#ifndef LATENCY_TRACE_EVERY
+#define LATENCY_TRACE_EVERY 32          // 1 packet in this many is traced.
+#endif
+
+enum TracePoint {
+    TP_AVAILABLE,
+    TP_READ,
+    TP_ACK_REARMED,
+    TP_DEQUEUED,
+    TP_DECODED,
+    TP_DISPLAYED,
+    TP_FORMATTED,
+    TP_WRITTEN,
+    TP_FSYNCED,
+    TP_POINTS
+};
+
+struct TraceStamps {
+    uint64_t at[TP_POINTS];             // Ticks; 0 = not reached.
+    bool on;                            // This packet is traced. Only then is at[] set.
+};
+
+#if LATENCY_TRACE
+#define TRACE_STAMP(stamps, point) ((stamps).on ? (void)((stamps).at[point] = LatencyTrace::ticks()) : (void)0)
+#define TRACE_SAME(stamps, point, as) ((stamps).on ? (void)((stamps).at[point] = (stamps).at[as]) : (void)0)
+#define TRACE_CLEAR(stamps) (((stamps).on = LatencyTrace::sample()) ? (void)memset((stamps).at, 0, sizeof((stamps).at)) : (void)0)
+#else
+#define TRACE_STAMP(stamps, point) ((void)0)
+#define TRACE_SAME(stamps, point, as) ((void)0)
+#define TRACE_CLEAR(stamps) ((void)0)
+#endif
+
+
+class LatencyTrace {
+
+  public:
+
+          /*    PURPOSE: Constructor. Works out the tick rate (takes ~10ms on x86). */
+    LatencyTrace();
+
+          /*    PURPOSE: Add a finished packet's stamps to the histograms. */
+    void record(const TraceStamps& stamps);
+
+          /*    PURPOSE: Write a table of the histograms, in microseconds. */
+    void dump(std::ostream& out) const;
+
+          /*    PURPOSE: Time into a point from the point before it. */
+    const LatencyHistogram& stage(TracePoint point) const { return _stage[point]; }
+    const LatencyHistogram& endToEnd() const { return _endToEnd; }
+    const LatencyHistogram& airToDisk() const { return _airToDisk; }
+
+    static const char* pointName(TracePoint point);
+
+          /*    PURPOSE: The time stamp. */
+    static uint64_t ticks();
+
+          /*    PURPOSE: Whether to trace the next packet taken on this thread: every
+           *  LATENCY_TRACE_EVERY'th, starting with the 1st. */
+    static bool sample();
+
+  private:
+    LatencyHistogram _stage[TP_POINTS];
+    LatencyHistogram _endToEnd;
+    LatencyHistogram _airToDisk;
+    double _nanosPerTick;
+
+    uint64_t nanos(uint64_t ticks) const { return (uint64_t)(ticks * _nanosPerTick); }
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline uint64_t LatencyTrace::ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t t;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#elif defined(__arm__) && __ARM_ARCH >= 7
+    uint64_t t;
+    asm volatile("mrrc p15, 1, %Q0, %R0, c14" : "=r"(t));
+    return t;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+inline bool LatencyTrace::sample() {
+#if LATENCY_TRACE_EVERY > 1
+    static thread_local unsigned int countdown = 1;
+    if (--countdown) return false;
+    countdown = LATENCY_TRACE_EVERY;
+#endif
+    return true;
+}
+
+
+inline LatencyTrace::LatencyTrace() {
+#if defined(__x86_64__) || defined(__i386__)
+        /* No architected way to ask the TSC's rate; time it against the clock. */
+    timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &t0);
+    uint64_t c0 = ticks();
+    do {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &t1);
+    } while ((t1.tv_sec - t0.tv_sec) * 1000000000LL + (t1.tv_nsec - t0.tv_nsec) < 10000000LL);
+    uint64_t c1 = ticks();
+    _nanosPerTick = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / (double)(c1 - c0);
+#elif defined(__aarch64__)
+    uint64_t freq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    _nanosPerTick = 1e9 / freq;
+#elif defined(__arm__) && __ARM_ARCH >= 7
+    uint32_t freq;
+    asm volatile("mrc p15, 0, %0, c14, c0, 0" : "=r"(freq));
+    _nanosPerTick = 1e9 / freq;
+#else
+    _nanosPerTick = 1.0;
+#endif
+}
+
+
+inline void LatencyTrace::record(const TraceStamps& stamps) {
+    if (!stamps.on || stamps.at[TP_AVAILABLE] == 0) return;
+    int last = TP_AVAILABLE;
+    for (int p = TP_AVAILABLE + 1; p < TP_POINTS; p++) {
+        if (stamps.at[p] == 0) continue;
+        _stage[p].record(nanos(stamps.at[p] - stamps.at[last]));
+        last = p;
+    }
+    _endToEnd.record(nanos(stamps.at[last] - stamps.at[TP_AVAILABLE]));
+    if (last == TP_FSYNCED) _airToDisk.record(nanos(stamps.at[TP_FSYNCED] - stamps.at[TP_AVAILABLE]));
+}
+
+
+inline const char* LatencyTrace::pointName(TracePoint point) {
+    static const char* names[TP_POINTS] = {
+        "available", "read", "ack re-armed", "dequeued", "decoded", "displayed", "formatted", "written", "fsynced"
+    };
+    return names[point];
+}
+
+
+inline void LatencyTrace::dump(std::ostream& out) const {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(1);
+    out << std::setw(16) << "into (us)" << std::setw(12) << "count" << std::setw(10) << "p50" << std::setw(10) << "p90"
+        << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "max" << std::endl;
+    for (int p = TP_AVAILABLE + 1; p <= TP_POINTS; p++) {
+        const LatencyHistogram& h = (p < TP_POINTS) ? _stage[p] : _endToEnd;
+        const char* name = (p < TP_POINTS) ? pointName((TracePoint)p) : "end to end";
+        out << std::setw(16) << name << std::setw(12) << h.count() << std::setw(10) << h.percentile(50) / 1000.0
+            << std::setw(10) << h.percentile(90) / 1000.0 << std::setw(10) << h.percentile(99) / 1000.0
+            << std::setw(10) << h.percentile(99.9) / 1000.0 << std::setw(12) << h.max() / 1000.0 << std::endl;
+    }
+    out << std::setw(16) << "air to disk" << std::setw(12) << _airToDisk.count() << std::setw(10)
+        << _airToDisk.percentile(50) / 1000.0 << std::setw(10) << _airToDisk.percentile(90) / 1000.0
+        << std::setw(10) << _airToDisk.percentile(99) / 1000.0 << std::setw(10) << _airToDisk.percentile(99.9) / 1000.0
+        << std::setw(12) << _airToDisk.max() / 1000.0 << std::endl;
+    out.flags(flags);
+    out.precision(precision);
+}
+
+#endif
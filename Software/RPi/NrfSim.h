@@ -0,0 +1,943 @@
+// Class: NrfSim, VirtualAir - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef NrfSim_h
+#define NrfSim_h
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <functional>
+
+/************************************************************************************************
+*
+*    PURPOSE: A stand-in for the nRF24L01+ chip, down to the register level, so that the code on
+* both ends of the radio link can be run on a PC (or the RPi) with no hardware. Each NrfSim is one
+* chip: it has the chip's register map, SPI command set, 3-deep TX and RX FIFOs, the Enhanced
+* ShockBurst auto-ack with ACK payloads, auto-retransmit (ARD/ARC, MAX_RT, OBSERVE_TX), dynamic
+* payload lengths, 6 RX pipes, and the RPD carrier detect. All chips share one VirtualAir, which
+* carries the frames between them, keeps simulated time, and can lose frames, add latency, and
+* corrupt frames that overlap on the same channel (collisions).
+*
+*    It is driven the same way as the real chip: SPI transactions (csnLow(), transfer(),
+* csnHigh(), or transaction() for a whole one) and the CE pin (ce()). The IRQ pin can be
+* followed with onIrq(). Nothing happens in simulated time until VirtualAir::runUntil() or
+* advance() is called; code that would spin waiting on the chip should instead run the air
+* forward, or wait for the IRQ.
+*
+*    USAGE:
+*    1. Declare one VirtualAir, then one NrfSim per radio, passing it the air.
+*    2. Program each chip through SPI exactly as the firmware/RPi code would.
+*    3. Run the air forward. VirtualAir::at() schedules your own code (e.g., a sensor's next
+*  reading) at a simulated time.
+*    4. VirtualAir's public counters tell what went on in the air.
+*
+*    NOTE:
+*    1. Times are in microseconds of simulated time, from 0 when the air is constructed.
+*    2. Timing follows the nRF24L01+ Product Specification v1.0: 130us PLL settling (Tstby2a)
+*  before every transmit and before an ACK, 1.5ms power down -> standby (Tpd2stby), ARD timed
+*  from the end of one attempt to the start of the next.
+*    3. Simplifications: an ACK payload leaves the PRX's TX FIFO when it is sent, not when the
+*  next new packet proves it arrived; and any overlap of two frames on a channel spoils both
+*  (no capture effect). See the footnotes at the bottom.
+*    4. Signal strength is simple: each chip has a path loss to a common point (setPathLossDb()),
+*  and the loss between two chips is the sum. RPD is set when a frame arrives at >= -64dBm.
+*/
+
+    /* SPI commands. */
+#define NRFSIM_R_REGISTER     0x00
+#define NRFSIM_W_REGISTER     0x20
+#define NRFSIM_R_RX_PAYLOAD   0x61
+#define NRFSIM_W_TX_PAYLOAD   0xA0
+#define NRFSIM_FLUSH_TX       0xE1
+#define NRFSIM_FLUSH_RX       0xE2
+#define NRFSIM_REUSE_TX_PL    0xE3
+#define NRFSIM_R_RX_PL_WID    0x60
+#define NRFSIM_W_ACK_PAYLOAD  0xA8        // | pipe
+#define NRFSIM_W_TX_NOACK     0xB0
+#define NRFSIM_NOP            0xFF
+
+    /* Registers. */
+#define NRFSIM_CONFIG         0x00
+#define NRFSIM_EN_AA          0x01
+#define NRFSIM_EN_RXADDR      0x02
+#define NRFSIM_SETUP_AW       0x03
+#define NRFSIM_SETUP_RETR     0x04
+#define NRFSIM_RF_CH          0x05
+#define NRFSIM_RF_SETUP       0x06
+#define NRFSIM_STATUS         0x07
+#define NRFSIM_OBSERVE_TX     0x08
+#define NRFSIM_RPD            0x09
+#define NRFSIM_RX_ADDR_P0     0x0A
+#define NRFSIM_RX_ADDR_P1     0x0B
+#define NRFSIM_TX_ADDR        0x10
+#define NRFSIM_RX_PW_P0       0x11
+#define NRFSIM_FIFO_STATUS    0x17
+#define NRFSIM_DYNPD          0x1C
+#define NRFSIM_FEATURE        0x1D
+
+    /* Bits. */
+#define NRFSIM_PRIM_RX        0x01        // CONFIG
+#define NRFSIM_PWR_UP         0x02
+#define NRFSIM_CRCO           0x04
+#define NRFSIM_EN_CRC         0x08
+#define NRFSIM_RX_DR          0x40        // STATUS, and CONFIG mask bits
+#define NRFSIM_TX_DS          0x20
+#define NRFSIM_MAX_RT         0x10
+#define NRFSIM_TX_FULL        0x01
+#define NRFSIM_EN_DYN_ACK     0x01        // FEATURE
+#define NRFSIM_EN_ACK_PAY     0x02
+#define NRFSIM_EN_DPL         0x04
+
+#define NRFSIM_FIFO_DEPTH 3
+#define NRFSIM_MAX_PAYLOAD 32
+#define NRFSIM_SETTLE_MICROS 130          // Tstby2a, also the PRX's RX -> TX turnaround for the ACK.
+#define NRFSIM_POWERUP_MICROS 1500        // Tpd2stby
+#define NRFSIM_RPD_DBM -64
+
+class NrfSim;
+
+
+    /* What the channel hook decides for one frame at one chip. */
+struct FrameFate {
+    bool drop = false;
+    bool corrupt = false;               // Chip will see a CRC failure.
+    bool duplicate = false;             // Chip hears it a 2nd time, duplicateMicros later.
+    uint32_t delayMicros = 0;           // On top of VirtualAir::latencyMicros.
+    uint32_t duplicateMicros = 0;
+};
+
+
+    /* One frame on the air. */
+struct AirFrame {
+    NrfSim* from;
+    uint64_t id;                        // Transmission number, for collision tracking.
+    uint8_t channel;
+    uint8_t dataRate;                   // 0 = 1Mbps, 1 = 2Mbps, 2 = 250kbps
+    int8_t txDbm;
+    uint8_t addrWidth;
+    uint8_t addr[5];
+    uint8_t pid;
+    bool noAck;
+    bool isAck;                         // An ACK (with or without payload), PRX -> PTX.
+    uint8_t len;
+    uint8_t payload[NRFSIM_MAX_PAYLOAD];
+};
+
+
+class VirtualAir {
+
+  public:
+
+          /*    PURPOSE: Constructor. seed makes the random frame loss repeatable. */
+    VirtualAir(uint64_t seed = 1);
+
+    uint64_t now() const { return _now; }
+
+          /*    PURPOSE: Run simulated time forward, handling everything that
+           *  happens in the air and in the chips on the way. */
+    void runUntil(uint64_t t);
+    void advance(uint64_t micros) { runUntil(_now + micros); }
+
+          /*    PURPOSE: Run your own code at a simulated time. */
+    void at(uint64_t t, std::function<void()> fn);
+
+          /*    PURPOSE: Chance (0-1) that any one frame never reaches any one
+           *  chip that would otherwise hear it, and extra delay on every
+           *  delivery. Applies to ACKs as well as data. */
+    double lossProbability = 0;
+    uint32_t latencyMicros = 0;
+    bool collisions = true;
+
+          /*    PURPOSE: Optional hook to decide a frame's fate at each chip in
+           *  place of lossProbability: drop it, corrupt it, duplicate it, or
+           *  hold it back. It may also change the frame (e.g., flip bits).
+           *  fate.corrupt comes in true if the frame was in a collision.
+           *  See FaultChannel.h. */
+    std::function<void(AirFrame& frame, const NrfSim* to, FrameFate& fate)> channel;
+
+        /* What went on. */
+    unsigned long framesSent = 0;
+    unsigned long acksSent = 0;
+    unsigned long framesLost = 0;       // Deliveries dropped (per receiving chip).
+    unsigned long framesDuplicated = 0; // Extra deliveries from the channel hook.
+    unsigned long framesCollided = 0;   // Transmissions spoiled by an overlap.
+
+          /*    PURPOSE: Random number 0 .. 1, from the air's seeded generator. */
+    double random();
+
+        /* For NrfSim. */
+    void attach(NrfSim* chip) { _chips.push_back(chip); }
+    void schedule(uint64_t t, NrfSim* chip, int kind, uint32_t gen);
+    void transmit(const AirFrame& frame, uint64_t airMicros);
+
+  private:
+    enum { EV_CHIP, EV_FRAME_END, EV_DELIVER, EV_USER };
+    struct Event {
+        uint64_t t;
+        uint64_t seq;                   // Keeps events at the same time in order.
+        int type;
+        NrfSim* chip;
+        int kind;
+        uint32_t gen;
+        size_t slot;                    // Frame or user function slot.
+        bool operator>(const Event& o) const { return t != o.t ? t > o.t : seq > o.seq; }
+    };
+    struct OnAir {
+        uint64_t id;
+        uint8_t channel;
+        uint64_t start, end;
+        bool corrupt;
+    };
+
+    uint64_t _now = 0;
+    uint64_t _seq = 0;
+    uint64_t _nextId = 1;
+    uint64_t _rng;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _events;
+    std::vector<NrfSim*> _chips;
+    std::deque<OnAir> _onAir;           // Recent transmissions, oldest first.
+    std::vector<AirFrame> _frames;      // Frame slots, reused.
+    std::vector<size_t> _freeFrames;
+    std::vector<std::function<void()>> _user;
+    std::vector<size_t> _freeUser;
+
+    void push(uint64_t t, int type, NrfSim* chip, int kind, uint32_t gen, size_t slot);
+    size_t storeFrame(const AirFrame& frame);
+    OnAir* findOnAir(uint64_t id);
+    void frameEnd(size_t slot);
+    void deliver(NrfSim* to, AirFrame& frame, bool corrupt);
+
+};
+
+
+class NrfSim {
+
+  public:
+
+          /*    PURPOSE: Constructor. The chip starts in its power-on reset state. */
+    NrfSim(VirtualAir& air);
+
+        /* SPI. A transaction is csnLow(), one transfer() per byte, csnHigh().
+           Writes take effect on csnHigh(), as on the chip. */
+    void csnLow();
+    uint8_t transfer(uint8_t b);
+    void csnHigh();
+    void transaction(const uint8_t* tx, uint8_t* rx, size_t len);
+
+        /* Pins. */
+    void ce(bool high);
+    bool irq() const;                   // True = IRQ pin asserted (low on the chip).
+
+          /*    PURPOSE: Called each time the IRQ pin asserts. */
+    void onIrq(std::function<void()> fn) { _irqFn = fn; }
+
+    void setPathLossDb(int db) { _pathLossDb = db; }
+
+          /*    PURPOSE: Make the chip stop answering, as one that has lost its
+           *  supply or whose SPI bus has hung: every byte clocked out reads
+           *  0xFF, writes go nowhere, and it is off the air. false puts it back
+           *  as it was. */
+    void setWedged(bool wedged) { _wedged = wedged; }
+
+          /*    PURPOSE: Brownout: registers back to their reset values, FIFOs
+           *  emptied, anything on the air dropped. The pins stay as they are. */
+    void powerOnReset();
+    int pathLossDb() const { return _pathLossDb; }
+
+        /* Shortcuts for tests: read/write one register over SPI. */
+    uint8_t readRegister(uint8_t reg);
+    void writeRegister(uint8_t reg, uint8_t value);
+
+        /* For VirtualAir. */
+    void onEvent(int kind, uint32_t gen);
+    void onFrame(const AirFrame& frame, bool corrupt);
+    void onTxEnd(const AirFrame& frame);
+    bool listening() const;
+    bool hears() const { return !_wedged && (listening() || _state == WAIT_ACK); }
+    uint8_t channel() const { return _reg[NRFSIM_RF_CH] & 0x7F; }
+
+  private:
+    enum { EV_TX_START, EV_ACK_TIMEOUT, EV_ACK_START };
+    enum { IDLE, TX_SETTLE, TX_AIR, WAIT_ACK, ACK_SETTLE, ACK_AIR };
+
+    struct FifoEntry {
+        uint8_t len;
+        uint8_t pipe;                   // ACK payloads: the pipe it is for.
+        bool noAck;
+        uint8_t data[NRFSIM_MAX_PAYLOAD];
+    };
+
+    VirtualAir& _air;
+    uint8_t _reg[0x20];
+    uint8_t _addr[7][5];                // RX_ADDR_P0..P5 (P2..P5 only byte 0 used), TX_ADDR.
+    std::deque<FifoEntry> _tx, _rx;
+    bool _ce = false;
+    bool _reuse = false;
+    bool _irqLine = false;
+    int _pathLossDb = 40;
+    bool _wedged = false;
+    uint64_t _readyAt = 0;              // Earliest a transmit can start after power up.
+    int _state = IDLE;
+    uint32_t _gen = 0;                  // Bumped to cancel outstanding timers.
+    uint8_t _pid = 0;
+    uint8_t _arc = 0;                   // Retransmits of the current packet.
+    uint8_t _plos = 0;
+    AirFrame _sending;                  // Frame being sent / waiting on its ACK.
+    uint8_t _ackPipe = 0;               // PRX: pipe the ACK is for ...
+    uint8_t _ackPid = 0;                // ... and the PID it echoes.
+    uint8_t _lastPid[6];                // PRX duplicate detection, per pipe.
+    uint8_t _lastSum[6];
+    bool _lastValid[6];
+    std::function<void()> _irqFn;
+
+        /* SPI transaction in progress. */
+    bool _selected = false;
+    uint8_t _cmd = 0;
+    unsigned int _idx = 0;
+    uint8_t _buf[NRFSIM_MAX_PAYLOAD];
+    bool _rxRead = false;
+
+    uint8_t status() const;
+    uint8_t readReg(uint8_t reg, unsigned int byte) const;
+    void writeReg(uint8_t reg, const uint8_t* data, unsigned int len);
+    uint8_t addrWidth() const { return (_reg[NRFSIM_SETUP_AW] & 0x03) + 2; }
+    uint8_t dataRate() const;
+    int8_t txDbm() const { return -18 + 6 * ((_reg[NRFSIM_RF_SETUP] >> 1) & 0x03); }
+    bool dynamic(uint8_t pipe) const;
+    uint64_t airMicros(uint8_t len) const;
+    int matchPipe(const AirFrame& frame) const;
+    void setFlag(uint8_t flag);
+    void updateIrq();
+    void maybeStartTx();
+    void sendAttempt();
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions - VirtualAir
+   =============================================================================
+*/
+
+inline VirtualAir::VirtualAir(uint64_t seed) : _rng(seed ? seed : 1) {
+}
+
+
+inline double VirtualAir::random() {
+    _rng ^= _rng << 13;                 // xorshift64
+    _rng ^= _rng >> 7;
+    _rng ^= _rng << 17;
+    return (_rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+inline void VirtualAir::push(uint64_t t, int type, NrfSim* chip, int kind, uint32_t gen, size_t slot) {
+    Event e;
+    e.t = t < _now ? _now : t;
+    e.seq = _seq++;
+    e.type = type;
+    e.chip = chip;
+    e.kind = kind;
+    e.gen = gen;
+    e.slot = slot;
+    _events.push(e);
+}
+
+
+inline void VirtualAir::schedule(uint64_t t, NrfSim* chip, int kind, uint32_t gen) {
+    push(t, EV_CHIP, chip, kind, gen, 0);
+}
+
+
+inline void VirtualAir::at(uint64_t t, std::function<void()> fn) {
+    size_t slot;
+    if (!_freeUser.empty()) {
+        slot = _freeUser.back();
+        _freeUser.pop_back();
+        _user[slot] = fn;
+    } else {
+        slot = _user.size();
+        _user.push_back(fn);
+    }
+    push(t, EV_USER, NULL, 0, 0, slot);
+}
+
+
+inline size_t VirtualAir::storeFrame(const AirFrame& frame) {
+    if (!_freeFrames.empty()) {
+        size_t slot = _freeFrames.back();
+        _freeFrames.pop_back();
+        _frames[slot] = frame;
+        return slot;
+    }
+    _frames.push_back(frame);
+    return _frames.size() - 1;
+}
+
+
+inline VirtualAir::OnAir* VirtualAir::findOnAir(uint64_t id) {
+    if (_onAir.empty() || id < _onAir.front().id) return NULL;
+    size_t i = id - _onAir.front().id;
+    return (i < _onAir.size()) ? &_onAir[i] : NULL;
+}
+
+
+inline void VirtualAir::transmit(const AirFrame& frame, uint64_t airMicros) {
+        /* Forget transmissions that can no longer overlap anything. 10ms is
+           longer than any frame, even at 250kbps. */
+    while (!_onAir.empty() && _onAir.front().end + 10000 < _now) _onAir.pop_front();
+
+    OnAir oa;
+    oa.id = _nextId++;
+    oa.channel = frame.channel;
+    oa.start = _now;
+    oa.end = _now + airMicros;
+    oa.corrupt = false;
+    if (collisions) {
+        for (OnAir& other : _onAir) {
+            if (other.channel == oa.channel && other.end > oa.start) {
+                if (!other.corrupt) framesCollided++;
+                other.corrupt = true;
+                oa.corrupt = true;
+            }
+        }
+        if (oa.corrupt) framesCollided++;
+    }
+    _onAir.push_back(oa);
+
+    if (frame.isAck) acksSent++; else framesSent++;
+    size_t slot = storeFrame(frame);
+    _frames[slot].id = oa.id;
+    push(oa.end, EV_FRAME_END, NULL, 0, 0, slot);
+}
+
+
+inline void VirtualAir::frameEnd(size_t slot) {
+    AirFrame frame = _frames[slot];
+    _freeFrames.push_back(slot);
+    OnAir* oa = findOnAir(frame.id);
+    bool corrupt = oa ? oa->corrupt : false;
+
+    frame.from->onTxEnd(frame);
+    for (NrfSim* to : _chips) {
+        if (to == frame.from || !to->hears() || to->channel() != frame.channel) continue;
+        AirFrame copy = frame;
+        FrameFate fate;
+        fate.corrupt = corrupt;
+        if (channel) {
+            channel(copy, to, fate);
+        } else if (lossProbability > 0 && random() < lossProbability) {
+            fate.drop = true;
+        }
+        if (fate.drop) {
+            framesLost++;
+            continue;
+        }
+        uint32_t delay = latencyMicros + fate.delayMicros;
+        if (delay == 0) {
+            to->onFrame(copy, fate.corrupt);
+        } else {
+            push(_now + delay, EV_DELIVER, to, fate.corrupt ? 1 : 0, 0, storeFrame(copy));
+        }
+        if (fate.duplicate) {
+            framesDuplicated++;
+            push(_now + delay + fate.duplicateMicros, EV_DELIVER, to, fate.corrupt ? 1 : 0, 0, storeFrame(copy));
+        }
+    }
+}
+
+
+inline void VirtualAir::runUntil(uint64_t t) {
+    while (!_events.empty() && _events.top().t <= t) {
+        Event e = _events.top();
+        _events.pop();
+        _now = e.t;
+        switch (e.type) {
+            case EV_CHIP:
+                e.chip->onEvent(e.kind, e.gen);
+                break;
+            case EV_FRAME_END:
+                frameEnd(e.slot);
+                break;
+            case EV_DELIVER: {
+                AirFrame frame = _frames[e.slot];
+                _freeFrames.push_back(e.slot);
+                if (e.chip->hears() && e.chip->channel() == frame.channel) e.chip->onFrame(frame, e.kind != 0);
+                break;
+            }
+            case EV_USER: {
+                std::function<void()> fn;
+                fn.swap(_user[e.slot]);
+                _freeUser.push_back(e.slot);
+                fn();
+                break;
+            }
+        }
+    }
+    if (t > _now) _now = t;
+}
+
+
+
+/* =============================================================================
+   Function Definitions - NrfSim
+   =============================================================================
+*/
+
+inline NrfSim::NrfSim(VirtualAir& air) : _air(air) {
+    powerOnReset();
+    _air.attach(this);
+}
+
+
+inline void NrfSim::powerOnReset() {
+        /* Reset values, Product Specification section 9. */
+    static const uint8_t resetRegs[0x20] = {
+        0x08, 0x3F, 0x03, 0x03, 0x03, 0x02, 0x0E, 0x0E, 0x00, 0x00, 0x00, 0x00, 0xC3, 0xC4, 0xC5, 0xC6,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    memcpy(_reg, resetRegs, sizeof(_reg));
+    memset(_addr[0], 0xE7, 5);
+    memset(_addr[1], 0xC2, 5);
+    for (int p = 2; p <= 5; p++) _addr[p][0] = 0xC1 + p;
+    memset(_addr[6], 0xE7, 5);
+    memset(_lastValid, 0, sizeof(_lastValid));
+    memset(&_sending, 0, sizeof(_sending));
+    _tx.clear();
+    _rx.clear();
+    _reuse = false;
+    _state = IDLE;
+    _gen++;                             // Cancels outstanding timers.
+    _arc = 0;
+    _plos = 0;
+    _selected = false;
+    _irqLine = false;
+}
+
+
+/* ---- SPI ---------------------------------------------------------------- */
+
+inline void NrfSim::csnLow() {
+    _selected = true;
+    _idx = 0;
+    _rxRead = false;
+}
+
+
+inline uint8_t NrfSim::transfer(uint8_t b) {
+    if (!_selected || _wedged) return 0xFF;
+    if (_idx == 0) {
+        _cmd = b;
+        _idx = 1;
+        return status();                // STATUS always comes out with the command byte.
+    }
+    unsigned int i = _idx - 1;
+    _idx++;
+
+    if (_cmd < NRFSIM_W_REGISTER) return readReg(_cmd & 0x1F, i);
+    if (_cmd == NRFSIM_R_RX_PL_WID) return _rx.empty() ? 0 : _rx.front().len;
+    if (_cmd == NRFSIM_R_RX_PAYLOAD) {
+        _rxRead = true;
+        if (_rx.empty() || i >= NRFSIM_MAX_PAYLOAD) return 0;
+        return _rx.front().data[i];
+    }
+    if (i < sizeof(_buf)) _buf[i] = b;  // Writes: kept until CSN goes high.
+    return 0;
+}
+
+
+inline void NrfSim::csnHigh() {
+    if (!_selected) return;
+    _selected = false;
+    if (_wedged) return;
+    unsigned int n = (_idx > 0) ? _idx - 1 : 0;
+    if (_idx == 0) return;
+    if (n > NRFSIM_MAX_PAYLOAD) n = NRFSIM_MAX_PAYLOAD;
+
+    if ((_cmd & 0xE0) == NRFSIM_W_REGISTER) {
+        if (n) writeReg(_cmd & 0x1F, _buf, n);
+    } else if (_cmd == NRFSIM_W_TX_PAYLOAD || _cmd == NRFSIM_W_TX_NOACK || (_cmd & 0xF8) == NRFSIM_W_ACK_PAYLOAD) {
+        bool noAckOk = (_cmd != NRFSIM_W_TX_NOACK) || (_reg[NRFSIM_FEATURE] & NRFSIM_EN_DYN_ACK);
+        bool ackOk = ((_cmd & 0xF8) != NRFSIM_W_ACK_PAYLOAD) || (_reg[NRFSIM_FEATURE] & NRFSIM_EN_ACK_PAY);
+        if (n && _tx.size() < NRFSIM_FIFO_DEPTH && noAckOk && ackOk) {
+            FifoEntry e;
+            e.len = n;
+            e.pipe = _cmd & 0x07;
+            e.noAck = (_cmd == NRFSIM_W_TX_NOACK);
+            memcpy(e.data, _buf, n);
+            _tx.push_back(e);
+            _reuse = false;
+        }
+    } else if (_cmd == NRFSIM_R_RX_PAYLOAD) {
+        if (_rxRead && !_rx.empty()) _rx.pop_front();
+    } else if (_cmd == NRFSIM_FLUSH_TX) {
+        if (_state != TX_AIR && _state != ACK_AIR) _tx.clear();
+        _reuse = false;
+    } else if (_cmd == NRFSIM_FLUSH_RX) {
+        _rx.clear();
+    } else if (_cmd == NRFSIM_REUSE_TX_PL) {
+        _reuse = true;
+    }
+    maybeStartTx();
+}
+
+
+inline void NrfSim::transaction(const uint8_t* tx, uint8_t* rx, size_t len) {
+    csnLow();
+    for (size_t i = 0; i < len; i++) {
+        uint8_t r = transfer(tx ? tx[i] : NRFSIM_NOP);
+        if (rx) rx[i] = r;
+    }
+    csnHigh();
+}
+
+
+inline uint8_t NrfSim::readRegister(uint8_t reg) {
+    uint8_t tx[2] = { (uint8_t)(NRFSIM_R_REGISTER | reg), NRFSIM_NOP }, rx[2];
+    transaction(tx, rx, 2);
+    return rx[1];
+}
+
+
+inline void NrfSim::writeRegister(uint8_t reg, uint8_t value) {
+    uint8_t tx[2] = { (uint8_t)(NRFSIM_W_REGISTER | reg), value };
+    transaction(tx, NULL, 2);
+}
+
+
+/* ---- Registers ---------------------------------------------------------- */
+
+inline uint8_t NrfSim::status() const {
+    uint8_t pipe = _rx.empty() ? 7 : _rx.front().pipe;
+    return (_reg[NRFSIM_STATUS] & 0x70) | (pipe << 1) | (_tx.size() >= NRFSIM_FIFO_DEPTH ? NRFSIM_TX_FULL : 0);
+}
+
+
+inline uint8_t NrfSim::readReg(uint8_t reg, unsigned int byte) const {
+    if (reg == NRFSIM_RX_ADDR_P0 || reg == NRFSIM_RX_ADDR_P1 || reg == NRFSIM_TX_ADDR) {
+        const uint8_t* a = (reg == NRFSIM_TX_ADDR) ? _addr[6] : _addr[reg - NRFSIM_RX_ADDR_P0];
+        return (byte < addrWidth()) ? a[byte] : 0;
+    }
+    if (reg >= NRFSIM_RX_ADDR_P0 + 2 && reg <= NRFSIM_RX_ADDR_P0 + 5) return _addr[reg - NRFSIM_RX_ADDR_P0][0];
+    switch (reg) {
+        case NRFSIM_STATUS:
+            return status();
+        case NRFSIM_OBSERVE_TX:
+            return (_plos << 4) | (_arc & 0x0F);
+        case NRFSIM_FIFO_STATUS:
+            return (_reuse ? 0x40 : 0)
+                 | (_tx.size() >= NRFSIM_FIFO_DEPTH ? 0x20 : 0) | (_tx.empty() ? 0x10 : 0)
+                 | (_rx.size() >= NRFSIM_FIFO_DEPTH ? 0x02 : 0) | (_rx.empty() ? 0x01 : 0);
+        default:
+            return _reg[reg];
+    }
+}
+
+
+inline void NrfSim::writeReg(uint8_t reg, const uint8_t* data, unsigned int len) {
+    if (reg >= NRFSIM_RX_ADDR_P0 && reg <= NRFSIM_TX_ADDR) {
+        if (reg == NRFSIM_TX_ADDR || reg <= NRFSIM_RX_ADDR_P1) {
+            uint8_t* a = (reg == NRFSIM_TX_ADDR) ? _addr[6] : _addr[reg - NRFSIM_RX_ADDR_P0];
+            memcpy(a, data, len < 5 ? len : 5);
+        } else {
+            _addr[reg - NRFSIM_RX_ADDR_P0][0] = data[0];
+        }
+        return;
+    }
+    uint8_t v = data[0];
+    switch (reg) {
+        case NRFSIM_STATUS:             // Write 1 to clear.
+            _reg[NRFSIM_STATUS] &= ~(v & 0x70);
+            updateIrq();
+            break;
+        case NRFSIM_OBSERVE_TX:
+        case NRFSIM_RPD:
+        case NRFSIM_FIFO_STATUS:
+            break;                      // Read only.
+        case NRFSIM_RF_CH:
+            _reg[reg] = v & 0x7F;
+            _plos = 0;                  // Writing RF_CH resets PLOS_CNT.
+            break;
+        case NRFSIM_CONFIG: {
+            uint8_t old = _reg[NRFSIM_CONFIG];
+            _reg[NRFSIM_CONFIG] = v & 0x7F;
+            if ((v & NRFSIM_PWR_UP) && !(old & NRFSIM_PWR_UP)) {
+                _readyAt = _air.now() + NRFSIM_POWERUP_MICROS;
+            } else if (!(v & NRFSIM_PWR_UP) && (old & NRFSIM_PWR_UP)) {
+                _state = IDLE;          // Power down drops whatever was going on.
+                _gen++;
+            }
+            if ((v ^ old) & NRFSIM_PRIM_RX) _reg[NRFSIM_RPD] = 0;
+            updateIrq();
+            break;
+        }
+        default:
+            if (reg < 0x20) _reg[reg] = v;
+            break;
+    }
+}
+
+
+inline uint8_t NrfSim::dataRate() const {
+    uint8_t rs = _reg[NRFSIM_RF_SETUP];
+    if (rs & 0x20) return 2;            // RF_DR_LOW: 250kbps
+    if (rs & 0x08) return 1;            // RF_DR_HIGH: 2Mbps
+    return 0;
+}
+
+
+inline bool NrfSim::dynamic(uint8_t pipe) const {
+    return (_reg[NRFSIM_FEATURE] & NRFSIM_EN_DPL) && (_reg[NRFSIM_DYNPD] & (1 << pipe));
+}
+
+
+inline uint64_t NrfSim::airMicros(uint8_t len) const {
+        /* Preamble, address, 9 bit packet control field, payload, CRC. */
+    unsigned int crc = (_reg[NRFSIM_CONFIG] & NRFSIM_EN_CRC) ? ((_reg[NRFSIM_CONFIG] & NRFSIM_CRCO) ? 2 : 1) : 0;
+    uint64_t bits = 8 * (1 + addrWidth() + len + crc) + 9;
+    switch (dataRate()) {
+        case 1:  return (bits + 1) / 2;
+        case 2:  return bits * 4;
+        default: return bits;
+    }
+}
+
+
+inline void NrfSim::setFlag(uint8_t flag) {
+    _reg[NRFSIM_STATUS] |= flag;
+    updateIrq();
+}
+
+
+inline bool NrfSim::irq() const {
+    return (_reg[NRFSIM_STATUS] & ~_reg[NRFSIM_CONFIG] & 0x70) != 0;   // CONFIG bits 4-6 mask them.
+}
+
+
+inline void NrfSim::updateIrq() {
+    bool line = irq();
+    bool edge = line && !_irqLine;
+    _irqLine = line;
+    if (edge && _irqFn) _irqFn();
+}
+
+
+inline void NrfSim::ce(bool high) {
+    if (!high && _ce && (_reg[NRFSIM_CONFIG] & NRFSIM_PRIM_RX)) _reg[NRFSIM_RPD] = 0;
+    _ce = high;
+    maybeStartTx();
+}
+
+
+inline bool NrfSim::listening() const {
+    return _ce && (_reg[NRFSIM_CONFIG] & NRFSIM_PWR_UP) && (_reg[NRFSIM_CONFIG] & NRFSIM_PRIM_RX)
+        && _air.now() >= _readyAt + NRFSIM_SETTLE_MICROS && (_state == IDLE);
+}
+
+
+/* ---- PTX: transmit and wait for the ACK --------------------------------- */
+
+inline void NrfSim::maybeStartTx() {
+    if (_state != IDLE || _tx.empty()) return;
+    if (!(_reg[NRFSIM_CONFIG] & NRFSIM_PWR_UP) || (_reg[NRFSIM_CONFIG] & NRFSIM_PRIM_RX)) return;
+    if (!_ce) return;                   // A CE pulse sends the one packet; held high, the whole FIFO.
+    if (_reg[NRFSIM_STATUS] & NRFSIM_MAX_RT) return;    // Must be cleared before anything else goes.
+
+    const FifoEntry& e = _tx.front();
+    memset(&_sending, 0, sizeof(_sending));
+    _sending.from = this;
+    _sending.addrWidth = addrWidth();
+    memcpy(_sending.addr, _addr[6], 5);
+    _sending.len = e.len;
+    memcpy(_sending.payload, e.data, e.len);
+    _sending.noAck = e.noAck;
+    _sending.pid = _pid = (_pid + 1) & 0x03;
+    _arc = 0;
+
+    _state = TX_SETTLE;
+    uint64_t start = _air.now() + NRFSIM_SETTLE_MICROS;
+    if (start < _readyAt) start = _readyAt;
+    _air.schedule(start, this, EV_TX_START, ++_gen);
+}
+
+
+inline void NrfSim::sendAttempt() {
+    _sending.channel = channel();
+    _sending.dataRate = dataRate();
+    _sending.txDbm = txDbm();
+    _state = TX_AIR;
+    _air.transmit(_sending, airMicros(_sending.len));
+}
+
+
+inline void NrfSim::onTxEnd(const AirFrame& frame) {
+    if (_state == ACK_AIR) {                    // PRX: our ACK is out.
+        _state = IDLE;
+        if (frame.len) setFlag(NRFSIM_TX_DS);   // An ACK payload went. See footnote #1.
+        return;
+    }
+    if (_state != TX_AIR) return;
+    if (_sending.noAck || !(_reg[NRFSIM_EN_AA] & 0x01)) {
+        if (!_reuse && !_tx.empty()) _tx.pop_front();
+        _state = IDLE;
+        setFlag(NRFSIM_TX_DS);
+        maybeStartTx();
+        return;
+    }
+    _state = WAIT_ACK;
+    uint64_t ard = 250 * (((_reg[NRFSIM_SETUP_RETR] >> 4) & 0x0F) + 1);
+    _air.schedule(_air.now() + ard, this, EV_ACK_TIMEOUT, ++_gen);
+}
+
+
+inline void NrfSim::onEvent(int kind, uint32_t gen) {
+    if (gen != _gen) return;                    // Cancelled.
+    switch (kind) {
+        case EV_TX_START:
+            if (_state == TX_SETTLE) sendAttempt();
+            break;
+
+        case EV_ACK_TIMEOUT:
+            if (_state != WAIT_ACK) break;
+            if (_arc < (_reg[NRFSIM_SETUP_RETR] & 0x0F)) {
+                _arc++;
+                sendAttempt();
+            } else {
+                _state = IDLE;
+                if (_plos < 15) _plos++;
+                setFlag(NRFSIM_MAX_RT);         // Payload stays in the TX FIFO.
+            }
+            break;
+
+        case EV_ACK_START: {
+            if (_state != ACK_SETTLE) break;
+            AirFrame ack;
+            memset(&ack, 0, sizeof(ack));
+            ack.from = this;
+            ack.isAck = true;
+            ack.addrWidth = addrWidth();
+            memcpy(ack.addr, _ackPipe <= 1 ? _addr[_ackPipe] : _addr[1], 5);
+            if (_ackPipe > 1) ack.addr[0] = _addr[_ackPipe][0];
+            ack.pid = _ackPid;
+            ack.channel = channel();
+            ack.dataRate = dataRate();
+            ack.txDbm = txDbm();
+            if (_reg[NRFSIM_FEATURE] & NRFSIM_EN_ACK_PAY) {
+                for (auto it = _tx.begin(); it != _tx.end(); ++it) {
+                    if (it->pipe == _ackPipe) {
+                        ack.len = it->len;
+                        memcpy(ack.payload, it->data, it->len);
+                        _tx.erase(it);
+                        break;
+                    }
+                }
+            }
+            _state = ACK_AIR;
+            _air.transmit(ack, airMicros(ack.len));
+            break;
+        }
+    }
+}
+
+
+/* ---- Receiving ---------------------------------------------------------- */
+
+inline int NrfSim::matchPipe(const AirFrame& frame) const {
+    uint8_t aw = addrWidth();
+    if (frame.addrWidth != aw) return -1;
+    for (int p = 0; p <= 5; p++) {
+        if (!(_reg[NRFSIM_EN_RXADDR] & (1 << p))) continue;
+        if (p <= 1) {
+            if (memcmp(frame.addr, _addr[p], aw) == 0) return p;
+        } else if (frame.addr[0] == _addr[p][0] && memcmp(frame.addr + 1, _addr[1] + 1, aw - 1) == 0) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+
+inline void NrfSim::onFrame(const AirFrame& frame, bool corrupt) {
+    int8_t rxDbm = frame.txDbm - _pathLossDb - frame.from->pathLossDb();
+
+        /* PTX waiting on an ACK. */
+    if (_state == WAIT_ACK) {
+        if (!frame.isAck || corrupt || frame.dataRate != dataRate()) return;
+        if (frame.pid != _sending.pid || memcmp(frame.addr, _addr[0], addrWidth()) != 0) return;
+        _gen++;                                 // Cancel the ACK timeout.
+        _state = IDLE;
+        if (!_reuse && !_tx.empty()) _tx.pop_front();
+        if (frame.len && _rx.size() < NRFSIM_FIFO_DEPTH) {
+            FifoEntry e;
+            e.len = frame.len;
+            e.pipe = 0;
+            e.noAck = false;
+            memcpy(e.data, frame.payload, frame.len);
+            _rx.push_back(e);
+            _reg[NRFSIM_STATUS] |= NRFSIM_RX_DR;
+        }
+        setFlag(NRFSIM_TX_DS);
+        maybeStartTx();
+        return;
+    }
+
+        /* PRX. */
+    if (!listening() || frame.dataRate != dataRate()) return;
+    if (rxDbm >= NRFSIM_RPD_DBM) _reg[NRFSIM_RPD] = 1;
+    if (frame.isAck || corrupt) return;         // Corrupt = CRC check fails.
+    int pipe = matchPipe(frame);
+    if (pipe < 0) return;
+    if (!dynamic(pipe) && frame.len != _reg[NRFSIM_RX_PW_P0 + pipe]) return;
+
+    uint8_t sum = 0;                            // Stands in for the CRC in duplicate detection.
+    for (int i = 0; i < frame.len; i++) sum = (sum << 1 | sum >> 7) ^ frame.payload[i];
+    bool duplicate = _lastValid[pipe] && _lastPid[pipe] == frame.pid && _lastSum[pipe] == sum;
+    if (!duplicate) {
+        if (_rx.size() >= NRFSIM_FIFO_DEPTH) return;    // RX FIFO full: no ACK, PTX will retry.
+        FifoEntry e;
+        e.len = frame.len;
+        e.pipe = pipe;
+        e.noAck = frame.noAck;
+        memcpy(e.data, frame.payload, frame.len);
+        _rx.push_back(e);
+        _lastValid[pipe] = true;
+        _lastPid[pipe] = frame.pid;
+        _lastSum[pipe] = sum;
+        setFlag(NRFSIM_RX_DR);
+    }
+
+    if ((_reg[NRFSIM_EN_AA] & (1 << pipe)) && !frame.noAck) {
+        _ackPipe = pipe;
+        _ackPid = frame.pid;
+        _state = ACK_SETTLE;
+        _air.schedule(_air.now() + NRFSIM_SETTLE_MICROS, this, EV_ACK_START, ++_gen);
+    }
+}
+
+#endif
+
+
+
+/* =============================================================================
+   FOOTNOTES
+   =============================================================================
+
+    1. ACK payloads. On the real chip an ACK payload stays in the PRX's TX FIFO until a packet
+  with a new PID shows the PTX got it, so a lost ACK gets the same payload again on the retry.
+  Here it leaves the FIFO when it is sent, so a lost ACK loses its payload. The RPi code already
+  copes with that (commands are re-queued until the sensor reports them carried out), and it is
+  the harsher case to test against. TX_DS is set on the PRX when an ACK payload goes out.
+
+    2. Collisions. Any two frames on the same channel that overlap in time spoil each other for
+  every receiver, whatever their signal strengths. Frames on other channels don't interfere.
+  Two PTXs with the same ARD that collide once will, as on the real chips, keep colliding on
+  every retry (their attempts are the same ARD + air time apart) until one runs out of retries.
+
+    3. Shared addresses. All our sensors send to the same address, so any PTX waiting on an ACK
+  hears every ACK the PRX sends on that address. If the PIDs happen to match, it takes another
+  sensor's ACK as its own - a 'delivered' reading the RPi never got. That happens with the real
+  chips too, and shows up in RPi_RadioSim as ACK'd readings over distinct readings received.
+*/
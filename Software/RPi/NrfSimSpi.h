@@ -0,0 +1,64 @@
+// Class: NrfSimSpi - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef NrfSimSpi_h
+#define NrfSimSpi_h
+
+#include <cstdint>
+#include <linux/spi/spidev.h>
+#include "SpiBatch.h"
+#include "NrfSim.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: Points an NrfSpiBatch (SpiBatch.h) at a simulated chip (NrfSim.h) instead of the
+* spidev driver. Kept out of SpiBatch.h so the receiver, which only ever talks to the real
+* chip, doesn't compile the simulator.
+*
+*    USAGE:
+*    1. NrfSim chip(air); NrfSimSpi spi(&chip); NrfSpiBatch batch(&spi);
+*    2. messages() counts the SPI_IOC_MESSAGE calls that would have been ioctls, and
+*  transfers() the chip select cycles within them.
+*
+*    NOTE:
+*    1. Each transfer is one whole chip select cycle on the simulated chip, whatever its
+*  cs_change. That is what NrfSpiBatch asks for: every transfer is one command.
+*/
+
+class NrfSimSpi : public SpiTransport {
+
+  public:
+
+    NrfSimSpi(NrfSim* chip) : _chip(chip) {}
+
+    int message(const struct spi_ioc_transfer* xfer, int n) override;
+
+    unsigned long messages() const { return _messages; }
+    unsigned long transfers() const { return _transfers; }
+
+  private:
+    NrfSim* _chip;
+    unsigned long _messages = 0;
+    unsigned long _transfers = 0;
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline int NrfSimSpi::message(const struct spi_ioc_transfer* xfer, int n) {
+    int total = 0;
+    _messages++;
+    for (int i = 0; i < n; i++) {
+        _chip->transaction((const uint8_t*)(uintptr_t)xfer[i].tx_buf, (uint8_t*)(uintptr_t)xfer[i].rx_buf, xfer[i].len);
+        total += xfer[i].len;
+        _transfers++;
+    }
+    return total;
+}
+
+#endif
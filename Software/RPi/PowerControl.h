@@ -0,0 +1,180 @@
+// Class: PowerController - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef PowerControl_h
+#define PowerControl_h
+
+#include <cstdint>
+
+/************************************************************************************************
+*
+*    PURPOSE: Closed-loop transmit power control for the sensors. A pot sitting next to the RPi
+* does not need the same PA level as one at the far end of the garden. Each time a sensor's
+* packet comes in we look at how hard that sensor had to work to get it here - the auto-retransmit
+* count it reports (txRetries) plus any whole failed writes (the increase in ctErrors) - and keep a
+* smoothed 'retransmits per delivered packet' figure for it. When that figure is high we tell the
+* sensor, through the ACK payload, to step its PA level up one notch; when it has been very low
+* for a good while we tell it to step down one notch.
+*
+*    Hysteresis comes from four places: the step-up and step-down thresholds are far apart; a
+* step down needs PC_HOLD_PACKETS quiet packets in a row; after any change we ignore the next
+* PC_SETTLE_PACKETS packets while the sensor picks up the new level; and a step down that has to
+* be taken back within PC_PROBE_PACKETS doubles the quiet packets the next one needs, up to
+* PC_MAX_BACKOFF times. Without that last one, a sensor that is quiet at one level and struggles
+* at the next one down would go back and forth between them for ever.
+*
+*    The controller also keeps an estimate of the radio energy each sensor spends per delivered
+* packet, from the nRF24L01+ data sheet currents for its PA level and the attempts it took.
+*
+*    USAGE:
+*    1. Keep one PowerControlState per sensor (it lives in SensorState, see SensorRegistry.h).
+*    2. For every received packet call PowerController::update() with that sensor's state and
+*  the values from the packet. It returns true if the sensor should be sent a new PA level,
+*  which is then in state.desiredPALevel.
+*
+*    NOTE:
+*    1. Only the PA level is controlled. The data rate has to be the same on both ends of the
+*  link, and the RPi listens for all sensors on one radio, so it cannot be changed per sensor.
+*    2. Level numbers are the RF24 library's: 0=MIN(-18dBm) 1=LOW(-12dBm) 2=HIGH(-6dBm) 3=MAX(0dBm).
+*    3. The step-up threshold is low on purpose. An attempt at MAX costs only ~30% more than one
+*  at MIN (listening for the ACK costs more than the transmit), so a level that needs more than
+*  about half a retransmit a packet spends more than the one above it would. RPi_GatewaySoak -m
+*  checks the loop against sensors at known path losses.
+*/
+
+#define PC_MIN_LEVEL 0
+#define PC_MAX_LEVEL 3
+#define PC_ARC_MAX 15                   // Auto-retransmit count the sensor's radio gives up after.
+#define PC_STEP_UP_THRESHOLD 0.5f       // Smoothed retransmits/packet above this: step up.
+#define PC_STEP_DOWN_THRESHOLD 0.1f     // Smoothed retransmits/packet below this ...
+#define PC_HOLD_PACKETS 8               // ... for this many packets in a row: step down.
+#define PC_SETTLE_PACKETS 3             // Packets to ignore after a level change.
+#define PC_PROBE_PACKETS 32             // A step down taken back within this many packets failed ...
+#define PC_MAX_BACKOFF 5                // ... and doubles PC_HOLD_PACKETS, at most this many times.
+#define PC_EWMA_WEIGHT 0.125f           // Weight of the newest packet in the smoothed figure.
+
+    /* Energy model. nRF24L01+ Product Spec v1.0, section 5.2: TX current at each PA level,
+     * RX current at 1Mbps. One attempt is the TX of a full 32 byte payload (~41 bytes on air
+     * at 1Mbps, plus 130us PLL settling) followed by listening for the ACK. */
+#define PC_SUPPLY_VOLTS 3.0f
+#define PC_TX_SECONDS 460e-6f
+#define PC_ACKWAIT_SECONDS 250e-6f
+#define PC_RX_MILLIAMPS 13.1f
+
+
+    /* Per sensor state for the controller. Plain data so it can be kept in the
+       sensor registry as is. */
+struct PowerControlState {
+    uint8_t reportedPALevel;            // Level the sensor says it is using.
+    uint8_t desiredPALevel;             // Level we want it to use.
+    uint8_t settlePackets;              // Packets still to ignore after a change.
+    uint8_t downBackoff;                // Failed step downs in a row.
+    uint8_t steppedDown;                // The last change was a step down ...
+    uint16_t levelPackets;              // ... this many packets ago (stops at 0xFFFF).
+    uint16_t quietPackets;              // Consecutive packets under the step-down threshold.
+    float retransmitsEwma;              // Smoothed retransmits per delivered packet.
+    float microJoulesPerPacket;         // Smoothed estimate of radio energy per delivered packet.
+};
+
+
+class PowerController {
+
+  public:
+
+        /* The thresholds and packet counts, from the defines above; a test can
+           change them, e.g. to see what the loop does without hysteresis. */
+    float stepUpThreshold = PC_STEP_UP_THRESHOLD;
+    float stepDownThreshold = PC_STEP_DOWN_THRESHOLD;
+    uint8_t holdPackets = PC_HOLD_PACKETS;
+    uint8_t settlePackets = PC_SETTLE_PACKETS;
+    uint8_t maxBackoff = PC_MAX_BACKOFF;
+
+          /*    PURPOSE: Fold one received packet into a sensor's state.
+           *    RETURNS: True if the sensor needs to be told to change its PA level. */
+    bool update(PowerControlState& st, bool firstPacket, uint8_t paLevel, uint8_t txRetries,
+                uint32_t newErrors);
+
+          /*    PURPOSE: Energy, in micro-joules, of one transmit attempt at a PA level. */
+    static float attemptMicroJoules(uint8_t paLevel);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline float PowerController::attemptMicroJoules(uint8_t paLevel) {
+    static const float txMilliAmps[4] = {7.0f, 7.5f, 9.0f, 11.3f};     // -18, -12, -6, 0 dBm
+    if (paLevel > PC_MAX_LEVEL) paLevel = PC_MAX_LEVEL;
+    float milliJoules = PC_SUPPLY_VOLTS * (txMilliAmps[paLevel] * PC_TX_SECONDS + PC_RX_MILLIAMPS * PC_ACKWAIT_SECONDS);
+    return milliJoules * 1000.0f;
+}
+
+
+inline bool PowerController::update(PowerControlState& st, bool firstPacket, uint8_t paLevel,
+                                    uint8_t txRetries, uint32_t newErrors) {
+    st.reportedPALevel = paLevel;
+
+        /* Every failed write() on the sensor already burned a full set of retransmits. */
+    float retransmits = (float)txRetries + (float)newErrors * (PC_ARC_MAX + 1);
+    float microJoules = (1.0f + retransmits) * attemptMicroJoules(paLevel);
+
+    if (firstPacket) {
+        st.desiredPALevel = paLevel;
+        st.retransmitsEwma = retransmits;
+        st.microJoulesPerPacket = microJoules;
+        st.quietPackets = 0;
+        st.settlePackets = 0;
+        st.downBackoff = 0;
+        st.steppedDown = 0;
+        st.levelPackets = 0;
+        return false;
+    }
+    st.microJoulesPerPacket += PC_EWMA_WEIGHT * (microJoules - st.microJoulesPerPacket);
+
+        /* Still waiting for the sensor to act on the last command? Keep asking. */
+    if (st.desiredPALevel != paLevel) return true;
+
+    if (st.levelPackets < 0xFFFF) st.levelPackets++;
+    if (st.steppedDown && st.levelPackets > PC_PROBE_PACKETS) {
+        st.steppedDown = 0;                     // The step down held: back off a little less.
+        if (st.downBackoff > 0) st.downBackoff--;
+    }
+    if (st.settlePackets > 0) {
+        st.settlePackets--;
+        st.retransmitsEwma = retransmits;       // Restart the average at the new level.
+        return false;
+    }
+    st.retransmitsEwma += PC_EWMA_WEIGHT * (retransmits - st.retransmitsEwma);
+
+    if (st.retransmitsEwma > stepUpThreshold) {
+        st.quietPackets = 0;
+        if (paLevel < PC_MAX_LEVEL) {
+            if (st.steppedDown && st.downBackoff < maxBackoff) st.downBackoff++;
+            st.desiredPALevel = paLevel + 1;
+            st.settlePackets = settlePackets;
+            st.steppedDown = 0;
+            st.levelPackets = 0;
+            return true;
+        }
+    } else if (st.retransmitsEwma < stepDownThreshold) {
+        if (++st.quietPackets >= (holdPackets << st.downBackoff)) {
+            st.quietPackets = 0;
+            if (paLevel > PC_MIN_LEVEL) {
+                st.desiredPALevel = paLevel - 1;
+                st.settlePackets = settlePackets;
+                st.steppedDown = 1;
+                st.levelPackets = 0;
+                return true;
+            }
+        }
+    } else {
+        st.quietPackets = 0;
+    }
+    return false;
+}
+
+#endif
@@ -7,8 +7,208 @@
  *  /home/jroc/Dropbox/projects/MoistureSensor/CapSensor
  *  Refer to git for version history and associated comments.
  *
- * NOTE: For how to handle a SIGTERM event coming in from the OS see:
- * https://www.tutorialspoint.com/cplusplus/cpp_signal_handling.htm
+ * 10/19/2026-rel27:
+ *      > The rollups are kept in ROLLUP_FILEPATH, an mmap()'d file next to the state file, so a
+ *        restart - the watchdog's included - carries on with the year it had rather than
+ *        starting it again. A sensor's rollup follows it if it moves slot on loading.
+ *      > rollup's levels are 15 min for 2 days, an hour for a month, 8 hours for a year and a
+ *        week for 5 years: 72KB a sensor, 72MB of file for MAX_SENSORS (was 141KB, ~147MB of
+ *        RAM). Only the pages being added to stay in RAM, about 20MB for MAX_SENSORS.
+ *      > New -q sensorID[,days[,points]] parameter prints a sensor's rollup, the last days (7)
+ *        in about so many points (28), from the file, and exits. It can be run alongside the
+ *        receiver.
+ *
+ * 10/19/2026-rel26:
+ *      > The latency trace follows 1 packet in LATENCY_TRACE_EVERY (32), not every one. Every
+ *        one cost ~7% of a packet's CPU time; sampled it is under 1%. The stats lines' stage
+ *        times are from the sampled packets.
+ *
+ * 10/19/2026-rel25:
+ *      > Each sensor is logged every LOG_INTERVAL, on its own clock (SensorState.lastLog), and
+ *        its 1st reading as soon as it is heard. It used to be one line per LOG_INTERVAL for
+ *        the whole gateway, whichever sensor happened to be due, so with many sensors most
+ *        were never logged. The state file is started over once for the new SensorState.
+ *
+ * 10/19/2026-rel24:
+ *      > A bad payload width from batched SPI no longer leaves the radio without an ACK payload:
+ *        NrfSpiBatch flushes the payload and loads the ack in the same 2nd ioctl, and
+ *        readAndReload() returns 0 for it. Only a failed ioctl leaves the ack to be held.
+ *
+ * 10/19/2026-rel23:
+ *      > rollup has a 6 hour level, kept for a year, so a year in 1000 points comes back in
+ *        ~1460 6 hour buckets (about 12us) rather than 365 days. A sensor's buckets, 141KB, are
+ *        allocated when it is first heard from, not for MAX_SENSORS at startup (100MB of address
+ *        space before).
+ *
+ * 10/19/2026-rel22:
+ *      > history keeps each capacitance as it was sent, all 23 mantissa bits, about 4 bytes a
+ *        reading. Rounding to 14 bits (~2.8 bytes) is now opt-in, HISTORY_LOSSY_MANTISSA_BITS.
+ *        The block pool is sized to match: about 16MB of address space for MAX_SENSORS.
+ *
+ * 10/19/2026-rel21:
+ *      > Batched SPI keeps exactly one ACK payload in the radio. If readAndReload() finds the
+ *        FIFO empty after all, it flushes TX and loads that ack alone, rather than leave 2
+ *        queued. If its ioctl fails or the width is bad, the ack it was given is held and goes
+ *        out with the next packet, instead of being lost; the bad payload is flushed within
+ *        NrfSpiBatch now, not by radio.flush_rx().
+ *
+ * 10/19/2026-rel20:
+ *      > Every sensor's readings are also summed up by 15 minutes, hour, day and week, in
+ *        ReceiverCore's rollup (SensorRollup, SensorRollup.h): count, min, max, sum and sum of
+ *        squares a bucket, kept for a week, a month, 3 years and 10 years. A year of a sensor in
+ *        1000 points is a few hundred day buckets, a few us, not a scan of every reading. About
+ *        97KB a sensor heard; 100MB of address space for MAX_SENSORS, only touched as used.
+ *
+ * 10/19/2026-rel19:
+ *      > The last HISTORY_DAYS (30) of every sensor's readings are kept in RAM, in ReceiverCore's
+ *        history (SensorHistory, SensorHistory.h): packed Gorilla style, time as delta of delta
+ *        and capacitance XORed with the last, about 2 bytes a reading. Each reading is stamped
+ *        with when its sensor sent it (SensorClock). Capacitance is kept to 14 mantissa bits,
+ *        0.01pF at 100pF. The block pool is allocated at startup, about 10MB for MAX_SENSORS,
+ *        and only touched as it fills.
+ *
+ * 10/19/2026-rel18:
+ *      > Each sensor's clock is fitted to ours (SensorClock, SensorClock.h): a line through its
+ *        last dozen (sensorTime, time received) pairs, leaving out packets that came in late,
+ *        with millis()'s 49.7 day wrap undone and a reboot starting it again. Log lines say when
+ *        the reading was sent, SampleTime (ISO 8601, ms), and how fast the sensor's clock runs,
+ *        ClockPpm. SensorState has grown, so a state file from an earlier release is not used:
+ *        the receiver starts fresh once.
+ *
+ * 10/19/2026-rel17:
+ *      > Time stamps on log lines (ReceiverCore::addTime()) come from TimeStamp (TimeStamp.h):
+ *        the minute is formatted once per thread and copied, in place of a localtime_r() and
+ *        strftime() per line. Same text. RPi_DummyService uses it too.
+ *
+ * 10/19/2026-rel16:
+ *      > The verbose (-v) display is now a dashboard of every sensor (SensorDashboard,
+ *        SensorDashboard.h): last reading, age, loss %, battery mV and days to empty, and PA
+ *        level and retransmits per packet standing in for RSSI, with the SPI, queue, latency
+ *        and radio lines under it. It is drawn from slave()'s loop at most 5 times a second,
+ *        not per packet, and only the characters that changed are sent, in one write() a
+ *        frame. With more sensors than the terminal has rows it pages through them.
+ *      > DisplayRxPacket is gone. It showed the one rxPayload, field by field in hex, with
+ *        ~15 lines of setw()/endl per packet. Packets are no longer stamped TP_DISPLAYED.
+ *
+ * 10/19/2026-rel15:
+ *      > Messages go to the journal as structured entries (JournalLog, JournalLog.h) over its
+ *        native socket, when run as a service: EVENT=, PRIORITY= and fields such as SENSOR_ID=,
+ *        PA_FROM=/PA_TO=, RADIO_FAULT=, so e.g. journalctl EVENT=pa-change SENSOR_ID=12 finds
+ *        them. Each kind of event is rate-limited on its own (a burst, then so many a minute);
+ *        the next one that gets through carries SUPPRESSED=n. Entries are queued and sent a
+ *        batch at a time with one non-blocking sendmmsg(), from the main loop's idle nap and
+ *        every 16 entries; a busy journal is never waited for.
+ *      > Run in a terminal, the same messages go to the console as before, but without endl's
+ *        flush per line; the console is flushed from the idle nap.
+ *
+ * 10/19/2026-rel14:
+ *      > The radio is looked after while it runs (RadioSupervisor, RadioSupervisor.h). The radio
+ *        thread's once a second check now also counts silence - nothing received for 3 times
+ *        the usual gap between packets, at least RADIO_SILENCE_MIN_MILLIS - as something wrong.
+ *        Whatever is wrong (a register not as set up, STATUS impossible, failureDetected,
+ *        silence), the radio is set up again from scratch in setUpRadio() - begin(), dynamic
+ *        payloads, ACK payloads, PA level, pipes - with the ACK payload re-loaded, and goes back
+ *        into RX, all in the radio thread. Nothing else stops: the queues, the sensor state and
+ *        the log carry on. A set up that fails is tried again, backing off to every 10s; the
+ *        watchdog pings are held back meanwhile. Each recovery goes to the console, the log file
+ *        and systemctl status, with its cause and how long the set up took.
+ *      > A radio that doesn't respond at startup no longer ends the program: it is tried again
+ *        the same way, and READY=1 waits for it.
+ *
+ * 10/19/2026-rel13:
+ *      > Runs under systemd as Type=notify with a watchdog (see RPi_CapDataReceive.service),
+ *        talking to it through SdNotify (SdNotify.h). Once a second the radio thread reads back
+ *        STATUS and the registers set up wrote (RadioHealth, RadioHealth.h), and with
+ *        FAILURE_HANDLING, RF24's failureDetected. The main loop sends READY=1 after the first
+ *        good check - the radio set up and listening - and WATCHDOG=1 only while the checks are
+ *        good and recent. So a radio that has browned out or dropped off the SPI bus, a radio
+ *        thread stuck in an ioctl, or a main thread stuck on the disk all stop the pings, and
+ *        systemd restarts the service. A change in the radio's health goes to the console and
+ *        to systemctl status.
+ *
+ * 10/19/2026-rel12:
+ *      > What is known about each sensor - power control, battery curve, counts, the time of the
+ *        last log entry - is kept in STATE_FILEPATH (StateFile, StateFile.h), an mmap()'d file
+ *        with a slot per sensor, updated as packets come in. On startup it is loaded back, so a
+ *        restart, or a crash, carries on where it left off. A slot is never left half written,
+ *        even by kill -9.
+ *
+ * 10/19/2026-rel11:
+ *      > Orderly shutdown on SIGTERM (systemctl stop, reboot) and SIGINT (Control-C). Signals are
+ *        read from a signalfd (SignalFd, SignalFd.h) by the main thread between frames and while
+ *        it is idle, so nothing is cut off half way. The radio thread takes the radio out of RX,
+ *        so no more packets are ACK'd, moves what is left in the RX FIFO onto the queue and
+ *        powers the radio down. The main thread processes everything queued (for up to
+ *        SHUTDOWN_BUDGET_MILLIS), logs the latest reading if it hasn't been, and writes a
+ *        final stats line - including how long the shutdown took - to the console and the log
+ *        file. SIGUSR1 comes in the same way now.
+ *
+ * 10/19/2026-rel10:
+ *      > Each packet is followed from the air to the disk (LatencyTrace, LatencyTrace.h): its frame
+ *        carries a time stamp for each point it reaches - available, read, ACK re-armed,
+ *        dequeued, decoded, displayed, formatted, written, fsynced - and each stage goes into a
+ *        histogram of its own. The stamps are the CPU's tick counter, a few ns each. SIGUSR1
+ *        writes the histograms to the console (kill -USR1 <pid>); they are also written when the
+ *        program ends. Build with -DLATENCY_TRACE=0 to leave it all out.
+ *      > Log lines are fdatasync()'d before the file is closed.
+ *
+ * 10/19/2026-rel09:
+ *      > The radio has a thread of its own. All it does is take packets off the radio, time-stamp
+ *        them, re-arm the ACK payload and push the raw frames onto a lock-free queue (SpscRing,
+ *        SpscRing.h). The main thread pops them and does the decoding, the display and the log
+ *        file, so a slow log write or terminal no longer holds up the ACK reload while the next
+ *        sensor's packets pile up in the radio's 3-deep RX FIFO. Commands for ACK payloads go
+ *        back to the radio thread on a 2nd queue, so only the main thread touches the sensor
+ *        registry. Queue depth, drops and time per stage are in the verbose display, and on the
+ *        console every STATS_INTERVAL. Build with -pthread.
+ *
+ * 10/19/2026-rel08:
+ *      > What happens to a packet once it is off the radio - decoding, tracking the sensor,
+ *        picking the ACK payload, the log file - moved into ReceiverCore (ReceiverCore.h), so
+ *        the RPi_GatewaySoak benchmark can run the same code without a radio. No change in
+ *        behavior.
+ *
+ * 10/19/2026-rel07:
+ *      > Packets are taken off the radio with one batched spidev ioctl (NrfSpiBatch, SpiBatch.h)
+ *        covering the payload width, the payload, clearing RX_DR and loading the next ACK
+ *        payload, instead of a string of RF24 calls each doing its own ioctl. Polling is one
+ *        1-byte ioctl. New -s parameter goes back to the RF24 calls. The ioctls and the time
+ *        per packet for whichever path is in use are shown in the verbose display.
+ *
+ * 10/19/2026-rel06:
+ *      > Sensors built with DIAGNOSTIC_BUILD send a 10 byte DiagPayloadStruct every few cycles,
+ *        on top of their readings: the stack high-water mark, free SRAM, static SRAM and reset
+ *        flags. Payload size is how we tell the two apart. Each one goes to the console and
+ *        the log file; a sensor whose lowest-ever unused stack falls under
+ *        DIAG_STACK_WARN_BYTES is flagged.
+ *
+ * 10/19/2026-rel05:
+ *      > Replaced statusText with probeCap[3]: readings of a sensor's 2nd to 4th probes, in
+ *        1/100ths of a pF, 0 if the sensor doesn't have that probe. Extra probes are shown in
+ *        the display and written to the log file as Probe2..Probe4.
+ *
+ * 10/19/2026-rel04:
+ *      > Added bootAckMillis to RxPayloadStruct (statusText is now 6 bytes): the time from the
+ *        sensor's boot to its 1st ACK'd transmit. Each time a sensor reports a new value (i.e.,
+ *        it has rebooted) a line goes to the console, flagged if it is over BOOT_ACK_BUDGET_MILLIS.
+ *
+ * 10/19/2026-rel03:
+ *      > Added awakeMillis to RxPayloadStruct (statusText is now 8 bytes): how long the sensor
+ *        was awake for its previous read-Tx-ACK cycle. Shown in the display and the log.
+ *
+ * 10/19/2026-rel02:
+ *      > Added vccMillivolts to RxPayloadStruct (statusText is now 10 bytes). Each sensor's
+ *        voltage is followed by a BatteryTracker (BatteryTracker.h) which projects the time
+ *        until its battery is empty. Voltage and time-to-empty are in the log file entries.
+ *
+ * 10/19/2026-rel01:
+ *      > Closed-loop transmit power control. Replaced the units[] field in RxPayloadStruct with
+ *        sensorID, paLevel and txRetries (the sensor side TxPayloadStruct changed to match).
+ *        Each sensor's retransmit trend is tracked in a SensorRegistry slot and a
+ *        PowerController (PowerControl.h) decides when a sensor should step its PA level up or
+ *        down. The command goes back to the sensor in the ACK payload.
+ *      > New -p parameter to set this radio's PA level (0-3). Defaults to RF24_PA_LOW as before.
+ *      > Log file entries now carry the sensor ID, its PA level and energy per packet estimate.
  *
  * 12/10/2023-rel01:
  *      > Modifications to make this program suitable for autostart by user ROOT upon RPi bootup.
@@ -52,11 +252,23 @@
  *        populated, and transmitted, by the ATTiny84/nRF24 prototype device.
  */
 #include <cstdint>
-#define VERSION "12-11-2023 rel 01"
-
-#define LOG_FILEPATH "/home/readings.txt"
-//#define LOG_INTERVAL 60           // This is in seconds. 60=1 minute.
-#define LOG_INTERVAL 60 * 60 * 2    // Let's start with once every 2 hours for initial deployment.
+#define VERSION "10-19-2026 rel 27"
+
+#define LOG_FILEPATH "/home/readings.txt"   // Log interval etc. are in ReceiverCore.h.
+#define STATE_FILEPATH "/home/readings.state" // Per sensor state, kept across restarts.
+#define ROLLUP_FILEPATH "/home/readings.rollup" // Per sensor rollups (SensorRollup.h), kept across restarts.
+#define QUERY_DAYS 7                  // -q: days back from now...
+#define QUERY_POINTS 28               // ... in about this many points.
+#define RX_QUEUE_SIZE 64              // Frames the radio thread can get ahead of the main thread.
+#define ACK_QUEUE_SIZE 16             // Commands waiting to go out in ACK payloads.
+#define PROCESS_IDLE_MICROS 500       // Main thread's nap when there is nothing queued.
+#define RADIO_IDLE_MICROS 100         // Radio thread's nap when the RX FIFO is empty. Keeps a 1-core Pi usable.
+#define STATS_INTERVAL 60 * 60        // Seconds between pipeline stats lines on the console.
+#define SIGNAL_CHECK_FRAMES 64        // When busy, look for signals after this many frames.
+#define SHUTDOWN_BUDGET_MILLIS 3000   // Stop processing queued frames after this long. systemd waits 90s.
+#define RADIO_CHECK_MILLIS 1000       // Radio thread reads the radio's registers back this often.
+#define RADIO_STALE_MILLIS 3000       // No check for this long: the radio thread is stuck. No watchdog pings.
+#define RADIO_SILENCE_MIN_MILLIS 20 * 60 * 1000    // Nothing received for this long (or longer, see RadioSupervisor): set the radio up again.
 
 /*
  * For nRF24 radio chip documentation see https://nRF24.github.io/RF24
@@ -70,10 +282,25 @@
 #include <iomanip>     // format manipulators for use with cout
 #include <sstream>     // For ostringstream object.
 #include <cstring>     // std:strcmp()
+#include <cstdlib>     // atoi()
+#include <cstdio>      // sscanf()
 #include <string>      // string, getline()
-#include <time.h>      // CLOCK_MONOTONIC_RAW, timespec, clock_gettime()
-#include <fstream>     // For writing a log text file.
+#include <unistd.h>    // usleep()
+#include <thread>      // std::thread
+#include <atomic>      // std::atomic
+#include <csignal>     // SIGTERM, SIGINT, SIGUSR1
+#include <time.h>      // CLOCK_MONOTONIC, timespec, clock_gettime()
 #include <RF24/RF24.h> // RF24, RF24_PA_LOW, delay()
+#include "ReceiverCore.h"   // ReceiverCore, the payload structs, SensorRegistry
+#include "SpiBatch.h"      // NrfSpiBatch
+#include "SpscRing.h"      // SpscRing
+#include "LatencyTrace.h"      // LatencyTrace, TraceStamps, TRACE_STAMP()
+#include "SignalFd.h"          // SignalFd
+#include "RadioHealth.h"       // RadioHealth::describe()
+#include "RadioSupervisor.h"   // RadioSupervisor
+#include "SdNotify.h"          // SdNotify
+#include "JournalLog.h"        // JournalLog, LOG_ priorities
+#include "SensorDashboard.h"   // SensorDashboard
 
 using namespace std;
 
@@ -85,47 +312,71 @@ using namespace std;
     /* Construct nRF24 Radio object. */
 RF24 radio(22, 0);
 
+    /* Let these addresses be used for the pair. "2Node" is the address of
+       ATTiny's nRF24 radio. */
+uint8_t address[2][6] = {"1Node", "2Node"};
+
     /*      Using a struct to directly load the received payload may fail
        due to boundary-alignment issues. See details in the Evernote note for
        Milestone #5.
-            SO - below declare is a variable to read the received, raw, bytes into.
-       These bytes are then 'manually' loaded into the payload struct using
-       loadRxStruct().
-    */
-uint8_t rxBytes[40];
-
-    /* Struct to hold the data received in
-       from the ATTiny's nRF24
+            SO - below declare is a frame to read the received, raw, bytes into.
+       The radio thread queues the frames and the main thread 'manually' loads
+       the bytes into the payload struct using ReceiverCore::loadRxStruct().
     */
-struct RxPayloadStruct {
-  float capacitance;
-  uint32_t sensorTime;            // Milliseconds on ATTiny clock at time of transmission.
-  uint32_t ctSuccess;             // count of success Tx attempts tiny84 has seen since boot
-  uint32_t ctErrors;              // count of Tx errors tiny84 saw since last successful transmit
-  char units[4];                  // nFD, mFD, FD
-  char statusText[12];            // For use in debugging.
+struct RxFrame {
+    uint8_t bytes[40];
+    uint8_t width;
+    TraceStamps trace;                  // When it reached each point, air to disk.
 };
-RxPayloadStruct rxPayload;
-
-    /* Structure to store the outgoing ACK payload
-    */
-struct AckPayloadStruct {
-    uint32_t command;
-    uint32_t uliCmdData;
-
-    /*uint8_t command;      // Command ID back to sensor | 1-byte
-    uint8_t uiCmdData;    // Command data field: unsigned int | 1-byte
-    int iCmdData;         // Command data field: signed int | 2-bytes
-    uint32_t uliCmdData;  // Command data field: unsigned long int | 4-bytes
-    float fCmdData;       // Command data field: float | 4-bytes
-    */
+SpscRing<RxFrame, RX_QUEUE_SIZE> rxQueue;               // Radio thread -> main thread.
+SpscRing<AckPayloadStruct, ACK_QUEUE_SIZE> ackQueue;    // Main thread -> radio thread.
+AckPayloadStruct heldAck;                               // Radio thread only: an ACK payload readAndReload() didn't take.
+bool ackHeld = false;
+
+    /* Everything that happens to a packet after it is off the radio. Holds
+       the payload structs, the sensor registry and power control. */
+ReceiverCore core(LOG_FILEPATH);
+
+    /* PA level for this radio. Set with the -p parameter. */
+uint8_t paLevel = RF24_PA_LOW;
+
+    /* Takes packets off the radio in one ioctl. Same spidev device as the
+       RF24 radio object above. Turned off with the -s parameter. */
+NrfSpiBatch spiBatch("/dev/spidev0.0");
+bool useSpiBatch = true;
+
+    /* Kept by the radio thread, read by the display. */
+struct RadioStats {
+    std::atomic<unsigned long> packets{0};
+    std::atomic<unsigned long> ioctls{0};       // Batched SPI only.
+    std::atomic<unsigned long> drops{0};        // Frames lost because rxQueue was full.
+    std::atomic<unsigned int> maxDepth{0};      // Deepest rxQueue has been.
+    std::atomic<uint32_t> fault{RADIO_FAULT_NONE};  // What is wrong with the radio now (RadioSupervisor::fault()).
+    std::atomic<uint64_t> checkedMicros{0};     // When it was last checked; 0 = not yet.
+    std::atomic<unsigned long> recoveries{0};   // Times the radio was set up again ...
+    std::atomic<uint32_t> recoveryCause{RADIO_FAULT_NONE};  // ... the last one's cause ...
+    std::atomic<uint64_t> recoveryMicros{0};    // ... and how long its set up took.
 };
-AckPayloadStruct ackPayload;
+RadioStats radioStats;
+
+    /* READY=1 and the watchdog pings to systemd; does nothing when not run by
+       systemd as Type=notify. */
+SdNotify sdNotify;
 
-    /* Custom defined timer for evaluating transmission
-       time in microseconds.
+    /* How long each packet spent getting to each point from the one before,
+       from the time stamps in its frame. Recorded on the main thread once the
+       packet is done with. SIGUSR1 writes the histograms to the console.
     */
-struct timespec startTimer, endTimer;
+LatencyTrace latency;
+
+    /* The signals the main thread acts on. A global, so they are blocked
+       before any thread starts. */
+SignalFd signals({SIGTERM, SIGINT, SIGUSR1});
+
+    /* Cleared by the main thread to stop the radio thread; radioStopped is set
+       by the radio thread once it has queued its last frame. */
+std::atomic<bool> radioRunning{true};
+std::atomic<bool> radioStopped{false};
 
     /* Set via the user specifying the -v parameter when invoking the program
      * at startup. In the code I am using this to control how much output to
@@ -138,21 +389,9 @@ struct timespec startTimer, endTimer;
      * set. Something for a future enhancement. */
 bool dispVerbose = false;
 
-
-/* =============================================================================
-   Class definitions
-   =============================================================================
-*/
-class DisplayRxPacket {
-    public:
-        DisplayRxPacket();
-        void displayRxResults(RxPayloadStruct* pStruct, bool bCurReset=true);
-
-    private:
-        bool bFirstTime;
-        void showHexOfBytes(unsigned char* b, int iLen);                                    // display hex value of variables
-
-};
+    /* The verbose display: a table of every sensor, drawn from slave()'s
+       loop. */
+SensorDashboard dashboard;
 
 
 /* =============================================================================
@@ -161,15 +400,26 @@ class DisplayRxPacket {
 */
 void setRole();                                                                     // to set the node's role
 void slave();                                                                       // RX node's behavior
-void displayRxResults(RxPayloadStruct* pStruct, bool bCurReset=true);               // display received transmission info
+void processFrame(RxFrame& frame);                                                  // Decode, track, log one frame
+void shutdown(std::thread& radioThread, int sig);                                   // Orderly exit on SIGTERM/SIGINT
+void showDashboard(uint64_t now);                                                   // Verbose display: every sensor, pipeline
 void displayRxStruct(RxPayloadStruct* pStruct);                                     // outputs received payload to console
 void displayRxbuffer(uint8_t* rxBytes, uint8_t size_rxBytes, uint8_t ctRawBytes);   // outputs raw received data to console
-void loadRxStruct(RxPayloadStruct* pStruct, uint8_t* pBytes);                       // loads raw data into structure
 void showHexOfBytes(unsigned char* b, int iLen);                                    // display hex value of variables
 void displayAck(AckPayloadStruct* pStruct);                                         // display ack response data
-void setAckPayload(uint32_t cmd, uint32_t uliData);                                 // Load the ack response data packet
-bool logData(RxPayloadStruct* rxData);                                              // Write a log entry.
-string getCurrTimeFormatted();                                                      // Get current time in a formatted string.
+bool setUpRadio();                                                                  // begin() and configure the radio
+void radioService();                                                                // Radio thread: FIFO -> rxQueue
+void superviseRadio(RadioSupervisor& supervisor, uint64_t now);                     // Radio thread: check, recover -> radioStats
+void watchdog(uint64_t now);                                                        // READY=1 / WATCHDOG=1 to systemd while the radio is well
+bool receivePacket(RxFrame* frame, AckPayloadStruct* ack);                          // Take the next packet off the radio, if there is one
+bool drainPacket(RxFrame* frame);                                                   // Same, radio out of RX, no ACK payload
+void queueFrame(const RxFrame& frame);                                              // Push onto rxQueue, count drops
+void nextAck(AckPayloadStruct* ack);                                                // Pick the next ACK payload from ackQueue
+string stageText(const LatencyHistogram& h);                                        // "p50/p99" in microseconds
+void reportPipeline();                                                              // Pipeline stats line to the console
+void dumpLatency();                                                                 // Latency histograms to the console
+uint64_t nowMicros();                                                               // CLOCK_MONOTONIC in us
+int queryRollup(const char* spec);                                                  // -q: a sensor's rollup to the console
 
 
 int main(int argc, char** argv) {
@@ -177,52 +427,68 @@ int main(int argc, char** argv) {
     string currTimeFormatted;
     string progName = argv[0];
 
-    //   Determine if we are in verbose output display mode or not.
+    //   Determine if we are in verbose output display mode or not, and
+    //   if a radio PA level was asked for. -q is a query, not a run.
     for (int i = 0; i < argc; ++i) {
         if (std::strcmp(argv[i], "-v") == 0) {
             dispVerbose = true;
-            break;
+        } else if (std::strcmp(argv[i], "-s") == 0) {
+            useSpiBatch = false;
+        } else if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            int level = atoi(argv[++i]);
+            if (level >= RF24_PA_MIN && level <= RF24_PA_MAX) paLevel = level;
+        } else if (std::strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            return queryRollup(argv[i + 1]);
         }
     }
 
-    //   Post 'announcement' of running to the console/systemlog.
-    ossConsoleDisplay << argv[0] << " [" << VERSION << "] " << "Started at: " << getCurrTimeFormatted();
-    cout << ossConsoleDisplay.str() << endl;
-    ossConsoleDisplay.str("");
+    //   Structured entries straight to the journal when run as a service.
+    core.journal.openIfJournal();
 
-    // perform hardware check
-    if (!radio.begin()) {
-        cout << "ERROR: nRF24 radio hardware is not responding." << endl;
-        return -1; // quit now, with error condition.
+    if (!signals.isOpen()) {
+        cout << "WARNING: Could not open a signalfd. SIGTERM will not shut down in order." << endl;
     }
 
-    // Let these addresses be used for the pair
-    uint8_t address[2][6] = {"1Node", "2Node"}; // "2Node is the address of ATTiny's nRF24 radio."
-
-    // to use ACK payloads, we need to enable dynamic payload lengths
-    radio.enableDynamicPayloads();    // ACK payloads are dynamically sized
-
-    // Acknowledgement packets have no payloads by default. We need to enable
-    // this feature for all nodes (TX & RX) to use ACK payloads.
-    radio.enableAckPayload();
+    //   Post 'announcement' of running to the console/systemlog.
+    ossConsoleDisplay << argv[0] << " [" << VERSION << "] " << "Started at: " << core.currTimeFormatted();
+    if (core.journal.start(EVENT_LIFECYCLE, LOG_NOTICE)) {
+        core.journal.field("VERSION", VERSION).send(ossConsoleDisplay.str().c_str());
+    }
+    core.journal.flush();
+    ossConsoleDisplay.str("");
 
-    // Set the PA Level low to try preventing power supply related problems
-    // because these examples are likely run with nodes in close proximity to
-    // each other.
-    radio.setPALevel(RF24_PA_LOW);  // RF24_PA_MAX is default.
+    //   Pick up what the last run knew about the sensors.
+    int restored = core.openState(STATE_FILEPATH, ROLLUP_FILEPATH);
+    if (restored < 0) {
+        cout << "WARNING: Could not open " << STATE_FILEPATH << ". Sensor state will not be kept." << endl;
+    } else {
+        cout << "Sensor state: " << restored << " sensors restored from " << STATE_FILEPATH << endl;
+    }
+    if (!core.rollup.isOpen()) {
+        cout << "WARNING: Could not open " << ROLLUP_FILEPATH << ". Rollups will not be kept." << endl;
+    } else {
+        cout << "Rollups: " << core.rollup.slotsInUse() << " sensors in " << ROLLUP_FILEPATH
+             << (core.rollup.fresh() ? " (started over)" : "") << endl;
+    }
 
-    // set the address of the receiving node into the TX pipe
-    radio.openWritingPipe(address[1]);     // always uses pipe 0
+    // perform hardware check, and set the radio up
+    if (!setUpRadio()) {
+        cout << "ERROR: nRF24 radio hardware is not responding. Will keep trying." << endl;
+    }
 
-    // set this nodes's address into a reading pipe
-    radio.openReadingPipe(1, address[0]); // using pipe 1
+    // Batched SPI needs its own handle on the spidev device.
+    if (useSpiBatch && !spiBatch.isOpen()) {
+        cout << "WARNING: Could not open /dev/spidev0.0 for batched SPI. Using RF24 calls." << endl;
+        useSpiBatch = false;
+    }
 
     // For debugging info
     if (dispVerbose) {
         radio.printPrettyDetails();     // (larger) function that prints human readable data
     } else {
         ossConsoleDisplay << "Radio Initilized: Receive-Addr=" << address[0];
-        ossConsoleDisplay << " | Pwr Level=" << radio.getPALevel();
+        ossConsoleDisplay << " | Pwr Level=" << (unsigned int)radio.getPALevel();
+        ossConsoleDisplay << " | SPI=" << (useSpiBatch ? "batched" : "RF24");
         cout << ossConsoleDisplay.str() << endl;
         ossConsoleDisplay.str("");
     }
@@ -244,6 +510,42 @@ int main(int argc, char** argv) {
    =============================================================================
 */
 
+/* Set the radio up from scratch.
+   ----------------------------------------------------------------------------
+   At startup, and again by the radio thread's RadioSupervisor whenever the
+   radio has stopped working - as RF24's failureDetected example does it.
+   Leaves it out of RX; radioService() loads the ACK payload and starts it
+   listening.
+   RETURNS: False if the radio hardware is not responding.
+ */
+bool setUpRadio() {
+    if (!radio.begin()) return false;
+
+    // to use ACK payloads, we need to enable dynamic payload lengths
+    radio.enableDynamicPayloads();    // ACK payloads are dynamically sized
+
+    // Acknowledgement packets have no payloads by default. We need to enable
+    // this feature for all nodes (TX & RX) to use ACK payloads.
+    radio.enableAckPayload();
+
+    // PA Level defaults to low to try preventing power supply related problems
+    // because these examples are likely run with nodes in close proximity to
+    // each other. Can be changed with the -p parameter.
+    radio.setPALevel(paLevel);  // RF24_PA_MAX is default.
+
+    // set the address of the receiving node into the TX pipe
+    radio.openWritingPipe(address[1]);     // always uses pipe 0
+
+    // set this nodes's address into a reading pipe
+    radio.openReadingPipe(1, address[0]); // using pipe 1
+
+#if defined(FAILURE_HANDLING)
+    radio.failureDetected = 0;
+#endif
+    return true;
+}
+
+
 /* 09/26/20233: This function is now obsolete.
  * Set this node's role from stdin stream.
  *   This only considers the first char as input.
@@ -270,49 +572,127 @@ void setRole() {
 } // setRole()
 
 
-/* Performs receiver-role tasks */
+/* Performs receiver-role tasks
+   ----------------------------------------------------------------------------
+   Starts the radio thread, then processes the frames it queues, until a
+   SIGTERM or SIGINT comes in and shutdown() winds things up. The watchdog is
+   seen to from here, so it only gets pinged while this loop goes round.
+ */
 void slave() {
     // Working variables.
-    time_t lastLog = time(0);
-    time_t logInterval = LOG_INTERVAL;
-    ostringstream ossConsoleDisplay;
+    RxFrame frame;
+    time_t lastStats = time(0);
+    unsigned int sinceSignalCheck = 0;
+    int sig = 0;
+
+    std::thread radioThread(radioService);                              // Radio thread: FIFO -> rxQueue, ACK payloads from ackQueue.
+    while (true) {                                                      // Until SIGTERM/SIGINT.
+        if (!rxQueue.pop(frame)) {                                      // Nothing received?
+            sig = signals.wait(PROCESS_IDLE_MICROS);                    // Nap, unless a signal comes in.
+            watchdog(nowMicros());
+            core.journal.flush();                                       // Whatever is queued for the journal.
+        } else {
+            processFrame(frame);
+            if (++sinceSignalCheck >= SIGNAL_CHECK_FRAMES) {
+                sinceSignalCheck = 0;
+                sig = signals.take();
+                watchdog(nowMicros());
+            }
+        }
+        if (sig == SIGTERM || sig == SIGINT) break;
+        if (sig == SIGUSR1) dumpLatency();                              // kill -USR1
+        sig = 0;
 
-    setAckPayload(0, 15000);                               // Populate ack payload struct for next Rx/ack cycle.
-    DisplayRxPacket dspRx;                                 // create object to display received packets
+        if (time(0) > lastStats + STATS_INTERVAL) {
+            reportPipeline();
+            lastStats = time(0);
+        }
+        if (dispVerbose) {
+            uint64_t now = nowMicros();
+            if (dashboard.due(now)) showDashboard(now);
+        }
+    } // BOTTOM of while loop
+    shutdown(radioThread, sig);
+} // BOTTOM of slave()
 
-        /* Load the ackPayload for first received
-           transmission on pipe 0. */
-    radio.writeAckPayload(1, &ackPayload, sizeof(ackPayload));
 
-    radio.startListening();                                             // put radio in RX mode
-    while (true) {                                                      // No timeout, infinite loop here.
-        uint8_t pipe;
-        if (radio.available(&pipe)) {                                   // is there a received payload? get the pipe number that recieved it
-            uint8_t bytes = radio.getDynamicPayloadSize();              // <<-- NOTE: Compilier says we never use this anywhere. Myes, get it's size
-            radio.read(&rxBytes[0], sizeof(rxBytes));                   // fetch payload from RX FIFO
-            loadRxStruct(&rxPayload, rxBytes);                          // Manually' load rxPayload structure from the received bytes array.
-            if(dispVerbose) dspRx.displayRxResults(&rxPayload, true);   // display received transmission info, if verbose display is true.
-            setAckPayload(0, 15000);                                    // Populate ack payload struct for next Rx/ack cycle.
-            radio.writeAckPayload(1, &ackPayload, sizeof(ackPayload));  // Load the ACK payload into writing pipe for next cycle.
-            if(time(0) > lastLog + logInterval) {                       // Time to write log entry?
-                logData(&rxPayload);
-                ossConsoleDisplay.str("");
-                ossConsoleDisplay << "Writing Sensor Readings to Log File.";
-                cout << ossConsoleDisplay.str() << endl;
-                ossConsoleDisplay.str("");
-                lastLog = time(0);
-            } //BOTTOM of IF[test if time to write log entry]
-        } // BOTTOM of IF[test if payload received]]
-    } // BOTTOM of while loop
+/* Decode and track a frame (which may give a sensor a command to go out in an
+   ACK payload), log it if due.
+   ----------------------------------------------------------------------------
+ */
+void processFrame(RxFrame& frame) {
+    TRACE_STAMP(frame.trace, TP_DEQUEUED);
 
-        /* Handle radio listening timout case. Which, other than a Control-C by
-           the user, is the only way the slave() function ends. And upon ending
-           we return back to the setRole() function's while loop, allowing the
-           user to quite or initiate another try.
-        */
-    radio.stopListening();                                              // recommended idle behavior is TX mode, tho we never get to this line.
-    cout << "Just executed radio.stopListening() inside of slave()";    // But IF we do, notify user of this fact.
-} // BOTTOM of slave()
+    bool reading = core.track(frame.bytes, frame.width);            // Load the payload struct and update what we know about this sensor; may queue a command for it.
+    while (core.sensors.pendingCount() > 0 && !ackQueue.full()) {   // Hand queued commands to the radio thread for the next ACK payloads.
+        core.setNextAckPayload();
+        ackQueue.push(core.ackPayload);
+    }
+    TRACE_STAMP(frame.trace, TP_DECODED);
+
+    if (reading) core.logIfDue(&frame.trace);                       // Time to write log entry?
+    latency.record(frame.trace);
+}
+
+
+/* Orderly shutdown on SIGTERM (systemctl stop, reboot) or SIGINT (Control-C).
+   ----------------------------------------------------------------------------
+   1. The radio thread is told to stop. On its way out it takes the radio out
+      of RX, so no sensor is ACK'd for a packet we then don't process, queues
+      what is left in the RX FIFO and powers the radio down.
+   2. Meanwhile, and until the radio thread is done and rxQueue is empty,
+      every frame queued is processed - unless that runs past
+      SHUTDOWN_BUDGET_MILLIS; whatever is left then is counted as lost.
+   3. The latest reading is logged if it hasn't been (log lines are fsync'd).
+   4. A final stats line goes to the console and the log file, with how long
+      all this took, then the pipeline stats and the latency histograms.
+ */
+void shutdown(std::thread& radioThread, int sig) {
+    uint64_t t0 = nowMicros();
+    if (core.journal.start(EVENT_LIFECYCLE, LOG_NOTICE)) {
+        core.journal.field("SIGNAL", sig).send(sig == SIGTERM ? "Caught SIGTERM. Shutting down." : "Caught SIGINT. Shutting down.");
+    }
+    core.journal.flush();
+    sdNotify.stopping();
+
+    radioRunning.store(false, memory_order_release);
+
+    RxFrame frame;
+    unsigned long drained = 0;
+    unsigned int lost = 0;
+    while (true) {
+        bool radioDone = radioStopped.load(memory_order_acquire);      // Before the pop, so no last frame is missed.
+        if (nowMicros() - t0 > SHUTDOWN_BUDGET_MILLIS * 1000ULL) {
+            lost = rxQueue.depth();
+            break;
+        }
+        if (rxQueue.pop(frame)) {
+            processFrame(frame);
+            drained++;
+        } else if (radioDone) {
+            break;
+        } else {
+            usleep(RADIO_IDLE_MICROS);
+        }
+    }
+    radioThread.join();
+    bool flushed = core.flush();
+
+    FixedLine line;
+    line.add("Shutdown (").add(sig == SIGTERM ? "SIGTERM" : "SIGINT").add("): ")
+        .add(radioStats.packets.load(memory_order_relaxed)).add(" packets, ").add(core.readings).add(" readings, ")
+        .add(radioStats.drops.load(memory_order_relaxed)).add(" dropped. Drained ").add(drained).add(" queued frames, ")
+        .add(lost).add(" lost, log ").add(flushed ? "flushed" : "NOT flushed").add(", in ")
+        .add((nowMicros() - t0) / 1000.0, 3).add(" ms.");
+    if (core.journal.start(EVENT_LIFECYCLE, LOG_NOTICE)) {
+        core.journal.field("SIGNAL", sig).field("DRAINED", drained).field("LOST", lost)
+                    .field("LOG_FLUSHED", flushed ? 1 : 0).send(line.c_str());
+    }
+    core.logNote(line.c_str());
+    reportPipeline();
+    core.journal.flush();
+    dumpLatency();
+}
 
 
 
@@ -330,7 +710,7 @@ void displayRxbuffer(uint8_t* rxBytes, uint8_t size_rxBytes, uint8_t ctRawBytes)
         */
     cout << "Recieved " << (unsigned int)ctRawBytes << " bytes | ";
     cout << "Size of rxBytes[]: " << (unsigned int)size_rxBytes << " || ";
-    cout << "Size Of rxPayload struct: " << sizeof(rxPayload) << " | " << endl;
+    cout << "Size Of rxPayload struct: " << sizeof(core.rxPayload) << " | " << endl;
 
         /* Inspect the received data received from ATTiny.
         */
@@ -367,38 +747,6 @@ void displayAck(AckPayloadStruct* pStruct) {
 
 
 
-/* Manually load the incoming data into a structure.
-   ----------------------------------------------------------------------------
-    REQUIRES: The RxPayloadStruct defintion on this node exactly match the
-              definition created on the transmit node.
-
-    07/19/202: Removed the code that writes the hex output to the console so
-    that this function only loads the structure and does not affect the
-    console display. If console output needs to be reimplemented, go back
-    to MS-06_CapDataReceived_05.cpp.
- */
-void loadRxStruct(RxPayloadStruct* pStruct, uint8_t* pBytes) {
-    size_t offset = 0;
-
-    pStruct->capacitance = *(float *)&pBytes[offset];
-    offset = offset + sizeof(pStruct->capacitance);
-
-    pStruct->sensorTime = *(uint32_t *)&pBytes[offset];
-    offset = offset + sizeof(pStruct->sensorTime);
-
-    pStruct->ctSuccess = *(uint32_t *)&pBytes[offset];
-    offset = offset + sizeof(pStruct->ctSuccess);
-
-    pStruct->ctErrors = *(uint32_t *)&pBytes[offset];
-    offset = offset + sizeof(pStruct->ctErrors);
-
-    memcpy((unsigned char *)&pStruct->units, &pBytes[offset], sizeof(pStruct->units));
-    offset = offset + sizeof(pStruct->units);
-
-    memcpy(pStruct->statusText, &pBytes[offset], sizeof(pStruct->statusText));
-}
-
-
 /* Display the HEX value of the bytes that store a variable.
    ----------------------------------------------------------------------------
    PARMS:      1. The first byte of the variable to show the HEX for is passed in
@@ -417,165 +765,364 @@ void showHexOfBytes(unsigned char* b, int iLen) {
 
 
 
-/* CLASS DisplayRxPacket
-   ============================================================================
-   Function definitions for class
-   */
-
-/* Class Constructor
+/* Draw the verbose display: every sensor, and the pipeline under it.
    ----------------------------------------------------------------------------
-   */
-DisplayRxPacket::DisplayRxPacket() {
-    bFirstTime = true;
+   From slave()'s loop whenever dashboard.due(), so at most 5 frames a second
+   however fast packets come in. The dashboard sends only what changed.
+ */
+void showDashboard(uint64_t now) {
+    FixedLine line;
+    unsigned long packets = radioStats.packets.load(memory_order_relaxed);
+    line.add(" SPI rx: ");
+    if (useSpiBatch && packets) line.add((double)radioStats.ioctls.load(memory_order_relaxed) / packets, 3).add(" ioctl/pkt");
+    else line.add("RF24 calls");
+    if (latency.stage(TP_READ).count()) line.add(", ").add(latency.stage(TP_READ).mean() / 1000, 3).add(" us/pkt");
+    line.add("  |  rx queue: ").add(rxQueue.depth()).add(" deep, max ").add(radioStats.maxDepth.load(memory_order_relaxed))
+        .add('/').add(RX_QUEUE_SIZE).add(", ").add(radioStats.drops.load(memory_order_relaxed)).add(" dropped");
+    dashboard.setStatus(0, line.c_str());
+
+    line.clear();
+    line.add(" p50/p99 us: read ").add(stageText(latency.stage(TP_READ)).c_str())
+        .add("  queue ").add(stageText(latency.stage(TP_DEQUEUED)).c_str())
+        .add("  decode ").add(stageText(latency.stage(TP_DECODED)).c_str())
+        .add("  to disk ").add(stageText(latency.airToDisk()).c_str());
+    dashboard.setStatus(1, line.c_str());
+
+    line.clear();
+    line.add(" radio: ");
+    RadioHealth::describe(radioStats.fault.load(memory_order_relaxed), line);
+    line.add(", set up again ").add(radioStats.recoveries.load(memory_order_relaxed)).add(" times");
+    dashboard.setStatus(2, line.c_str());
+
+    dashboard.draw(core.sensors, time(0), now);
 }
 
 
-/* Display Results of a received Transmission
+/* Radio thread.
    ----------------------------------------------------------------------------
-   REQUIRES:    loadRxStruct() has already been called.
-   bCurReset:   If TRUE then this proc will move cursor back up the screen so
-                that it overwrites a previous call to this function so that
-                the display does not scroll. If FALSE it will outputting the
-                display below whever the current console cursor is
-                (i.e., scroll mode). Defaults to TRUE.
+   Only services the radio: takes each packet off it, re-arms the ACK payload
+   and queues the raw frame for the main thread. Nothing here waits on the
+   console or the disk. If the main thread has fallen so far behind that
+   rxQueue is full the frame is dropped and counted; the sensor has its ACK
+   already, so it will not resend. Every RADIO_CHECK_MILLIS it checks the
+   radio is still there and working, and sets it up again if not
+   (superviseRadio()).
  */
-void DisplayRxPacket::displayRxResults(RxPayloadStruct* pStruct, bool bCurReset) {
-    static bool bFirstTime = true;
-    unsigned int iLinesConsumed = 7;
-    unsigned int wdthVarName = 14;
-    unsigned int wdthValue = 14;
-
-    /* Avoid overwriting the prior 7 lines when we perform
-     this fuction the first time through. 1st time through it should write out
-     to new lines. Then, if bCurRest is passed in as TRUE it should
-     subsequently go back up the screen the right number of lines.
-     */
-    if(bCurReset && !bFirstTime) {
-        cout << "\033[" << iLinesConsumed << "A";
+void radioService() {
+    RxFrame frame;
+    AckPayloadStruct ack = {CMD_NONE, 0};
+
+        /* Load the ackPayload for first received
+           transmission on pipe 0, and put the radio in RX mode. Again
+           after each set up, with whatever ACK payload was in it. */
+    auto startRadio = [&ack]() {
+        radio.writeAckPayload(1, &ack, sizeof(ack));
+        radio.startListening();
+    };
+    RadioSupervisor supervisor(spiBatch.isOpen() ? &spiBatch : NULL, [&startRadio]() {
+        if (!setUpRadio()) return false;
+        startRadio();
+        return true;
+    });
+    supervisor.checkMicros = RADIO_CHECK_MILLIS * 1000ULL;
+    supervisor.silenceMinMicros = RADIO_SILENCE_MIN_MILLIS * 1000ULL;
+
+    startRadio();
+    supervisor.start(nowMicros());                                      // Set up as it should be; checks compare with this.
+    superviseRadio(supervisor, nowMicros());
+    while (radioRunning.load(memory_order_acquire)) {
+        uint64_t now = nowMicros();
+        if (supervisor.due(now)) superviseRadio(supervisor, now);
+        if (!receivePacket(&frame, &ack)) {
+                /* Nothing received. If the ACK payload waiting in the radio is an
+                   empty one and a command has come in, swap it in now rather than
+                   hold the command back a whole packet. */
+            if (ack.command == CMD_NONE && ackQueue.pop(ack)) {
+                radio.flush_tx();
+                radio.writeAckPayload(1, &ack, sizeof(ack));
+            }
+            usleep(RADIO_IDLE_MICROS);                              // The FIFO holds 3 packets; there is time.
+            continue;
+        }
+        supervisor.received(now);
+        queueFrame(frame);
     }
-    bFirstTime = false;
 
-    cout << "============= Incoming Transmissions ==============" << endl;
+        /* Shutting down. Out of RX first, so nothing more is ACK'd, then
+           whatever the sensors were ACK'd for is still in the RX FIFO. */
+    radio.stopListening();
+    while (drainPacket(&frame)) {
+        while (rxQueue.full()) usleep(RADIO_IDLE_MICROS);          // The main thread is emptying it.
+        queueFrame(frame);
+    }
+    radio.powerDown();
+    radioStopped.store(true, memory_order_release);
+}
 
-    cout << setw(wdthVarName) << setfill(' ') << " capacitance: ";
-    cout << setw(2) << (unsigned int)sizeof(rxPayload.capacitance);
-    cout << " | " << setw(wdthValue) << rxPayload.capacitance << " | 0x ";
-    showHexOfBytes((unsigned char*)&rxPayload.capacitance,sizeof(rxPayload.capacitance));
-    cout << endl;
 
-    cout << setw(wdthVarName) << setfill(' ') << " sensorTime: ";
-    cout << setw(2) << (unsigned int)sizeof(rxPayload.sensorTime);
-    cout << " | " << setw(wdthValue) << rxPayload.sensorTime << " | 0x ";
-    showHexOfBytes((unsigned char*)&rxPayload.sensorTime,sizeof(rxPayload.sensorTime));
-    cout << endl;
+/* Check the radio is working, set it up again if not, tell the main thread.
+   ----------------------------------------------------------------------------
+   Radio thread. The supervisor reads back STATUS and the set up registers
+   through the batched SPI handle - whichever path takes the packets - and
+   looks for silence. If the handle could not be opened, RF24 is asked if the
+   chip is connected instead. With FAILURE_HANDLING, RF24's own
+   failureDetected counts too.
+ */
+void superviseRadio(RadioSupervisor& supervisor, uint64_t now) {
+    uint32_t other = RADIO_FAULT_NONE;
+    if (!spiBatch.isOpen() && !radio.isChipConnected()) other = RADIO_FAULT_LIBRARY;
+#if defined(FAILURE_HANDLING)
+    if (radio.failureDetected) other = RADIO_FAULT_LIBRARY;
+#endif
+    if (supervisor.service(now, other)) {
+        radioStats.recoveryCause.store(supervisor.lastCause(), memory_order_relaxed);
+        radioStats.recoveryMicros.store(supervisor.lastSetUpMicros(), memory_order_relaxed);
+        radioStats.recoveries.store(supervisor.recoveries, memory_order_release);
+    }
+    radioStats.fault.store(supervisor.fault(), memory_order_relaxed);
+    radioStats.checkedMicros.store(now, memory_order_release);
+}
 
-    cout << setw(wdthVarName) << setfill(' ') << " ctSuccess: ";
-    cout << setw(2) << (unsigned int)sizeof(rxPayload.ctSuccess);
-    cout << " | " << setw(wdthValue) << rxPayload.ctSuccess << " | 0x ";
-    showHexOfBytes((unsigned char*)&rxPayload.ctSuccess,sizeof(rxPayload.ctSuccess));
-    cout << endl;
 
-    cout << setw(wdthVarName) << setfill(' ') << " ctErrors: ";
-    cout << setw(2) << (unsigned int)sizeof(rxPayload.ctErrors);
-    cout << " | " << setw(wdthValue) << rxPayload.ctErrors << " | 0x ";
-    showHexOfBytes((unsigned char*)&rxPayload.ctErrors,sizeof(rxPayload.ctErrors));
-    cout << endl;
+/* Tell systemd we are alive - only if we are.
+   ----------------------------------------------------------------------------
+   Main thread. READY=1 goes with the first good radio check, i.e. once the
+   radio is set up and listening. WATCHDOG=1 (SdNotify::keepAlive() sends one
+   every WatchdogSec / 2) only while the last check was good and is no older
+   than RADIO_STALE_MILLIS. So the pings stop if the radio is bad, if the radio
+   thread stops checking, or if this loop stops going round; systemd then
+   restarts the service. Changes in the radio's health, and each time the
+   radio thread has set it up again, go to the journal and to systemctl
+   status; recoveries to the log file as well.
+ */
+void watchdog(uint64_t now) {
+    static bool ready = false;
+    static uint32_t reported = RADIO_FAULT_NONE;
+    static unsigned long recoveries = 0;
+
+    uint64_t checked = radioStats.checkedMicros.load(memory_order_acquire);
+    if (checked == 0) return;                                       // Radio thread not started checking yet.
+    unsigned long recovered = radioStats.recoveries.load(memory_order_acquire);
+    if (recovered != recoveries) {
+        FixedLine line;
+        line.add("Radio set up again (").add(recovered).add(" times so far): ");
+        RadioHealth::describe(radioStats.recoveryCause.load(memory_order_relaxed), line);
+        uint32_t cause = radioStats.recoveryCause.load(memory_order_relaxed);
+        uint64_t setUp = radioStats.recoveryMicros.load(memory_order_relaxed);
+        line.add(". Set up took ").add(setUp / 1000.0, 3).add(" ms.");
+        if (core.journal.start(EVENT_RADIO, LOG_WARNING)) {
+            core.journal.field("RADIO_RECOVERIES", recovered).field("RADIO_FAULT", cause)
+                        .field("SETUP_US", setUp).send(line.c_str());
+        }
+        core.logNote(line.c_str());
+        sdNotify.status(line.c_str());
+        recoveries = recovered;
+    }
+    uint32_t fault = radioStats.fault.load(memory_order_relaxed);
+    if (fault != reported) {
+        FixedLine line;
+        line.add("Radio check: ");
+        RadioHealth::describe(fault, line);
+        if (fault != RADIO_FAULT_NONE) line.add(". Watchdog pings held back.");
+        if (core.journal.start(EVENT_RADIO, fault != RADIO_FAULT_NONE ? LOG_ERR : LOG_NOTICE)) {
+            core.journal.field("RADIO_FAULT", fault).send(line.c_str());
+        }
+        sdNotify.status(line.c_str());
+        reported = fault;
+    }
+    if (fault != RADIO_FAULT_NONE || checked + RADIO_STALE_MILLIS * 1000ULL < now) return;
+
+    if (!ready) {
+        ready = true;
+        if (sdNotify.ready() && sdNotify.watchdogMicros() && core.journal.start(EVENT_LIFECYCLE)) {
+            FixedLine line;
+            line.add("systemd: ready, watchdog every ").add(sdNotify.watchdogMicros() / 1000000.0).add("s.");
+            core.journal.field("WATCHDOG_USEC", sdNotify.watchdogMicros()).send(line.c_str());
+        }
+    }
+    sdNotify.keepAlive(now);
+}
 
-    cout << setw(wdthVarName) << setfill(' ') << " units: ";
-    cout << setw(2) << (unsigned int)sizeof(rxPayload.units);
-    cout << " | " << setw(wdthValue) << rxPayload.units << " | 0x ";
-    showHexOfBytes((unsigned char*)&rxPayload.units,sizeof(rxPayload.units));
-    cout << endl;
 
-    cout << setw(wdthVarName) << setfill(' ') << " statusText: ";
-    cout << setw(2) << (unsigned int)sizeof(rxPayload.statusText);
-    cout << " | " << setw(wdthValue) << rxPayload.statusText << " | 0x ";
-    showHexOfBytes((unsigned char*)&rxPayload.statusText,sizeof(rxPayload.statusText));
-    cout << endl;
+/* Push a frame onto rxQueue for the main thread.
+   ----------------------------------------------------------------------------
+ */
+void queueFrame(const RxFrame& frame) {
+    if (rxQueue.push(frame)) {
+        unsigned int depth = rxQueue.depth();
+        if (depth > radioStats.maxDepth.load(memory_order_relaxed)) radioStats.maxDepth.store(depth, memory_order_relaxed);
+    } else {
+        radioStats.drops.fetch_add(1, memory_order_relaxed);
+    }
+    radioStats.packets.fetch_add(1, memory_order_relaxed);
+    if (useSpiBatch) radioStats.ioctls.store(spiBatch.ioctls(), memory_order_relaxed);
 }
 
-/* Display the HEX value of the bytes that store a variable.
+
+/* Take the next packet off the radio into a frame, if there is one.
    ----------------------------------------------------------------------------
-   PARMS:      1. The first byte of the variable to show the HEX for is passed in
-            as a pointer to an unsigned char.
-               2. The 2nd param is the length of the variable, i.e., the length
-            of it's data type (or length of the string array if a string).
-            E.g., use the sizeof() function on the variable to obtain this
-            param.
-   */
-void DisplayRxPacket::showHexOfBytes(unsigned char* b, int iLen) {
-    for (int k=0; k<iLen; k++) {
-        cout << setfill('0') << setw(2) << hex << (unsigned int)b[k] << " ";
+   The next ACK payload is picked (nextAck()) and loaded into the radio at the
+   same time: with batched SPI in the same ioctl that reads the packet, with
+   RF24 calls straight after. ack is left holding what was loaded. If the
+   batch didn't take it, it is held for the next packet (nextAck()).
+   RETURNS: True if a packet was read; its size is put in frame->width.
+ */
+bool receivePacket(RxFrame* frame, AckPayloadStruct* ack) {
+    int width;
+    if (useSpiBatch) {
+        if (spiBatch.rxPipe() < 0) return false;
+        TRACE_CLEAR(frame->trace);
+        TRACE_STAMP(frame->trace, TP_AVAILABLE);
+        nextAck(ack);
+        width = spiBatch.readAndReload(frame->bytes, 1, ack, sizeof(*ack));
+        TRACE_STAMP(frame->trace, TP_READ);
+        TRACE_SAME(frame->trace, TP_ACK_REARMED, TP_READ);          // Same ioctl re-armed the ACK payload.
+        if (width < 0 && ack->command != CMD_NONE) {                // ioctl failed: not loaded.
+            heldAck = *ack;
+            ackHeld = true;
+        }
+    } else {
+        uint8_t pipe;
+        if (!radio.available(&pipe)) return false;
+        TRACE_CLEAR(frame->trace);
+        TRACE_STAMP(frame->trace, TP_AVAILABLE);
+        width = radio.getDynamicPayloadSize();
+        radio.read(frame->bytes, SPIB_MAX_PAYLOAD);                 // fetch payload from RX FIFO
+        TRACE_STAMP(frame->trace, TP_READ);
+        nextAck(ack);
+        radio.writeAckPayload(1, ack, sizeof(*ack));                // Load the ACK payload into writing pipe for next cycle.
+        TRACE_STAMP(frame->trace, TP_ACK_REARMED);
     }
-    cout << dec;
+    if (width <= 0) return false;
+    frame->width = width;
+    return true;
 }
 
 
-void setAckPayload(uint32_t cmd, uint32_t uliData) {
-    ackPayload.command = cmd;
-    ackPayload.uliCmdData = 0;
-    //ackPayload.iCmdData = 0;
-    //ackPayload.uliCmdData = uliData;
-    //ackPayload.fCmdData = 0;
+/* Take a packet left in the RX FIFO, once the radio is out of RX.
+   ----------------------------------------------------------------------------
+   Plain RF24 calls whichever SPI path is in use; there are at most 3 packets
+   and no ACK payload to load.
+   RETURNS: True if a packet was read; its size is put in frame->width.
+ */
+bool drainPacket(RxFrame* frame) {
+    if (!radio.available()) return false;
+    TRACE_CLEAR(frame->trace);
+    TRACE_STAMP(frame->trace, TP_AVAILABLE);
+    uint8_t width = radio.getDynamicPayloadSize();                  // 0 if it was bad; RF24 flushes the FIFO.
+    if (width == 0) return false;
+    radio.read(frame->bytes, SPIB_MAX_PAYLOAD);
+    TRACE_STAMP(frame->trace, TP_READ);
+    frame->width = width;
+    return true;
+}
+
+
+/* Decide what goes out in the next ACK payload.
+   ----------------------------------------------------------------------------
+   The main thread picks commands (ReceiverCore::setNextAckPayload()) and
+   queues them on ackQueue; the oldest one goes out next, else an empty one.
+   One that didn't get loaded last time (receivePacket()) goes before them.
+ */
+void nextAck(AckPayloadStruct* ack) {
+    if (ackHeld) {
+        *ack = heldAck;
+        ackHeld = false;
+    } else if (!ackQueue.pop(*ack)) {
+        ack->command = CMD_NONE;
+        ack->uliCmdData = 0;
+    }
 }
 
-bool logData(RxPayloadStruct* rxData) {
 
-    // Open a file for appending sensor readings
-    std::ofstream logFile;
-    logFile.open(LOG_FILEPATH, std::ios::app);
+string stageText(const LatencyHistogram& h) {
+    ostringstream oss;
+    oss << fixed << setprecision(1) << h.percentile(50) / 1000.0 << "/" << h.percentile(99) / 1000.0;
+    return oss.str();
+}
 
-    if (!logFile.is_open()) {
-        std::cerr << "Error opening the log file:" << LOG_FILEPATH << std::endl;
-        return false;
-      }
 
-    // Write the sensor reading and timestamp to the log file
-    //logFile << "Timestamp: " << asctime(localTime);
-    logFile << getCurrTimeFormatted() << ":";
-    logFile << " Moisture: " << rxData->capacitance;
-    logFile << "  ctSuccess: " << rxData->ctSuccess;
-    logFile << "  ctErrors: " << rxData->ctErrors;
-    logFile << "  SensorTime: " << rxData->sensorTime;
-    logFile << std::endl;
+/* Post a line of pipeline stats to the journal.
+   ----------------------------------------------------------------------------
+ */
+void reportPipeline() {
+    ostringstream oss;
+    oss << "Pipeline: " << radioStats.packets.load(memory_order_relaxed) << " packets, rx queue max "
+        << radioStats.maxDepth.load(memory_order_relaxed) << "/" << RX_QUEUE_SIZE << ", "
+        << radioStats.drops.load(memory_order_relaxed) << " dropped | p50/p99 us: read " << stageText(latency.stage(TP_READ))
+        << " queue " << stageText(latency.stage(TP_DEQUEUED)) << " decode " << stageText(latency.stage(TP_DECODED))
+        << " air to disk " << stageText(latency.airToDisk());
+    if (core.journal.start(EVENT_PIPELINE)) {
+        core.journal.field("PACKETS", radioStats.packets.load(memory_order_relaxed))
+                    .field("RX_QUEUE_MAX", radioStats.maxDepth.load(memory_order_relaxed))
+                    .field("DROPPED", radioStats.drops.load(memory_order_relaxed))
+                    .field("AIR_TO_DISK_P99_NS", latency.airToDisk().percentile(99))
+                    .send(oss.str().c_str());
+    }
+}
 
-    // Close the file
-    logFile.close();
 
-    return true;
+/* Write the latency histograms to the console/systemlog.
+   ----------------------------------------------------------------------------
+   One row per point a packet goes through: the time to get there from the
+   point before it that the packet reached.
+ */
+void dumpLatency() {
+#if LATENCY_TRACE
+    cout << "Latency, " << latency.endToEnd().count() << " packets:" << endl;
+    latency.dump(cout);
+#else
+    cout << "Latency: not traced (built with LATENCY_TRACE=0)." << endl;
+#endif
 }
 
-string getCurrTimeFormatted() {
-    string formattedTime;
 
-    // Get the current time, in a pretty string format.
-    time_t now = time(0);
-    tm* localTime = localtime(&now);
-    char buffer[80];
-    strftime(buffer,80, "%a %R %F", localTime);
-    formattedTime = buffer;
-    return formattedTime;
+
+/* Print a sensor's rollup from ROLLUP_FILEPATH: -q sensorID[,days[,points]].
+   ----------------------------------------------------------------------------
+   The file is only read, so this can run while the receiver is adding to
+   it. A point is the readings of one or more buckets of the level picked
+   (SensorRollup::query()); times are local.
+   RETURNS: Exit status: 0 if the sensor has a rollup, 1 if not.
+ */
+int queryRollup(const char* spec) {
+    unsigned int sensorID = 0, days = QUERY_DAYS, points = QUERY_POINTS;
+    if (sscanf(spec, "%u,%u,%u", &sensorID, &days, &points) < 1 || sensorID > 0xFFFF || days == 0) {
+        cout << "Usage: -q sensorID[,days[,points]]" << endl;
+        return 1;
+    }
+    if (!core.rollup.open(ROLLUP_FILEPATH, true)) {
+        cout << "ERROR: Could not open " << ROLLUP_FILEPATH << ", or it is from another build." << endl;
+        return 1;
+    }
+    int slot = core.rollup.slotOf(sensorID);
+    if (slot < 0) {
+        cout << "Sensor " << sensorID << ": no readings in " << ROLLUP_FILEPATH << endl;
+        return 1;
+    }
+
+    time_t to = time(0), from = to - (time_t)days * 86400;
+    int level = core.rollup.levelFor(slot, from, to, points);
+    char start[32];
+    cout << "Sensor " << sensorID << ", last " << days << " days, " << SensorRollup::bucketSeconds(level) / 60
+         << " min buckets:" << endl;
+    cout << setw(18) << "from" << setw(9) << "minutes" << setw(10) << "readings" << setw(10) << "mean" << setw(10) << "min"
+         << setw(10) << "max" << setw(10) << "stddev" << endl;
+    cout << fixed << setprecision(2);
+    core.rollup.query(slot, from, to, points, [&](const RollupPoint& p) {
+        struct tm tmLocal;
+        localtime_r(&p.start, &tmLocal);
+        strftime(start, sizeof(start), "%Y-%m-%d %H:%M", &tmLocal);
+        cout << setw(18) << start << setw(9) << p.seconds / 60 << setw(10) << p.count << setw(10) << p.mean()
+             << setw(10) << p.min << setw(10) << p.max << setw(10) << p.stddev() << endl;
+    });
+    return 0;
 }
 
-/* BEGIN TO-DOs ===================================================================================
-/*
- *      TODO: Work out the radio power level display for the log entries. I am calling library
- * funcion: uint8_t RF24::getPALevel(void) to get the power level. But when I try to display I
- * get a blank space on the screen. I think this is down to the fact that at present I am setting
- * the power level to it's lowest value. In the data sheet the RF_SETUP register bits for the
- * power level use the binary value of '00' for the lowest level. So when interperted as a
- * string in my code for the display output this is seen as an empty string - just contains the
- * value \0. So I should change the power level and see what I get. REF: Specs, pg-26.
- *
- *      TODO: Make the radio power level an input parameter on the command line.
- *
- *      TODO: Implement handling for the SIGTERM event so that we have an orderly shutdown,
- * with a log entry, for Control-C and any OS initiated shutdown events (like sudo shutdown or
- * service stop).NOTE: For how to handle a SIGTERM event coming in from the OS see:
- * https://www.tutorialspoint.com/cplusplus/cpp_signal_handling.htm
- *
- *
- *
- *
- END TO-DOs ==================================================================================== */
+
+uint64_t nowMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
 
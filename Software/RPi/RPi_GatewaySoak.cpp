@@ -0,0 +1,2541 @@
+/*  ATTiny84 Moisture Sensor Project - Gateway Soak Benchmark
+ *  -----------------------------------------------------------------------------------------------------
+ *
+ *  How does RPi_CapDataReceive hold up with a lot of sensors over a long uptime? This runs the
+ *  receiver's packet path - ReceiverCore (ReceiverCore.h), the very code slave() calls - with N
+ *  synthetic sensors on a fast-forwarded clock, a simulated year by default, with no radio.
+ *      > Each sensor sends a reading every interval, give or take a random jitter. A reading is
+ *        lost with the given probability; the sensor counts it in ctErrors as the tiny84 would.
+ *      > Sensors report auto-retransmits that depend on their PA level, so the power control
+ *        loop moves them up and down, and they obey the PA commands that come back in the ACK
+ *        payload - which goes to whichever sensor transmits next, as on the air.
+ *      > Supply voltage sags slowly, so BatteryTracker has something to project.
+ *  ReceiverCore's clock is the simulated clock, so the log interval, battery curve points, etc.
+ *  all run at simulated time.
+ *
+ *  Each N runs in its own child process so its peak RSS is its own. For each it records:
+ *  sensors turned away (the registry is MAX_SENSORS, as the receiver's), peak RSS, CPU time,
+ *  bytes and write() calls (from /proc/self/io), fsync()s, log file size, log lines and bytes
+ *  per sensor a day, console bytes, and packet latency percentiles (time in ReceiverCore per
+ *  packet). A line per run goes to the console, and a JSON object per run is appended to the
+ *  results file, one per line, so runs can be compared over time. A run fails if the registry
+ *  didn't fill up to the sensors it has room for, or if a sensor in it has a reading newer than
+ *  its log interval since its last log entry that wasn't logged.
+ *
+ *  With -a it checks instead that the packet path doesn't allocate: after a warm-up, ALLOC_CHECK_PACKETS
+ *  packets (one in DIAG_EVERY a diagnostic packet) go through ReceiverCore with a log entry for
+ *  every reading, each frame also going through an SpscRing as in the receiver, while malloc()
+ *  and friends are counted. Any allocation fails the check: exit status 1.
+ *
+ *  With -t it measures what the latency trace (LatencyTrace.h) costs against the CPU time of a
+ *  packet: TRACE_BENCH_ROUNDS rounds of TRACE_BENCH_PACKETS packets are each taken off a simulated
+ *  nRF24 (NrfSim.h) with NrfSpiBatch, through NrfSimSpi.h, then go through an SpscRing and
+ *  ReceiverCore the way slave() takes them, stamped and recorded as the receiver does, then
+ *  TRACE_BENCH_SYNC_PACKETS more with the log's fdatasync() on, so the fsynced and air to disk
+ *  stages have samples. It builds this file again with -DLATENCY_TRACE=0 (TRACE_BENCH_CXX, so run
+ *  it from Software/RPi) and runs that with -t for the untraced CPU time a packet. The stamps and
+ *  record() are then timed alone, sampled as the receiver samples them and with every packet
+ *  traced. Fails (exit status 1) if the sampled trace comes to TRACE_BENCH_MAX_PERCENT or more of
+ *  the untraced packet, if the untraced build fails, or if no packet got to the disk. The SPI bus
+ *  time is shown, but isn't CPU and isn't counted. Built with -DLATENCY_TRACE=0 it only shows its
+ *  packet time.
+ *
+ *  With -k it checks the receiver's SIGTERM shutdown: a radio thread feeds an SpscRing as fast as
+ *  the main thread takes frames off it, and SIGTERM is sent at a different moment in each of
+ *  SHUTDOWN_TRIALS trials. The main thread picks it up from a signalfd as slave() does, stops the
+ *  radio thread (which queues the last SHUTDOWN_FIFO_FRAMES frames, as if left in the RX FIFO)
+ *  while processing everything queued, and flushes the log. Each trial fails if any frame sent wasn't
+ *  tracked or counted as dropped, if the latest reading isn't the last line in the log, or if it
+ *  took over SHUTDOWN_BUDGET_MILLIS. Exit status 1 if any trial failed.
+ *
+ *  With -w it checks the state file (StateFile.h) and rollup file (SensorRollup.h) survive
+ *  kill -9: in each of WARM_TRIALS trials a child process runs WARM_SENSORS sensors through
+ *  ReceiverCore with both files, and is killed with SIGKILL at a random moment. They are then
+ *  loaded back, timed, and every sensor's state and rollup compared with a replay of the same
+ *  packets up to the last one saved. Exit status 1 if any sensor differs in any trial.
+ *
+ *  With -g it measures what a message to the journal costs: JOURNAL_BENCH_EVENTS of the receiver's
+ *  PA change messages, written the way it used to (cout, endl) to a stream socket standing in for
+ *  the journal's stdout stream, then with JournalLog (JournalLog.h) as plain text to the same
+ *  stream, as native entries to a datagram socket standing in for the journal's, and as native
+ *  entries rate-limited as ReceiverCore limits them. Each is timed, with the CPU time of the
+ *  thread doing the logging, and a thread at the other end counts what arrives and checks the
+ *  first entry's fields. Fails (exit status 1) if an entry is malformed or the rate limit lets
+ *  the wrong number through.
+ *
+ *  With -v it measures the receiver's verbose dashboard (SensorDashboard.h): DASH_BENCH_SENSORS
+ *  sensors (or -n) each send a reading every DASH_BENCH_INTERVAL_SECONDS, in real time, for
+ *  DASH_BENCH_SECONDS, through ReceiverCore, while the main loop naps and draws frames as
+ *  slave() does. Every sensor has a row (the screen is made that tall), and the frames go to
+ *  /dev/null. Shows the CPU time drawing takes as a share of one core, frames, write()s and bytes
+ *  per frame against a full redraw. Fails (exit status 1) at 1% of a core or more, or if a frame
+ *  took more than one write().
+ *
+ *  With -c it checks and times the wall clock time stamps (TimeStamp.h). Their text is compared
+ *  with strftime()'s for CLOCK_CHECK_TIMES times, one every few minutes through a year, in
+ *  several time zones, including ones with DST and half-hour offsets. Then each way of getting the
+ *  time now as text is called CLOCK_BENCH_CALLS times, best of CLOCK_BENCH_ROUNDS rounds: the
+ *  functions RPi_CapDataReceive and RPi_DummyService used, and TimeStamp's. The same is done with
+ *  CLOCK_BENCH_THREADS threads at once. Fails (exit status 1) if any text differs.
+ *
+ *  With -e it checks the sensor clock estimator (SensorClock.h) against simulated sensor clocks:
+ *  SKEW_CHECK_SENSORS sensors send a reading every -i seconds (+/- -j) for SKEW_CHECK_DAYS, their
+ *  millis() running up to SKEW_CHECK_PPM fast or slow, wandering by SKEW_CHECK_WANDER_PPM over each
+ *  day as the temperature would, and wrapping at 2^32. Each sensor reboots once part way through;
+ *  half of them say so (bootAckMillis, so ReceiverCore calls restart()), half are left for the
+ *  estimator to notice. Packets take 1-5ms to arrive; one in SKEW_CHECK_LATE_EVERY is late by up to
+ *  SKEW_CHECK_LATE_SECONDS, and some are lost. The time each packet was sent, by the estimator, is
+ *  compared with when it really was, and its skew with the sensor clock's rate at the time. Fails
+ *  (exit status 1) if the error's p99 is over SKEW_CHECK_PROMPT_MS for packets that came straight
+ *  through or SKEW_CHECK_LATE_MS for late ones, if the skew's p99 is over SKEW_CHECK_SKEW_PPM out,
+ *  or if a wrap or reboot is missed or one is seen that wasn't.
+ *
+ *  With -p it measures the in-memory history (SensorHistory.h) on two sets of readings, each for
+ *  -n sensors (100 by default) over HISTORY_DAYS, a reading every -i seconds (+/- -j):
+ *      > replayed from the archived receiver output in HISTORY_ARCHIVE_DIR (run from
+ *        Software/RPi), the capacitances in the order they came, round and round. There are
+ *        only a couple of dozen of them, so this is archived values in a synthetic series;
+ *      > the soak's sensors' daily watering cycle, put through the tiny84's own sum - ten ADC
+ *        readings, each +/-1 count, averaged as floats - so the low bits are as noisy as real ones.
+ *  Each is packed lossless (HISTORY_MANTISSA_BITS, the default) and with the opt-in
+ *  HISTORY_LOSSY_MANTISSA_BITS, and shows bytes a point, ns to append a point, and ns (and
+ *  millions of points a second) to read them all back, best of HISTORY_BENCH_ROUNDS. Fails (exit
+ *  status 1) if a point reads back wrong, if reading is under HISTORY_BENCH_MIN_MPOINTS million
+ *  points a second, or if the packed points take more than the HISTORY_POINT_BYTES the pool is
+ *  sized for, at either.
+ *
+ *  With -q it measures the rollups (SensorRollup.h): -n sensors (100 by default) send a year of
+ *  readings every -i seconds (+/- -j), then the same again with ROLLUP_BENCH_FAST_SENSORS sensors
+ *  sending every ROLLUP_BENCH_FAST_SECONDS, for 15 times the readings. Shows ns to add a reading,
+ *  then for each of ROLLUP_BENCH_QUERIES (a year in 1000 points, a month in 1000, ...) the level
+ *  picked, points returned and us a query, mean over every sensor, best of ROLLUP_BENCH_ROUNDS,
+ *  against a scan of the raw readings for the same answer. Every point is checked against that
+ *  scan. The rollups are in a file, which is then opened again read only, as RPi_CapDataReceive -q
+ *  does, and every query's points compared. Fails (exit status 1) if one differs, if the year
+ *  query takes over ROLLUP_BENCH_MAX_MICROS or comes back in buckets coarser than its points ask
+ *  for, or if the rollups of MAX_SENSORS sensors would take over ROLLUP_BENCH_MAX_MB.
+ *
+ *  With -m it checks the transmit power control loop (PowerControl.h) with a deterministic path
+ *  loss model: one sensor at each path loss from PC_CHECK_MIN_LOSS_DB to PC_CHECK_MAX_LOSS_DB, each
+ *  attempt getting through by its margin over the RPi's sensitivity, sends PC_CHECK_READINGS
+ *  readings through ReceiverCore and obeys the PA commands that come back. The same is run without
+ *  the loop's hysteresis, and at fixed LOW and fixed MAX. Fails (exit status 1) unless, over the
+ *  2nd half, every sensor is mostly at its lowest working level, none changes level more than
+ *  PC_CHECK_MAX_CHANGES times and all make under a tenth of the changes they do without
+ *  hysteresis, and the uJ per delivered packet is under fixed LOW's and within
+ *  PC_CHECK_MAX_OVER_FIXED of fixed MAX's.
+ *
+ *  Usage --:
+ *      RPi_GatewaySoak [-n sensors[,sensors...]] [-d simDays] [-i intervalSeconds]
+ *                      [-j jitterSeconds] [-l lossProbability] [-r registrySlots] [-s seed]
+ *                      [-o resultsFile] [-L logFile] [-a] [-t] [-k] [-w] [-g] [-v] [-c] [-e] [-p] [-q] [-m]
+ *          Defaults: -n 1,100,10000 -d 365 -i 900 -j 5 -l 0.01 -s 1
+ *                    -o gateway_soak.jsonl -L /tmp/gateway_soak_readings.txt
+ *          -r defaults to MAX_SENSORS, the receiver's own. Sensors past it are turned away, as
+ *             they would be on the real gateway, and counted ('turned away', and 'unregistered'
+ *             packets in the results).
+ *
+ *  Build --:
+ *      g++ -O2 -std=c++17 -pthread -o RPi_GatewaySoak RPi_GatewaySoak.cpp
+ *      g++ -O2 -std=c++17 -pthread -DLATENCY_TRACE=0 -o RPi_GatewaySoak_notrace RPi_GatewaySoak.cpp
+ *
+ * 10/19/2026-rel19:
+ *      > The state file check (-w) keeps the rollups in a file too, and checks they come back.
+ *      > The rollup benchmark (-q) has the new levels (8 hours in place of 6 hours and a day),
+ *        runs from a file and reads it back read only, and fails over ROLLUP_BENCH_MAX_MB for
+ *        MAX_SENSORS.
+ *
+ * 10/19/2026-rel18:
+ *      > The trace benchmark (-t) measures the trace against the CPU time of an untraced packet,
+ *        from a -DLATENCY_TRACE=0 build it makes and runs, not the SPI bus time. Traced every
+ *        packet it is ~7% of that, so the trace is sampled now (LATENCY_TRACE_EVERY), and both
+ *        are shown. A last round has fdatasync() on, for the fsynced and air to disk stages.
+ *
+ * 10/19/2026-rel17:
+ *      > The registry is MAX_SENSORS again unless -r is given, as in the receiver, and the
+ *        sensors turned away above it are reported rather than failing the run.
+ *      > ReceiverCore logs each sensor on its own interval now. Each run shows log lines and
+ *        bytes per sensor a day, and fails if a registered sensor isn't being logged.
+ *
+ * 10/19/2026-rel16:
+ *      > The rollup benchmark (-q) shows the 6 hour level and the memory of the slots in use, and
+ *        fails if a year in 1000 points comes back in buckets coarser than 1000 points ask for.
+ *
+ * 10/19/2026-rel15:
+ *      > The history benchmark (-p) packs lossless first, as SensorHistory now does by default,
+ *        then with the opt-in HISTORY_LOSSY_MANTISSA_BITS, and holds both to the pool's sizing.
+ *
+ * 10/19/2026-rel14:
+ *      > The trace benchmark (-t) takes each packet off a simulated chip through NrfSpiBatch,
+ *        counts the SPI bus time, times the trace on its own and fails at TRACE_BENCH_MAX_PERCENT.
+ *
+ * 10/19/2026-rel13:
+ *      > The registry is sized to each run's sensors unless -r is given, rather than
+ *        MAX_SENSORS, which left most of the 10000 sensor run unregistered.
+ *
+ * 10/19/2026-rel12:
+ *      > Power control check (-m).
+ *
+ * 10/19/2026-rel11:
+ *      > Rollup benchmark (-q).
+ *
+ * 10/19/2026-rel10:
+ *      > In-memory history benchmark (-p).
+ *
+ * 10/19/2026-rel09:
+ *      > Sensor clock estimator check (-e). ReceiverCore's clockMillis is the simulated clock too.
+ *
+ * 10/19/2026-rel08:
+ *      > Time stamp check and benchmark (-c).
+ *
+ * 10/19/2026-rel07:
+ *      > Dashboard benchmark (-v).
+ *
+ * 10/19/2026-rel06:
+ *      > Journal logging benchmark (-g). ReceiverCore's messages go through its journal now.
+ *
+ * 10/19/2026-rel05:
+ *      > State file kill -9 check (-w).
+ *
+ * 10/19/2026-rel04:
+ *      > SIGTERM shutdown check (-k).
+ *
+ * 10/19/2026-rel03:
+ *      > Latency trace overhead benchmark (-t). The allocation check turns off the log file's
+ *        fdatasync(), since it logs every reading.
+ *
+ * 10/19/2026-rel02:
+ *      > Allocation check (-a).
+ *
+ * 10/19/2026-rel01:
+ *      > Initial program.
+ */
+#define VERSION "10-19-2026 rel 19"
+
+#define DEFAULT_SENSORS "1,100,10000"
+#define DEFAULT_DAYS 365
+#define DEFAULT_INTERVAL_SECONDS 900    // Dispatcher's reading interval.
+#define DEFAULT_JITTER_SECONDS 5
+#define DEFAULT_LOSS 0.01
+#define DEFAULT_RESULTS "gateway_soak.jsonl"
+#define DEFAULT_LOGFILE "/tmp/gateway_soak_readings.txt"
+#define PAYLOAD_BYTES 32
+#define VCC_START_MV 3200
+#define VCC_SAG_MV_PER_DAY 1.0
+#define ALLOC_CHECK_PACKETS 1000000
+#define ALLOC_WARMUP_PACKETS 10000
+#define DIAG_EVERY 50
+#define TRACE_BENCH_PACKETS 1000000
+#define TRACE_BENCH_ROUNDS 5
+#define TRACE_BENCH_AIR_MICROS 1000     // Air time let run after each packet, for its ACK.
+#define TRACE_BENCH_MAX_PERCENT 1.0     // The trace's share of a packet's CPU it must stay under.
+#define TRACE_BENCH_SYNC_PACKETS 100000 // Packets in the round with fdatasync() on.
+#define TRACE_BENCH_CXX "g++ -O2 -std=c++17 -pthread"     // Builds the untraced soak, from Software/RPi ...
+#define TRACE_BENCH_NOTRACE "/tmp/RPi_GatewaySoak_notrace"  // ... here.
+#define SHUTDOWN_TRIALS 10
+#define SHUTDOWN_FIFO_FRAMES 3          // nRF24 RX FIFO depth.
+#define SHUTDOWN_BUDGET_MILLIS 3000     // As RPi_CapDataReceive.
+#define SHUTDOWN_IDLE_MICROS 500        // As RPi_CapDataReceive's PROCESS_IDLE_MICROS.
+#define SHUTDOWN_SIGNAL_CHECK 64        // As RPi_CapDataReceive's SIGNAL_CHECK_FRAMES.
+#define WARM_TRIALS 20
+#define WARM_SENSORS 1000
+#define WARM_KILL_MAX_MICROS 500000     // Children are killed somewhere in their 1st half second.
+#define JOURNAL_BENCH_EVENTS 200000
+#define JOURNAL_BENCH_SOCKET "@RPi_GatewaySoak.journal"
+#define DASH_BENCH_SENSORS 500
+#define DASH_BENCH_SECONDS 10
+#define DASH_BENCH_INTERVAL_SECONDS 10  // Far more often than a real sensor: 50 packets/s with 500.
+#define DASH_BENCH_IDLE_MICROS 500      // As RPi_CapDataReceive's PROCESS_IDLE_MICROS.
+#define CLOCK_CHECK_TIMES 200000
+#define CLOCK_BENCH_CALLS 1000000
+#define CLOCK_BENCH_ROUNDS 5
+#define CLOCK_BENCH_THREADS 4
+#define SKEW_CHECK_SENSORS 200
+#define SKEW_CHECK_DAYS 120             // Long enough for millis() to wrap, twice for some.
+#define SKEW_CHECK_PPM 20000            // tiny84's RC oscillator: +/-2% after factory calibration.
+#define SKEW_CHECK_WANDER_PPM 500       // Daily swing with temperature.
+#define SKEW_CHECK_LATE_EVERY 20        // 5% of packets ...
+#define SKEW_CHECK_LATE_SECONDS 60      // ... come in up to this late.
+#define SKEW_CHECK_PROMPT_MS 10
+#define SKEW_CHECK_LATE_MS 1000
+#define SKEW_CHECK_SKEW_PPM 400
+#define HISTORY_BENCH_SENSORS 100
+#define HISTORY_BENCH_ROUNDS 5
+#define HISTORY_BENCH_MIN_MPOINTS 2
+#define HISTORY_ARCHIVE_DIR "../../archive/nRF24-with-Rpi"
+#define ROLLUP_BENCH_SENSORS 100
+#define ROLLUP_BENCH_FAST_SENSORS 10
+#define ROLLUP_BENCH_FAST_SECONDS 60
+#define ROLLUP_BENCH_ROUNDS 5
+#define ROLLUP_BENCH_MAX_MICROS 2000    // "Low milliseconds" for a year in 1000 points.
+#define ROLLUP_BENCH_MAX_MB 80          // Rollup file for MAX_SENSORS. Page cache a 512MB Pi can spare.
+#define PC_CHECK_MIN_LOSS_DB 58         // -m: path losses from here ...
+#define PC_CHECK_MAX_LOSS_DB 82         // ... to here: MIN is plenty at the near end, MAX is needed at the far end.
+#define PC_CHECK_SENSITIVITY_DBM -85    // nRF24L01+ at 1Mbps, Product Spec v1.0 section 6.3.
+#define PC_CHECK_SLOPE_DB 3.0           // Attempts lost: 50% at the sensitivity, 10x fewer every 3dB over it.
+#define PC_CHECK_READINGS 2000          // Readings at each path loss; the 2nd half are checked.
+#define PC_CHECK_MAX_WRITES 200         // RadioComms retries a reading until it's ACK'd; give up here.
+#define PC_CHECK_MAX_CHANGES 40         // No more than one change in 25 readings.
+#define PC_CHECK_NO_HYSTERESIS 0.25f    // The one threshold for the run without hysteresis.
+#define PC_CHECK_MAX_OVER_FIXED 1.1     // uJ/pkt may be at most this times fixed MAX's.
+
+#include <cstdint>
+#include <cstdio>      // printf(), fopen()
+#include <cstdlib>     // atoi(), atof(), strtoull()
+#include <cstring>     // memcpy(), strcmp()
+#include <cmath>       // log(), sin()
+#include <algorithm>   // sort()
+#include <ctime>       // time()
+#include <queue>       // priority_queue
+#include <vector>
+#include <string>
+#include <streambuf>
+#include <ostream>
+#include <time.h>      // CLOCK_MONOTONIC, timespec, clock_gettime()
+#include <unistd.h>    // fork(), syscall(), _exit()
+#include <sys/syscall.h>    // SYS_fsync, SYS_fdatasync
+#include <sys/resource.h>   // getrusage()
+#include <sys/stat.h>       // stat()
+#include <sys/wait.h>       // waitpid()
+#include <sys/socket.h>     // socketpair(), recv()
+#include <sys/un.h>         // sockaddr_un
+#include <signal.h>         // kill(), SIGTERM
+#include <sched.h>          // sched_yield()
+#include <thread>
+#include <atomic>
+#include "ReceiverCore.h"   // ReceiverCore
+#include "LatencyHistogram.h"   // LatencyHistogram
+#include "SpscRing.h"           // SpscRing
+#include "LatencyTrace.h"       // LatencyTrace, TraceStamps, TRACE_STAMP()
+#include "SignalFd.h"           // SignalFd
+#include "JournalLog.h"         // JournalLog
+#include "SensorDashboard.h"    // SensorDashboard
+#include "TimeStamp.h"          // TimeStamp
+#include "SensorClock.h"        // SensorClock
+#include "SensorHistory.h"      // SensorHistory
+#include "SensorRollup.h"       // SensorRollup
+#include "NrfSim.h"             // NrfSim, VirtualAir - for -t
+#include "NrfSimSpi.h"          // NrfSimSpi
+
+using namespace std;
+
+
+/* =============================================================================
+   Measuring
+   =============================================================================
+*/
+
+    /* fsync()s made by anything in this process, counted by standing in for
+       the C library's. */
+static unsigned long fsyncCount = 0;
+extern "C" int fsync(int fd) {
+    fsyncCount++;
+    return syscall(SYS_fsync, fd);
+}
+extern "C" int fdatasync(int fd) {
+    fsyncCount++;
+    return syscall(SYS_fdatasync, fd);
+}
+
+    /* Heap allocations while allocCounting is on, counted by standing in for
+       the C library's malloc() family (operator new comes through here too). */
+extern "C" void* __libc_malloc(size_t n);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t n);
+static bool allocCounting = false;
+static unsigned long allocCount = 0;
+extern "C" void* malloc(size_t n) {
+    if (allocCounting) allocCount++;
+    return __libc_malloc(n);
+}
+extern "C" void* calloc(size_t n, size_t size) {
+    if (allocCounting) allocCount++;
+    return __libc_calloc(n, size);
+}
+extern "C" void* realloc(void* ptr, size_t n) {
+    if (allocCounting) allocCount++;
+    return __libc_realloc(ptr, n);
+}
+
+    /* Where ReceiverCore's console messages go: counted, not shown. */
+class CountingBuf : public streambuf {
+  public:
+    unsigned long bytes = 0;
+  protected:
+    int overflow(int c) override { bytes++; return c; }
+    streamsize xsputn(const char*, streamsize n) override { bytes += n; return n; }
+};
+
+    /* Bytes written and write() calls so far, from /proc/self/io. -1 if it
+       can't be read. */
+static void procIo(long long* wchar, long long* syscw) {
+    *wchar = *syscw = -1;
+    FILE* f = fopen("/proc/self/io", "r");
+    if (!f) return;
+    char name[32];
+    long long v;
+    while (fscanf(f, "%31[^:]: %lld\n", name, &v) == 2) {
+        if (strcmp(name, "wchar") == 0) *wchar = v;
+        else if (strcmp(name, "syscw") == 0) *syscw = v;
+    }
+    fclose(f);
+}
+
+static uint64_t monoNanos() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* =============================================================================
+   Simulated sensors and clock
+   =============================================================================
+*/
+
+static time_t simStart;
+static uint64_t simMicros = 0;
+static time_t simClock() { return simStart + (time_t)(simMicros / 1000000); }
+static int64_t simClockMillis() { return (int64_t)simStart * 1000 + (int64_t)(simMicros / 1000); }
+
+struct SoakParams {
+    unsigned int sensors;
+    double days;
+    double intervalSeconds;
+    double jitterSeconds;
+    double loss;
+    unsigned int registrySlots;
+    uint64_t seed;
+    string logFile;
+};
+
+    /* Registry slots for a run: -r, else the receiver's own. */
+static unsigned int slotsFor(const SoakParams& p) { return p.registrySlots ? p.registrySlots : MAX_SENSORS; }
+
+struct SoakSensor {
+    uint16_t id;
+    uint8_t paLevel;
+    uint32_t ctSuccess;
+    uint32_t ctErrors;
+    float capBase;
+    uint64_t bootMicros;
+};
+
+static uint64_t rng;
+static double random01() {
+    rng ^= rng << 13;                   // xorshift64
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (rng >> 11) * (1.0 / 9007199254740992.0);
+}
+
+    /* Auto-retransmits a reading took: fewer at higher PA levels. Mean 3 at
+       PA 0 down to 0.1 at PA 3, so the power control loop has work to do. */
+static uint8_t retriesAt(uint8_t paLevel) {
+    static const double mean[4] = {3.0, 1.0, 0.3, 0.1};
+    double r = -log(1.0 - random01()) * mean[paLevel & 3];
+    return r > PC_ARC_MAX ? PC_ARC_MAX : (uint8_t)r;
+}
+
+    /* Lay out a reading the way the sensor's RadioComms does, at the offsets
+       ReceiverCore::loadRxStruct() reads. */
+static void buildPayload(uint8_t* b, const SoakSensor& s, uint64_t now, uint8_t retries) {
+    double days = (now - s.bootMicros) / 86400e6;
+    float cap = s.capBase + 5.0f * (float)sin(days * 2 * M_PI);        // Daily watering cycle.
+    uint32_t sensorTime = (uint32_t)((now - s.bootMicros) / 1000);     // millis() wraps at 49 days, as it does.
+    uint16_t vcc = (uint16_t)(VCC_START_MV - days * VCC_SAG_MV_PER_DAY + (random01() - 0.5) * 20);
+    uint16_t awake = 40 + retries;
+    uint16_t bootAck = 1200;
+    uint16_t probes[3] = {0, 0, 0};
+
+    memcpy(&b[0], &cap, 4);
+    memcpy(&b[4], &sensorTime, 4);
+    memcpy(&b[8], &s.ctSuccess, 4);
+    memcpy(&b[12], &s.ctErrors, 4);
+    memcpy(&b[16], &s.id, 2);
+    b[18] = s.paLevel;
+    b[19] = retries;
+    memcpy(&b[20], &vcc, 2);
+    memcpy(&b[22], &awake, 2);
+    memcpy(&b[24], &bootAck, 2);
+    memcpy(&b[26], probes, 6);
+}
+
+
+/* =============================================================================
+   Main
+   =============================================================================
+*/
+
+void soak(const SoakParams& p, const char* resultsFile);
+int allocCheck(const SoakParams& p);
+int traceBench(const SoakParams& p);
+int shutdownCheck(const SoakParams& p);
+int warmRestartCheck(const SoakParams& p);
+int journalBench(const SoakParams& p);
+int dashboardBench(const SoakParams& p);
+int clockBench();
+int sensorClockCheck(const SoakParams& p);
+int historyBench(const SoakParams& p);
+int rollupBench(const SoakParams& p);
+int powerCheck(const SoakParams& p);
+
+int main(int argc, char** argv) {
+    SoakParams p;
+    p.days = DEFAULT_DAYS;
+    p.intervalSeconds = DEFAULT_INTERVAL_SECONDS;
+    p.jitterSeconds = DEFAULT_JITTER_SECONDS;
+    p.loss = DEFAULT_LOSS;
+    p.registrySlots = 0;
+    p.seed = 1;
+    p.logFile = DEFAULT_LOGFILE;
+    string sensorList = DEFAULT_SENSORS;
+    string resultsFile = DEFAULT_RESULTS;
+    bool checkAllocs = false;
+    bool benchTrace = false;
+    bool checkShutdown = false;
+    bool checkWarm = false;
+    bool benchJournal = false;
+    bool benchDashboard = false;
+    bool benchClock = false;
+    bool checkSensorClock = false;
+    bool benchHistory = false;
+    bool benchRollup = false;
+    bool checkPower = false;
+    unsigned int dashSensors = DASH_BENCH_SENSORS;
+
+    for (int i = 1; i < argc; i++) {
+        bool more = (i + 1 < argc);
+        if (strcmp(argv[i], "-n") == 0 && more) {
+            sensorList = argv[++i];
+            dashSensors = atoi(sensorList.c_str());
+        }
+        else if (strcmp(argv[i], "-d") == 0 && more) p.days = atof(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0 && more) p.intervalSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-j") == 0 && more) p.jitterSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && more) p.loss = atof(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && more) p.registrySlots = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && more) p.seed = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-o") == 0 && more) resultsFile = argv[++i];
+        else if (strcmp(argv[i], "-L") == 0 && more) p.logFile = argv[++i];
+        else if (strcmp(argv[i], "-a") == 0) checkAllocs = true;
+        else if (strcmp(argv[i], "-t") == 0) benchTrace = true;
+        else if (strcmp(argv[i], "-k") == 0) checkShutdown = true;
+        else if (strcmp(argv[i], "-w") == 0) checkWarm = true;
+        else if (strcmp(argv[i], "-g") == 0) benchJournal = true;
+        else if (strcmp(argv[i], "-v") == 0) benchDashboard = true;
+        else if (strcmp(argv[i], "-c") == 0) benchClock = true;
+        else if (strcmp(argv[i], "-e") == 0) checkSensorClock = true;
+        else if (strcmp(argv[i], "-p") == 0) benchHistory = true;
+        else if (strcmp(argv[i], "-q") == 0) benchRollup = true;
+        else if (strcmp(argv[i], "-m") == 0) checkPower = true;
+        else {
+            fprintf(stderr, "usage: %s [-n sensors[,sensors...]] [-d simDays] [-i intervalSeconds] [-j jitterSeconds] "
+                            "[-l loss] [-r registrySlots] [-s seed] [-o resultsFile] [-L logFile] [-a] [-t] [-k] [-w] [-g] [-v] [-c] [-e] [-p] [-q] [-m]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (checkAllocs) {
+        p.sensors = 100;
+        return allocCheck(p);
+    }
+    if (benchTrace) {
+        p.sensors = 100;
+        return traceBench(p);
+    }
+    if (checkShutdown) {
+        p.sensors = 100;
+        return shutdownCheck(p);
+    }
+    if (checkWarm) {
+        p.sensors = WARM_SENSORS;
+        return warmRestartCheck(p);
+    }
+    if (benchJournal) {
+        p.sensors = 100;
+        return journalBench(p);
+    }
+    if (benchClock) return clockBench();
+    if (checkSensorClock) {
+        p.sensors = SKEW_CHECK_SENSORS;
+        return sensorClockCheck(p);
+    }
+    if (benchHistory) {
+        p.sensors = (sensorList != DEFAULT_SENSORS && dashSensors > 0) ? dashSensors : HISTORY_BENCH_SENSORS;
+        return historyBench(p);
+    }
+    if (benchRollup) {
+        p.sensors = (sensorList != DEFAULT_SENSORS && dashSensors > 0) ? dashSensors : ROLLUP_BENCH_SENSORS;
+        return rollupBench(p);
+    }
+    if (checkPower) return powerCheck(p);
+    if (benchDashboard) {
+        p.sensors = (dashSensors > 0) ? dashSensors : DASH_BENCH_SENSORS;
+        return dashboardBench(p);
+    }
+
+    printf("RPi_GatewaySoak [%s]: %.0f days, %.0fs interval +/-%.0fs, loss %.3f, registry slots %u, log every %ds, seed %llu -> %s\n",
+           VERSION, p.days, p.intervalSeconds, p.jitterSeconds, p.loss, slotsFor(p), LOG_INTERVAL,
+           (unsigned long long)p.seed, resultsFile.c_str());
+    printf("%8s %11s %11s %9s %8s %12s %9s %8s %9s %10s %9s %9s %9s %9s %9s\n", "sensors", "turned away", "packets",
+           "RSS KB", "CPU s", "bytes out", "writes", "fsyncs", "log KB", "log ln/s/d", "log B/s/d", "p50 ns", "p99 ns",
+           "p99.9 ns", "max ns");
+    fflush(stdout);
+
+    size_t pos = 0;
+    while (pos < sensorList.size()) {
+        size_t end = sensorList.find(',', pos);
+        if (end == string::npos) end = sensorList.size();
+        p.sensors = atoi(sensorList.substr(pos, end - pos).c_str());
+        pos = end + 1;
+        if (p.sensors == 0 || p.sensors > MAX_SENSOR_ID) continue;
+
+        pid_t pid = fork();                     // Own process, own peak RSS.
+        if (pid == 0) {
+            soak(p, resultsFile.c_str());
+            fflush(stdout);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "soak run with %u sensors failed\n", p.sensors);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/* One soak run, in a child process.
+   ----------------------------------------------------------------------------
+ */
+void soak(const SoakParams& p, const char* resultsFile) {
+    remove(p.logFile.c_str());
+    rng = p.seed * 2654435761ULL + p.sensors;
+    simStart = time(0);
+    simMicros = 0;
+
+    CountingBuf consoleBuf;
+    ostream consoleOut(&consoleBuf);
+    ReceiverCore core(p.logFile.c_str(), slotsFor(p));
+    core.clock = simClock;
+    core.clockMillis = simClockMillis;
+    core.journal.console = &consoleOut;
+
+        /* Sensors come up at random points in the 1st interval. */
+    uint64_t interval = (uint64_t)(p.intervalSeconds * 1e6);
+    uint64_t jitter = (uint64_t)(p.jitterSeconds * 1e6);
+    uint64_t endMicros = (uint64_t)(p.days * 86400e6);
+    vector<SoakSensor> sensors(p.sensors);
+    typedef pair<uint64_t, uint32_t> Due;      // (when, sensor)
+    vector<Due> dueStore;
+    dueStore.reserve(p.sensors);
+    priority_queue<Due, vector<Due>, greater<Due>> due(greater<Due>(), move(dueStore));
+    for (unsigned int k = 0; k < p.sensors; k++) {
+        SoakSensor& s = sensors[k];
+        s.id = k + 1;
+        s.paLevel = 1;                          // RF24_PA_LOW
+        s.ctSuccess = 0;
+        s.ctErrors = 0;
+        s.capBase = 80 + 40 * random01();
+        s.bootMicros = (uint64_t)(random01() * interval);
+        due.push(Due(s.bootMicros, k));
+    }
+
+    LatencyHistogram latency;
+    unsigned long packets = 0, lost = 0;
+    uint8_t bytes[PAYLOAD_BYTES];
+    AckPayloadStruct heard = {CMD_NONE, 0};    // ACK payload the next sensor to transmit will hear.
+    long long wchar0, syscw0;
+    procIo(&wchar0, &syscw0);
+    rusage ru0;
+    getrusage(RUSAGE_SELF, &ru0);
+    uint64_t wall0 = monoNanos();
+
+    while (!due.empty() && due.top().first < endMicros) {
+        Due d = due.top();
+        due.pop();
+        SoakSensor& s = sensors[d.second];
+        simMicros = d.first;
+
+        uint8_t retries = retriesAt(s.paLevel);
+        if (random01() < p.loss) {
+            s.ctErrors++;
+            lost++;
+        } else {
+            buildPayload(bytes, s, simMicros, retries);
+            s.ctSuccess++;
+
+            uint64_t t0 = monoNanos();
+            bool reading = core.track(bytes, PAYLOAD_BYTES);
+            core.setNextAckPayload();
+            if (reading) core.logIfDue();
+            latency.record(monoNanos() - t0);
+            packets++;
+
+                /* This sensor hears the ACK payload loaded for the previous
+                   packet, as on the air; a command for it changes its level. */
+            if ((heard.command & 0xFF) == CMD_SET_PA_LEVEL && (heard.command >> CMD_TARGET_SHIFT) == s.id) {
+                s.paLevel = heard.uliCmdData & 3;
+            }
+            heard = core.ackPayload;
+        }
+
+        int64_t j = jitter ? (int64_t)(random01() * 2 * jitter) - (int64_t)jitter : 0;
+        due.push(Due(d.first + interval + j, d.second));
+    }
+
+    uint64_t wall1 = monoNanos();
+    rusage ru1;
+    getrusage(RUSAGE_SELF, &ru1);
+    long long wchar1, syscw1;
+    procIo(&wchar1, &syscw1);
+    struct stat st;
+    long long logSize = (stat(p.logFile.c_str(), &st) == 0) ? st.st_size : 0;
+
+    double cpu = (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec) + (ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec) / 1e6
+               + (ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) + (ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec) / 1e6;
+    double wall = (wall1 - wall0) / 1e9;
+    long long bytesOut = (wchar0 >= 0 && wchar1 >= 0) ? wchar1 - wchar0 : -1;
+    long long writes = (syscw0 >= 0 && syscw1 >= 0) ? syscw1 - syscw0 : -1;
+
+        /* Sensors the registry had no room for, and log volume for each that it had. The
+           1st reading a sensor sends once its log interval is up is logged, so its last one
+           can't be more than the interval after its last log entry. */
+    unsigned int registered = core.sensors.count();
+    unsigned int turnedAway = p.sensors - registered;
+    unsigned int unlogged = 0;
+    for (unsigned int k = 0; k < registered; k++) {
+        const SensorState* st = core.sensors.at(k);
+        if (st->lastLog == 0 || st->lastRxTime > st->lastLog + core.logInterval) unlogged++;
+    }
+    double sensorDays = registered ? registered * p.days : 1;
+
+    printf("%8u %11u %11lu %9ld %8.2f %12lld %9lld %8lu %9.1f %10.2f %9.0f %9llu %9llu %9llu %9llu\n", p.sensors,
+           turnedAway, packets, ru1.ru_maxrss, cpu, bytesOut, writes, fsyncCount, logSize / 1024.0,
+           core.logEntries / sensorDays, logSize / sensorDays,
+           (unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(99),
+           (unsigned long long)latency.percentile(99.9), (unsigned long long)latency.max());
+
+    FILE* f = fopen(resultsFile, "a");
+    if (!f) {
+        fprintf(stderr, "could not open %s\n", resultsFile);
+        _exit(1);
+    }
+    fprintf(f, "{\"bench\":\"gateway_soak\",\"version\":\"%s\",\"started\":%lld,\"sensors\":%u,\"days\":%g,"
+               "\"interval_s\":%g,\"jitter_s\":%g,\"loss\":%g,\"registry_slots\":%u,\"seed\":%llu,"
+               "\"packets\":%lu,\"lost\":%lu,\"unregistered\":%lu,\"turned_away\":%u,\"log_entries\":%lu,"
+               "\"log_entries_per_sensor_day\":%.3f,\"log_bytes_per_sensor_day\":%.1f,"
+               "\"peak_rss_kb\":%ld,\"cpu_s\":%.3f,\"wall_s\":%.3f,\"bytes_written\":%lld,\"write_calls\":%lld,"
+               "\"fsyncs\":%lu,\"log_bytes\":%lld,\"console_bytes\":%lu,"
+               "\"latency_ns\":{\"mean\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}}\n",
+            VERSION, (long long)simStart, p.sensors, p.days, p.intervalSeconds, p.jitterSeconds, p.loss,
+            slotsFor(p), (unsigned long long)p.seed, packets, lost, core.unregistered, turnedAway, core.logEntries,
+            core.logEntries / sensorDays, logSize / sensorDays,
+            ru1.ru_maxrss, cpu, wall, bytesOut, writes, fsyncCount, logSize, consoleBuf.bytes, latency.mean(),
+            (unsigned long long)latency.percentile(50), (unsigned long long)latency.percentile(90),
+            (unsigned long long)latency.percentile(99), (unsigned long long)latency.percentile(99.9),
+            (unsigned long long)latency.max());
+    fclose(f);
+
+    if (registered != min(p.sensors, slotsFor(p))) {
+        fprintf(stderr, "%u sensors registered, with room for %u of %u\n", registered, slotsFor(p), p.sensors);
+        fflush(stdout);
+        _exit(1);
+    }
+    if (unlogged) {
+        fprintf(stderr, "%u of %u registered sensors missed a log entry that was due\n", unlogged, registered);
+        fflush(stdout);
+        _exit(1);
+    }
+}
+
+
+/* Check that the packet path doesn't touch the heap.
+   ----------------------------------------------------------------------------
+   RETURNS: Exit status: 0 if nothing was allocated, 1 if anything was.
+ */
+int allocCheck(const SoakParams& p) {
+    struct Frame {
+        uint8_t bytes[PAYLOAD_BYTES];
+        uint8_t width;
+    };
+
+    remove(p.logFile.c_str());
+    rng = p.seed;
+    simStart = time(0);
+    simMicros = 0;
+
+    CountingBuf consoleBuf;
+    ostream consoleOut(&consoleBuf);
+    ReceiverCore core(p.logFile.c_str(), slotsFor(p));
+    core.clock = simClock;
+    core.clockMillis = simClockMillis;
+    core.journal.console = &consoleOut;
+    core.logInterval = -1;                  // A log entry for every reading.
+    core.syncLog = false;                   // A million fdatasync()s would be the whole run.
+    SpscRing<Frame, 64> ring;
+    LatencyHistogram latency;
+
+    vector<SoakSensor> sensors(p.sensors);
+    for (unsigned int k = 0; k < p.sensors; k++) {
+        sensors[k] = SoakSensor{(uint16_t)(k + 1), 1, 0, 0, (float)(80 + 40 * random01()), 0};
+    }
+
+    uint64_t step = (uint64_t)(p.intervalSeconds * 1e6) / p.sensors;
+    unsigned long total = ALLOC_WARMUP_PACKETS + ALLOC_CHECK_PACKETS;
+    Frame in = {}, out = {};
+    unsigned long readings0 = 0, diags0 = 0, logEntries0 = 0;
+    for (unsigned long n = 0; n < total; n++) {
+        if (n == ALLOC_WARMUP_PACKETS) {
+            readings0 = core.readings;
+            diags0 = core.diags;
+            logEntries0 = core.logEntries;
+            allocCounting = true;
+        }
+        SoakSensor& s = sensors[n % p.sensors];
+        simMicros += step;
+        s.ctSuccess++;
+        if (n % DIAG_EVERY == 0) {
+            uint16_t diag[4] = {s.id, (uint16_t)(20 + n % 40), 150, 300};
+            memcpy(in.bytes, diag, 8);
+            in.bytes[8] = 1;
+            in.bytes[9] = 0;
+            in.width = DIAG_PAYLOAD_SIZE;
+        } else {
+            buildPayload(in.bytes, s, simMicros, retriesAt(s.paLevel));
+            in.width = PAYLOAD_BYTES;
+        }
+
+        uint64_t t0 = monoNanos();
+        ring.push(in);
+        ring.pop(out);
+        bool reading = core.track(out.bytes, out.width);
+        core.setNextAckPayload();
+        if (reading) core.logIfDue();
+        latency.record(monoNanos() - t0);
+        if ((core.ackPayload.command & 0xFF) == CMD_SET_PA_LEVEL) {
+            sensors[(core.ackPayload.command >> CMD_TARGET_SHIFT) - 1].paLevel = core.ackPayload.uliCmdData & 3;
+        }
+    }
+    allocCounting = false;
+
+    printf("RPi_GatewaySoak [%s] allocation check: %d packets (%lu readings, %lu diagnostic, %lu log lines) "
+           "after %d warm-up, %.0f ns/pkt: %lu allocations -> %s\n", VERSION, ALLOC_CHECK_PACKETS, core.readings - readings0,
+           core.diags - diags0, core.logEntries - logEntries0, ALLOC_WARMUP_PACKETS, latency.mean(), allocCount, allocCount ? "FAIL" : "PASS");
+    return allocCount ? 1 : 0;
+}
+
+
+/* What the latency trace costs per packet, against what the packet costs.
+   ----------------------------------------------------------------------------
+   Each packet is put into a simulated chip's RX FIFO as if it had come off
+   the air (NrfSim::onFrame()), and taken off it as radioService() does:
+   rxPipe(), then readAndReload() with the ACK payload ReceiverCore picked,
+   through NrfSimSpi. It is then pushed and popped through an SpscRing,
+   tracked and logIfDue()'d, and its stamps recorded, exactly as slave()
+   does; the log interval is the receiver's own. Only that is timed, packet
+   by packet; building the payload and running the air on for its ACK
+   (TRACE_BENCH_AIR_MICROS) aren't. Readings only. The best round is taken as
+   the least disturbed; those rounds have no fdatasync(), as the disk's time
+   would swamp the trace's, but a last, shorter one does, so that some traced
+   packets get to the disk.
+     The packet's cost is a -DLATENCY_TRACE=0 build's best round, built and
+   run from here. Its 47 bytes on the bus at SPIB_SPEED_HZ are shown but not
+   added: the ioctl waits them out, but they are not CPU. The trace's own cost
+   is the stamps a packet gets and a record(), timed on their own - as
+   sampled, and every packet. Timing the two builds' packets and taking one
+   from the other is only a rough cross-check: they differ run to run by
+   more than the trace costs.
+   RETURNS: Exit status: 0 if the sampled trace is under
+   TRACE_BENCH_MAX_PERCENT of the untraced packet and packets were traced to
+   the disk (or compiled out), 1 if not.
+ */
+int traceBench(const SoakParams& p) {
+    struct Frame {
+        uint8_t bytes[PAYLOAD_BYTES];
+        uint8_t width;
+        TraceStamps trace;
+    };
+
+    remove(p.logFile.c_str());
+    rng = p.seed;
+    simStart = time(0);
+    simMicros = 0;
+
+    CountingBuf consoleBuf;
+    ostream consoleOut(&consoleBuf);
+    ReceiverCore core(p.logFile.c_str(), slotsFor(p));
+    core.clock = simClock;
+    core.clockMillis = simClockMillis;
+    core.journal.console = &consoleOut;
+    core.syncLog = false;
+    SpscRing<Frame, 64> ring;
+    LatencyTrace latency;
+
+        /* The gateway's chip, listening on pipe 1 (its reset address) with dynamic
+           payloads and ACK payloads, and a chip for the frames to come from. */
+    VirtualAir air(p.seed);
+    NrfSim chip(air), sender(air);
+    NrfSimSpi spi(&chip);
+    NrfSpiBatch batch(&spi);
+    chip.writeRegister(NRFSIM_FEATURE, NRFSIM_EN_DPL | NRFSIM_EN_ACK_PAY);
+    chip.writeRegister(NRFSIM_DYNPD, 0x3F);
+    chip.writeRegister(NRFSIM_RF_SETUP, 0x07);      // 1Mbps, as RF24::begin() leaves it.
+    chip.writeRegister(NRFSIM_CONFIG, NRFSIM_EN_CRC | NRFSIM_CRCO | NRFSIM_PWR_UP | NRFSIM_PRIM_RX);
+    chip.ce(true);
+    air.advance(NRFSIM_POWERUP_MICROS + NRFSIM_SETTLE_MICROS);
+    AirFrame frame = {};
+    frame.from = &sender;
+    frame.channel = chip.channel();
+    frame.txDbm = -6;
+    frame.addrWidth = 5;
+    memset(frame.addr, 0xC2, 5);                    // RX_ADDR_P1's reset value.
+    frame.len = PAYLOAD_BYTES;
+
+    vector<SoakSensor> sensors(p.sensors);
+    for (unsigned int k = 0; k < p.sensors; k++) {
+        sensors[k] = SoakSensor{(uint16_t)(k + 1), 1, 0, 0, (float)(80 + 40 * random01()), 0};
+    }
+
+    uint64_t step = (uint64_t)(p.intervalSeconds * 1e6) / p.sensors;
+    Frame in = {}, out = {};
+    unsigned long taken = 0;
+    auto round = [&](unsigned long packets) {
+        uint64_t nanos = 0;
+        for (unsigned long n = 0; n < packets; n++) {
+            SoakSensor& s = sensors[n % p.sensors];
+            simMicros += step;
+            s.ctSuccess++;
+            buildPayload(frame.payload, s, simMicros, retriesAt(s.paLevel));
+            frame.pid = (uint8_t)(n & 3);
+            chip.onFrame(frame, false);
+
+            uint64_t t0 = monoNanos();
+            TRACE_CLEAR(in.trace);
+            in.width = 0;
+            if (batch.rxPipe() >= 0) {
+                TRACE_STAMP(in.trace, TP_AVAILABLE);
+                int width = batch.readAndReload(in.bytes, 1, &core.ackPayload, sizeof(core.ackPayload));
+                TRACE_STAMP(in.trace, TP_READ);
+                TRACE_SAME(in.trace, TP_ACK_REARMED, TP_READ);
+                if (width > 0) in.width = width;
+            }
+            if (in.width) {
+                ring.push(in);
+                ring.pop(out);
+                TRACE_STAMP(out.trace, TP_DEQUEUED);
+                bool reading = core.track(out.bytes, out.width);
+                core.setNextAckPayload();
+                TRACE_STAMP(out.trace, TP_DECODED);
+                if (reading) core.logIfDue(&out.trace);
+                latency.record(out.trace);
+                taken++;
+            }
+            nanos += monoNanos() - t0;
+
+            if ((core.ackPayload.command & 0xFF) == CMD_SET_PA_LEVEL) {
+                sensors[(core.ackPayload.command >> CMD_TARGET_SHIFT) - 1].paLevel = core.ackPayload.uliCmdData & 3;
+            }
+            air.advance(TRACE_BENCH_AIR_MICROS);
+        }
+        return (double)nanos / packets;
+    };
+
+    double best = 0;
+    for (int r = 0; r < TRACE_BENCH_ROUNDS; r++) {
+        double perPacket = round(TRACE_BENCH_PACKETS);
+        if (r == 0 || perPacket < best) best = perPacket;
+    }
+    core.syncLog = true;                            // One more round with fdatasync(), for fsynced and air to disk.
+    unsigned long fsyncs0 = fsyncCount;
+    double syncPerPacket = round(TRACE_BENCH_SYNC_PACKETS);
+    unsigned long fsyncs = fsyncCount - fsyncs0;
+    core.syncLog = false;
+
+        /* rxPipe()'s NOP; then width, payload, ACK payload and STATUS, each with its command byte. */
+    double busNanos = (1 + 2 + (1 + SPIB_MAX_PAYLOAD) + (1 + sizeof(core.ackPayload)) + 2) * 8e9 / SPIB_SPEED_HZ;
+
+    printf("RPi_GatewaySoak [%s] latency trace %s: best of %d rounds of %d packets, each off a simulated nRF24 "
+           "through NrfSpiBatch, then %d with fdatasync() (%lu taken, %lu log lines)\n", VERSION,
+           LATENCY_TRACE ? "compiled in" : "compiled out (LATENCY_TRACE=0)", TRACE_BENCH_ROUNDS, TRACE_BENCH_PACKETS,
+           TRACE_BENCH_SYNC_PACKETS, taken, core.logEntries);
+    printf("  packet:  %8.1f ns CPU (SPI batch on the simulated chip, ring, ReceiverCore%s); %.1f ns with fdatasync() "
+           "(%lu); %.1f ns on the SPI bus at %.0fMHz, not counted\n", best, LATENCY_TRACE ? ", trace" : "",
+           syncPerPacket, fsyncs, busNanos, SPIB_SPEED_HZ / 1e6);
+    bool pass = taken == (unsigned long)TRACE_BENCH_ROUNDS * TRACE_BENCH_PACKETS + TRACE_BENCH_SYNC_PACKETS;
+#if LATENCY_TRACE
+        /* The same packets with no trace: a -DLATENCY_TRACE=0 build of this file, run with -t. */
+    double untraced = 0;
+    string build = string(TRACE_BENCH_CXX) + " -DLATENCY_TRACE=0 -o " + TRACE_BENCH_NOTRACE + " " + __FILE__;
+    fflush(stdout);
+    if (system(build.c_str()) == 0) {
+        FILE* f = popen((string(TRACE_BENCH_NOTRACE) + " -t -L " + p.logFile + ".notrace").c_str(), "r");
+        char text[512];
+        while (f && fgets(text, sizeof(text), f)) {
+            const char* at = strstr(text, "packet:");
+            if (at) sscanf(at, "packet: %lf", &untraced);
+        }
+        if (f && pclose(f) != 0) untraced = 0;
+        remove((p.logFile + ".notrace").c_str());
+    }
+    printf("  untraced:%8.1f ns CPU a packet, from %s\n", untraced, build.c_str());
+    if (untraced <= 0) {
+        printf("  untraced build or run failed -> FAIL\n");
+        return 1;
+    }
+
+        /* The trace alone, as the packets above get it: TRACE_CLEAR() picks 1 in
+           LATENCY_TRACE_EVERY, which get the stamps a reading that isn't logged
+           gets, and a record(). Then every packet stamped and recorded. */
+    LatencyTrace alone;
+    double sampledNanos = 0, everyNanos = 0;
+    for (int r = 0; r < TRACE_BENCH_ROUNDS; r++) {
+        for (int every = 0; every < 2; every++) {
+            uint64_t t0 = monoNanos();
+            for (unsigned long n = 0; n < TRACE_BENCH_PACKETS; n++) {
+                TRACE_CLEAR(in.trace);
+                if (every && !in.trace.on) {
+                    memset(in.trace.at, 0, sizeof(in.trace.at));
+                    in.trace.on = true;
+                }
+                TRACE_STAMP(in.trace, TP_AVAILABLE);
+                TRACE_STAMP(in.trace, TP_READ);
+                TRACE_SAME(in.trace, TP_ACK_REARMED, TP_READ);
+                TRACE_STAMP(in.trace, TP_DEQUEUED);
+                TRACE_STAMP(in.trace, TP_DECODED);
+                alone.record(in.trace);
+            }
+            double perPacket = (double)(monoNanos() - t0) / TRACE_BENCH_PACKETS;
+            double& keep = every ? everyNanos : sampledNanos;
+            if (r == 0 || perPacket < keep) keep = perPacket;
+        }
+    }
+    double percent = 100.0 * sampledNanos / untraced;
+    bool under = percent < TRACE_BENCH_MAX_PERCENT;
+    pass = pass && under;
+    printf("  trace:   %8.1f ns a packet, 1 in %d traced = %.2f%% of the untraced packet -> %s (under %.0f%%)\n",
+           sampledNanos, LATENCY_TRACE_EVERY, percent, under ? "PASS" : "FAIL", TRACE_BENCH_MAX_PERCENT);
+    printf("           %8.1f ns with every packet traced = %.2f%%%s\n", everyNanos, 100.0 * everyNanos / untraced,
+           100.0 * everyNanos / untraced < TRACE_BENCH_MAX_PERCENT ? "" : " - over, which is why it is sampled");
+    printf("           (cross-check: this build's packet less the untraced one's, %+.1f ns - separate runs, so rough)\n",
+           best - untraced);
+    bool synced = latency.stage(TP_FSYNCED).count() > 0 && latency.airToDisk().count() > 0;
+    pass = pass && synced;
+    if (!synced) printf("  no fsynced or air to disk samples from the fdatasync() round -> FAIL\n");
+    fflush(stdout);
+    latency.dump(cout);
+#else
+    printf("  trace:   compiled out, nothing to measure -> %s\n", pass ? "PASS" : "FAIL");
+#endif
+    return pass ? 0 : 1;
+}
+
+
+/* Check the SIGTERM shutdown: nothing sent is lost, the log is flushed, and
+   it is quick.
+   ----------------------------------------------------------------------------
+   The main thread's side is slave() and shutdown() from RPi_CapDataReceive,
+   with ReceiverCore as it is. The radio thread sends frames from p.sensors
+   sensors round and round, waiting when the ring is full as a sensor would
+   retry; once told to stop, it queues SHUTDOWN_FIFO_FRAMES more, as
+   radioService() does with the RX FIFO, and says it is done. Another thread
+   sends the SIGTERM.
+   RETURNS: Exit status: 0 if every trial passed, 1 if any failed.
+ */
+int shutdownCheck(const SoakParams& p) {
+    struct Frame {
+        uint8_t bytes[PAYLOAD_BYTES];
+        uint8_t width;
+    };
+
+    SignalFd signals({SIGTERM});                // Before any thread starts.
+    if (!signals.isOpen()) {
+        printf("RPi_GatewaySoak: could not open a signalfd\n");
+        return 1;
+    }
+    printf("RPi_GatewaySoak [%s] shutdown check: %d trials, %u sensors, budget %d ms\n", VERSION, SHUTDOWN_TRIALS,
+           p.sensors, SHUTDOWN_BUDGET_MILLIS);
+    rng = p.seed;
+
+    int failed = 0;
+    for (int trial = 0; trial < SHUTDOWN_TRIALS; trial++) {
+        remove(p.logFile.c_str());
+        CountingBuf consoleBuf;
+        ostream consoleOut(&consoleBuf);
+        ReceiverCore core(p.logFile.c_str(), slotsFor(p));
+        core.journal.console = &consoleOut;
+        SpscRing<Frame, 64> ring;
+        std::atomic<bool> running{true};
+        std::atomic<bool> stopped{false};
+        unsigned long sent = 0;                 // The radio thread's until it is joined.
+        uint16_t lastSensor = 0;
+
+        std::thread radio([&]() {
+            vector<SoakSensor> sensors(p.sensors);
+            for (unsigned int k = 0; k < p.sensors; k++) {
+                sensors[k] = SoakSensor{(uint16_t)(k + 1), 1, 0, 0, (float)(80 + 40 * random01()), 0};
+            }
+            Frame frame = {};
+            frame.width = PAYLOAD_BYTES;
+            uint64_t micros = 0;
+            unsigned int fifoLeft = SHUTDOWN_FIFO_FRAMES;
+            for (unsigned long n = 0; fifoLeft > 0; n++) {
+                if (!running.load(std::memory_order_acquire)) fifoLeft--;
+                SoakSensor& s = sensors[n % p.sensors];
+                s.ctSuccess++;
+                micros += 9000;
+                buildPayload(frame.bytes, s, micros, retriesAt(s.paLevel));
+                while (!ring.push(frame)) std::this_thread::yield();
+                sent++;
+                lastSensor = s.id;
+            }
+            stopped.store(true, std::memory_order_release);
+        });
+        unsigned int killAfterMicros = 20000 + trial * 23000;      // Somewhere new each trial.
+        std::thread killer([killAfterMicros]() {
+            usleep(killAfterMicros);
+            kill(getpid(), SIGTERM);
+        });
+
+            /* slave() */
+        Frame frame;
+        unsigned int sinceSignalCheck = 0;
+        int sig = 0;
+        while (sig != SIGTERM) {
+            if (!ring.pop(frame)) {
+                sig = signals.wait(SHUTDOWN_IDLE_MICROS);
+            } else {
+                core.track(frame.bytes, frame.width);
+                core.setNextAckPayload();
+                core.logIfDue();
+                if (++sinceSignalCheck >= SHUTDOWN_SIGNAL_CHECK) {
+                    sinceSignalCheck = 0;
+                    sig = signals.take();
+                }
+            }
+        }
+
+            /* shutdown() */
+        uint64_t t0 = monoNanos();
+        running.store(false, std::memory_order_release);
+        unsigned long drained = 0;
+        while (true) {
+            bool radioDone = stopped.load(std::memory_order_acquire);
+            if (ring.pop(frame)) {
+                core.track(frame.bytes, frame.width);
+                core.setNextAckPayload();
+                core.logIfDue();
+                drained++;
+            } else if (radioDone) {
+                break;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        radio.join();
+        bool flushed = core.flush();
+        double millis = (monoNanos() - t0) / 1e6;
+        killer.join();
+
+            /* The log's last line should be the last reading processed. */
+        char lastLine[FIXEDLINE_SIZE] = "";
+        FILE* f = fopen(p.logFile.c_str(), "r");
+        if (f) {
+            char buf[FIXEDLINE_SIZE];
+            while (fgets(buf, sizeof(buf), f)) strcpy(lastLine, buf);
+            fclose(f);
+        }
+        char expect[32];
+        snprintf(expect, sizeof(expect), " Sensor: %u ", (unsigned int)core.rxPayload.sensorID);
+        unsigned long lost = sent - core.readings;
+        bool logged = flushed && strstr(lastLine, expect) != NULL && core.rxPayload.sensorID == lastSensor;
+        bool pass = (lost == 0 && logged && millis <= SHUTDOWN_BUDGET_MILLIS);
+        if (!pass) failed++;
+
+        printf("  trial %2d: SIGTERM at %3u ms: %8lu sent, %8lu tracked, %lu lost, %3lu drained, "
+               "log %s, shutdown %.3f ms -> %s\n", trial + 1, killAfterMicros / 1000, sent, core.readings, lost,
+               drained, logged ? "flushed" : "NOT flushed", millis, pass ? "PASS" : "FAIL");
+    }
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
+
+
+/* Packet n of a repeatable stream: the same n always gives the same packet
+   and the same state after it, given the same rng and simMicros to start.
+   ----------------------------------------------------------------------------
+ */
+static void warmPacket(ReceiverCore& core, vector<SoakSensor>& sensors, unsigned long n, uint64_t step) {
+    uint8_t bytes[PAYLOAD_BYTES];
+    SoakSensor& s = sensors[n % sensors.size()];
+    simMicros += step;
+    s.ctSuccess++;
+    buildPayload(bytes, s, simMicros, retriesAt(s.paLevel));
+    core.track(bytes, PAYLOAD_BYTES);
+    core.setNextAckPayload();
+    core.logIfDue();
+    if ((core.ackPayload.command & 0xFF) == CMD_SET_PA_LEVEL) {
+        sensors[(core.ackPayload.command >> CMD_TARGET_SHIFT) - 1].paLevel = core.ackPayload.uliCmdData & 3;
+    }
+}
+
+static vector<SoakSensor> warmSensors(const SoakParams& p) {
+    rng = p.seed;
+    simMicros = 0;
+    vector<SoakSensor> sensors(p.sensors);
+    for (unsigned int k = 0; k < p.sensors; k++) {
+        sensors[k] = SoakSensor{(uint16_t)(k + 1), 1, 0, 0, (float)(80 + 40 * random01()), 0};
+    }
+    return sensors;
+}
+
+
+/* Check the state file: killed at any moment, it loads back as it was after
+   the last packet saved.
+   ----------------------------------------------------------------------------
+   Each packet changes one sensor's slot, so the packet counts in the slots
+   loaded back add up to how many packets got saved. Replaying that many
+   gives what every slot should hold. commandQueued is left out of the
+   comparison: taking a command off the queue isn't saved, so a restart
+   sends it again. lastLog is saved again once the log line is written, so a
+   kill in between leaves one sensor's lastLog behind the replay's - the
+   restart logs that reading again rather than losing it. That much is let
+   through. Each slot's rollup, all of it summed, must come back as the
+   replay has it too - bar one sensor with one reading more, the packet
+   added to the rollups when the kill came, before its state was saved.
+   RETURNS: Exit status: 0 if every trial matched, 1 if any didn't.
+ */
+static RollupPoint rollupTotal(const SensorRollup& rollup, unsigned int slot) {
+    RollupPoint total = {0, 0, 0, 0, 0, 0, 0};
+    rollup.query(slot, 0, simClock() + 86400, 1, [&](const RollupPoint& pt) {
+        total.count += pt.count;
+        total.sum += pt.sum;
+    });
+    return total;
+}
+
+int warmRestartCheck(const SoakParams& p) {
+    string statePath = p.logFile + ".state";
+    string rollupPath = p.logFile + ".rollup";
+    uint64_t step = (uint64_t)(p.intervalSeconds * 1e6) / p.sensors;
+    simStart = time(0);
+    printf("RPi_GatewaySoak [%s] state file check: %d trials, %u sensors, %u slots, %lu bytes/sensor -> %s\n",
+           VERSION, WARM_TRIALS, p.sensors, slotsFor(p), (unsigned long)sizeof(SensorState), statePath.c_str());
+
+    int failed = 0;
+    uint64_t killRng = p.seed * 2654435761u + 1;
+    for (int trial = 0; trial < WARM_TRIALS; trial++) {
+        remove(statePath.c_str());
+        remove(rollupPath.c_str());
+        remove(p.logFile.c_str());
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            CountingBuf consoleBuf;
+            ostream consoleOut(&consoleBuf);
+            ReceiverCore core(p.logFile.c_str(), slotsFor(p));
+            core.clock = simClock;
+    core.clockMillis = simClockMillis;
+            core.journal.console = &consoleOut;
+            if (core.openState(statePath.c_str(), rollupPath.c_str()) < 0 || !core.rollup.isOpen()) _exit(2);
+            vector<SoakSensor> sensors = warmSensors(p);
+            for (unsigned long n = 0; ; n++) warmPacket(core, sensors, n, step);
+        }
+        killRng ^= killRng << 13;
+        killRng ^= killRng >> 7;
+        killRng ^= killRng << 17;
+        unsigned int killAfter = 20000 + killRng % (WARM_KILL_MAX_MICROS - 20000);
+        usleep(killAfter);
+        kill(pid, SIGKILL);
+        int status;
+        waitpid(pid, &status, 0);
+
+            /* Load back what it left. */
+        CountingBuf consoleBuf;
+        ostream consoleOut(&consoleBuf);
+        uint64_t t0 = monoNanos();
+        ReceiverCore restored("/dev/null", slotsFor(p));
+        restored.clock = simClock;
+        restored.clockMillis = simClockMillis;
+        restored.journal.console = &consoleOut;
+        int sensorsBack = restored.openState(statePath.c_str(), rollupPath.c_str());
+        double loadMillis = (monoNanos() - t0) / 1e6;
+        unsigned long saved = 0;
+        for (unsigned int k = 0; k < restored.sensors.count(); k++) saved += restored.sensors.at(k)->packets;
+
+            /* Replay to the same point. */
+        ReceiverCore replay("/dev/null", slotsFor(p));
+        replay.clock = simClock;
+        replay.clockMillis = simClockMillis;
+        replay.journal.console = &consoleOut;
+        replay.syncLog = false;
+        vector<SoakSensor> sensors = warmSensors(p);
+        for (unsigned long n = 0; n < saved; n++) warmPacket(replay, sensors, n, step);
+
+        unsigned int differ = (restored.sensors.count() != replay.sensors.count()) ? 1 : 0;
+        unsigned int logBehind = 0;
+        for (unsigned int k = 0; k < replay.sensors.count() && k < restored.sensors.count(); k++) {
+            SensorState a, b;
+            memcpy(&a, restored.sensors.at(k), sizeof(a));
+            memcpy(&b, replay.sensors.at(k), sizeof(b));
+            a.commandQueued = b.commandQueued = false;
+            if (a.lastLog < b.lastLog) {
+                logBehind++;
+                a.lastLog = b.lastLog;
+            }
+            if (memcmp(&a, &b, sizeof(a)) != 0) differ++;
+        }
+        if (logBehind > 1) differ += logBehind;
+
+        unsigned int rollupsDiffer = 0, rollupAhead = 0;
+        for (unsigned int k = 0; k < replay.sensors.count() && k < restored.sensors.count(); k++) {
+            RollupPoint a = rollupTotal(restored.rollup, k), b = rollupTotal(replay.rollup, k);
+            if (a.count == b.count + 1) rollupAhead++;
+            else if (a.count != b.count || a.sum != b.sum) rollupsDiffer++;
+        }
+        if (rollupAhead > 1) rollupsDiffer += rollupAhead;
+        bool pass = (sensorsBack > 0 && saved > 0 && differ == 0 && rollupsDiffer == 0 && restored.rollup.isOpen()
+                     && restored.rollup.slotsInUse() == restored.sensors.count());
+        if (!pass) failed++;
+        printf("  trial %2d: killed at %3u ms after %8lu packets: %4d sensors back in %.3f ms, %u differ%s, "
+               "%u rollups differ%s -> %s\n", trial + 1, killAfter / 1000, saved, sensorsBack, loadMillis, differ,
+               logBehind == 1 ? " (1 log entry to redo)" : "", rollupsDiffer,
+               rollupAhead == 1 ? " (1 a reading ahead)" : "", pass ? "PASS" : "FAIL");
+    }
+    remove(statePath.c_str());
+    remove(rollupPath.c_str());
+    printf("%s\n", failed ? "FAIL" : "PASS");
+    return failed ? 1 : 0;
+}
+
+
+/* =============================================================================
+   Journal logging benchmark
+   =============================================================================
+*/
+
+    /* JournalLog's clock in the rate-limited run, so time can be moved on. */
+static uint64_t benchMicros = 0;
+static uint64_t benchClock() { return benchMicros; }
+
+    /* The journal's end of a stand-in socket: counts what comes in - lines on
+       a stream, entries on a datagram socket - and keeps the first and last
+       entry. Runs until the stream is closed, or until stop is set and
+       nothing more comes for a while. */
+struct JournalSink {
+    int fd;
+    bool datagrams;
+    atomic<bool> stop{false};
+    atomic<unsigned long> messages{0};
+    string first, last;
+};
+
+static void drainSink(JournalSink* sink) {
+    static char buf[65536];
+    timeval tv = {0, 20000};
+    setsockopt(sink->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (true) {
+        ssize_t n = recv(sink->fd, buf, sizeof(buf), 0);
+        if (n == 0) break;                                      // Stream closed.
+        if (n < 0) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && !sink->stop.load()) continue;
+            break;
+        }
+        if (sink->datagrams) {
+            sink->messages++;
+            if (sink->first.empty()) sink->first.assign(buf, n);
+            sink->last.assign(buf, n);
+        } else {
+            for (ssize_t k = 0; k < n; k++) if (buf[k] == '\n') sink->messages++;
+        }
+    }
+}
+
+    /* The value of NAME= in a native journal entry; "(none)" if it isn't there. */
+static string journalField(const string& entry, const char* name) {
+    string key = string(name) + "=";
+    size_t pos = 0;
+    while (pos < entry.size()) {
+        size_t end = entry.find('\n', pos);
+        if (end == string::npos) end = entry.size();
+        if (entry.compare(pos, key.size(), key) == 0) return entry.substr(pos + key.size(), end - pos - key.size());
+        pos = end + 1;
+    }
+    return "(none)";
+}
+
+    /* One PA change message, as ReceiverCore::trackSensor() sends it. */
+static void journalPaChange(JournalLog& journal, FixedLine& line, unsigned long k, unsigned int sensors) {
+    if (!journal.start(EVENT_PA_CHANGE, LOG_NOTICE)) return;
+    unsigned int id = k % sensors + 1, from = k & 3, to = (k + 1) & 3;
+    double retransmits = 0.5 + (k % 7) * 0.25, microJoules = 120.5;
+    line.clear();
+    line.add("Sensor ").add(id).add(": PA level ").add(from).add(" -> ").add(to)
+        .add(" (retransmits/pkt ").add(retransmits).add(", ").add(microJoules).add(" uJ/pkt)");
+    journal.field("SENSOR_ID", id).field("PA_FROM", from).field("PA_TO", to)
+           .field("RETRANSMITS_PER_PACKET", retransmits).field("UJ_PER_PACKET", microJoules)
+           .send(line.c_str());
+}
+
+static uint64_t threadCpuNanos() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/* What a message to the journal costs, the old way and with JournalLog.
+   ----------------------------------------------------------------------------
+   Four runs of JOURNAL_BENCH_EVENTS PA change messages, each to a stand-in
+   journal drained by a thread:
+        cout, endl          the receiver before rel15: a stream socket as
+                            stdout, as systemd gives a service, one write()
+                            per line.
+        JournalLog text     the same stream, JournalLog with no journal open:
+                            '\n' and a flush at the end.
+        JournalLog native   entries with their fields to a datagram socket,
+                            as to /run/systemd/journal/socket, not limited;
+                            after each JOURNAL_BATCH the sink is let catch up,
+                            as journald would on a core of its own.
+        ... overloaded      the same without letting it catch up: the
+                            socket fills, and the rest are dropped, not
+                            waited for.
+        ... rate-limited    the same, limited as ReceiverCore limits
+                            pa-change, all in a simulated 0.2s storm; then one
+                            more 10s on, which should say how many were held back.
+   Wall time and the logging thread's CPU time are per message, whether it got
+   through or not. System calls are write()s (from /proc/self/io) for the
+   stream, sendmmsg()s for the datagrams. systemd's own sysctl raises
+   net.unix.max_dgram_qlen to 512 for journald; here it may be the kernel's
+   default of 10, which costs the native run extra sendmmsg()s.
+   RETURNS: Exit status: 0 if the entries check out, 1 if not.
+ */
+int journalBench(const SoakParams& p) {
+    const unsigned long events = JOURNAL_BENCH_EVENTS;
+    FixedLine line;
+    bool pass = true;
+
+    FILE* f = fopen("/proc/sys/net/unix/max_dgram_qlen", "r");
+    int qlen = -1;
+    if (f) {
+        if (fscanf(f, "%d", &qlen) != 1) qlen = -1;
+        fclose(f);
+    }
+    printf("RPi_GatewaySoak [%s] journal benchmark: %lu PA change messages, %u sensors, max_dgram_qlen %d\n",
+           VERSION, events, p.sensors, qlen);
+    printf("%-22s %11s %11s %11s %10s %10s %10s %10s\n", "", "events/s", "ns/event", "CPU ns/ev", "syscalls",
+           "received", "suppressed", "dropped");
+    fflush(stdout);
+
+    auto report = [&](const char* name, uint64_t wall, uint64_t cpu, long long syscalls, unsigned long received,
+                      unsigned long suppressed, unsigned long dropped) {
+        printf("%-22s %11.0f %11.1f %11.1f %10lld %10lu %10lu %10lu\n", name, events / (wall / 1e9), (double)wall / events,
+               (double)cpu / events, syscalls, received, suppressed, dropped);
+        fflush(stdout);
+    };
+
+        /* 1 & 2: a stream socket as stdout. */
+    for (int run = 0; run < 2; run++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+            printf("RPi_GatewaySoak: could not make a socket pair\n");
+            return 1;
+        }
+        fflush(stdout);
+        int savedOut = dup(STDOUT_FILENO);
+        dup2(sv[0], STDOUT_FILENO);
+        close(sv[0]);
+        JournalSink sink;
+        sink.fd = sv[1];
+        sink.datagrams = false;
+        thread drain(drainSink, &sink);
+
+        JournalLog journal("RPi_GatewaySoak");
+        for (int t = 0; t <= EVENT_PA_CHANGE; t++) journal.addType(t == EVENT_PA_CHANGE ? "pa-change" : "other", 0, 0);
+        journal.console = &cout;
+        long long w0, s0, w1, s1;
+        procIo(&w0, &s0);
+        uint64_t t0 = monoNanos(), c0 = threadCpuNanos();
+        for (unsigned long k = 0; k < events; k++) {
+            if (run == 0) {
+                unsigned int id = k % p.sensors + 1, from = k & 3, to = (k + 1) & 3;
+                double retransmits = 0.5 + (k % 7) * 0.25, microJoules = 120.5;
+                cout << "Sensor " << id << ": PA level " << from << " -> " << to << " (retransmits/pkt " << retransmits
+                     << ", " << microJoules << " uJ/pkt)" << endl;
+            } else {
+                journalPaChange(journal, line, k, p.sensors);
+            }
+        }
+        journal.flush();
+        fflush(stdout);
+        uint64_t wall = monoNanos() - t0, cpu = threadCpuNanos() - c0;
+        procIo(&w1, &s1);
+
+        dup2(savedOut, STDOUT_FILENO);                          // Closes the stream's last write end.
+        close(savedOut);
+        drain.join();
+        close(sv[1]);
+        report(run == 0 ? "cout, endl" : "JournalLog text", wall, cpu, s1 - s0, sink.messages.load(), 0, 0);
+        if (sink.messages.load() != events) {
+            printf("  FAIL: %lu lines received\n", sink.messages.load());
+            pass = false;
+        }
+    }
+
+        /* 3 & 4: native entries to a datagram socket. */
+    for (int run = 0; run < 3; run++) {
+        bool paced = (run == 0), limited = (run == 2);
+        int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path + 1, JOURNAL_BENCH_SOCKET + 1);   // Abstract.
+        int rcvbuf = 8 * 1024 * 1024;                           // As journald.
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        if (fd < 0 || bind(fd, (sockaddr*)&addr, offsetof(sockaddr_un, sun_path) + strlen(JOURNAL_BENCH_SOCKET)) != 0) {
+            printf("RPi_GatewaySoak: could not bind %s\n", JOURNAL_BENCH_SOCKET);
+            return 1;
+        }
+        JournalSink sink;
+        sink.fd = fd;
+        sink.datagrams = true;
+        thread drain(drainSink, &sink);
+
+        JournalLog journal("RPi_GatewaySoak");
+        for (int t = 0; t <= EVENT_PA_CHANGE; t++) {
+            if (t == EVENT_PA_CHANGE) journal.addType("pa-change", limited ? 20 : 0, limited ? 10 : 0);
+            else journal.addType("other", 0, 0);
+        }
+        if (limited) {
+            benchMicros = 1;
+            journal.clock = benchClock;
+        }
+        journal.open(JOURNAL_BENCH_SOCKET);
+        uint64_t t0 = monoNanos(), c0 = threadCpuNanos();
+        for (unsigned long k = 0; k < events; k++) {
+            if (limited) benchMicros = 1 + k * 200000ULL / events;
+            journalPaChange(journal, line, k, p.sensors);
+            if (paced && (k + 1) % JOURNAL_BATCH == 0) {
+                while (journal.queued() > 0 || sink.messages.load() + journal.dropped < k + 1) {
+                    sched_yield();
+                    if (journal.queued() > 0) journal.flush();
+                }
+            }
+        }
+        journal.flush();
+        uint64_t wall = monoNanos() - t0, cpu = threadCpuNanos() - c0;
+        unsigned long suppressedInStorm = journal.suppressed;
+        if (limited) {                                          // 10s on: one more gets through.
+            benchMicros += 10000000ULL;
+            journalPaChange(journal, line, events, p.sensors);
+        }
+        for (int tries = 0; journal.queued() > 0 && tries < 1000; tries++) {
+            usleep(1000);
+            journal.flush();
+        }
+        sink.stop.store(true);
+        drain.join();
+        close(fd);
+        unsigned long received = sink.messages.load();
+        report(paced ? "JournalLog native" : limited ? "... rate-limited" : "... overloaded", wall, cpu, journal.batches,
+               received, suppressedInStorm, journal.dropped);
+
+            /* The entries are what they should be. */
+        string want = "Sensor 1: PA level 0 -> 1 (retransmits/pkt 0.5, 120.5 uJ/pkt)";
+        if (journalField(sink.first, "MESSAGE") != want || journalField(sink.first, "PRIORITY") != "5"
+            || journalField(sink.first, "SYSLOG_IDENTIFIER") != "RPi_GatewaySoak"
+            || journalField(sink.first, "EVENT") != "pa-change" || journalField(sink.first, "SENSOR_ID") != "1"
+            || journalField(sink.first, "PA_FROM") != "0" || journalField(sink.first, "PA_TO") != "1"
+            || journalField(sink.first, "RETRANSMITS_PER_PACKET") != "0.5") {
+            printf("  FAIL: first entry:\n%s", sink.first.c_str());
+            pass = false;
+        }
+        if (!limited && received + journal.dropped != events) {
+            printf("  FAIL: %lu received + %lu dropped != %lu\n", received, journal.dropped, events);
+            pass = false;
+        }
+        if (limited) {
+            string held = journalField(sink.last, "SUPPRESSED");
+            printf("  storm: %lu of %lu through at burst 20, 10/min; the next one, 10s on, says SUPPRESSED=%s\n",
+                   events - suppressedInStorm, events, held.c_str());
+            if (events - suppressedInStorm != 20 || received != 21 || held != to_string(events - 20)) {
+                pass = false;
+                printf("  FAIL: rate limit\n");
+            }
+        }
+    }
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* What the verbose dashboard costs.
+   ----------------------------------------------------------------------------
+   slave()'s loop in real time: packets from p.sensors sensors, evenly spread
+   over DASH_BENCH_INTERVAL_SECONDS, go through ReceiverCore as they come due;
+   in between the loop naps DASH_BENCH_IDLE_MICROS; a frame is drawn whenever
+   the dashboard is due, with status lines built as showDashboard() builds
+   them. Only the drawing is timed (thread CPU time), so the share of a core
+   is the dashboard's own. The screen is one row per sensor - the worst case,
+   every sensor on every frame - where a real terminal would page.
+   RETURNS: Exit status: 0 if under 1% of a core and one write() a frame.
+ */
+int dashboardBench(const SoakParams& p) {
+    remove(p.logFile.c_str());
+    rng = p.seed;
+    CountingBuf consoleBuf;
+    ostream consoleOut(&consoleBuf);
+    ReceiverCore core(p.logFile.c_str(), slotsFor(p));
+    core.journal.console = &consoleOut;
+    core.syncLog = false;
+
+    int fd = open("/dev/null", O_WRONLY);
+    SensorDashboard dashboard(fd);
+    dashboard.resize(p.sensors + 2 + DASH_STATUS_LINES, 80);
+
+    vector<SoakSensor> sensors(p.sensors);
+    for (unsigned int k = 0; k < p.sensors; k++) {
+        sensors[k] = SoakSensor{(uint16_t)(k + 1), 1, 0, 0, (float)(80 + 40 * random01()), 0};
+    }
+    printf("RPi_GatewaySoak [%s] dashboard: %u sensors every %ds for %ds, frames every %.0f ms, %u x %u screen\n",
+           VERSION, p.sensors, DASH_BENCH_INTERVAL_SECONDS, DASH_BENCH_SECONDS, dashboard.frameMicros / 1000.0,
+           p.sensors + 2 + DASH_STATUS_LINES, 80);
+    fflush(stdout);
+
+    uint64_t step = DASH_BENCH_INTERVAL_SECONDS * 1000000ULL / p.sensors;
+    uint64_t start = monoNanos() / 1000, nextPacket = 0, drawNanos = 0;
+    unsigned long n = 0;
+    uint8_t bytes[PAYLOAD_BYTES];
+    FixedLine line;
+    while (true) {
+        uint64_t now = monoNanos() / 1000;
+        if (now - start >= DASH_BENCH_SECONDS * 1000000ULL) break;
+        while (nextPacket <= now - start) {
+            SoakSensor& s = sensors[n++ % p.sensors];
+            nextPacket += step;
+            if (random01() < p.loss) {                          // Lost: the sensor counts it.
+                s.ctErrors++;
+                continue;
+            }
+            s.ctSuccess++;
+            buildPayload(bytes, s, now, retriesAt(s.paLevel));
+            core.track(bytes, PAYLOAD_BYTES);
+            core.setNextAckPayload();
+            core.logIfDue();
+            if ((core.ackPayload.command & 0xFF) == CMD_SET_PA_LEVEL) {
+                sensors[(core.ackPayload.command >> CMD_TARGET_SHIFT) - 1].paLevel = core.ackPayload.uliCmdData & 3;
+            }
+        }
+        if (dashboard.due(now)) {
+            uint64_t c0 = threadCpuNanos();
+            line.clear();
+            line.add(" rx: ").add(core.readings).add(" readings, ").add(core.unregistered).add(" unregistered");
+            dashboard.setStatus(0, line.c_str());
+            line.clear();
+            line.add(" log: ").add(core.logEntries).add(" entries, ").add(core.logBytes).add(" bytes");
+            dashboard.setStatus(1, line.c_str());
+            dashboard.draw(core.sensors, time(0), now);
+            drawNanos += threadCpuNanos() - c0;
+        }
+        usleep(DASH_BENCH_IDLE_MICROS);
+    }
+    double wall = (monoNanos() / 1000 - start) / 1e6;
+    close(fd);
+
+    size_t fullFrame = (size_t)(p.sensors + 2 + DASH_STATUS_LINES) * 80;
+    double share = 100.0 * drawNanos / 1e9 / wall;
+    bool pass = share < 1.0 && dashboard.writes <= dashboard.frames;
+    printf("  %lu packets, %lu frames (%.1f/s): %.1f us CPU a frame, %.3f%% of a core; %.2f write()s and %.0f bytes a frame"
+           " (full redraw %zu bytes)\n", core.readings, dashboard.frames, dashboard.frames / wall,
+           dashboard.frames ? drawNanos / 1e3 / dashboard.frames : 0.0, share,
+           dashboard.frames ? (double)dashboard.writes / dashboard.frames : 0.0,
+           dashboard.frames ? (double)dashboard.bytes / dashboard.frames : 0.0, fullFrame);
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* =============================================================================
+   Time stamps
+   =============================================================================
+*/
+
+    /* RPi_CapDataReceive's currTimeFormatted() before TimeStamp. */
+static string oldReceiverTime() {
+    time_t now = time(0);
+    tm localTime;
+    localtime_r(&now, &localTime);
+    char buffer[80];
+    strftime(buffer, 80, "%a %R %F", &localTime);
+    FixedLine line;
+    line.add(buffer);
+    return line.c_str();
+}
+
+    /* RPi_DummyService's getCurrTimeFormatted() before TimeStamp. */
+static string oldDummyTime() {
+    string formattedTime;
+    time_t now = time(0);
+    tm* localTime = localtime(&now);
+    char buffer[80];
+    strftime(buffer, 80, "%a %R %F", localTime);
+    formattedTime = buffer;
+    return formattedTime;
+}
+
+    /* What TimeStamp should give, the slow way. */
+static void expectedTimes(const timespec& ts, char* legacy, char* iso) {
+    tm local;
+    localtime_r(&ts.tv_sec, &local);
+    strftime(legacy, TIMESTAMP_MAX, "%a %R %F", &local);
+    size_t n = strftime(iso, TIMESTAMP_MAX, "%Y-%m-%dT%H:%M:%S", &local);
+    long offset = local.tm_gmtoff / 60;
+    snprintf(iso + n, TIMESTAMP_MAX - n, ".%03ld%c%02ld:%02ld", ts.tv_nsec / 1000000, offset < 0 ? '-' : '+',
+             labs(offset) / 60, labs(offset) % 60);
+}
+
+    /* Best of CLOCK_BENCH_ROUNDS, ns a call. */
+template <typename F> static double timeCalls(F call) {
+    double best = 0;
+    for (int round = 0; round < CLOCK_BENCH_ROUNDS; round++) {
+        uint64_t t0 = monoNanos();
+        for (int k = 0; k < CLOCK_BENCH_CALLS; k++) call();
+        double perCall = (double)(monoNanos() - t0) / CLOCK_BENCH_CALLS;
+        if (round == 0 || perCall < best) best = perCall;
+    }
+    return best;
+}
+
+
+/* Check TimeStamp's text against strftime()'s, then time it against what it
+   replaced.
+   ----------------------------------------------------------------------------
+   The check walks through 2026 in steps of a little over 2.5 minutes, so
+   every hour, every DST change and every second of the minute comes up, with
+   the milliseconds varied too, in each zone. The benchmark runs in the
+   system's own zone, TZ unset, as the services do. In the threaded runs each
+   thread's CPU time for its calls is taken, so what is shown is ns of CPU a
+   call, however many cores there are to share.
+   RETURNS: Exit status: 0 if all text matched, 1 if not.
+ */
+int clockBench() {
+    const char* zones[] = {"UTC0", "America/New_York", "Europe/London", "Australia/Lord_Howe", "Asia/Kathmandu",
+                           "America/St_Johns"};
+    unsigned long checked = 0, differ = 0;
+    char got[TIMESTAMP_MAX], legacy[TIMESTAMP_MAX], iso[TIMESTAMP_MAX];
+    const char* savedTz = getenv("TZ");
+    string tz = savedTz ? savedTz : "";
+
+    printf("RPi_GatewaySoak [%s] time stamps: %d times in each of %zu zones\n", VERSION, CLOCK_CHECK_TIMES,
+           sizeof(zones) / sizeof(zones[0]));
+    for (const char* zone : zones) {
+        setenv("TZ", zone, 1);
+        tzset();
+        TimeStamp::reset();
+        timespec ts = {1767225600, 0};                          // 2026-01-01 UTC.
+        for (int k = 0; k < CLOCK_CHECK_TIMES; k++) {
+            ts.tv_sec += 157;
+            ts.tv_nsec = (k * 7919L % 1000) * 1000000L + k % 1000000;
+            expectedTimes(ts, legacy, iso);
+            TimeStamp::legacy(ts.tv_sec, got);
+            bool bad = strcmp(got, legacy) != 0;
+            if (bad && differ < 5) printf("  %s: legacy \"%s\", strftime \"%s\"\n", zone, got, legacy);
+            TimeStamp::iso(ts, got);
+            if (strcmp(got, iso) != 0) {
+                if (differ < 5) printf("  %s: iso \"%s\", strftime \"%s\"\n", zone, got, iso);
+                bad = true;
+            }
+            checked++;
+            if (bad) differ++;
+        }
+        printf("  %-20s e.g. %s  %s\n", zone, legacy, iso);
+    }
+    if (savedTz) setenv("TZ", tz.c_str(), 1);
+    else unsetenv("TZ");
+    tzset();
+    TimeStamp::reset();
+    printf("  %lu checked, %lu differ\n", checked, differ);
+
+    ReceiverCore core("/dev/null");
+    volatile size_t sink = 0;
+    printf("  ns a call, best of %d rounds of %d:\n", CLOCK_BENCH_ROUNDS, CLOCK_BENCH_CALLS);
+    printf("  %-58s %8.1f\n", "RPi_CapDataReceive currTimeFormatted() before (string)",
+           timeCalls([&] { sink += oldReceiverTime().size(); }));
+    printf("  %-58s %8.1f\n", "RPi_DummyService getCurrTimeFormatted() before (string)",
+           timeCalls([&] { sink += oldDummyTime().size(); }));
+    printf("  %-58s %8.1f\n", "ReceiverCore::currTimeFormatted() now (string)",
+           timeCalls([&] { sink += core.currTimeFormatted().size(); }));
+    printf("  %-58s %8.1f\n", "TimeStamp::legacyNow()", timeCalls([&] { sink += TimeStamp::legacyNow(got); }));
+    printf("  %-58s %8.1f\n", "TimeStamp::isoNow()", timeCalls([&] { sink += TimeStamp::isoNow(got); }));
+
+    for (int kind = 0; kind < 2; kind++) {
+        atomic<uint64_t> total{0};
+        vector<thread> threads;
+        for (int t = 0; t < CLOCK_BENCH_THREADS; t++) {
+            threads.emplace_back([&, kind] {
+                char buf[TIMESTAMP_MAX];
+                size_t n = 0;
+                uint64_t t0 = threadCpuNanos();
+                for (int k = 0; k < CLOCK_BENCH_CALLS; k++) n += kind ? TimeStamp::isoNow(buf) : oldReceiverTime().size();
+                total += threadCpuNanos() - t0;
+                sink += n;
+            });
+        }
+        for (thread& t : threads) t.join();
+        char name[80];
+        snprintf(name, sizeof(name), "%s, %d threads at once", kind ? "TimeStamp::isoNow()" : "currTimeFormatted() before",
+                 CLOCK_BENCH_THREADS);
+        printf("  %-58s %8.1f\n", name, (double)total / CLOCK_BENCH_THREADS / CLOCK_BENCH_CALLS);
+    }
+    printf("%s\n", differ ? "FAIL" : "PASS");
+    return differ ? 1 : 0;
+}
+
+
+/* =============================================================================
+   Sensor clock estimator check
+   =============================================================================
+*/
+
+struct SkewSensor {
+    SoakSensor s;
+    double skew;                        // Rate off the wall clock, less the daily wander.
+    double phase;                       // Of the daily wander, radians.
+    double offsetMs;                    // millis() at the start, from a boot before it.
+    double bootSeconds;                 // When it last booted; 0 = before the start.
+    double rebootSeconds;
+    bool announces;                     // Says it rebooted (bootAckMillis 0).
+    bool justBooted;
+    uint64_t sentMicros;                // The packet on its way.
+    uint32_t sentTime;
+    bool sentLate;
+};
+
+    /* The simulated sensor's millis(), and its rate, at t seconds. */
+static double skewRate(const SkewSensor& k, double t) {
+    const double w = 2 * M_PI / 86400;
+    return 1 + k.skew + SKEW_CHECK_WANDER_PPM * 1e-6 * sin(w * t + k.phase);
+}
+static uint32_t skewMillis(const SkewSensor& k, double t) {
+    const double w = 2 * M_PI / 86400, a = SKEW_CHECK_WANDER_PPM * 1e-6;
+    auto f = [&](double t) { return t * (1 + k.skew) - a * cos(w * t + k.phase) / w; };
+    double ms = (f(t) - f(k.bootSeconds)) * 1000 + (k.bootSeconds == 0 ? k.offsetMs : 0);
+    return (uint32_t)(uint64_t)ms;                              // millis() wraps at 2^32.
+}
+
+static double percentile(vector<double>& v, double p) {
+    if (v.empty()) return 0;
+    sort(v.begin(), v.end());
+    return v[(size_t)(p * (v.size() - 1))];
+}
+
+
+/* Check SensorClock against simulated drifting sensor clocks.
+   ----------------------------------------------------------------------------
+   Packets go through ReceiverCore, so it is the receiver's own use of the
+   estimator that is checked, restart() on bootAckMillis and all. Each sensor's
+   send is an event, and so is its packet's arrival; arrivals are tracked in
+   the order they come in. The estimate checked is SensorClock::toWall() of
+   the packet's sensorTime just after it is tracked, which is what the log
+   line's SampleTime is.
+   RETURNS: Exit status: 0 if it all came within the limits, 1 if not.
+ */
+int sensorClockCheck(const SoakParams& p) {
+    rng = p.seed * 2654435761ULL;
+    simStart = time(0);
+    simMicros = 0;
+
+    CountingBuf consoleBuf;
+    ostream consoleOut(&consoleBuf);
+    ReceiverCore core("/dev/null", p.sensors);
+    core.clock = simClock;
+    core.clockMillis = simClockMillis;
+    core.journal.console = &consoleOut;
+    core.logInterval = (time_t)1 << 40;
+    core.syncLog = false;
+
+    uint64_t interval = (uint64_t)(p.intervalSeconds * 1e6);
+    uint64_t jitter = (uint64_t)(p.jitterSeconds * 1e6);
+    uint64_t endMicros = (uint64_t)(SKEW_CHECK_DAYS * 86400e6);
+    vector<SkewSensor> sensors(p.sensors);
+    typedef pair<uint64_t, uint32_t> Due;      // (when, sensor | ARRIVES)
+    const uint32_t ARRIVES = 0x80000000;
+    priority_queue<Due, vector<Due>, greater<Due>> due;
+    for (unsigned int n = 0; n < p.sensors; n++) {
+        SkewSensor& k = sensors[n];
+        memset(&k, 0, sizeof(k));
+        k.s.id = n + 1;
+        k.s.paLevel = 3;
+        k.s.capBase = 100;
+        k.skew = (random01() * 2 - 1) * SKEW_CHECK_PPM * 1e-6;
+        k.phase = random01() * 2 * M_PI;
+        k.offsetMs = random01() * 4294967296.0;
+        k.rebootSeconds = (0.25 + random01() * 0.5) * SKEW_CHECK_DAYS * 86400;
+        k.announces = (n % 2 == 0);
+        due.push(Due((uint64_t)(random01() * interval), n));
+    }
+
+    vector<double> promptMs, lateMs, skewPpm;
+    unsigned long packets = 0, lost = 0, unfitted = 0, wraps = 0, received = 0;
+    vector<uint32_t> lastRaw(p.sensors, 0);
+    vector<bool> heard(p.sensors, false);
+    uint8_t bytes[PAYLOAD_BYTES];
+    while (!due.empty() && due.top().first < endMicros) {
+        Due d = due.top();
+        due.pop();
+        SkewSensor& k = sensors[d.second & ~ARRIVES];
+        double t = d.first / 1e6;
+
+        if (!(d.second & ARRIVES)) {
+            if (k.bootSeconds == 0 && t >= k.rebootSeconds) {
+                k.bootSeconds = t - 1.2;                        // It booted and got its 1st ACK just now.
+                k.justBooted = true;
+            }
+            packets++;
+            if (random01() < p.loss) {
+                k.s.ctErrors++;
+                lost++;
+            } else {
+                bool late = random01() < 1.0 / SKEW_CHECK_LATE_EVERY;
+                double delay = late ? 0.5 + random01() * (SKEW_CHECK_LATE_SECONDS - 0.5) : 0.001 + random01() * 0.004;
+                k.sentMicros = d.first;
+                k.sentTime = skewMillis(k, t);
+                k.sentLate = late;
+                due.push(Due(d.first + (uint64_t)(delay * 1e6), d.second | ARRIVES));
+            }
+            int64_t j = jitter ? (int64_t)(random01() * 2 * jitter) - (int64_t)jitter : 0;
+            due.push(Due(d.first + interval + j, d.second));
+            continue;
+        }
+
+            /* It arrives. */
+        unsigned int n = d.second & ~ARRIVES;
+        simMicros = d.first;
+        buildPayload(bytes, k.s, k.sentMicros, 0);
+        uint16_t bootAck = (k.justBooted && k.announces) ? 0 : 1200;
+        memcpy(&bytes[4], &k.sentTime, 4);
+        memcpy(&bytes[24], &bootAck, 2);
+        if (heard[n] && !k.justBooted && k.sentTime < lastRaw[n]) wraps++;
+        heard[n] = true;
+        lastRaw[n] = k.sentTime;
+        k.justBooted = false;
+        k.s.ctSuccess++;
+        core.track(bytes, PAYLOAD_BYTES);
+        received++;
+
+        SensorState* st = core.sensors.lookup(k.s.id);
+        if (!SensorClock::hasFit(st->clock)) {
+            unfitted++;
+            continue;
+        }
+        int64_t truth = (int64_t)simStart * 1000 + (int64_t)(k.sentMicros / 1000);
+        double error = (double)llabs(SensorClock::toWall(st->clock, k.sentTime) - truth);
+        (k.sentLate ? lateMs : promptMs).push_back(error);
+        skewPpm.push_back(fabs(st->clock.skewPpm - (skewRate(k, k.sentMicros / 1e6) - 1) * 1e6));
+    }
+
+    unsigned long seenReboots = 0, seenWraps = 0;
+    for (unsigned int n = 0; n < p.sensors; n++) {
+        SensorState* st = core.sensors.lookup(n + 1);
+        seenReboots += st->clock.reboots;
+        seenWraps += st->clock.wraps;
+    }
+
+    printf("RPi_GatewaySoak [%s] sensor clocks: %u sensors, %d days, %.0fs interval +/-%.0fs, skew +/-%dppm "
+           "wandering +/-%dppm a day, 1 in %d late by up to %ds\n", VERSION, p.sensors, SKEW_CHECK_DAYS,
+           p.intervalSeconds, p.jitterSeconds, SKEW_CHECK_PPM, SKEW_CHECK_WANDER_PPM, SKEW_CHECK_LATE_EVERY,
+           SKEW_CHECK_LATE_SECONDS);
+    printf("  %lu packets, %lu lost, %lu before a fit\n", packets, lost, unfitted);
+    size_t nPrompt = promptMs.size(), nLate = lateMs.size(), nSkew = skewPpm.size();
+    double promptP99 = percentile(promptMs, 0.99), lateP99 = percentile(lateMs, 0.99), skewP99 = percentile(skewPpm, 0.99);
+    printf("  %-28s %8s %9s %9s %9s %9s\n", "send time error, ms", "packets", "p50", "p99", "p99.9", "max");
+    printf("  %-28s %8zu %9.1f %9.1f %9.1f %9.1f\n", "came straight through", nPrompt, percentile(promptMs, 0.5),
+           promptP99, percentile(promptMs, 0.999), percentile(promptMs, 1));
+    printf("  %-28s %8zu %9.1f %9.1f %9.1f %9.1f\n", "came in late", nLate, percentile(lateMs, 0.5), lateP99,
+           percentile(lateMs, 0.999), percentile(lateMs, 1));
+    printf("  %-28s %8zu %9.1f %9.1f %9.1f %9.1f\n", "skew error, ppm", nSkew, percentile(skewPpm, 0.5), skewP99,
+           percentile(skewPpm, 0.999), percentile(skewPpm, 1));
+    printf("  wraps %lu seen of %lu, reboots %lu seen of %u\n", seenWraps, wraps, seenReboots, p.sensors);
+
+    bool pass = true;
+    if (promptP99 > SKEW_CHECK_PROMPT_MS || lateP99 > SKEW_CHECK_LATE_MS) {
+        printf("  FAIL: send time p99 over %dms (straight through) or %dms (late)\n", SKEW_CHECK_PROMPT_MS,
+               SKEW_CHECK_LATE_MS);
+        pass = false;
+    }
+    if (skewP99 > SKEW_CHECK_SKEW_PPM) {
+        printf("  FAIL: skew p99 over %dppm out\n", SKEW_CHECK_SKEW_PPM);
+        pass = false;
+    }
+    if (seenWraps != wraps || seenReboots != p.sensors) {
+        printf("  FAIL: wraps or reboots\n");
+        pass = false;
+    }
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* =============================================================================
+   In-memory history benchmark
+   =============================================================================
+*/
+
+    /* The capacitances in the archived receiver output, in order. The
+       receivers of the time showed them either as a number ("capacitance:
+       48.6953") or with the payload bytes ("capacitance:  4 | 49 | 0x 00 c8
+       42 42"), whose float is the true one. */
+static vector<float> archiveReadings() {
+    const char* files[] = {"CapDataReceive_02a_Output.txt", "CapDataReceive_02b_Output.txt",
+                           "CapDataReceive_02c_Output.txt"};
+    vector<float> v;
+    for (const char* name : files) {
+        string path = string(HISTORY_ARCHIVE_DIR) + "/" + name;
+        FILE* f = fopen(path.c_str(), "r");
+        if (!f) continue;
+        char line[512];
+        while (fgets(line, sizeof(line), f)) {
+            const char* c = strstr(line, "capacitance:");
+            if (!c) continue;
+            const char* hex = strstr(c, "0x");
+            if (hex) {
+                uint8_t b[4];
+                if (sscanf(hex + 2, "%hhx %hhx %hhx %hhx", &b[0], &b[1], &b[2], &b[3]) != 4) continue;
+                float cap;
+                memcpy(&cap, b, 4);
+                v.push_back(cap);
+            } else {
+                char* end;
+                float cap = strtof(c + strlen("capacitance:"), &end);
+                if (end != c + strlen("capacitance:")) v.push_back(cap);
+            }
+        }
+        fclose(f);
+    }
+    return v;
+}
+
+    /* A reading as the tiny84 works it out: ten ADC readings of the divider
+       the probe makes with the stray capacitance, +/-1 count, averaged. */
+static float tinyReading(double cap) {
+    float sum = 0;
+    for (int k = 0; k < 10; k++) {
+        int adc = (int)lround(1023 * cap / (cap + 24.48) + (random01() * 2 - 1));
+        sum += (float)(adc * 24.48f) / (float)(1023 - adc);
+    }
+    return sum / 10;
+}
+
+struct HistoryPoint {
+    unsigned int slot;
+    time_t t;
+    float cap;
+};
+
+    /* Pack the points, read them back and check them, and time both. */
+static bool historyRun(const char* name, const vector<HistoryPoint>& points, unsigned int slots, unsigned int mantissaBits) {
+    SensorHistory history(slots);
+    history.mantissaBits = mantissaBits;
+    uint64_t t0 = monoNanos();
+    for (const HistoryPoint& pt : points) history.append(pt.slot, pt.t, pt.cap);
+    double appendNs = (double)(monoNanos() - t0) / points.size();
+
+        /* Every point back, in order, the last ones of each slot if any were
+           dropped for room. Values to within the bits kept. */
+    vector<vector<const HistoryPoint*>> bySlot(slots);
+    for (const HistoryPoint& pt : points) bySlot[pt.slot].push_back(&pt);
+    unsigned long wrong = 0, read = 0;
+    double tolerance = ldexp(1.0, -(int)mantissaBits);
+    for (unsigned int s = 0; s < slots; s++) {
+        size_t i = bySlot[s].size() - history.points(s);
+        read += history.forEach(s, 0, (time_t)UINT32_MAX, [&](time_t t, float cap) {
+            const HistoryPoint* want = (i < bySlot[s].size()) ? bySlot[s][i] : NULL;
+            if (!want || t != want->t || fabs(cap - want->cap) > fabs(want->cap) * tolerance) wrong++;
+            i++;
+        });
+    }
+    double best = 0;
+    volatile double sink = 0;
+    for (int round = 0; round < HISTORY_BENCH_ROUNDS; round++) {
+        double sum = 0;
+        unsigned long n = 0;
+        uint64_t r0 = monoNanos();
+        for (unsigned int s = 0; s < slots; s++) {
+            n += history.forEach(s, 0, (time_t)UINT32_MAX, [&](time_t, float cap) { sum += cap; });
+        }
+        double perPoint = (double)(monoNanos() - r0) / (n ? n : 1);
+        if (round == 0 || perPoint < best) best = perPoint;
+        sink = sink + sum;
+    }
+
+    double bytesPerPoint = (double)history.bytes() / (read ? read : 1);
+    printf("  %-22s %9lu %6u %9.2f %9.1f %9.2f %9.1f %8lu %7lu\n", name, read, mantissaBits, bytesPerPoint, appendNs,
+           best, 1e3 / best, history.reclaimed, wrong);
+    bool pass = true;
+    if (wrong) {
+        printf("  FAIL: %lu points read back wrong\n", wrong);
+        pass = false;
+    }
+    if (1e3 / best < HISTORY_BENCH_MIN_MPOINTS) {
+        printf("  FAIL: reading under %d million points a second\n", HISTORY_BENCH_MIN_MPOINTS);
+        pass = false;
+    }
+    if (bytesPerPoint > HISTORY_POINT_BYTES) {
+        printf("  FAIL: over the %d bytes a point the pool is sized for\n", HISTORY_POINT_BYTES);
+        pass = false;
+    }
+    return pass;
+}
+
+
+/* Measure SensorHistory's packing and reading on archived and simulated
+   readings.
+   ----------------------------------------------------------------------------
+   Each set is HISTORY_DAYS of readings for each sensor, all in the order
+   they would come in, so the sensors' appends are interleaved as on the
+   gateway. Only the appends are timed, not making the readings.
+   RETURNS: Exit status: 0 if all passed, 1 if not.
+ */
+int historyBench(const SoakParams& p) {
+    rng = p.seed * 2654435761ULL;
+    vector<float> archive = archiveReadings();
+    uint64_t interval = (uint64_t)(p.intervalSeconds * 1e6);
+    uint64_t jitter = (uint64_t)(p.jitterSeconds * 1e6);
+    unsigned long perSensor = (unsigned long)(HISTORY_DAYS * 86400.0 / p.intervalSeconds);
+    time_t start = time(0);
+
+    printf("RPi_GatewaySoak [%s] history: %u sensors, %d days, %.0fs interval +/-%.0fs; %zu archived readings in %s\n",
+           VERSION, p.sensors, HISTORY_DAYS, p.intervalSeconds, p.jitterSeconds, archive.size(), HISTORY_ARCHIVE_DIR);
+    printf("  %-22s %9s %6s %9s %9s %9s %9s %8s %7s\n", "readings", "points", "bits", "bytes/pt", "append ns", "read ns",
+           "Mpt/s", "reclaim", "wrong");
+
+    bool pass = true;
+    for (int set = 0; set < 2; set++) {
+        if (set == 0 && archive.empty()) {
+            printf("  (no archived output in %s: run from Software/RPi)\n", HISTORY_ARCHIVE_DIR);
+            pass = false;
+            continue;
+        }
+        vector<HistoryPoint> points;
+        points.reserve(perSensor * p.sensors);
+        vector<uint64_t> due(p.sensors);
+        vector<double> base(p.sensors);
+        for (unsigned int s = 0; s < p.sensors; s++) {
+            due[s] = (uint64_t)(random01() * interval);
+            base[s] = 80 + 40 * random01();
+        }
+        for (unsigned long k = 0; k < perSensor; k++) {
+            for (unsigned int s = 0; s < p.sensors; s++) {
+                float cap;
+                if (set == 0) {
+                    cap = archive[(k + s * 7) % archive.size()];
+                } else {
+                    double days = due[s] / 86400e6;
+                    cap = tinyReading(base[s] + 5 * sin(days * 2 * M_PI));
+                }
+                points.push_back({s, start + (time_t)(due[s] / 1000000), cap});
+                int64_t j = jitter ? (int64_t)(random01() * 2 * jitter) - (int64_t)jitter : 0;
+                due[s] += interval + j;
+            }
+        }
+        const char* name = set ? "watering cycle (tiny84)" : "archived output";
+        pass &= historyRun(name, points, p.sensors, HISTORY_MANTISSA_BITS);
+        pass &= historyRun(name, points, p.sensors, HISTORY_LOSSY_MANTISSA_BITS);
+    }
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* =============================================================================
+   Rollup benchmark
+   =============================================================================
+*/
+
+struct RollupQuery {
+    const char* name;
+    time_t seconds;                     // Back from the newest reading.
+    unsigned int points;
+};
+static const RollupQuery ROLLUP_BENCH_QUERIES[] = {
+    {"year in 1000", 365 * 86400, 1000},
+    {"quarter in 1000", 91 * 86400, 1000},
+    {"month in 1000", 30 * 86400, 1000},
+    {"week in 500", 7 * 86400, 500},
+    {"day in 96", 86400, 96},
+};
+
+typedef pair<time_t, float> RawReading;
+
+    /* The raw readings a RollupPoint covers, summed up the slow way. */
+static RollupPoint rawRollup(const vector<RawReading>& raw, time_t start, time_t end) {
+    RollupPoint p = {start, end - start, 0, 0, 0, 0, 0};
+    auto it = lower_bound(raw.begin(), raw.end(), RawReading(start, -INFINITY));
+    for (; it != raw.end() && it->first < end; ++it) {
+        if (p.count == 0 || it->second < p.min) p.min = it->second;
+        if (p.count == 0 || it->second > p.max) p.max = it->second;
+        p.count++;
+        p.sum += it->second;
+        p.sumSquares += (double)it->second * it->second;
+    }
+    return p;
+}
+
+static bool sameRollup(const RollupPoint& a, const RollupPoint& b) {
+    return a.count == b.count && a.min == b.min && a.max == b.max && fabs(a.sum - b.sum) <= 1e-9 * fabs(b.sum)
+           && fabs(a.sumSquares - b.sumSquares) <= 1e-9 * fabs(b.sumSquares);
+}
+
+    /* A year of readings for n sensors every interval seconds, into a
+       SensorRollup, then each query on each. */
+static bool rollupRun(const SoakParams& p, unsigned int n, double intervalSeconds) {
+    uint64_t interval = (uint64_t)(intervalSeconds * 1e6);
+    uint64_t jitter = (uint64_t)(min(p.jitterSeconds, intervalSeconds / 4) * 1e6);
+    uint64_t endMicros = 365 * 86400e6;
+    time_t start = time(0) - 365 * 86400;
+    vector<vector<RawReading>> raw(n);
+    vector<uint64_t> due(n);
+    vector<double> base(n);
+    for (unsigned int s = 0; s < n; s++) {
+        due[s] = (uint64_t)(random01() * interval);
+        base[s] = 80 + 40 * random01();
+        raw[s].reserve((size_t)(endMicros / interval) + 1);
+    }
+    unsigned long readings = 0;
+    for (bool more = true; more;) {                                 // Round the sensors, one reading each.
+        more = false;
+        for (unsigned int s = 0; s < n; s++) {
+            if (due[s] >= endMicros) continue;
+            double days = due[s] / 86400e6;
+            float cap = (float)(base[s] + 5 * sin(days * 2 * M_PI) + 10 * sin(days * 2 * M_PI / 365) + random01() - 0.5);
+            raw[s].push_back(RawReading(start + (time_t)(due[s] / 1000000), cap));
+            int64_t j = jitter ? (int64_t)(random01() * 2 * jitter) - (int64_t)jitter : 0;
+            due[s] += interval + j;
+            readings++;
+            more = true;
+        }
+    }
+
+    string rollupPath = p.logFile + ".rollup";
+    remove(rollupPath.c_str());
+    SensorRollup rollup(n);
+    if (!rollup.open(rollupPath.c_str())) {
+        printf("    FAIL: couldn't open %s\n", rollupPath.c_str());
+        return false;
+    }
+    vector<size_t> next(n, 0);
+    uint64_t t0 = monoNanos();
+    for (bool more = true; more;) {
+        more = false;
+        for (unsigned int s = 0; s < n; s++) {
+            if (next[s] == raw[s].size()) continue;
+            const RawReading& r = raw[s][next[s]++];
+            rollup.add(s, (uint16_t)(s + 1), r.first, r.second);
+            more = true;
+        }
+    }
+    double addNs = (double)(monoNanos() - t0) / readings;
+    printf("  %u sensors, a reading every %.0fs: %lu readings, %.1f ns to add one; %u slots in use, %zu KB\n", n,
+           intervalSeconds, readings, addNs, rollup.slotsInUse(), rollup.bytes() / 1024);
+    printf("    %-16s %6s %7s %10s %10s %9s\n", "query", "level", "points", "us", "scan us", "wrong");
+
+    bool pass = true;
+    for (const RollupQuery& q : ROLLUP_BENCH_QUERIES) {
+        double best = 0, scanBest = 0;
+        unsigned long points = 0, wrong = 0;
+        int level = -1;
+        volatile double sink = 0;
+        for (int round = 0; round < ROLLUP_BENCH_ROUNDS; round++) {
+            uint64_t r0 = monoNanos();
+            for (unsigned int s = 0; s < n; s++) {
+                time_t to = raw[s].back().first, from = to - q.seconds;
+                double sum = 0;
+                points += rollup.query(s, from, to, q.points, [&](const RollupPoint& pt) { sum += pt.mean(); });
+                sink = sink + sum;
+            }
+            double perQuery = (double)(monoNanos() - r0) / n / 1000;
+            if (round == 0 || perQuery < best) best = perQuery;
+
+                /* What it would take without them: go through the raw readings
+                   in range, into as many bins. */
+            r0 = monoNanos();
+            for (unsigned int s = 0; s < n; s++) {
+                time_t to = raw[s].back().first, from = to - q.seconds, step = q.seconds / q.points;
+                vector<RollupPoint> bins(q.points + 1, RollupPoint{0, 0, 0, 0, 0, 0, 0});
+                auto it = lower_bound(raw[s].begin(), raw[s].end(), RawReading(from, -INFINITY));
+                for (; it != raw[s].end() && it->first <= to; ++it) {
+                    RollupPoint& b = bins[(it->first - from) / step];
+                    b.count++;
+                    b.sum += it->second;
+                }
+                sink = sink + bins[0].sum;
+            }
+            double scan = (double)(monoNanos() - r0) / n / 1000;
+            if (round == 0 || scan < scanBest) scanBest = scan;
+        }
+        points /= ROLLUP_BENCH_ROUNDS;
+
+        for (unsigned int s = 0; s < n; s++) {                      // Every point, against the raw readings.
+            time_t to = raw[s].back().first, from = to - q.seconds;
+            level = rollup.levelFor(s, from, to, q.points);
+            rollup.query(s, from, to, q.points, [&](const RollupPoint& pt) {
+                if (!sameRollup(pt, rawRollup(raw[s], pt.start, pt.start + pt.seconds))) wrong++;
+            });
+        }
+        const char* levels[ROLLUP_LEVELS] = {"15min", "hour", "8hour", "week"};
+        printf("    %-16s %6s %7.0f %10.2f %10.2f %9lu\n", q.name, level >= 0 ? levels[level] : "-", (double)points / n,
+               best, scanBest, wrong);
+        if (wrong) pass = false;
+        if (q.seconds == 365 * 86400 && best > ROLLUP_BENCH_MAX_MICROS) {
+            printf("    FAIL: a year's query over %dus\n", ROLLUP_BENCH_MAX_MICROS);
+            pass = false;
+        }
+        if (q.seconds == 365 * 86400 && (level < 0 || SensorRollup::bucketSeconds(level) > q.seconds / q.points)) {
+            printf("    FAIL: a year's query in buckets coarser than its %u points\n", q.points);
+            pass = false;
+        }
+    }
+
+        /* What a restart, or RPi_CapDataReceive -q, gets back from the file. */
+    SensorRollup reopened(n);
+    unsigned long differ = 0;
+    bool opened = reopened.open(rollupPath.c_str(), true);
+    for (unsigned int s = 0; opened && s < n; s++) {
+        if (reopened.slotOf((uint16_t)(s + 1)) != (int)s) differ++;
+        for (const RollupQuery& q : ROLLUP_BENCH_QUERIES) {
+            time_t to = raw[s].back().first, from = to - q.seconds;
+            vector<RollupPoint> expect;
+            rollup.query(s, from, to, q.points, [&](const RollupPoint& pt) { expect.push_back(pt); });
+            size_t k = 0;
+            reopened.query(s, from, to, q.points, [&](const RollupPoint& pt) {
+                if (k >= expect.size() || pt.start != expect[k].start || !sameRollup(pt, expect[k])) differ++;
+                k++;
+            });
+            if (k != expect.size()) differ++;
+        }
+    }
+    printf("    reopened read only: %s, %u slots in use, %lu differ\n", opened ? "ok" : "FAILED",
+           reopened.slotsInUse(), differ);
+    if (!opened || reopened.fresh() || reopened.slotsInUse() != n || differ) pass = false;
+    remove(rollupPath.c_str());
+    if (!pass) printf("    FAIL\n");
+    return pass;
+}
+
+
+/* Measure SensorRollup: adding readings, and queries over each level,
+   against scanning the raw readings.
+   ----------------------------------------------------------------------------
+   The readings are a daily watering cycle on a yearly drift, with noise.
+   A reading's jitter is kept under a quarter of the interval, so readings
+   stay in order. The raw readings are kept in a sorted vector and found by
+   binary search, so the scan is the best a raw scan could do.
+   RETURNS: Exit status: 0 if all passed, 1 if not.
+ */
+int rollupBench(const SoakParams& p) {
+    rng = p.seed * 2654435761ULL;
+    double maxMB = (double)SensorRollup::slotBytes() * MAX_SENSORS / (1024 * 1024);
+    printf("RPi_GatewaySoak [%s] rollups: levels of 15 min, 1 hour, 8 hours, 1 week, keeping %u, %u, %u, %u "
+           "buckets, %zu bytes a sensor, %.0f MB for MAX_SENSORS (%d)\n", VERSION, SensorRollup::bucketsKept(0),
+           SensorRollup::bucketsKept(1), SensorRollup::bucketsKept(2), SensorRollup::bucketsKept(3),
+           SensorRollup::slotBytes(), maxMB, MAX_SENSORS);
+    bool pass = maxMB <= ROLLUP_BENCH_MAX_MB;
+    if (!pass) printf("  FAIL: over %d MB\n", ROLLUP_BENCH_MAX_MB);
+    pass &= rollupRun(p, p.sensors, p.intervalSeconds);
+    pass &= rollupRun(p, ROLLUP_BENCH_FAST_SENSORS, ROLLUP_BENCH_FAST_SECONDS);
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* =============================================================================
+   Power control check
+   =============================================================================
+*/
+
+    /* Chance one transmit attempt is lost at a margin (dB) over the RPi's
+       receive sensitivity: half at 0dB, ten times less every PC_CHECK_SLOPE_DB
+       above that, ten times more likely to get through every PC_CHECK_SLOPE_DB below. */
+static double attemptLoss(double marginDb) {
+    return 1.0 / (1.0 + pow(10.0, marginDb / PC_CHECK_SLOPE_DB));
+}
+
+static double marginAt(int pathLossDb, uint8_t paLevel) {
+    return -18 + 6 * paLevel - pathLossDb - PC_CHECK_SENSITIVITY_DBM;
+}
+
+static double meanRetransmits(int pathLossDb, uint8_t paLevel) {
+    double q = attemptLoss(marginAt(pathLossDb, paLevel));
+    return q / (1 - q);
+}
+
+    /* The lowest PA level whose mean retransmits per packet are under the
+       step-up threshold: where the loop should end up. */
+static uint8_t lowestWorkingLevel(int pathLossDb) {
+    uint8_t level = PC_MIN_LEVEL;
+    while (level < PC_MAX_LEVEL && meanRetransmits(pathLossDb, level) > PC_STEP_UP_THRESHOLD) level++;
+    return level;
+}
+
+    /* One way of setting the sensors' PA level, run at every path loss. */
+struct PowerRun {
+    const char* name;
+    int fixedLevel;                     // -1: the sensor obeys the RPi's PA commands.
+    bool hysteresis;
+    unsigned long readings = 0, delivered = 0, attempts = 0;
+    double microJoules = 0;
+    unsigned long settled = 0;          // 2nd half: sensors mostly at the level they should be ...
+    unsigned long changes = 0;          // ... PA changes ...
+    unsigned int maxChanges = 0;        // ... and the most any one sensor made.
+};
+
+    /* One sensor at one path loss, alone with a ReceiverCore for
+       PC_CHECK_READINGS readings, so every ACK payload is its own. */
+static void powerRun(const SoakParams& p, PowerRun& run, int pathLossDb) {
+    remove(p.logFile.c_str());
+    simStart = time(0);
+    simMicros = 0;
+
+    CountingBuf consoleBuf;
+    ostream consoleOut(&consoleBuf);
+    ReceiverCore core(p.logFile.c_str(), 1);
+    core.clock = simClock;
+    core.clockMillis = simClockMillis;
+    core.journal.console = &consoleOut;
+    core.syncLog = false;
+    if (!run.hysteresis) {                      // One threshold, and act on every packet.
+        core.powerControl.stepUpThreshold = PC_CHECK_NO_HYSTERESIS;
+        core.powerControl.stepDownThreshold = PC_CHECK_NO_HYSTERESIS;
+        core.powerControl.holdPackets = 1;
+        core.powerControl.settlePackets = 0;
+        core.powerControl.maxBackoff = 0;
+    }
+
+    SoakSensor s;
+    s.id = 1;
+    s.paLevel = run.fixedLevel >= 0 ? run.fixedLevel : 1;          // RF24_PA_LOW
+    s.ctSuccess = 0;
+    s.ctErrors = 0;
+    s.capBase = 100;
+    s.bootMicros = 0;
+    uint64_t interval = (uint64_t)(p.intervalSeconds * 1e6);
+    unsigned long lateAt[PC_MAX_LEVEL + 1] = {0};                  // Readings at each level in the 2nd half.
+    unsigned int changes = 0;
+    uint8_t bytes[PAYLOAD_BYTES];
+    AckPayloadStruct heard = {CMD_NONE, 0};     // ACK payload loaded after the last packet.
+
+    for (unsigned int r = 0; r < PC_CHECK_READINGS; r++) {
+        bool late = r >= PC_CHECK_READINGS / 2;
+        simMicros = (uint64_t)r * interval;
+        run.readings++;
+        if (late) lateAt[s.paLevel]++;
+
+            /* write()s, each the first attempt and up to PC_ARC_MAX retransmits,
+               one every RadioComms _txWaitDelay until one is ACK'd. */
+        double q = attemptLoss(marginAt(pathLossDb, s.paLevel));
+        unsigned int attempts = 0, writes = 0;
+        bool acked = false;
+        while (!acked && writes < PC_CHECK_MAX_WRITES) {
+            writes++;
+            for (unsigned int a = 0; !acked && a <= PC_ARC_MAX; a++) {
+                attempts++;
+                acked = random01() >= q;
+            }
+            if (!acked) s.ctErrors++;
+        }
+        run.attempts += attempts;
+        run.microJoules += attempts * PowerController::attemptMicroJoules(s.paLevel);
+        if (!acked) continue;
+        run.delivered++;
+        buildPayload(bytes, s, simMicros, (attempts - 1) % (PC_ARC_MAX + 1));
+        s.ctSuccess++;
+        if (core.track(bytes, PAYLOAD_BYTES)) core.logIfDue();
+        core.setNextAckPayload();
+
+            /* The ACK brought back what was loaded after the last packet. */
+        if (run.fixedLevel < 0 && (heard.command & 0xFF) == CMD_SET_PA_LEVEL &&
+            (heard.command >> CMD_TARGET_SHIFT) == s.id && s.paLevel != (heard.uliCmdData & 3)) {
+            s.paLevel = heard.uliCmdData & 3;
+            if (late) changes++;
+        }
+        heard = core.ackPayload;
+    }
+
+        /* Mostly at the lowest working level; or one above, if that level's
+           mean is within a quarter of the threshold, where the smoothed
+           figure's noise (about 0.13 at a mean of 0.2) crosses it now and then. */
+    uint8_t most = PC_MIN_LEVEL;
+    for (uint8_t level = PC_MIN_LEVEL + 1; level <= PC_MAX_LEVEL; level++) if (lateAt[level] > lateAt[most]) most = level;
+    uint8_t want = lowestWorkingLevel(pathLossDb);
+    bool edge = meanRetransmits(pathLossDb, want) > PC_STEP_UP_THRESHOLD / 4;
+    if (most == want || (edge && most == want + 1)) run.settled++;
+    run.changes += changes;
+    if (changes > run.maxChanges) run.maxChanges = changes;
+}
+
+
+/* Check the power control loop against sensors at known path losses.
+   ----------------------------------------------------------------------------
+   A deterministic path loss model: a sensor PC_CHECK_MIN_LOSS_DB to
+   PC_CHECK_MAX_LOSS_DB from the RPi, 1dB apart, transmits at -18 + 6 x PA level
+   dBm, and each attempt's chance of getting through follows its margin over
+   PC_CHECK_SENSITIVITY_DBM (attemptLoss()). The losses are fixed and the only
+   randomness is the seeded generator, so a seed always gives the same result.
+   The ACK is taken to always get back. Each path loss is run four ways: under
+   the loop as the receiver runs it, under the loop with no hysteresis, and at
+   fixed LOW (what the sensors did before power control) and fixed MAX. It
+   checks, over the 2nd half of each run:
+     > convergence: every sensor is mostly at its lowest working level;
+     > hysteresis: no sensor changes level more than PC_CHECK_MAX_CHANGES
+       times, and the loop makes under a tenth of the changes it makes
+       without hysteresis;
+     > energy: uJ per delivered packet (PowerController::attemptMicroJoules()
+       for every attempt) is under fixed LOW's and no more than
+       PC_CHECK_MAX_OVER_FIXED times fixed MAX's, delivering within 0.1% as
+       many.
+   RETURNS: Exit status: 0 if all passed, 1 if not.
+ */
+int powerCheck(const SoakParams& p) {
+    PowerRun runs[4];
+    runs[0].name = "closed loop";   runs[0].fixedLevel = -1; runs[0].hysteresis = true;
+    runs[1].name = "no hysteresis"; runs[1].fixedLevel = -1; runs[1].hysteresis = false;
+    runs[2].name = "fixed LOW";     runs[2].fixedLevel = 1;  runs[2].hysteresis = true;
+    runs[3].name = "fixed MAX";     runs[3].fixedLevel = 3;  runs[3].hysteresis = true;
+    unsigned int losses = PC_CHECK_MAX_LOSS_DB - PC_CHECK_MIN_LOSS_DB + 1;
+    printf("RPi_GatewaySoak [%s] power control: path loss %d-%ddB, sensitivity %ddBm, %u readings at each, seed %llu\n",
+           VERSION, PC_CHECK_MIN_LOSS_DB, PC_CHECK_MAX_LOSS_DB, PC_CHECK_SENSITIVITY_DBM, PC_CHECK_READINGS,
+           (unsigned long long)p.seed);
+    printf("%-14s %9s %8s %8s %8s %9s %9s %11s\n", "run", "readings", "rxd %", "att/rdg", "uJ/pkt", "settled", "changes", "most/sensor");
+    for (PowerRun& run : runs) {
+        rng = p.seed * 2654435761ULL;
+        for (int db = PC_CHECK_MIN_LOSS_DB; db <= PC_CHECK_MAX_LOSS_DB; db++) powerRun(p, run, db);
+        char settled[16] = "-";
+        if (run.fixedLevel < 0) snprintf(settled, sizeof(settled), "%lu/%u", run.settled, losses);
+        printf("%-14s %9lu %8.2f %8.3f %8.1f %9s %9lu %11u\n", run.name, run.readings,
+               100.0 * run.delivered / run.readings, (double)run.attempts / run.readings,
+               run.microJoules / run.delivered, settled, run.changes, run.maxChanges);
+    }
+
+    const PowerRun& loop = runs[0];
+    const PowerRun& noHysteresis = runs[1];
+    const PowerRun& fixedLow = runs[2];
+    const PowerRun& fixedMax = runs[3];
+    double loopEnergy = loop.microJoules / loop.delivered;
+    bool converged = loop.settled == losses;
+    bool steady = loop.maxChanges <= PC_CHECK_MAX_CHANGES && loop.changes * 10 < noHysteresis.changes;
+    bool frugal = loopEnergy < fixedLow.microJoules / fixedLow.delivered &&
+                  loopEnergy <= PC_CHECK_MAX_OVER_FIXED * fixedMax.microJoules / fixedMax.delivered &&
+                  loop.delivered * 1000 >= fixedMax.delivered * 999;
+    printf("  converged:  %s (%lu of %u path losses mostly at the lowest working level)\n",
+           converged ? "yes" : "NO", loop.settled, losses);
+    printf("  hysteresis: %s (%lu changes, at most %u for a sensor, against %lu without)\n",
+           steady ? "holds" : "OSCILLATES", loop.changes, loop.maxChanges, noHysteresis.changes);
+    printf("  energy:     %s (%.1f uJ/pkt, fixed LOW %.1f, fixed MAX %.1f)\n", frugal ? "ok" : "TOO HIGH",
+           loopEnergy, fixedLow.microJoules / fixedLow.delivered, fixedMax.microJoules / fixedMax.delivered);
+    bool pass = converged && steady && frugal;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
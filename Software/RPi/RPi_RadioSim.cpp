@@ -0,0 +1,1422 @@
+/*  ATTiny84 Moisture Sensor Project - Simulated Sensor Network
+ *  -----------------------------------------------------------------------------------------------------
+ *
+ *  Runs a whole sensor network - N sensors and the RPi gateway - on simulated nRF24L01+ chips
+ *  (NrfSim.h), with no radio hardware. Every chip is driven through its SPI registers the way the
+ *  real code drives it:
+ *      > Each sensor node programs its chip with the same register values as the tiny84's
+ *        Nrf24Lite driver, and sends a 32 byte reading every interval (write the payload, hold CE
+ *        high until TX_DS or MAX_RT, read back the ACK payload).
+ *      > The gateway is set up as RPi_CapDataReceive sets up its radio, and takes packets off the
+ *        chip with the very same NrfSpiBatch code (SpiBatch.h), reloading an ACK payload with
+ *        each one.
+ *  A sensor reacts to its chip's IRQ after a short delay, as the tiny84 polling STATUS in
+ *  write() would. The gateway polls its chip every GATEWAY_POLL_MICROS, as slave()'s loop does.
+ *
+ *  As the tiny84's RadioComms does, a sensor whose write() fails (MAX_RT) tries the same reading
+ *  again every SENSOR_RETRY_MICROS until it gets through or its next reading is due. A write()
+ *  that is ACK'd with no ACK payload is RadioComms' error #3: the reading is in, so it is not
+ *  sent again, and the sensor sleeps until its next reading, as the sketch's Dispatcher does.
+ *
+ *  At the end it reports what happened to the readings and in the air, and how fast the
+ *  simulation ran. Energy per reading uses PowerController's per-attempt model (PowerControl.h).
+ *
+ *  Usage --:
+ *      RPi_RadioSim [-n sensors] [-t simSeconds] [-i intervalMillis] [-l lossProbability]
+ *                   [-L latencyMicros] [-s seed] [-c] [-f faultProfile] [-B] [-w] [-r] [-F] [-D] [-S]
+ *          -c turns off collisions.
+ *          -f runs the air through a FaultChannel (FaultChannel.h), e.g. -f ge=0.02/0.25/0/0.9
+ *          -B benchmark: runs every profile in benchProfiles[] and prints one line for each.
+ *          -w watchdog check: runs the network in real time with the gateway's radio health
+ *             check (RadioHealth.h) gating systemd watchdog pings (SdNotify.h) into a stand-in
+ *             notify socket, wedges the gateway's chip part way through, and checks that
+ *             READY=1 came after set up, that pings kept up while the radio was well, and
+ *             that they stopped long enough after the stall for systemd to restart it.
+ *          -r recovery check: for each fault in recoveryFaults[], runs the network with the
+ *             gateway under a RadioSupervisor (RadioSupervisor.h), injects the fault into the
+ *             gateway's chip at a random time, and measures the time to recover: to the set up
+ *             being run again, and to the first packet after it.
+ *          -F firmware run: the tiny84 sketch itself (SensorFirmware.h), built once on the RF24
+ *             library and once on Nrf24Lite, runs as the one sensor against the gateway for
+ *             FIRMWARE_READINGS readings. Reports what each put on its SPI bus, the awake time
+ *             per cycle and boot to 1st ACK the sensor reported, and boot to 1st packet at the
+ *             gateway. Each build is run again with the radio woken only once the reading is
+ *             in, as before the wake-up overlapped the sampling. Fails unless every reading got
+ *             through, the overlapped cycle is awake for less time than that serial one, and
+ *             boot to 1st ACK and to 1st packet are within FIRMWARE_BOOT_BUDGET_MILLIS.
+             Then once more against a gateway that loads no ACK payloads, so every ACK comes
+             back empty (error #3): fails unless every reading still gets through and each
+             one's error #3 is counted in the next reading's ctErrors.
+ *          -D driver check: Nrf24Lite against NrfSim - the registers its init table leaves
+ *             (and that they match what RF24 leaves after the same RadioComms::setup()), a
+ *             write() that comes back with an ACK payload, a write() that ends in MAX_RT, and a
+ *             chip that isn't there. Also what each driver call costs on the bus, next to RF24.
+ *          -S SPI batch check: the gateway's NrfSpiBatch on a simulated spidev that can fail an
+ *             ioctl or garble a payload width. Checks that readAndReload() leaves exactly one
+ *             ACK payload loaded after an empty FIFO and after a bad width - so the next
+ *             packet gets its ack - even when the 2nd ioctl fails once, and none after a
+ *             failed ioctl, and that the held ack goes out next. Then a benchmark: ioctls and us
+ *             per packet, batched against RF24's one ioctl per command.
+ *
+ *  Build --:
+ *      g++ -O2 -std=c++17 -IArduinoSim -o RPi_RadioSim RPi_RadioSim.cpp
+ *
+ * 10/19/2026-rel09:
+ *      > A sensor counts ACKs that came back without a payload (error #3, "empty ACKs") and
+ *        does not send that reading again, as the fixed sketch does.
+ *      > -F runs each build against a gateway with no ACK payloads too (SimGateway.ackPayloads),
+ *        and serialPass() follows the Dispatcher's new phase-3.
+ *
+ * 10/19/2026-rel08:
+ *      > -S checks that a bad width leaves the ack loaded for the next packet, and that a 2nd
+ *        ioctl (after an empty FIFO or a bad width) that fails is run again.
+ *
+ * 10/19/2026-rel07:
+ *      > The firmware run (-F) is a check now: overlapped against serial radio wake-up. Each
+ *        run is in its own process.
+ *      > -F also checks boot to 1st ACK, and to the gateway's 1st packet, against
+ *        FIRMWARE_BOOT_BUDGET_MILLIS.
+ *
+ * 10/19/2026-rel06:
+ *      > SPI batch check and benchmark (-S). SimGateway can be told not to poll (polling).
+ *
+ * 10/19/2026-rel05:
+ *      > The gateway's NrfSpiBatch reaches its chip through NrfSimSpi.h, so SpiBatch.h (and the
+ *        receiver) no longer pull in the simulator.
+ *      > Firmware run (-F): the real sensor sketch on an Arduino stand-in (ArduinoSim/). Needs
+ *        -IArduinoSim to build.
+ *      > Driver check (-D).
+ *
+ * 10/19/2026-rel04:
+ *      > Recovery check (-r). NrfSim can now brown out (powerOnReset()).
+ *
+ * 10/19/2026-rel03:
+ *      > Watchdog check (-w).
+ *
+ * 10/19/2026-rel02:
+ *      > Fault injection (-f) and the loss profile benchmark (-B). Sensors retry failed writes,
+ *        and transmit attempts and energy per reading are reported.
+ *
+ * 10/19/2026-rel01:
+ *      > Initial program.
+ */
+#define VERSION "10-19-2026 rel 09"
+
+#define DEFAULT_SENSORS 10
+#define DEFAULT_SECONDS 60
+#define DEFAULT_INTERVAL_MILLIS 1000
+#define SENSOR_REACT_MICROS 20      // tiny84 polling STATUS in write().
+#define SENSOR_RETRY_MICROS 30000   // RadioComms' _txWaitDelay.
+#define GATEWAY_POLL_MICROS 200     // RPi main loop going round.
+#define PAYLOAD_BYTES 32
+#define ACK_BYTES 8
+#define WATCHDOG_USEC 400000        // -w: WatchdogSec for the stand-in systemd ...
+#define WATCHDOG_CHECK_MICROS 50000 // ... the gateway's health check interval (RADIO_CHECK_MILLIS, scaled down) ...
+#define WATCHDOG_STALE_MICROS 150000 // ... no pings on a check older than this (RADIO_STALE_MILLIS) ...
+#define WATCHDOG_STALL_MICROS 2000000   // ... the chip wedges this far in ...
+#define WATCHDOG_RUN_MICROS 4000000     // ... and the check ends here.
+#define RECOVERY_TRIALS 20              // -r: trials per fault ...
+#define RECOVERY_CHECK_MICROS 100000    // ... the supervisor's check interval ...
+#define RECOVERY_FAULT_INTERVALS 3      // ... the fault comes this many sensor intervals in, plus up to one more ...
+#define RECOVERY_RUN_INTERVALS 4        // ... and the trial runs this many after it.
+#define RECOVERY_SPI_LOST_MICROS 200000 // "spi-lost": how long the bus is gone.
+#define FIRMWARE_READINGS 4             // -F: readings to run for ...
+#define FIRMWARE_LOOP_CYCLES 200        // ... CPU cycles for the rest of a pass of loop() ...
+#define FIRMWARE_IDLE_MICROS 1000       // ... and the step while the radio is powered down (millis() can't tell).
+    /* -F: boot to 1st ACK, and to the gateway having the 1st packet. The 1st reading's samples, then a
+       little for the radio. The receiver flags anything over BOOT_ACK_BUDGET_MILLIS (10s). */
+#define FIRMWARE_BOOT_BUDGET_MILLIS ((NUM_READINGS_TO_AVERAGE - 1) * INTER_MEASUREMENT_DELAY + 300)
+#define SPI_BENCH_PACKETS 20000         // -S: packets per path in the benchmark.
+
+#include <cstdint>
+#include <cstdio>      // printf()
+#include <cstdlib>     // atoi(), atof(), strtoull()
+#include <cstring>     // memset(), memcpy(), strcmp()
+#include <vector>
+#include <string>
+#include <time.h>      // CLOCK_MONOTONIC, timespec, clock_gettime()
+#include <unistd.h>    // usleep(), getpid()
+#include <fcntl.h>     // open() - /dev/null for -S
+#include <sys/ioctl.h>
+#include <sys/wait.h>  // waitpid() - each -F run in its own process
+#include <sys/socket.h>     // The stand-in notify socket.
+#include <sys/un.h>
+#include "NrfSim.h"    // NrfSim, VirtualAir
+#include "SpiBatch.h"  // NrfSpiBatch
+#include "NrfSimSpi.h" // NrfSimSpi
+#include "SensorFirmware.h"     // tinyRF24::, tinyLite:: - the sensor sketch
+#include "FaultChannel.h"   // FaultChannel
+#include "PowerControl.h"   // PowerController::attemptMicroJoules()
+#include "RadioHealth.h"    // RadioHealth
+#include "RadioSupervisor.h"    // RadioSupervisor
+#include "LatencyHistogram.h"   // LatencyHistogram
+#include "SdNotify.h"       // SdNotify
+
+using namespace std;
+
+static const uint8_t addrGateway[5] = {'1', 'N', 'o', 'd', 'e'};
+static const uint8_t addrSensor[5] = {'2', 'N', 'o', 'd', 'e'};
+
+    /* Profiles run by -B. */
+static const char* benchProfiles[] = {
+    "clean",
+    "loss=0.01",
+    "loss=0.05",
+    "loss=0.2",
+    "ge=0.02/0.25/0/0.9",           // Bursts of ~4 frames at 90% loss.
+    "ge=0.005/0.05/0.01/0.5",       // Long bad spells.
+    "ackloss=0.1",
+    "corrupt=0.05",
+    "dup=0.05",
+    "delay=500/500",
+    "loss=0.05,ackloss=0.05,dup=0.01,delay=100/200",
+};
+
+    /* Faults run by -r, done to the gateway's chip. */
+    /* Registers -D checks after set up, and what Nrf24Lite's NRF_INIT_TABLE (then
+       setPALevel(RF24_PA_LOW), the pipes and powerUp()) must leave in them. */
+static const struct { uint8_t reg; uint8_t value; const char* name; } driverRegisters[] = {
+    {NRFSIM_CONFIG, NRFSIM_EN_CRC | NRFSIM_CRCO | NRFSIM_PWR_UP, "CONFIG"},
+    {NRFSIM_EN_AA, 0x3F, "EN_AA"},
+    {NRFSIM_EN_RXADDR, 0x03, "EN_RXADDR"},
+    {NRFSIM_SETUP_AW, 0x03, "SETUP_AW"},
+    {NRFSIM_SETUP_RETR, 0x5F, "SETUP_RETR"},
+    {NRFSIM_RF_CH, 76, "RF_CH"},
+    {NRFSIM_RF_SETUP, 0x03, "RF_SETUP"},
+    {NRFSIM_STATUS, 0x0E, "STATUS"},
+    {NRFSIM_DYNPD, 0x3F, "DYNPD"},
+    {NRFSIM_FEATURE, NRFSIM_EN_DPL | NRFSIM_EN_ACK_PAY, "FEATURE"},
+};
+
+static const char* recoveryFaults[] = {
+    "none",                         // No fault: there must be no recoveries.
+    "brownout",                     // Registers back to reset values, FIFOs emptied.
+    "spi-lost",                     // Bus reads 0xFF for RECOVERY_SPI_LOST_MICROS, then the chip is back from a reset.
+    "ce-low",                       // CE pin dropped: registers fine, hears nothing.
+    "channel",                      // RF_CH overwritten.
+};
+
+
+/* =============================================================================
+   Class definitions
+   =============================================================================
+*/
+
+/* One sensor: its chip, and the tiny84 side of the conversation. */
+class SimSensor {
+    public:
+        SimSensor(VirtualAir& air, uint16_t id, uint64_t intervalMicros);
+        void start(uint64_t firstReading);
+
+        unsigned long readings = 0;     // Readings taken.
+        unsigned long delivered = 0;    // ACK'd.
+        unsigned long failed = 0;       // write()s that ended in MAX_RT.
+        unsigned long attempts = 0;     // Frames sent: 1 + ARC_CNT for every write().
+        unsigned long retransmits = 0;  // ARC_CNT summed over ACK'd writes.
+        unsigned long acks = 0;         // ACK payloads read back.
+        unsigned long emptyAcks = 0;    // ACK'd with no ACK payload: RadioComms' error #3.
+
+    private:
+        VirtualAir& _air;
+        NrfSim _chip;
+        uint16_t _id;
+        uint64_t _interval;
+        uint32_t _seq = 0;
+        uint8_t _payload[PAYLOAD_BYTES];
+
+        void reading();
+        void send();
+        void irq();
+        void command(uint8_t cmd);
+        void writeBuf(uint8_t cmd, const uint8_t* buf, uint8_t len);
+};
+
+
+/* The RPi: its chip, read through NrfSpiBatch. */
+class SimGateway {
+    public:
+        SimGateway(VirtualAir& air, unsigned int sensors);
+
+        unsigned long packets = 0;      // Taken off the chip.
+        unsigned long readings = 0;     // Distinct readings among them.
+        unsigned long duplicates = 0;
+        uint8_t idAt = 0, seqAt = 2;    // Where the sensor ID and reading number are in a payload.
+        uint8_t last[NRFSIM_MAX_PAYLOAD];   // The last payload taken.
+        bool polling = true;            // False: leave the chip to someone else.
+        bool ackPayloads = true;        // False: keep no ACK payload loaded, so every ACK goes out empty.
+        NrfSpiBatch& batch() { return _batch; }
+        NrfSim& chip() { return _chip; }
+
+          /*    PURPOSE: Set the chip up and listening, as RPi_CapDataReceive's
+           *  setUpRadio() and radioService() do. Again after a fault. */
+        void setUp();
+
+          /*    PURPOSE: Called for each packet taken off the chip. */
+        std::function<void()> onPacket;
+
+    private:
+        VirtualAir& _air;
+        NrfSim _chip;
+        NrfSimSpi _spi;
+        NrfSpiBatch _batch;
+        vector<uint32_t> _lastSeq;      // Per sensor; 0 = none yet.
+        uint8_t _ack[ACK_BYTES];
+
+        void poll();
+};
+
+
+/* What one run came to. */
+struct SimResult {
+    unsigned long readings = 0, delivered = 0, failed = 0, attempts = 0, retransmits = 0, acks = 0, emptyAcks = 0;
+    unsigned long gwPackets = 0, gwReadings = 0, gwDuplicates = 0, gwIoctls = 0;
+    double wallSeconds = 0;
+};
+
+SimResult runSim(VirtualAir& air, unsigned int numSensors, double seconds, unsigned int intervalMillis);
+int watchdogCheck(unsigned int numSensors, unsigned int intervalMillis, uint64_t seed);
+int recoveryCheck(unsigned int numSensors, unsigned int intervalMillis, uint64_t seed);
+int firmwareRun(uint64_t seed);
+int driverCheck(uint64_t seed);
+int spiBatchCheck(uint64_t seed);
+uint64_t wallMicros();
+
+
+/* =============================================================================
+   Main
+   =============================================================================
+*/
+
+int main(int argc, char** argv) {
+    unsigned int numSensors = DEFAULT_SENSORS;
+    double seconds = DEFAULT_SECONDS;
+    unsigned int intervalMillis = DEFAULT_INTERVAL_MILLIS;
+    double loss = 0;
+    unsigned int latency = 0;
+    uint64_t seed = 1;
+    bool collisions = true;
+    string profile;
+    bool bench = false;
+    bool watchdog = false;
+    bool recovery = false;
+    bool firmware = false;
+    bool driver = false;
+    bool spiCheck = false;
+
+    for (int i = 1; i < argc; i++) {
+        bool more = (i + 1 < argc);
+        if (strcmp(argv[i], "-n") == 0 && more) numSensors = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && more) seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0 && more) intervalMillis = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && more) loss = atof(argv[++i]);
+        else if (strcmp(argv[i], "-L") == 0 && more) latency = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && more) seed = strtoull(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-c") == 0) collisions = false;
+        else if (strcmp(argv[i], "-f") == 0 && more) profile = argv[++i];
+        else if (strcmp(argv[i], "-B") == 0) bench = true;
+        else if (strcmp(argv[i], "-w") == 0) watchdog = true;
+        else if (strcmp(argv[i], "-r") == 0) recovery = true;
+        else if (strcmp(argv[i], "-F") == 0) firmware = true;
+        else if (strcmp(argv[i], "-D") == 0) driver = true;
+        else if (strcmp(argv[i], "-S") == 0) spiCheck = true;
+        else {
+            fprintf(stderr, "usage: %s [-n sensors] [-t simSeconds] [-i intervalMillis] [-l loss] [-L latencyMicros] [-s seed] [-c] [-f faultProfile] [-B] [-w] [-r] [-F] [-D] [-S]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (numSensors < 1 || numSensors > 0xFFFF || intervalMillis < 1) {
+        fprintf(stderr, "sensors must be 1 - 65535, interval at least 1ms\n");
+        return 1;
+    }
+
+    if (watchdog) return watchdogCheck(numSensors, intervalMillis, seed);
+    if (recovery) return recoveryCheck(numSensors, intervalMillis, seed);
+    if (firmware) return firmwareRun(seed);
+    if (driver) return driverCheck(seed);
+    if (spiCheck) return spiBatchCheck(seed);
+
+    float microJoules = PowerController::attemptMicroJoules(1);   // RF24_PA_LOW
+
+    if (bench) {
+        printf("RPi_RadioSim [%s] loss profile benchmark: %u sensors, %.0fs simulated, %ums interval, collisions %s, seed %llu\n",
+               VERSION, numSensors, seconds, intervalMillis, collisions ? "on" : "off", (unsigned long long)seed);
+        printf("%-48s %9s %8s %8s %9s %8s %8s %9s\n",
+               "profile", "readings", "rxd %", "att/rdg", "MAX_RT", "dups", "uJ/rdg", "wall s");
+        for (const char* prof : benchProfiles) {
+            VirtualAir air(seed);
+            air.collisions = collisions;
+            FaultChannel faults(seed * 7919 + 1);
+            faults.parse(prof);
+            faults.attach(air);
+            SimResult r = runSim(air, numSensors, seconds, intervalMillis);
+            printf("%-48s %9lu %8.2f %8.3f %9lu %8lu %8.1f %9.3f\n", prof, r.readings,
+                   r.readings ? 100.0 * r.gwReadings / r.readings : 0.0,
+                   r.readings ? (double)r.attempts / r.readings : 0.0, r.failed, r.gwDuplicates,
+                   r.gwReadings ? r.attempts * microJoules / r.gwReadings : 0.0, r.wallSeconds);
+        }
+        return 0;
+    }
+
+    VirtualAir air(seed);
+    air.lossProbability = loss;
+    air.latencyMicros = latency;
+    air.collisions = collisions;
+    FaultChannel faults(seed * 7919 + 1);
+    if (!profile.empty()) {
+        if (!faults.parse(profile)) {
+            fprintf(stderr, "could not parse fault profile: %s\n", profile.c_str());
+            return 1;
+        }
+        faults.attach(air);
+    }
+
+    SimResult r = runSim(air, numSensors, seconds, intervalMillis);
+
+    printf("RPi_RadioSim [%s]: %u sensors, %.0fs simulated, %ums interval, loss %.3f, latency %uus, collisions %s, seed %llu%s%s\n",
+           VERSION, numSensors, seconds, intervalMillis, loss, latency, collisions ? "on" : "off", (unsigned long long)seed,
+           profile.empty() ? "" : ", faults ", profile.c_str());
+    printf("  Sensors:  %lu readings, %lu ACK'd, %lu failed writes (MAX_RT), %lu attempts (%.2f per reading), %lu ACK payloads, %lu empty ACKs\n",
+           r.readings, r.delivered, r.failed, r.attempts, r.readings ? (double)r.attempts / r.readings : 0.0, r.acks, r.emptyAcks);
+    printf("  Gateway:  %lu packets, %lu distinct readings (%.1f%% of taken), %lu duplicates, %.2f ioctls/pkt\n",
+           r.gwPackets, r.gwReadings, r.readings ? 100.0 * r.gwReadings / r.readings : 0.0, r.gwDuplicates,
+           r.gwPackets ? (double)r.gwIoctls / r.gwPackets : 0.0);
+    printf("  Air:      %lu frames, %lu ACKs, %lu deliveries lost, %lu duplicated, %lu frames collided\n",
+           air.framesSent, air.acksSent, air.framesLost, air.framesDuplicated, air.framesCollided);
+    if (!profile.empty()) {
+        printf("  Faults:   %lu dropped, %lu ACKs dropped, %lu corrupted, %lu duplicated, %lu frames in bad state\n",
+               faults.dropped, faults.ackDropped, faults.corrupted, faults.duplicated, faults.badFrames);
+    }
+    printf("  Energy:   %.1f uJ radio energy per reading received\n",
+           r.gwReadings ? r.attempts * microJoules / r.gwReadings : 0.0);
+    printf("  Speed:    %.3fs wall, %.0f readings/s, %.0fx real time\n",
+           r.wallSeconds, r.wallSeconds > 0 ? r.readings / r.wallSeconds : 0.0,
+           r.wallSeconds > 0 ? seconds / r.wallSeconds : 0.0);
+    return 0;
+}
+
+
+/* Run one simulation on an air that has been set up.
+   ----------------------------------------------------------------------------
+ */
+SimResult runSim(VirtualAir& air, unsigned int numSensors, double seconds, unsigned int intervalMillis) {
+    SimResult r;
+    SimGateway gateway(air, numSensors);
+    vector<SimSensor*> sensors;
+    uint64_t interval = (uint64_t)intervalMillis * 1000;
+    for (unsigned int k = 0; k < numSensors; k++) {
+        SimSensor* s = new SimSensor(air, k + 1, interval);
+        s->start(2000 + (uint64_t)(air.random() * interval));      // After power up, at a random phase.
+        sensors.push_back(s);
+    }
+
+    timespec wallStart, wallEnd;
+    clock_gettime(CLOCK_MONOTONIC, &wallStart);
+    air.runUntil((uint64_t)(seconds * 1e6));
+    clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+    r.wallSeconds = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+
+    for (SimSensor* s : sensors) {
+        r.readings += s->readings;
+        r.delivered += s->delivered;
+        r.failed += s->failed;
+        r.attempts += s->attempts;
+        r.retransmits += s->retransmits;
+        r.acks += s->acks;
+        r.emptyAcks += s->emptyAcks;
+        delete s;
+    }
+    r.gwPackets = gateway.packets;
+    r.gwReadings = gateway.readings;
+    r.gwDuplicates = gateway.duplicates;
+    r.gwIoctls = gateway.batch().ioctls();
+    return r;
+}
+
+
+
+/* Watchdog check (-w).
+   ----------------------------------------------------------------------------
+   Plays systemd: binds a datagram socket, and points NOTIFY_SOCKET and
+   WATCHDOG_USEC at it for an SdNotify. The network then runs in real time,
+   the gateway doing what RPi_CapDataReceive does, at a smaller scale: a
+   RadioHealth check of its chip every WATCHDOG_CHECK_MICROS, READY=1 after
+   the first good one, and keepAlive() only while the last check was good and
+   fresh. At WATCHDOG_STALL_MICROS the gateway's chip is wedged (NrfSim::
+   setWedged()). Every message that reaches the socket is time-stamped, and:
+     > READY=1 must be first, after the radio was set up;
+     > while the radio is well, no gap between pings may reach WATCHDOG_USEC;
+     > after the stall, pings must stop, for long enough that systemd's
+       watchdog fires before the run ends.
+   RETURNS: 0 on PASS, 1 on FAIL.
+ */
+int watchdogCheck(unsigned int numSensors, unsigned int intervalMillis, uint64_t seed) {
+    struct Message {
+        uint64_t at;
+        bool ready;
+    };
+    vector<Message> messages;
+    messages.reserve(1000);
+
+    char name[64];
+    snprintf(name, sizeof(name), "@RPi_RadioSim-%d", (int)getpid());
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, name + 1, strlen(name) - 1);      // Abstract namespace: leading '\0'.
+    int sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (sock < 0 || bind(sock, (const sockaddr*)&addr, offsetof(sockaddr_un, sun_path) + strlen(name)) != 0) {
+        fprintf(stderr, "could not bind the stand-in notify socket\n");
+        return 1;
+    }
+    char usec[24], pid[24];
+    snprintf(usec, sizeof(usec), "%u", WATCHDOG_USEC);
+    snprintf(pid, sizeof(pid), "%d", (int)getpid());
+    setenv("NOTIFY_SOCKET", name, 1);
+    setenv("WATCHDOG_USEC", usec, 1);
+    setenv("WATCHDOG_PID", pid, 1);
+    SdNotify notify;
+
+    uint64_t t0 = wallMicros();
+    VirtualAir air(seed);
+    SimGateway gateway(air, numSensors);
+    vector<SimSensor*> sensors;
+    uint64_t interval = (uint64_t)intervalMillis * 1000;
+    for (unsigned int k = 0; k < numSensors; k++) {
+        SimSensor* s = new SimSensor(air, k + 1, interval);
+        s->start(2000 + (uint64_t)(air.random() * interval));
+        sensors.push_back(s);
+    }
+    air.advance(NRFSIM_SETTLE_MICROS);                              // Listening.
+    RadioHealth health;
+    health.learn(gateway.batch());
+    uint64_t setUp = wallMicros() - t0;
+
+    bool ready = false, healthy = false, wedged = false;
+    uint64_t checkedAt = 0, nextCheck = 0, stallAt = 0, detectedAt = 0;
+    unsigned long packetsAtStall = 0;
+    uint64_t now;
+    while ((now = wallMicros() - t0) < WATCHDOG_RUN_MICROS) {
+        air.runUntil(now);                                          // Simulated time keeps up with the wall clock.
+        if (!wedged && now >= WATCHDOG_STALL_MICROS) {
+            gateway.chip().setWedged(true);
+            wedged = true;
+            stallAt = now;
+            packetsAtStall = gateway.packets;
+        }
+        if (now >= nextCheck) {
+            healthy = health.check(gateway.batch());
+            checkedAt = now;
+            nextCheck = now + WATCHDOG_CHECK_MICROS;
+            if (!healthy && wedged && detectedAt == 0) detectedAt = now;
+        }
+        if (healthy && checkedAt + WATCHDOG_STALE_MICROS > now) {
+            if (!ready) ready = notify.ready();
+            notify.keepAlive(now);
+        }
+
+        char buf[64];
+        ssize_t n;
+        while ((n = recv(sock, buf, sizeof(buf) - 1, 0)) > 0) {
+            buf[n] = '\0';
+            messages.push_back({wallMicros() - t0, strcmp(buf, "READY=1") == 0});
+        }
+        usleep(1000);
+    }
+    close(sock);
+    for (SimSensor* s : sensors) delete s;
+
+        /* What systemd would have made of it. */
+    bool readyFirst = !messages.empty() && messages[0].ready && messages[0].at >= setUp;
+    uint64_t maxGap = 0, lastPing = 0;
+    unsigned long pings = 0;
+    for (size_t k = 1; k < messages.size(); k++) {
+        if (messages[k].ready) {
+            readyFirst = false;
+            continue;
+        }
+        pings++;
+        lastPing = messages[k].at;
+        uint64_t gap = messages[k].at - messages[k - 1].at;
+        if (messages[k].at <= stallAt && gap > maxGap) maxGap = gap;
+    }
+    uint64_t firesAt = lastPing + WATCHDOG_USEC;
+    bool keptUp = pings > 0 && maxGap < WATCHDOG_USEC;
+    bool stopped = detectedAt > 0 && lastPing <= detectedAt && firesAt < WATCHDOG_RUN_MICROS;
+    bool pass = readyFirst && keptUp && stopped;
+
+    printf("RPi_RadioSim [%s] watchdog check: %u sensors, WatchdogSec %.1fs, radio checked every %.0fms, wedged at %.1fs\n",
+           VERSION, numSensors, WATCHDOG_USEC / 1e6, WATCHDOG_CHECK_MICROS / 1e3, stallAt / 1e6);
+    printf("  READY=1:   %s (set up done at %.1fms, READY at %.1fms)\n", readyFirst ? "first, after set up" : "WRONG",
+           setUp / 1e3, messages.empty() ? 0.0 : messages[0].at / 1e3);
+    printf("  Healthy:   %lu pings in all, longest gap %.1fms (must be under %.0fms), %lu packets taken\n",
+           pings, maxGap / 1e3, WATCHDOG_USEC / 1e3, packetsAtStall);
+    printf("  Stalled:   bad check %.1fms after the stall (%s), last ping %.1fms after it, %lu packets taken since\n",
+           detectedAt ? (detectedAt - stallAt) / 1e3 : 0.0, detectedAt ? "detected" : "NOT detected",
+           lastPing > stallAt ? (lastPing - stallAt) / 1e3 : 0.0, gateway.packets - packetsAtStall);
+    printf("  systemd:   watchdog fires %.1fms after the stall%s\n", firesAt > stallAt ? (firesAt - stallAt) / 1e3 : 0.0,
+           stopped ? "" : " - NOT before the end of the run");
+    printf("  %s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* Recovery check (-r).
+   ----------------------------------------------------------------------------
+   For each fault in recoveryFaults[], RECOVERY_TRIALS runs of the network in
+   simulated time, the gateway's chip under a RadioSupervisor set up the way
+   the receiver's is, only checking every RECOVERY_CHECK_MICROS and with a
+   silence window fit for the sensors' interval. The fault is done to the chip
+   at a random time; the trial then runs on for RECOVERY_RUN_INTERVALS. Run it at
+   a load the air can carry: past that (e.g. 50 sensors at 1s) retries
+   collide until nothing gets through, and that silence is rightly taken for
+   a dead radio. For each
+   fault it reports:
+     > detect: fault to the supervisor having set the chip up again;
+     > back: fault to the first packet taken after that;
+     > set up: wall time the set up and re-learning took;
+     > lost: readings the sensors took that never reached the gateway.
+   RETURNS: 0 on PASS (every fault recovered from in every trial, and no
+   recoveries without one), 1 on FAIL.
+ */
+int recoveryCheck(unsigned int numSensors, unsigned int intervalMillis, uint64_t seed) {
+    uint64_t interval = (uint64_t)intervalMillis * 1000;
+    uint64_t silence = interval * 3 / 2;                            // Shortest silence window: 1.5 sensor intervals.
+    printf("RPi_RadioSim [%s] recovery check: %u sensors, %ums interval, %d trials a fault, checks every %.0fms, silence after %.1fs\n",
+           VERSION, numSensors, intervalMillis, RECOVERY_TRIALS, RECOVERY_CHECK_MICROS / 1e3, silence / 1e6);
+    printf("%-10s %9s %16s %16s %18s %8s %8s\n", "fault", "recovered", "detect p50/max", "back p50/max", "set up us p50/max", "lost", "readings");
+    bool pass = true;
+    for (const char* fault : recoveryFaults) {
+        bool none = strcmp(fault, "none") == 0;
+        LatencyHistogram detect, back, setUp;
+        unsigned int recovered = 0;
+        unsigned long readings = 0, received = 0, falseAlarms = 0;
+
+        for (int trial = 0; trial < RECOVERY_TRIALS; trial++) {
+            VirtualAir air(seed + trial);
+            SimGateway gateway(air, numSensors);
+            vector<SimSensor*> sensors;
+            for (unsigned int k = 0; k < numSensors; k++) {
+                SimSensor* s = new SimSensor(air, k + 1, interval);
+                s->start(2000 + (uint64_t)(air.random() * interval));
+                sensors.push_back(s);
+            }
+
+            RadioSupervisor supervisor(&gateway.batch(), [&gateway]() {
+                gateway.setUp();
+                return true;
+            });
+            supervisor.checkMicros = RECOVERY_CHECK_MICROS;
+            supervisor.silenceMinMicros = silence;
+            uint64_t faultAt = RECOVERY_FAULT_INTERVALS * interval + (uint64_t)(air.random() * interval);
+            uint64_t recoveredAt = 0, backAt = 0;
+            gateway.onPacket = [&]() {
+                supervisor.received(air.now());
+                if (recoveredAt && !backAt) backAt = air.now();
+            };
+            std::function<void()> supervise = [&]() {
+                if (supervisor.due(air.now()) && supervisor.service(air.now())) {
+                    if (air.now() < faultAt) falseAlarms++;
+                    else if (!recoveredAt) recoveredAt = air.now();
+                }
+                air.at(air.now() + 10000, supervise);
+            };
+            air.advance(NRFSIM_SETTLE_MICROS);
+            supervisor.start(air.now());
+            air.at(air.now(), supervise);
+
+            NrfSim& chip = gateway.chip();
+            air.at(faultAt, [&]() {
+                if (strcmp(fault, "brownout") == 0) {
+                    chip.powerOnReset();
+                } else if (strcmp(fault, "spi-lost") == 0) {
+                    chip.setWedged(true);
+                    air.at(air.now() + RECOVERY_SPI_LOST_MICROS, [&chip]() {
+                        chip.powerOnReset();
+                        chip.setWedged(false);
+                    });
+                } else if (strcmp(fault, "ce-low") == 0) {
+                    chip.ce(false);
+                } else if (strcmp(fault, "channel") == 0) {
+                    chip.writeRegister(NRFSIM_RF_CH, 2);
+                }
+            });
+            air.runUntil(faultAt + RECOVERY_RUN_INTERVALS * interval);
+
+            if (none) {
+                falseAlarms += supervisor.recoveries;
+            } else if (recoveredAt && backAt) {
+                recovered++;
+                detect.record(recoveredAt - faultAt);
+                back.record(backAt - faultAt);
+                setUp.record(supervisor.lastSetUpMicros());
+            }
+            for (SimSensor* s : sensors) {
+                readings += s->readings;
+                delete s;
+            }
+            received += gateway.readings;
+        }
+
+        bool ok = none ? falseAlarms == 0 : (recovered == RECOVERY_TRIALS && falseAlarms == 0);
+        pass = pass && ok;
+        char detectText[24] = "-", backText[24] = "-", setUpText[24] = "-";
+        if (!none) {
+            snprintf(detectText, sizeof(detectText), "%.1f/%.1f", detect.percentile(50) / 1e3, detect.max() / 1e3);
+            snprintf(backText, sizeof(backText), "%.1f/%.1f", back.percentile(50) / 1e3, back.max() / 1e3);
+            snprintf(setUpText, sizeof(setUpText), "%.0f/%.0f", (double)setUp.percentile(50), (double)setUp.max());
+        }
+        printf("%-10s %6u/%-2d %16s %16s %18s %8lu %8lu%s\n", fault, recovered, none ? 0 : RECOVERY_TRIALS,
+               detectText, backText, setUpText, readings - received, readings, ok ? "" : "  FAIL");
+        if (falseAlarms) printf("%-10s %lu recoveries with no fault\n", "", falseAlarms);
+    }
+    printf("  (times in ms from the fault; lost = readings the sensors took that never reached the gateway)\n");
+    printf("  %s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* Firmware run (-F).
+   ----------------------------------------------------------------------------
+   The sensor sketch, unchanged, as the one sensor: setup(), then loop() over
+   and over, each pass costing FIRMWARE_LOOP_CYCLES on top of what the core
+   calls it makes cost (ArduinoSim/Arduino.h). While the sketch has its radio
+   powered down the CPU's clock is stepped FIRMWARE_IDLE_MICROS a pass, so a
+   15 minute wait doesn't take 15 minutes of passes at a few us each. The
+   gateway finds the sensor ID and the reading's sensorTime in the payload
+   where RadioComms' TxPayloadStruct has them, and the awake time and boot to
+   1st ACK that the sensor reports are read out of the last payload.
+     Each build also runs serialLoop() in place of loop(): the Dispatcher's
+   cycle with radio.wake() moved to after the reading is in, which is how
+   long the radio's wake-up would add to the awake time if it weren't
+   overlapped with the sampling. And loop() once more against a gateway that
+   keeps no ACK payload loaded: every write() is ACK'd empty, RadioComms'
+   error #3, and the Dispatcher must still finish each cycle and take the
+   next reading (it used to wait in phase-3 for a payload that never came).
+   The sketch's objects are globals, so each run is in a process of its own
+   (forkFirmware()).
+   RETURNS: 0 on PASS, 1 on FAIL.
+ */
+struct FirmwareRun {
+    unsigned long readings = 0;         // Distinct readings at the gateway.
+    double bootPacketMillis = 0;        // Boot to the gateway taking the 1st packet.
+    unsigned long setUpTransactions = 0, setUpBytes = 0;
+    unsigned long transactions = 0, bytes = 0;      // SPI after setup().
+    uint64_t spiCycles = 0;
+    uint16_t awakeMillis = 0, bootAckMillis = 0;    // As last reported by the sensor.
+    uint32_t ctErrors = 0;
+    uint64_t awakeMillisSum = 0;
+    unsigned long awakeReports = 0;
+};
+
+static FirmwareRun runFirmware(uint64_t seed, void (*setup)(), void (*loop)(), bool ackPayloads) {
+    FirmwareRun r;
+    VirtualAir air(seed);
+    SimGateway gateway(air, 1);
+    NrfSim chip(air);
+    ArduinoBoard board(air, chip, CE_PIN, CSN_PIN);
+    arduinoBoard = &board;
+    gateway.idAt = 16;                  // TxPayloadStruct.sensorID
+    gateway.seqAt = 4;                  // TxPayloadStruct.sensorTime: the same on every retry of one reading.
+    gateway.ackPayloads = ackPayloads;
+    gateway.onPacket = [&]() {
+        if (gateway.packets == 1) r.bootPacketMillis = (air.now() - board.bootMicros) / 1000.0;
+        memcpy(&r.awakeMillis, &gateway.last[22], 2);
+        memcpy(&r.bootAckMillis, &gateway.last[24], 2);
+        memcpy(&r.ctErrors, &gateway.last[12], 4);
+        if (r.awakeMillis) {
+            r.awakeMillisSum += r.awakeMillis;
+            r.awakeReports++;
+        }
+    };
+
+    setup();
+    r.setUpTransactions = board.spiTransactions;
+    r.setUpBytes = board.spiBytes;
+    uint64_t setUpCycles = board.spiCycles;
+    uint64_t end = board.micros() + (uint64_t)(FIRMWARE_READINGS - 1) * CAP_READ_INTERVAL * 1000 + 60000000;
+    while (board.micros() < end) {
+        loop();
+        if (chip.readRegister(NRFSIM_CONFIG) & NRFSIM_PWR_UP) board.spend(FIRMWARE_LOOP_CYCLES);
+        else board.spend(FIRMWARE_IDLE_MICROS * ARDUINO_SIM_CYCLES_PER_MICRO);
+    }
+    arduinoBoard = nullptr;
+
+    r.readings = gateway.readings;
+    r.transactions = board.spiTransactions - r.setUpTransactions;
+    r.bytes = board.spiBytes - r.setUpBytes;
+    r.spiCycles = board.spiCycles - setUpCycles;
+    return r;
+}
+
+static FirmwareRun forkFirmware(uint64_t seed, void (*setup)(), void (*loop)(), bool ackPayloads = true) {
+    FirmwareRun r;
+    int fds[2];
+    if (pipe(fds) != 0) return r;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        r = runFirmware(seed, setup, loop, ackPayloads);
+        ssize_t n = write(fds[1], &r, sizeof(r));
+        _exit(n == (ssize_t)sizeof(r) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid > 0) {
+        if (read(fds[0], &r, sizeof(r)) != (ssize_t)sizeof(r)) r = FirmwareRun();
+        waitpid(pid, NULL, 0);
+    }
+    close(fds[0]);
+    return r;
+}
+
+    /* The Dispatcher's cycle, phases as in Dispatcher::dispatch(), but with the radio
+       woken once the reading is in rather than as it starts. No commands are carried
+       out; the gateway here sends none. */
+template <class Cap, class Radio, class Beat, class Flash>
+static void serialPass(Cap& cap, Radio& radio, Beat& beat, Flash& flash) {
+    static int phase = 1;                       // As begin(): straight to a reading.
+    static unsigned long start = 0;
+    switch (phase) {
+        case 0:
+            if (millis() > start + CAP_READ_INTERVAL) phase = 1;
+            break;
+        case 1:
+            start = millis();
+            cap.initiateSensorReading();
+            phase = 2;
+            break;
+        case 2:
+            if (cap.readingAvailable()) {
+                radio.wake();
+                phase = 5;
+            }
+            break;
+        case 5:                                 // Waiting for the radio to wake.
+            if (radio.isAwake()) {
+                radio.setTxPayload(cap.getCapacitance(0), cap.getVccMillivolts());
+                for (uint8_t p = 1; p < cap.getNumProbes(); p++) radio.setProbeCapacitance(p, cap.getCapacitance(p));
+                phase = 3;
+            }
+            break;
+        case 3:
+            if (!radio.isBusy()) {
+                if (radio.ackAvailable()) radio.getAckPayload();
+                phase = 4;
+            }
+            break;
+        case 4:
+            radio.sleep();
+            radio.setAwakeMillis(millis() - start);
+            phase = 0;
+            break;
+    }
+    flash.setError(radio.update());
+    beat.update();
+    flash.update();
+}
+
+static void serialLoopRF24() { serialPass(tinyRF24::capSensor, tinyRF24::radio, tinyRF24::heartBeat, tinyRF24::errorFlash); }
+static void serialLoopLite() { serialPass(tinyLite::capSensor, tinyLite::radio, tinyLite::heartBeat, tinyLite::errorFlash); }
+
+int firmwareRun(uint64_t seed) {
+    struct Build {
+        const char* driver;
+        void (*setup)();
+        void (*loop)();
+        void (*serialLoop)();
+    };
+    const Build builds[] = {
+        {"RF24", tinyRF24::setup, tinyRF24::loop, serialLoopRF24},
+        {"Nrf24Lite", tinyLite::setup, tinyLite::loop, serialLoopLite},
+    };
+    printf("RPi_RadioSim [%s] firmware run: the tiny84 sketch on NrfSim, %d readings %.0f min apart, seed %llu\n",
+           VERSION, FIRMWARE_READINGS, CAP_READ_INTERVAL / 60000.0, (unsigned long long)seed);
+    printf("%-10s %-8s %9s %12s %12s %12s %14s %14s %14s\n", "driver", "wake", "readings", "set up SPI", "boot->ACK ms",
+           "boot->pkt ms", "awake ms/rdg", "SPI txn/rdg", "SPI us/rdg");
+    bool pass = true;
+    for (const Build& b : builds) {
+        double awake[2] = {0, 0};
+        for (int serial = 0; serial < 2; serial++) {
+            FirmwareRun r = forkFirmware(seed, b.setup, serial ? b.serialLoop : b.loop);
+            awake[serial] = r.awakeReports ? (double)r.awakeMillisSum / r.awakeReports : 0.0;
+            bool ok = r.readings == FIRMWARE_READINGS && r.bootAckMillis > 0
+                   && r.bootAckMillis <= FIRMWARE_BOOT_BUDGET_MILLIS && r.bootPacketMillis <= FIRMWARE_BOOT_BUDGET_MILLIS;
+            pass = pass && ok;
+            double n = r.readings ? r.readings : 1;
+            char setUp[24];
+            snprintf(setUp, sizeof(setUp), "%lu/%luB", r.setUpTransactions, r.setUpBytes);
+            printf("%-10s %-8s %6lu/%-2d %12s %12u %12.1f %14.1f %14.1f %14.1f%s\n", b.driver, serial ? "serial" : "overlap",
+                   r.readings, FIRMWARE_READINGS, setUp, r.bootAckMillis, r.bootPacketMillis, awake[serial],
+                   r.transactions / n, r.spiCycles / n / ARDUINO_SIM_CYCLES_PER_MICRO, ok ? "" : "  FAIL");
+        }
+        bool faster = awake[0] > 0 && awake[0] < awake[1];
+        pass = pass && faster;
+        printf("%-10s overlapping the wake-up saves %.1f ms awake a reading%s\n", "", awake[1] - awake[0], faster ? "" : "  FAIL");
+
+            /* Every ACK empty: each reading ends in error #3, counted in the next one's ctErrors. */
+        FirmwareRun r = forkFirmware(seed, b.setup, b.loop, false);
+        bool ok = r.readings == FIRMWARE_READINGS && r.ctErrors == FIRMWARE_READINGS - 1;
+        pass = pass && ok;
+        printf("%-10s no ACK payloads: %lu/%d readings, %u error #3s reported%s\n", "", r.readings, FIRMWARE_READINGS,
+               r.ctErrors, ok ? "" : "  FAIL");
+    }
+    printf("  (boot budget %d ms; SPI per reading is everything after setup(); us at the ARDUINO_SIM_ cycle\n"
+           "   estimates, 8MHz)\n", FIRMWARE_BOOT_BUDGET_MILLIS);
+    printf("  %s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* Driver check (-D).
+   ----------------------------------------------------------------------------
+   Runs the same steps on each radio driver the sketch can be built with, on
+   a chip of its own, with the gateway's chip as the other end:
+     > set up as RadioComms::setup() does: begin() must say the chip is there,
+       and the registers must be driverRegisters[] (Nrf24Lite), and the
+       same for both drivers, addresses included;
+     > write() with the gateway there: ACK'd first time, the gateway has the
+       payload, and available()/read() give back the ACK payload the gateway
+       loaded, on pipe 0, with the FIFO empty and no flags left after;
+     > write() with the gateway gone: false, having used all 15 retries,
+       inside NRF_WRITE_TIMEOUT, with the TX FIFO flushed and MAX_RT cleared,
+       so that the next write(), with the gateway back, goes through;
+     > a chip that isn't there (reads 0xFF): begin() and write() false.
+   And for each call, what it puts on the bus. Bus time is at the
+   ARDUINO_SIM_ cycle estimates (ArduinoSim/Arduino.h).
+   RETURNS: 0 on PASS, 1 on FAIL.
+ */
+struct BusCount {
+    unsigned long transactions = 0, bytes = 0;
+    uint64_t cycles = 0;
+};
+
+enum { OP_BEGIN, OP_SET_UP, OP_WRITE, OP_AVAILABLE, OP_READ, OP_GET_ARC, OP_SET_PA, OP_POWER_DOWN, OP_POWER_UP, OP_MAX_RT, OPS };
+static const char* driverOps[OPS] = {
+    "begin()", "rest of setup()", "write() ACK'd", "available()", "read() 8B", "getARC()", "setPALevel()",
+    "powerDown()", "powerUp()", "write() MAX_RT"
+};
+
+struct DriverResult {
+    vector<string> failures;
+    uint8_t regs[0x20];
+    uint8_t addr[3][5];                 // RX_ADDR_P0, RX_ADDR_P1, TX_ADDR
+    BusCount op[OPS];
+    uint8_t maxRtArc = 0;
+    double maxRtMillis = 0;
+};
+
+template <class Driver>
+static DriverResult checkDriver(uint64_t seed) {
+    DriverResult r;
+    const uint8_t* master = (const uint8_t*)"1Node";
+    const uint8_t* self = (const uint8_t*)"2Node";
+    VirtualAir air(seed);
+    SimGateway gateway(air, 1);
+    NrfSim chip(air);
+    ArduinoBoard board(air, chip, CE_PIN, CSN_PIN);
+    arduinoBoard = &board;
+    auto fail = [&r](const char* what) { r.failures.push_back(what); };
+    auto measure = [&board](BusCount& c, const std::function<void()>& fn) {
+        BusCount before = {board.spiTransactions, board.spiBytes, board.spiCycles};
+        fn();
+        c.transactions = board.spiTransactions - before.transactions;
+        c.bytes = board.spiBytes - before.bytes;
+        c.cycles = board.spiCycles - before.cycles;
+    };
+
+    Driver radio(CE_PIN, CSN_PIN);
+    bool begun = false;
+    measure(r.op[OP_BEGIN], [&]() { begun = radio.begin(); });
+    if (!begun) fail("begin() said the chip isn't there");
+    measure(r.op[OP_SET_UP], [&]() {
+        radio.setPALevel(RF24_PA_LOW);
+        radio.enableDynamicPayloads();
+        radio.enableAckPayload();
+        radio.openWritingPipe(master);
+        radio.openReadingPipe(1, self);
+        radio.stopListening();
+    });
+    for (uint8_t reg = 0; reg < 0x20; reg++) r.regs[reg] = chip.readRegister(reg);
+    const uint8_t addrRegs[3] = {NRFSIM_RX_ADDR_P0, NRFSIM_RX_ADDR_P1, NRFSIM_TX_ADDR};
+    for (int a = 0; a < 3; a++) {
+        uint8_t tx[6] = {addrRegs[a], NRFSIM_NOP, NRFSIM_NOP, NRFSIM_NOP, NRFSIM_NOP, NRFSIM_NOP}, rx[6];
+        chip.transaction(tx, rx, 6);
+        memcpy(r.addr[a], &rx[1], 5);
+    }
+    if (memcmp(r.addr[0], master, 5) || memcmp(r.addr[1], self, 5) || memcmp(r.addr[2], master, 5))
+        fail("pipe addresses not as set");
+
+        /* ACK'd write, with an ACK payload the gateway has loaded in place of its own. */
+    air.advance(NRFSIM_SETTLE_MICROS);
+    uint8_t ack[ACK_BYTES] = {0x01, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00}, ackTx[1 + ACK_BYTES] = {NRFSIM_W_ACK_PAYLOAD | 1};
+    memcpy(&ackTx[1], ack, ACK_BYTES);
+    uint8_t flush = NRFSIM_FLUSH_TX;
+    gateway.chip().transaction(&flush, NULL, 1);
+    gateway.chip().transaction(ackTx, NULL, sizeof(ackTx));
+    uint8_t payload[PAYLOAD_BYTES];
+    for (int i = 0; i < PAYLOAD_BYTES; i++) payload[i] = 0xA0 + i;
+    bool sent = false, avail = false;
+    uint8_t pipe = 0xFF, ackRx[ACK_BYTES], arc = 0xFF;
+    measure(r.op[OP_WRITE], [&]() { sent = radio.write(payload, sizeof(payload)); });
+    measure(r.op[OP_GET_ARC], [&]() { arc = radio.getARC(); });
+    measure(r.op[OP_AVAILABLE], [&]() { avail = radio.available(&pipe); });
+    memset(ackRx, 0, sizeof(ackRx));
+    measure(r.op[OP_READ], [&]() { radio.read(ackRx, sizeof(ackRx)); });
+    if (!sent) fail("write() not ACK'd on a clean channel");
+    if (arc != 0) fail("getARC() not 0 on a clean channel");
+    board.spend(GATEWAY_POLL_MICROS * 2 * ARDUINO_SIM_CYCLES_PER_MICRO);    // The gateway takes it off its chip.
+    if (gateway.packets != 1 || memcmp(gateway.last, payload, sizeof(payload))) fail("gateway didn't get the payload");
+    if (!avail || pipe != 0) fail("available() didn't see the ACK payload on pipe 0");
+    if (memcmp(ackRx, ack, sizeof(ack))) fail("read() didn't give back the ACK payload");
+    if (radio.available(&pipe)) fail("available() still true after read()");
+    if (chip.readRegister(NRFSIM_STATUS) & (NRFSIM_RX_DR | NRFSIM_TX_DS | NRFSIM_MAX_RT)) fail("STATUS flags left set after write()/read()");
+
+        /* Gateway gone: MAX_RT. */
+    gateway.chip().setWedged(true);
+    uint64_t start = board.micros();
+    measure(r.op[OP_MAX_RT], [&]() { sent = radio.write(payload, sizeof(payload)); });
+    r.maxRtMillis = (board.micros() - start) / 1000.0;
+    r.maxRtArc = chip.readRegister(NRFSIM_OBSERVE_TX) & 0x0F;
+    if (sent) fail("write() true with nobody to ACK it");
+    if (r.maxRtArc != 15) fail("write() gave up before 15 retries");
+    if (r.maxRtMillis >= 95) fail("write() ran into its timeout rather than MAX_RT");
+    if (!(chip.readRegister(NRFSIM_FIFO_STATUS) & 0x10)) fail("TX FIFO not flushed after MAX_RT");
+    if (chip.readRegister(NRFSIM_STATUS) & NRFSIM_MAX_RT) fail("MAX_RT left set");
+    gateway.chip().setWedged(false);
+    if (!radio.write(payload, sizeof(payload))) fail("write() after MAX_RT didn't go through");
+    radio.flush_rx();
+
+    measure(r.op[OP_SET_PA], [&]() { radio.setPALevel(RF24_PA_HIGH); });
+    measure(r.op[OP_POWER_DOWN], [&]() { radio.powerDown(); });
+    measure(r.op[OP_POWER_UP], [&]() { radio.powerUp(); });
+
+        /* No chip. */
+    chip.setWedged(true);
+    Driver missing(CE_PIN, CSN_PIN);
+    if (missing.begin()) fail("begin() true with no chip");
+    if (radio.write(payload, sizeof(payload))) fail("write() true with no chip");
+    arduinoBoard = nullptr;
+    return r;
+}
+
+int driverCheck(uint64_t seed) {
+    DriverResult rf24 = checkDriver<tinyRF24::RF24>(seed);
+    DriverResult lite = checkDriver<tinyLite::Nrf24Lite>(seed);
+
+    for (const auto& reg : driverRegisters) {
+        char what[64];
+        if (lite.regs[reg.reg] != reg.value) {
+            snprintf(what, sizeof(what), "%s is 0x%02X, init table says 0x%02X", reg.name, lite.regs[reg.reg], reg.value);
+            lite.failures.push_back(what);
+        }
+        if (lite.regs[reg.reg] != rf24.regs[reg.reg]) {
+            snprintf(what, sizeof(what), "%s is 0x%02X, RF24 leaves 0x%02X", reg.name, lite.regs[reg.reg], rf24.regs[reg.reg]);
+            lite.failures.push_back(what);
+        }
+    }
+    if (memcmp(lite.addr, rf24.addr, sizeof(lite.addr))) lite.failures.push_back("pipe addresses differ from RF24's");
+
+    printf("RPi_RadioSim [%s] driver check: Nrf24Lite against NrfSim, RF24 alongside, seed %llu\n", VERSION, (unsigned long long)seed);
+    printf("%-18s %22s %22s\n", "bus per call", "RF24 txn/bytes/us", "Nrf24Lite txn/bytes/us");
+    for (int op = 0; op < OPS; op++) {
+        char a[32], b[32];
+        snprintf(a, sizeof(a), "%lu/%lu/%.1f", rf24.op[op].transactions, rf24.op[op].bytes, rf24.op[op].cycles / (double)ARDUINO_SIM_CYCLES_PER_MICRO);
+        snprintf(b, sizeof(b), "%lu/%lu/%.1f", lite.op[op].transactions, lite.op[op].bytes, lite.op[op].cycles / (double)ARDUINO_SIM_CYCLES_PER_MICRO);
+        printf("%-18s %22s %22s\n", driverOps[op], a, b);
+    }
+    printf("  MAX_RT: RF24 %u retries in %.1fms, Nrf24Lite %u retries in %.1fms\n",
+           rf24.maxRtArc, rf24.maxRtMillis, lite.maxRtArc, lite.maxRtMillis);
+    printf("  Registers after set up (Nrf24Lite):");
+    for (const auto& reg : driverRegisters) printf(" %s=%02X", reg.name, lite.regs[reg.reg]);
+    printf("\n");
+    for (const string& f : rf24.failures) printf("  RF24 FAIL: %s\n", f.c_str());
+    for (const string& f : lite.failures) printf("  Nrf24Lite FAIL: %s\n", f.c_str());
+    bool pass = rf24.failures.empty() && lite.failures.empty();
+    printf("  %s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+/* SPI batch check (-S).
+   ----------------------------------------------------------------------------
+   The gateway's chip, not polled by SimGateway, read by an NrfSpiBatch on a
+   CheckSpi: NrfSimSpi that can fail a message before it reaches the chip
+   (an ioctl error), or read the next payload width back as 0xFF (a
+   glitch on MISO), and that also makes a real ioctl() on /dev/null for each
+   message, so a system call is paid as it would be on spidev. The sensor is
+   Nrf24Lite, on the sketch's build (tinyLite::), and every ACK payload the
+   gateway loads carries a number in its 1st byte.
+     > Check: a packet, a read that finds the FIFO empty, a failed ioctl and a
+       bad width, in that order, then an empty FIFO and a bad width again with
+       the 2nd ioctl failing once. After each, the sensor's next write() must
+       get back the ack the gateway last loaded - not an older one still
+       queued, and not none - and after -1, the same ack passed again must go
+       out.
+     > Benchmark: SPI_BENCH_PACKETS packets taken off with rxPipe() and
+       readAndReload(), then the same taken off as RF24 does on Linux, one
+       ioctl per command. Every write() must get its ack back, in order.
+   RETURNS: 0 on PASS, 1 on FAIL.
+ */
+class CheckSpi : public NrfSimSpi {
+  public:
+    CheckSpi(NrfSim* chip) : NrfSimSpi(chip) {}
+
+    int failIn = 0;                     // Fail the failIn'th message from now; 0 = none.
+    bool badWidthNext = false;
+    int syscallFd = -1;
+    unsigned long bytes = 0;
+
+    int message(const struct spi_ioc_transfer* xfer, int n) override {
+        if (syscallFd >= 0) ioctl(syscallFd, SPI_IOC_MESSAGE(1), xfer);     // ENOTTY, after the round trip.
+        if (failIn && --failIn == 0) return -1;
+        int total = NrfSimSpi::message(xfer, n);
+        bytes += total;
+        if (badWidthNext && ((const uint8_t*)(uintptr_t)xfer[0].tx_buf)[0] == SPIB_R_RX_PL_WID) {
+            badWidthNext = false;
+            ((uint8_t*)(uintptr_t)xfer[0].rx_buf)[1] = 0xFF;
+        }
+        return total;
+    }
+};
+
+    /* One sensor on Nrf24Lite, set up as RadioComms::setup() does, and the gateway's chip
+       read only through spi. */
+struct SpiRig {
+    VirtualAir air;
+    SimGateway gateway;
+    CheckSpi spi;
+    NrfSpiBatch batch;
+    NrfSim chip;
+    ArduinoBoard board;
+    tinyLite::Nrf24Lite radio;
+
+    SpiRig(uint64_t seed)
+        : air(seed), gateway(air, 1), spi(&gateway.chip()), batch(&spi), chip(air),
+          board(air, chip, CE_PIN, CSN_PIN), radio(CE_PIN, CSN_PIN) {
+        gateway.polling = false;
+        arduinoBoard = &board;
+        radio.begin();
+        radio.setPALevel(RF24_PA_LOW);
+        radio.enableDynamicPayloads();
+        radio.enableAckPayload();
+        radio.openWritingPipe((const uint8_t*)"1Node");
+        radio.openReadingPipe(1, (const uint8_t*)"2Node");
+        radio.stopListening();
+        air.advance(NRFSIM_SETTLE_MICROS);
+    }
+    ~SpiRig() { arduinoBoard = nullptr; }
+
+          /*    RETURNS: The number on the ACK payload the sensor got back; -1 if
+           *  it got none; -2 if write() failed. */
+    int send() {
+        uint8_t payload[PAYLOAD_BYTES], ack[ACK_BYTES], pipe;
+        memset(payload, 0x5A, sizeof(payload));
+        if (!radio.write(payload, sizeof(payload))) return -2;
+        if (!radio.available(&pipe)) return -1;
+        radio.read(ack, sizeof(ack));
+        return ack[0];
+    }
+
+          /*    PURPOSE: readAndReload() with ACK payload number n. */
+    int take(uint8_t n) {
+        uint8_t ack[ACK_BYTES] = {n}, buf[SPIB_MAX_PAYLOAD];
+        return batch.readAndReload(buf, 1, ack, sizeof(ack));
+    }
+
+          /*    PURPOSE: The same as rxPipe() and readAndReload() together, as RF24
+           *  does it on Linux: available(), getDynamicPayloadSize(), read() - the
+           *  payload, then RX_DR cleared - and writeAckPayload(), one ioctl each. */
+    int takePerCall(uint8_t n) {
+        uint8_t nop = SPIB_NOP, status = 0;
+        uint8_t widTx[2] = {SPIB_R_RX_PL_WID, SPIB_NOP}, widRx[2];
+        uint8_t payTx[1 + SPIB_MAX_PAYLOAD], payRx[1 + SPIB_MAX_PAYLOAD];
+        uint8_t clear[2] = {SPIB_W_REGISTER | SPIB_STATUS, SPIB_RX_DR};
+        uint8_t load[1 + ACK_BYTES] = {SPIB_W_ACK_PAYLOAD | 1, n};
+        memset(payTx, SPIB_NOP, sizeof(payTx));
+        payTx[0] = SPIB_R_RX_PAYLOAD;
+        auto one = [this](const uint8_t* tx, uint8_t* rx, uint32_t len) {
+            struct spi_ioc_transfer x;
+            memset(&x, 0, sizeof(x));
+            x.tx_buf = (unsigned long)tx;
+            x.rx_buf = (unsigned long)rx;
+            x.len = len;
+            x.speed_hz = SPIB_SPEED_HZ;
+            x.bits_per_word = 8;
+            return spi.message(&x, 1);
+        };
+        if (one(&nop, &status, 1) < 1 || ((status >> 1) & 0x07) > 5) return 0;
+        if (one(widTx, widRx, 2) < 1 || widRx[1] > SPIB_MAX_PAYLOAD) return -1;
+        one(payTx, payRx, sizeof(payTx));
+        one(clear, NULL, sizeof(clear));
+        one(load, NULL, sizeof(load));
+        return widRx[1];
+    }
+};
+
+struct SpiBench {
+    unsigned long packets = 0, misses = 0, messages = 0, bytes = 0;
+    uint64_t wallNanos = 0;
+};
+
+static SpiBench runSpiBench(uint64_t seed, bool batched) {
+    SpiBench b;
+    SpiRig rig(seed);
+    rig.spi.syscallFd = open("/dev/null", O_RDONLY);
+    for (unsigned long i = 0; i < SPI_BENCH_PACKETS; i++) {
+        if (rig.send() != (int)(i & 0xFF)) b.misses++;       // The ack loaded with the last packet.
+        unsigned long messages = rig.spi.messages(), bytes = rig.spi.bytes;
+        timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int width;
+        if (batched) width = rig.batch.rxPipe() >= 0 ? rig.take((i + 1) & 0xFF) : 0;
+        else width = rig.takePerCall((i + 1) & 0xFF);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        b.wallNanos += (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+        b.messages += rig.spi.messages() - messages;
+        b.bytes += rig.spi.bytes - bytes;
+        if (width == PAYLOAD_BYTES) b.packets++;
+    }
+    if (rig.spi.syscallFd >= 0) close(rig.spi.syscallFd);
+    return b;
+}
+
+int spiBatchCheck(uint64_t seed) {
+    vector<string> failures;
+    auto expect = [&failures](bool ok, const char* what) { if (!ok) failures.push_back(what); };
+    {
+        SpiRig rig(seed);
+        expect(rig.send() == 0, "1st packet didn't get the ACK payload loaded at set up");
+        expect(rig.take(1) == PAYLOAD_BYTES, "packet not read");
+
+        expect(rig.take(2) == 0, "empty FIFO not returned as 0");
+        expect(rig.send() == 2, "after an empty FIFO, the next packet didn't get the ack loaded then");
+        expect(rig.take(3) == PAYLOAD_BYTES, "packet after an empty FIFO not read");
+        expect(rig.send() == 3, "an older ACK payload still queued after an empty FIFO");
+
+        expect(rig.batch.rxPipe() == 1, "rxPipe() didn't see the packet on pipe 1");
+        rig.spi.failIn = 1;
+        expect(rig.take(4) == -1, "failed ioctl not returned as -1");
+        expect(rig.take(4) == PAYLOAD_BYTES, "packet not read once the ioctl went through");
+        expect(rig.send() == 4, "the held ack didn't go out after a failed ioctl");
+
+        rig.spi.badWidthNext = true;
+        expect(rig.take(5) == 0, "bad width not returned as 0");
+        uint8_t fifo = rig.gateway.chip().readRegister(NRFSIM_FIFO_STATUS);
+        expect(fifo & 0x01, "RX FIFO not flushed after a bad width");
+        expect(!(fifo & 0x10), "no ACK payload loaded after a bad width");
+        expect(rig.send() == 5, "the packet after a bad width didn't get the ack loaded with it");
+        expect(rig.take(6) == PAYLOAD_BYTES, "packet after a bad width not read");
+        expect(rig.send() == 6, "an older ACK payload still queued after a bad width");
+        expect(rig.batch.badWidths() == 1, "bad width not counted");
+
+            /* The 2nd ioctl failing once: run again, the ack still loaded. */
+        expect(rig.take(7) == PAYLOAD_BYTES, "packet not read");
+        rig.spi.failIn = 2;
+        expect(rig.take(8) == 0, "empty FIFO, 2nd ioctl failed once: not returned as 0");
+        expect(rig.send() == 8, "empty FIFO, 2nd ioctl failed once: the next packet didn't get the ack");
+        rig.spi.badWidthNext = true;
+        rig.spi.failIn = 2;
+        expect(rig.take(9) == 0, "bad width, 2nd ioctl failed once: not returned as 0");
+        expect(rig.send() == 9, "bad width, 2nd ioctl failed once: the next packet didn't get the ack");
+        expect(rig.take(10) == PAYLOAD_BYTES, "packet not read");
+        expect(rig.send() == 10, "an older ACK payload still queued after the 2nd ioctls were run again");
+    }
+
+    SpiBench batched = runSpiBench(seed, true);
+    SpiBench perCall = runSpiBench(seed, false);
+    if (batched.packets != SPI_BENCH_PACKETS || batched.misses) failures.push_back("batched: packets or acks lost");
+    if (perCall.packets != SPI_BENCH_PACKETS || perCall.misses) failures.push_back("per call: packets or acks lost");
+    if (batched.messages != 2UL * SPI_BENCH_PACKETS) failures.push_back("batched: not 2 ioctls a packet");
+
+    printf("RPi_RadioSim [%s] SPI batch check: NrfSpiBatch on a simulated spidev (NrfSimSpi), seed %llu\n",
+           VERSION, (unsigned long long)seed);
+    printf("  Packet, empty FIFO, failed ioctl, bad width, failed 2nd ioctl: %s\n",
+           failures.empty() ? "one ACK payload loaded after each, held acks sent" : "see below");
+    printf("%-10s %9s %11s %10s %12s %11s %13s\n", "path", "packets", "ioctls/pkt", "bytes/pkt", "wall us/pkt", "bus us/pkt", "total us/pkt");
+    for (int k = 0; k < 2; k++) {
+        const SpiBench& b = k ? perCall : batched;
+        double n = SPI_BENCH_PACKETS;
+        double wall = b.wallNanos / 1000.0 / n, bus = b.bytes / n * 8e6 / SPIB_SPEED_HZ;
+        printf("%-10s %9lu %11.2f %10.1f %12.2f %11.1f %13.1f\n", k ? "per call" : "batched", b.packets,
+               b.messages / n, b.bytes / n, wall, bus, wall + bus);
+    }
+    printf("  (wall: the receive code, the simulated chip, and a real ioctl() per message on /dev/null -\n"
+           "   system call entry and exit, not spidev's own work; bus: the bytes at %.0fMHz)\n", SPIB_SPEED_HZ / 1e6);
+    for (const string& f : failures) printf("  FAIL: %s\n", f.c_str());
+    bool pass = failures.empty();
+    printf("  %s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+
+uint64_t wallMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+
+
+/* =============================================================================
+   Class SimSensor
+   =============================================================================
+*/
+
+SimSensor::SimSensor(VirtualAir& air, uint16_t id, uint64_t intervalMicros)
+    : _air(air), _chip(air), _id(id), _interval(intervalMicros) {
+        /* Same as Nrf24Lite's NRF_INIT_TABLE, then openWritingPipe()/openReadingPipe(). */
+    _chip.writeRegister(NRFSIM_SETUP_AW, 3);
+    _chip.writeRegister(NRFSIM_SETUP_RETR, 0x5F);
+    _chip.writeRegister(NRFSIM_RF_CH, 76);
+    _chip.writeRegister(NRFSIM_RF_SETUP, 0x03);
+    _chip.writeRegister(NRFSIM_EN_AA, 0x3F);
+    _chip.writeRegister(NRFSIM_EN_RXADDR, 0x03);
+    _chip.writeRegister(NRFSIM_FEATURE, NRFSIM_EN_DPL | NRFSIM_EN_ACK_PAY);
+    _chip.writeRegister(NRFSIM_DYNPD, 0x3F);
+    writeBuf(NRFSIM_W_REGISTER | NRFSIM_RX_ADDR_P0, addrGateway, 5);
+    writeBuf(NRFSIM_W_REGISTER | NRFSIM_TX_ADDR, addrGateway, 5);
+    writeBuf(NRFSIM_W_REGISTER | NRFSIM_RX_ADDR_P1, addrSensor, 5);
+    _chip.writeRegister(NRFSIM_CONFIG, NRFSIM_EN_CRC | NRFSIM_CRCO | NRFSIM_PWR_UP);
+    _chip.onIrq([this]() { _air.at(_air.now() + SENSOR_REACT_MICROS, [this]() { irq(); }); });
+}
+
+
+void SimSensor::start(uint64_t firstReading) {
+    _air.at(firstReading, [this]() { reading(); });
+}
+
+
+void SimSensor::reading() {
+    memset(_payload, 0, sizeof(_payload));
+    _seq++;
+    memcpy(&_payload[0], &_id, 2);
+    memcpy(&_payload[2], &_seq, 4);
+    command(NRFSIM_FLUSH_TX);                   // A retry of the last reading may still be waiting.
+    send();
+    readings++;
+
+        /* +-5% so the sensors don't stay in lock step. */
+    uint64_t next = _interval - _interval / 20 + (uint64_t)(_air.random() * (_interval / 10));
+    _air.at(_air.now() + next, [this]() { reading(); });
+}
+
+
+void SimSensor::send() {
+    writeBuf(NRFSIM_W_TX_PAYLOAD, _payload, sizeof(_payload));
+    _chip.ce(true);
+}
+
+
+void SimSensor::irq() {
+    uint8_t tx = NRFSIM_NOP, status;
+    _chip.transaction(&tx, &status, 1);
+    if (status & (NRFSIM_TX_DS | NRFSIM_MAX_RT)) _chip.ce(false);
+
+    uint8_t arc = 0;
+    if (status & (NRFSIM_TX_DS | NRFSIM_MAX_RT)) {
+        arc = _chip.readRegister(NRFSIM_OBSERVE_TX) & 0x0F;
+        attempts += 1 + arc;
+    }
+    if (status & NRFSIM_TX_DS) {
+        delivered++;
+        retransmits += arc;
+        if (!(status & NRFSIM_RX_DR)) emptyAcks++;      // Error #3. The reading is in: nothing to send again.
+    }
+    if (status & NRFSIM_MAX_RT) {
+        failed++;
+        command(NRFSIM_FLUSH_TX);
+        uint32_t seq = _seq;                    // Try again, unless the next reading has started by then.
+        _air.at(_air.now() + SENSOR_RETRY_MICROS, [this, seq]() { if (seq == _seq) send(); });
+    }
+    if (status & NRFSIM_RX_DR) {
+        uint8_t wid[2] = {NRFSIM_R_RX_PL_WID, NRFSIM_NOP}, w[2];
+        _chip.transaction(wid, w, 2);
+        uint8_t buf[1 + NRFSIM_MAX_PAYLOAD] = {NRFSIM_R_RX_PAYLOAD};
+        _chip.transaction(buf, buf, 1 + (w[1] <= NRFSIM_MAX_PAYLOAD ? w[1] : NRFSIM_MAX_PAYLOAD));
+        acks++;
+    }
+    _chip.writeRegister(NRFSIM_STATUS, status & 0x70);
+}
+
+
+void SimSensor::command(uint8_t cmd) {
+    _chip.transaction(&cmd, NULL, 1);
+}
+
+
+void SimSensor::writeBuf(uint8_t cmd, const uint8_t* buf, uint8_t len) {
+    uint8_t tx[1 + NRFSIM_MAX_PAYLOAD];
+    tx[0] = cmd;
+    memcpy(&tx[1], buf, len);
+    _chip.transaction(tx, NULL, 1 + len);
+}
+
+
+
+/* =============================================================================
+   Class SimGateway
+   =============================================================================
+*/
+
+SimGateway::SimGateway(VirtualAir& air, unsigned int sensors)
+    : _air(air), _chip(air), _spi(&_chip), _batch(&_spi), _lastSeq(sensors + 1, 0) {
+    memset(_ack, 0, sizeof(_ack));
+    memset(last, 0, sizeof(last));
+    setUp();
+    _air.at(GATEWAY_POLL_MICROS, [this]() { poll(); });
+}
+
+
+void SimGateway::setUp() {
+        /* As RPi_CapDataReceive: RF24 begin() defaults, DPL + ACK payloads,
+           writing pipe 2Node, reading pipe 1 1Node, PA LOW, listening. */
+    uint8_t tx[6];
+    _chip.ce(false);
+    tx[0] = NRFSIM_FLUSH_RX; _chip.transaction(tx, NULL, 1);
+    tx[0] = NRFSIM_FLUSH_TX; _chip.transaction(tx, NULL, 1);
+    _chip.writeRegister(NRFSIM_SETUP_RETR, 0x5F);
+    _chip.writeRegister(NRFSIM_RF_CH, 76);
+    _chip.writeRegister(NRFSIM_RF_SETUP, 0x03);
+    _chip.writeRegister(NRFSIM_FEATURE, NRFSIM_EN_DPL | NRFSIM_EN_ACK_PAY);
+    _chip.writeRegister(NRFSIM_DYNPD, 0x3F);
+    tx[0] = NRFSIM_W_REGISTER | NRFSIM_RX_ADDR_P0; memcpy(&tx[1], addrSensor, 5); _chip.transaction(tx, NULL, 6);
+    tx[0] = NRFSIM_W_REGISTER | NRFSIM_TX_ADDR;    memcpy(&tx[1], addrSensor, 5); _chip.transaction(tx, NULL, 6);
+    tx[0] = NRFSIM_W_REGISTER | NRFSIM_RX_ADDR_P1; memcpy(&tx[1], addrGateway, 5); _chip.transaction(tx, NULL, 6);
+    _chip.writeRegister(NRFSIM_EN_RXADDR, 0x03);
+    _chip.writeRegister(NRFSIM_CONFIG, NRFSIM_EN_CRC | NRFSIM_CRCO | NRFSIM_PWR_UP | NRFSIM_PRIM_RX);
+    _chip.ce(true);
+
+    uint8_t ackTx[1 + ACK_BYTES] = {NRFSIM_W_ACK_PAYLOAD | 1};
+    memcpy(&ackTx[1], _ack, ACK_BYTES);
+    _chip.transaction(ackTx, NULL, sizeof(ackTx));                 // ACK payload, as radioService() does.
+}
+
+
+void SimGateway::poll() {
+    _air.at(_air.now() + GATEWAY_POLL_MICROS, [this]() { poll(); });
+    if (!polling) return;
+    if (!ackPayloads) {
+        uint8_t flush = NRFSIM_FLUSH_TX;                    // Whatever setUp() or the last reload loaded.
+        _chip.transaction(&flush, NULL, 1);
+    }
+    uint8_t buf[NRFSIM_MAX_PAYLOAD];
+    while (_batch.rxPipe() >= 0) {
+        int width = _batch.readAndReload(buf, 1, _ack, sizeof(_ack));
+        if (!ackPayloads) {
+            uint8_t flush = NRFSIM_FLUSH_TX;
+            _chip.transaction(&flush, NULL, 1);
+        }
+        if (width <= 0) break;
+        packets++;
+        memcpy(last, buf, sizeof(last));
+        if (onPacket) onPacket();
+        uint16_t id;
+        uint32_t seq;
+        memcpy(&id, &buf[idAt], 2);
+        memcpy(&seq, &buf[seqAt], 4);
+        if (id >= _lastSeq.size()) continue;
+        if (seq == _lastSeq[id]) duplicates++;
+        else readings++;
+        _lastSeq[id] = seq;
+    }
+}
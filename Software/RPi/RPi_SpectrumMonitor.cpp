@@ -0,0 +1,550 @@
+/*  ATTiny84 Moisture Sensor Project - Raspberry Pi Spectrum Monitor
+ *  -----------------------------------------------------------------------------------------------------
+ *
+ *  Raspberry Pi C++ program to continuously monitor the 2.4GHz band, channel by channel, using an
+ *  nRF24 radio's carrier detect. This is a re-write of the archived channel scanner,
+ *  /archive/nRF24-with-Rpi/scanner_ch4C-highlighted.cpp, into something that can be left running.
+ *
+ *  What is different from that scanner --:
+ *      > Dwell time per channel and the number of reps per sweep are command line parameters
+ *        rather than the hard-coded delayMicroseconds(128) and 100 reps.
+ *      > Each channel keeps a rolling occupancy over the last N sweeps, so the display shows the
+ *        'busyness' of a channel over time, not just the last sweep.
+ *      > Every sweep is written as a fixed-size frame into a 'ring file' (binary, or CSV if
+ *        asked for) so that other programs can read it. The file never grows past the number of
+ *        frames it is sized for; the oldest frame is overwritten.
+ *      > The live terminal heat map is redrawn at a fixed frame rate that has nothing to do with
+ *        how long a sweep takes. A slow sweep (long dwell, many reps) still gets a smooth display.
+ *      > The CE pin and spidev are parameters, so the monitor can run on a 2nd radio module
+ *        alongside RPi_CapDataReceive (which owns CE 22 / spidev0.0).
+ *      > A benchmark mode (-b) runs the scanning engine against a simulated radio and reports
+ *        sweeps per second and CPU time per sweep.
+ *
+ *  Usage --:
+ *      RPi_SpectrumMonitor [-d dwellMicros] [-r reps] [-w windowSweeps] [-o ringFile]
+ *                          [-n ringFrames] [-f bin|csv] [-F framesPerSec] [-c highlightChan]
+ *                          [-ce cePin] [-csn spiDev] [-q] [-b sweeps]
+ *
+ * 10/19/2026-rel02:
+ *      > The heat map's "last" row is the last completed sweep. It was the sweep in progress,
+ *        part counted, as the display is redrawn in the middle of a sweep.
+ *      > The CSV ring file starts with a line giving the number of frames written and the slot
+ *        of the newest, kept up to date as the binary file's header is, so a reader can find
+ *        the latest frame.
+ *
+ * 10/19/2026-rel01:
+ *      > Initial program.
+ */
+#define VERSION "10-19-2026 rel 02"
+
+#define NUM_CHANNELS 126            // nRF24 channels 0 .. 125
+#define DEFAULT_DWELL_MICROS 128    // Same dwell the original scanner used.
+#define DEFAULT_REPS 100
+#define DEFAULT_WINDOW 20           // Sweeps in the rolling occupancy window.
+#define DEFAULT_RING_FRAMES 4096    // Frames kept in the ring file.
+#define DEFAULT_FPS 4               // Heat map redraw rate.
+#define DEFAULT_RING_FILEPATH "/home/spectrum.ring"
+#define MAX_WINDOW 1024
+
+#include <cstdint>
+#include <cstdio>      // snprintf()
+#include <cstddef>     // offsetof()
+#include <cstdlib>     // atoi(), strtol()
+#include <cstring>     // memset(), strcmp()
+#include <iostream>    // cout, cerr, endl
+#include <time.h>      // CLOCK_MONOTONIC, timespec, clock_gettime()
+#include <fcntl.h>     // open()
+#include <unistd.h>    // pwrite(), write(), close()
+#include <RF24/RF24.h> // RF24, delayMicroseconds()
+
+using namespace std;
+
+
+/* =============================================================================
+   Class definitions
+   =============================================================================
+*/
+
+/* Stand-in for the nRF24 chip, used by the benchmark mode. Each channel gets
+   a fixed carrier probability shaped like what the real scanner shows here: a
+   WiFi hump on the low channels, a little noise everywhere, and my sensor
+   chattering on 0x4C. Uses a xorshift PRNG so runs are repeatable. */
+class SimCarrierRadio {
+    public:
+        SimCarrierRadio(uint32_t seed = 0x2545F491);
+        void setChannel(uint8_t ch) { _channel = ch; }
+        void startListening() {}
+        void stopListening() {}
+        bool testCarrier();
+
+    private:
+        uint32_t _rng;
+        uint8_t _channel = 0;
+        uint32_t _threshold[NUM_CHANNELS];  // carrier present if rng < threshold
+};
+
+
+/* The scanning engine. Does one sweep across all channels at a time, 'reps'
+   times per channel, and folds the result into the rolling occupancy window.
+   It is templated on the radio type so the same code runs against the real
+   RF24 object and the SimCarrierRadio. */
+class SpectrumScanner {
+    public:
+        SpectrumScanner(unsigned int dwellMicros, unsigned int reps, unsigned int window);
+
+            /* Do one full sweep. 'tick' is called once per rep so a caller can
+               do time-driven work (like redrawing the display) in the middle
+               of a long sweep. */
+        template <class Radio, class Tick>
+        void sweep(Radio& radio, Tick tick);
+
+        uint32_t sweepCount() const { return _sweepCount; }
+        unsigned int reps() const { return _reps; }
+        unsigned int dwell() const { return _dwellMicros; }
+        const uint16_t* lastSweep() const { return _lastHits; }
+        uint8_t occupancy(unsigned int ch) const;                   // 0..255 over the rolling window
+        uint8_t lastOccupancy(unsigned int ch) const;               // 0..255 for the last sweep only
+
+    private:
+        unsigned int _dwellMicros;
+        unsigned int _reps;
+        unsigned int _window;
+        uint32_t _sweepCount = 0;
+        uint16_t _hits[NUM_CHANNELS];                               // carrier hits in the sweep in progress
+        uint16_t _lastHits[NUM_CHANNELS];                           // ... and in the last completed sweep
+        uint16_t _history[MAX_WINDOW][NUM_CHANNELS];                // hits per sweep, rolling window
+        uint32_t _windowSum[NUM_CHANNELS];                          // running sum over _history
+};
+
+
+/* Writes every sweep as one fixed-size record into a ring of 'frames'
+   records. Binary layout is RingFileHeader followed by RingFrame records. The
+   CSV layout is a status line (frames written, slot of the newest), a column
+   header line, then fixed-width lines, so a record can be overwritten in
+   place. Either way the count is only updated after the frame is written. */
+class RingFileWriter {
+    public:
+        bool open(const char* path, unsigned int frames, bool csv, const SpectrumScanner& scanner);
+        void write(const SpectrumScanner& scanner);
+        void close();
+
+    private:
+        struct RingFileHeader {
+            char magic[8];              // "NRFSCAN1"
+            uint32_t headerSize;
+            uint32_t frameSize;
+            uint32_t frames;            // capacity of the ring
+            uint32_t channels;
+            uint32_t reps;
+            uint32_t dwellMicros;
+            uint64_t writeCount;        // total frames written; slot = (writeCount-1) % frames is the newest
+            uint8_t reserved[24];
+        };
+        struct RingFrame {
+            uint64_t timeMicros;        // CLOCK_REALTIME at end of sweep
+            uint32_t sweep;
+            uint8_t occupancy[NUM_CHANNELS];    // hits scaled 0..255 against reps
+            uint8_t pad[2];
+        };
+        static const unsigned int CSV_FRAME_SIZE = 17 + 11 + NUM_CHANNELS * 4;
+        static const unsigned int CSV_STATUS_SIZE = 67;             // "# frames=%010u written=%020llu newest=%010u\n"
+
+        int _fd = -1;
+        bool _csv = false;
+        unsigned int _frames = 0;
+        off_t _dataStart = 0;
+        uint64_t _writeCount = 0;
+        char _csvLine[CSV_FRAME_SIZE + 1];
+
+        int csvStatus(char* line);
+};
+
+
+/* Live terminal heat map. Each frame is assembled into one buffer and sent
+   with a single write() so the terminal never shows half a frame. */
+class HeatMapDisplay {
+    public:
+        HeatMapDisplay(unsigned int fps, int highlightChannel);
+        bool frameDue();                                    // cheap; fine to call every rep
+        void render(const SpectrumScanner& scanner);
+
+    private:
+        long _frameNanos;
+        struct timespec _nextFrame = {0, 0};
+        int _highlight;
+        bool _firstTime = true;
+        char _buf[16384];
+        size_t _len = 0;
+        void put(const char* s);
+        void putChar(char c) { _buf[_len++] = c; }
+};
+
+
+/* =============================================================================
+   Function prototypes
+   =============================================================================
+*/
+void runBenchmark(unsigned int sweeps, unsigned int reps, unsigned int window);     // simulated radio, no display
+double elapsedSeconds(const struct timespec& from, const struct timespec& to);     // difference of two timespecs
+
+
+int main(int argc, char** argv) {
+    unsigned int dwellMicros = DEFAULT_DWELL_MICROS;
+    unsigned int reps = DEFAULT_REPS;
+    unsigned int window = DEFAULT_WINDOW;
+    unsigned int ringFrames = DEFAULT_RING_FRAMES;
+    unsigned int fps = DEFAULT_FPS;
+    unsigned int benchSweeps = 0;
+    int highlight = 0x4C;                       // My sensor's channel.
+    int cePin = 22;
+    int csnDev = 0;
+    bool csv = false;
+    bool quiet = false;
+    const char* ringPath = DEFAULT_RING_FILEPATH;
+
+    for (int i = 1; i < argc; ++i) {
+        bool hasArg = (i + 1 < argc);
+        if (strcmp(argv[i], "-d") == 0 && hasArg) dwellMicros = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && hasArg) reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && hasArg) window = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && hasArg) ringPath = argv[++i];
+        else if (strcmp(argv[i], "-n") == 0 && hasArg) ringFrames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && hasArg) csv = (strcmp(argv[++i], "csv") == 0);
+        else if (strcmp(argv[i], "-F") == 0 && hasArg) fps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && hasArg) highlight = strtol(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-ce") == 0 && hasArg) cePin = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-csn") == 0 && hasArg) csnDev = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && hasArg) benchSweeps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-q") == 0) quiet = true;
+        else {
+            cerr << "Unrecognized parameter: " << argv[i] << endl;
+            return -1;
+        }
+    }
+    if (reps < 1 || reps > 65535) reps = DEFAULT_REPS;
+    if (window < 1 || window > MAX_WINDOW) window = DEFAULT_WINDOW;
+    if (ringFrames < 1) ringFrames = DEFAULT_RING_FRAMES;
+    if (fps < 1) fps = 1;
+
+    if (benchSweeps > 0) {
+        runBenchmark(benchSweeps, reps, window);
+        return 0;
+    }
+
+    cout << argv[0] << " [" << VERSION << "] dwell=" << dwellMicros << "us reps=" << reps
+         << " window=" << window << " sweeps" << endl;
+
+    RF24 radio(cePin, csnDev);
+    if (!radio.begin()) {
+        cout << "ERROR: nRF24 radio hardware is not responding." << endl;
+        return -1;
+    }
+    radio.setAutoAck(false);
+    radio.startListening();                     // Get into standby mode
+    radio.stopListening();
+
+    static SpectrumScanner scanner(dwellMicros, reps, window);     // static: the window history is ~250KB
+    RingFileWriter ring;
+    if (!ring.open(ringPath, ringFrames, csv, scanner)) {
+        cerr << "Error opening the ring file: " << ringPath << endl;
+        return -1;
+    }
+    HeatMapDisplay display(fps, highlight);
+
+    while (true) {
+        scanner.sweep(radio, [&]() {
+            if (!quiet && display.frameDue()) display.render(scanner);
+        });
+        ring.write(scanner);
+    }
+
+    ring.close();
+    return 0;
+
+} // Main()
+
+
+
+/* =============================================================================
+   Local Functions
+   =============================================================================
+*/
+
+/* Run the scanning engine flat out against the simulated radio and report
+   how fast it goes. There is no dwell here, so what is being measured is the
+   per-channel overhead of the engine itself (channel loop, carrier count,
+   rolling window update), which is what would eat into the dwell budget on
+   the real radio.
+ */
+void runBenchmark(unsigned int sweeps, unsigned int reps, unsigned int window) {
+    static SpectrumScanner scanner(0, reps, window);
+    SimCarrierRadio sim;
+    struct timespec wallStart, wallEnd, cpuStart, cpuEnd;
+
+    clock_gettime(CLOCK_MONOTONIC, &wallStart);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+    for (unsigned int k = 0; k < sweeps; k++) {
+        scanner.sweep(sim, []() {});
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuEnd);
+    clock_gettime(CLOCK_MONOTONIC, &wallEnd);
+
+    double wall = elapsedSeconds(wallStart, wallEnd);
+    double cpu = elapsedSeconds(cpuStart, cpuEnd);
+    cout << "Benchmark: " << sweeps << " sweeps x " << reps << " reps x " << NUM_CHANNELS << " channels (simulated radio)" << endl;
+    cout << "  sweeps/sec:     " << sweeps / wall << endl;
+    cout << "  CPU us/sweep:   " << cpu * 1e6 / sweeps << endl;
+    cout << "  CPU ns/channel: " << cpu * 1e9 / ((double)sweeps * reps * NUM_CHANNELS) << endl;
+    cout << "  ch 0x4C occupancy: " << (unsigned int)scanner.occupancy(0x4C) * 100 / 255 << "%" << endl;
+}
+
+
+double elapsedSeconds(const struct timespec& from, const struct timespec& to) {
+    return (to.tv_sec - from.tv_sec) + (to.tv_nsec - from.tv_nsec) / 1e9;
+}
+
+
+
+/* CLASS SimCarrierRadio
+   ============================================================================
+   */
+SimCarrierRadio::SimCarrierRadio(uint32_t seed) {
+    _rng = seed;
+    for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) {
+        double p = 0.01;                                // background noise
+        if (ch >= 2 && ch <= 24) p = 0.35;              // WiFi channel 1 - 22MHz wide
+        if (ch >= 37 && ch <= 59) p = 0.15;             // WiFi channel 6
+        if (ch == 0x4C) p = 0.05;                       // sensor
+        _threshold[ch] = (uint32_t)(p * 4294967295.0);
+    }
+}
+
+bool SimCarrierRadio::testCarrier() {
+    _rng ^= _rng << 13;
+    _rng ^= _rng >> 17;
+    _rng ^= _rng << 5;
+    return _rng < _threshold[_channel];
+}
+
+
+
+/* CLASS SpectrumScanner
+   ============================================================================
+   */
+SpectrumScanner::SpectrumScanner(unsigned int dwellMicros, unsigned int reps, unsigned int window) {
+    _dwellMicros = dwellMicros;
+    _reps = reps;
+    _window = window;
+    memset(_hits, 0, sizeof(_hits));
+    memset(_lastHits, 0, sizeof(_lastHits));
+    memset(_history, 0, sizeof(_history));
+    memset(_windowSum, 0, sizeof(_windowSum));
+}
+
+
+template <class Radio, class Tick>
+void SpectrumScanner::sweep(Radio& radio, Tick tick) {
+    memset(_hits, 0, sizeof(_hits));
+
+    unsigned int repCounter = _reps;
+    while (repCounter--) {
+        for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) {
+            radio.setChannel(ch);
+            radio.startListening();                             // Listen for a little
+            if (_dwellMicros) delayMicroseconds(_dwellMicros);
+            radio.stopListening();
+            _hits[ch] += radio.testCarrier();                   // Did we get a carrier?
+        }
+        tick();
+    }
+
+        /* Roll the window - drop the oldest sweep, add this one. */
+    uint16_t* slot = _history[_sweepCount % _window];
+    for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) {
+        _windowSum[ch] += _hits[ch];
+        _windowSum[ch] -= slot[ch];
+        slot[ch] = _hits[ch];
+    }
+    memcpy(_lastHits, _hits, sizeof(_lastHits));                // What the display and ring file show.
+    _sweepCount++;
+}
+
+
+uint8_t SpectrumScanner::occupancy(unsigned int ch) const {
+    uint32_t sweepsInWindow = (_sweepCount < _window) ? _sweepCount : _window;
+    if (sweepsInWindow == 0) return 0;
+    return (uint8_t)((uint64_t)_windowSum[ch] * 255 / ((uint64_t)sweepsInWindow * _reps));
+}
+
+
+uint8_t SpectrumScanner::lastOccupancy(unsigned int ch) const {
+    return (uint8_t)((uint32_t)_lastHits[ch] * 255 / _reps);
+}
+
+
+
+/* CLASS RingFileWriter
+   ============================================================================
+   */
+bool RingFileWriter::open(const char* path, unsigned int frames, bool csv, const SpectrumScanner& scanner) {
+    _fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) return false;
+    _csv = csv;
+    _frames = frames;
+    _writeCount = 0;
+
+    if (_csv) {
+        char header[CSV_STATUS_SIZE + 32 + NUM_CHANNELS * 5];
+        int len = csvStatus(header);
+        len += snprintf(header + len, sizeof(header) - len, "time_us         ,sweep     ");
+        for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) {
+            len += snprintf(header + len, sizeof(header) - len, ",%03X", ch);
+        }
+        header[len++] = '\n';
+        _dataStart = len;
+        return pwrite(_fd, header, len, 0) == len;
+    }
+
+    RingFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "NRFSCAN1", 8);
+    hdr.headerSize = sizeof(RingFileHeader);
+    hdr.frameSize = sizeof(RingFrame);
+    hdr.frames = frames;
+    hdr.channels = NUM_CHANNELS;
+    hdr.reps = scanner.reps();
+    hdr.dwellMicros = scanner.dwell();
+    _dataStart = sizeof(RingFileHeader);
+    return pwrite(_fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr);
+}
+
+
+void RingFileWriter::write(const SpectrumScanner& scanner) {
+    if (_fd < 0) return;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t timeMicros = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    unsigned int slot = _writeCount % _frames;
+
+    if (_csv) {
+        int len = snprintf(_csvLine, sizeof(_csvLine), "%016llu,%010u", (unsigned long long)timeMicros, scanner.sweepCount());
+        for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) {
+            unsigned int v = scanner.lastOccupancy(ch);
+            _csvLine[len++] = ',';
+            _csvLine[len++] = '0' + v / 100;
+            _csvLine[len++] = '0' + (v / 10) % 10;
+            _csvLine[len++] = '0' + v % 10;
+        }
+        _csvLine[len++] = '\n';
+        pwrite(_fd, _csvLine, len, _dataStart + (off_t)slot * CSV_FRAME_SIZE);
+        _writeCount++;
+        char status[CSV_STATUS_SIZE + 1];
+        pwrite(_fd, status, csvStatus(status), 0);
+        return;
+    }
+
+    RingFrame frame;
+    frame.timeMicros = timeMicros;
+    frame.sweep = scanner.sweepCount();
+    for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) frame.occupancy[ch] = scanner.lastOccupancy(ch);
+    frame.pad[0] = frame.pad[1] = 0;
+    pwrite(_fd, &frame, sizeof(frame), _dataStart + (off_t)slot * sizeof(RingFrame));
+
+        /* Publish the frame only after it is written. */
+    _writeCount++;
+    pwrite(_fd, &_writeCount, sizeof(_writeCount), offsetof(RingFileHeader, writeCount));
+}
+
+
+/* The CSV file's first line: frames written so far, and the slot (0 is the
+   line after the column headers) of the newest, 0 until one is written.
+   Always CSV_STATUS_SIZE characters.
+ */
+int RingFileWriter::csvStatus(char* line) {
+    unsigned int newest = _writeCount ? (unsigned int)((_writeCount - 1) % _frames) : 0;
+    return snprintf(line, CSV_STATUS_SIZE + 1, "# frames=%010u written=%020llu newest=%010u\n", _frames,
+                    (unsigned long long)_writeCount, newest);
+}
+
+
+void RingFileWriter::close() {
+    if (_fd >= 0) ::close(_fd);
+    _fd = -1;
+}
+
+
+
+/* CLASS HeatMapDisplay
+   ============================================================================
+   */
+HeatMapDisplay::HeatMapDisplay(unsigned int fps, int highlightChannel) {
+    _frameNanos = 1000000000L / fps;
+    _highlight = highlightChannel;
+}
+
+
+bool HeatMapDisplay::frameDue() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec < _nextFrame.tv_sec || (now.tv_sec == _nextFrame.tv_sec && now.tv_nsec < _nextFrame.tv_nsec)) {
+        return false;
+    }
+    _nextFrame.tv_sec = now.tv_sec;
+    _nextFrame.tv_nsec = now.tv_nsec + _frameNanos;
+    while (_nextFrame.tv_nsec >= 1000000000L) {
+        _nextFrame.tv_sec++;
+        _nextFrame.tv_nsec -= 1000000000L;
+    }
+    return true;
+}
+
+
+void HeatMapDisplay::put(const char* s) {
+    while (*s) _buf[_len++] = *s++;
+}
+
+
+/* Draw the heat map
+   ----------------------------------------------------------------------------
+   Two header lines with the channel number in hex (high digit, then low
+   digit), as the original scanner did; then a line for the rolling occupancy
+   and a line for the last completed sweep. Each cell is one character, shaded
+   by a 256-color background running from blue (quiet) to red (busy).
+ */
+void HeatMapDisplay::render(const SpectrumScanner& scanner) {
+    static const char hexDigit[] = "0123456789ABCDEF";
+    static const char glyph[] = " .:-=+*#%@";
+    static const uint8_t color[] = {17, 18, 19, 25, 31, 37, 71, 142, 178, 208, 196};
+    char tmp[64];
+    _len = 0;
+
+    if (_firstTime) {
+        put("\033[2J");                             // clear screen
+        _firstTime = false;
+    }
+    put("\033[H");                                  // home
+
+    snprintf(tmp, sizeof(tmp), "Sweep %-10u dwell %uus reps %u\033[K\n", scanner.sweepCount(), scanner.dwell(), scanner.reps());
+    put(tmp);
+    for (int row = 0; row < 2; row++) {
+        put("     ");
+        for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) {
+            if ((int)ch == _highlight) put("\033[7m");
+            putChar(hexDigit[row == 0 ? (ch >> 4) : (ch & 0xf)]);
+            if ((int)ch == _highlight) put("\033[0m");
+        }
+        put("\n");
+    }
+    for (int row = 0; row < 2; row++) {
+        put(row == 0 ? "roll " : "last ");
+        for (unsigned int ch = 0; ch < NUM_CHANNELS; ch++) {
+            unsigned int v = (row == 0) ? scanner.occupancy(ch) : scanner.lastOccupancy(ch);
+            snprintf(tmp, sizeof(tmp), "\033[48;5;%um", color[v * 10 / 255]);
+            put(tmp);
+            putChar(v ? glyph[1 + v * 8 / 255] : glyph[0]);
+        }
+        put("\033[0m\n");
+    }
+
+    ::write(STDOUT_FILENO, _buf, _len);
+}
@@ -0,0 +1,179 @@
+// Class: RadioHealth - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef RadioHealth_h
+#define RadioHealth_h
+
+#include <cstdint>
+#include "SpiBatch.h"       // NrfSpiBatch::readRegister()
+#include "FixedLine.h"      // FixedLine
+
+/************************************************************************************************
+*
+*    PURPOSE: Tells whether the nRF24L01+ is still there and still set up the way it was. A radio
+* can stop working without anything failing: a brownout resets its registers to their power-on
+* values (off channel 76, out of RX, no dynamic payloads), a loose wire or a hung SPI bus reads
+* every byte as 0xFF or 0x00. Either way no more packets come in, and from the inside that looks
+* just like sensors that have nothing to say. check() reads back STATUS and the registers the
+* set up wrote, and compares them with what they were just after it.
+*
+*    USAGE:
+*    1. Set the radio up and start listening, then learn() the registers as they are. A radio
+*  that is not powered up in RX (CONFIG) isn't learned - that catches a bus that reads 0x00.
+*    2. check() every so often (~1s), from the thread that owns the radio. It returns whether
+*  all is well; fault() says what was wrong with the last check, describe() puts it in words.
+*
+*    NOTE:
+*    1. Checks STATUS (bit 7 always reads 0, RX_P_NO is never 6) and CONFIG, EN_AA, EN_RXADDR,
+*  SETUP_AW, RF_CH, RF_SETUP, DYNPD, FEATURE: 8 one-register ioctls a check, STATUS coming
+*  back with each.
+*    2. Nothing here changes the radio. What to do about a bad one is up to the caller.
+*/
+
+#define RADIO_HEALTH_REGS 8
+
+    /* fault() kinds, in its top byte. */
+#define RADIO_FAULT_NONE 0
+#define RADIO_FAULT_SPI 1               // The ioctl failed.
+#define RADIO_FAULT_STATUS 2            // STATUS can't be right.
+#define RADIO_FAULT_REGISTER 3          // A register isn't what set up left it as.
+#define RADIO_FAULT_LIBRARY 4           // For the caller: RF24's failureDetected, or not connected.
+#define RADIO_FAULT_SILENCE 5           // For the caller: nothing received for far longer than usual.
+
+
+class RadioHealth {
+
+  public:
+
+    RadioHealth() {}
+
+          /*    PURPOSE: Take the registers as they are now as the good values.
+           *    RETURNS: False if they can't be read, STATUS is already wrong or
+           *  the radio isn't listening; fault() says which. */
+    bool learn(NrfSpiBatch& spi);
+
+          /*    PURPOSE: Read back STATUS and the registers, compare with what
+           *  learn() saw.
+           *    RETURNS: True if all is well. */
+    bool check(NrfSpiBatch& spi);
+
+    bool learned() const { return _learned; }
+
+          /*    PURPOSE: What the last check() found, packed so it can be passed
+           *  between threads in one word: kind << 24 | register << 16 |
+           *  value read << 8 | value expected. 0 if all was well. */
+    uint32_t fault() const { return _fault; }
+
+          /*    PURPOSE: Put a fault() in words, e.g. "RF_CH read 0x2, set up as 0x4c". */
+    static void describe(uint32_t fault, FixedLine& line);
+
+    unsigned long checks = 0;
+    unsigned long failures = 0;
+
+  private:
+    uint8_t _expect[RADIO_HEALTH_REGS];
+    bool _learned = false;
+    uint32_t _fault = RADIO_FAULT_NONE;
+
+    static const uint8_t* regs();
+    static const char* regName(uint8_t reg);
+    static bool statusOk(uint8_t status) { return !(status & 0x80) && ((status >> 1) & 0x07) != 6; }
+    static uint32_t pack(uint32_t kind, uint8_t reg, uint8_t read, uint8_t expect) {
+        return kind << 24 | (uint32_t)reg << 16 | (uint32_t)read << 8 | expect;
+    }
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline const uint8_t* RadioHealth::regs() {
+        /* CONFIG, EN_AA, EN_RXADDR, SETUP_AW, RF_CH, RF_SETUP, DYNPD, FEATURE */
+    static const uint8_t r[RADIO_HEALTH_REGS] = {0x00, 0x01, 0x02, 0x03, 0x05, 0x06, 0x1C, 0x1D};
+    return r;
+}
+
+
+inline const char* RadioHealth::regName(uint8_t reg) {
+    switch (reg) {
+        case 0x00: return "CONFIG";
+        case 0x01: return "EN_AA";
+        case 0x02: return "EN_RXADDR";
+        case 0x03: return "SETUP_AW";
+        case 0x05: return "RF_CH";
+        case 0x06: return "RF_SETUP";
+        case 0x07: return "STATUS";
+        case 0x1C: return "DYNPD";
+        case 0x1D: return "FEATURE";
+    }
+    return "register";
+}
+
+
+inline bool RadioHealth::learn(NrfSpiBatch& spi) {
+    const uint8_t listening = 0x03;                         // CONFIG PWR_UP | PRIM_RX
+    _learned = false;
+    for (int k = 0; k < RADIO_HEALTH_REGS; k++) {
+        uint8_t status = 0;
+        int v = spi.readRegister(regs()[k], &status);
+        if (v < 0) _fault = pack(RADIO_FAULT_SPI, regs()[k], 0, 0);
+        else if (!statusOk(status)) _fault = pack(RADIO_FAULT_STATUS, 0x07, status, 0);
+        else if (regs()[k] == 0x00 && (v & listening) != listening) _fault = pack(RADIO_FAULT_REGISTER, 0x00, v, v | listening);
+        else {
+            _expect[k] = v;
+            continue;
+        }
+        return false;
+    }
+    _learned = true;
+    _fault = RADIO_FAULT_NONE;
+    return true;
+}
+
+
+inline bool RadioHealth::check(NrfSpiBatch& spi) {
+    checks++;
+    _fault = RADIO_FAULT_NONE;
+    for (int k = 0; k < RADIO_HEALTH_REGS && _fault == RADIO_FAULT_NONE; k++) {
+        uint8_t status = 0;
+        int v = spi.readRegister(regs()[k], &status);
+        if (v < 0) _fault = pack(RADIO_FAULT_SPI, regs()[k], 0, 0);
+        else if (!statusOk(status)) _fault = pack(RADIO_FAULT_STATUS, 0x07, status, 0);
+        else if (_learned && v != _expect[k]) _fault = pack(RADIO_FAULT_REGISTER, regs()[k], v, _expect[k]);
+    }
+    if (_fault != RADIO_FAULT_NONE) failures++;
+    return _fault == RADIO_FAULT_NONE;
+}
+
+
+inline void RadioHealth::describe(uint32_t fault, FixedLine& line) {
+    uint8_t reg = fault >> 16, read = fault >> 8, expect = fault;
+    switch (fault >> 24) {
+        case RADIO_FAULT_NONE:
+            line.add("OK");
+            break;
+        case RADIO_FAULT_SPI:
+            line.add("SPI ioctl failed reading ").add(regName(reg));
+            break;
+        case RADIO_FAULT_STATUS:
+            line.add("STATUS read 0x").add((unsigned int)read, 16);
+            break;
+        case RADIO_FAULT_REGISTER:
+            line.add(regName(reg)).add(" read 0x").add((unsigned int)read, 16).add(", set up as 0x").add((unsigned int)expect, 16);
+            break;
+        case RADIO_FAULT_LIBRARY:
+            line.add("RF24 says the radio failed");
+            break;
+        case RADIO_FAULT_SILENCE:
+            line.add("nothing received for much longer than usual");
+            break;
+        default:
+            line.add("fault 0x").add(fault, 16);
+    }
+}
+
+#endif
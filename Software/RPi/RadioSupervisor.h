@@ -0,0 +1,178 @@
+// Class: RadioSupervisor - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef RadioSupervisor_h
+#define RadioSupervisor_h
+
+#include <cstdint>
+#include <functional>
+#include <time.h>           // clock_gettime()
+#include "RadioHealth.h"    // RadioHealth, RADIO_FAULT_
+#include "SpiBatch.h"       // NrfSpiBatch
+
+/************************************************************************************************
+*
+*    PURPOSE: Notices when the radio has stopped working, and sets it up again, without the
+* process restarting: queues, sensor state and the log carry on as they were. Something is
+* wrong when any of these is true:
+*       > a RadioHealth check fails: STATUS impossible, or a register not as set up (brownout,
+*         lost SPI sync);
+*       > the caller says so, e.g. RF24's failureDetected;
+*       > nothing has been received for silenceGaps times the usual gap between packets
+*         (clamped to silenceMinMicros .. silenceMaxMicros), once packets have been coming in.
+*         That catches a radio that reads back fine but hears nothing, e.g. CE stuck low.
+* The set up given to the constructor is then run again - the whole of it: begin(), dynamic
+* payloads, ACK payloads, PA level, pipes, the ACK payload re-loaded, back into RX - and the
+* registers learned afresh. If that fails it is tried again after retryMinMicros, doubling up
+* to retryMaxMicros, until it works.
+*
+*    USAGE:
+*    1. Construct in the thread that owns the radio, with the batched SPI handle (or NULL to
+*  skip the register check) and the set up function. Change the intervals if need be.
+*    2. Once the radio is set up and listening, start().
+*    3. received() for each packet taken off the radio.
+*    4. When due(), service(), passing anything else known to be wrong. It returns true if
+*  the radio was just set up again. fault() is what is wrong now (RADIO_FAULT_NONE when all
+*  is well), lastCause() what the last recovery was for, lastSetUpMicros() how long it took.
+*
+*    NOTE:
+*    1. A recovery for silence doubles the next silence window (up to 8x), until a packet
+*  comes in, so a network that has really gone quiet isn't set up again and again.
+*/
+
+#define RADIO_SILENCE_STRIKES 3         // At most 2^3 times the silence window.
+
+
+class RadioSupervisor {
+
+  public:
+
+          /*    PURPOSE: Constructor. setUp() sets the radio up from scratch and
+           *  starts it listening; false if the radio didn't respond. */
+    RadioSupervisor(NrfSpiBatch* spi, std::function<bool()> setUp) : _spi(spi), _setUp(setUp) {}
+
+    uint64_t checkMicros = 1000000ULL;              // How often to check.
+    uint64_t silenceMinMicros = 20 * 60000000ULL;   // Silence windows: the longest a sensor goes between readings ...
+    uint64_t silenceMaxMicros = 6 * 3600000000ULL;  // ... and low battery sensors stretched out.
+    unsigned int silenceGaps = 3;                   // Window: this many times the average gap between packets.
+    uint64_t retryMinMicros = 100000ULL;            // After a failed set up, try again after ...
+    uint64_t retryMaxMicros = 10000000ULL;          // ... doubling up to.
+
+          /*    PURPOSE: The radio is set up and listening: learn its registers. */
+    void start(uint64_t now);
+
+          /*    PURPOSE: A packet was taken off the radio. */
+    void received(uint64_t now);
+
+    bool due(uint64_t now) const { return now >= _nextCheck; }
+
+          /*    PURPOSE: Check the radio, and set it up again if anything is wrong.
+           *  otherFault is a RADIO_FAULT_ kind found by the caller, or 0.
+           *    RETURNS: True if the radio was set up again. */
+    bool service(uint64_t now, uint32_t otherFault = RADIO_FAULT_NONE);
+
+    uint32_t fault() const { return _fault; }
+    uint32_t lastCause() const { return _lastCause; }
+    uint64_t lastSetUpMicros() const { return _lastSetUp; }
+    uint64_t silenceWindow() const;
+
+    unsigned long recoveries = 0;       // Set ups that worked.
+    unsigned long attempts = 0;         // All set ups tried.
+
+  private:
+    NrfSpiBatch* _spi;
+    std::function<bool()> _setUp;
+    RadioHealth _health;
+    uint32_t _fault = RADIO_FAULT_NONE;
+    uint32_t _lastCause = RADIO_FAULT_NONE;
+    uint64_t _lastSetUp = 0;
+    uint64_t _nextCheck = 0;
+    uint64_t _retry = 0;
+    uint64_t _lastRx = 0;
+    uint64_t _meanGap = 0;
+    unsigned long _packets = 0;         // Since construction; the silence check waits for 2.
+    unsigned int _strikes = 0;
+
+    static uint64_t monotonicMicros();
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline void RadioSupervisor::start(uint64_t now) {
+    if (_spi && !_health.learn(*_spi)) _fault = _health.fault();
+    _lastRx = now;
+    _nextCheck = now + checkMicros;
+    _retry = retryMinMicros;
+}
+
+
+    /* Average gap as an EWMA (1/8 weight), in microseconds. */
+inline void RadioSupervisor::received(uint64_t now) {
+    if (_packets > 0 && now > _lastRx) {
+        uint64_t gap = now - _lastRx;
+        _meanGap = (_packets == 1) ? gap : _meanGap - _meanGap / 8 + gap / 8;
+    }
+    _packets++;
+    _lastRx = now;
+    _strikes = 0;
+}
+
+
+inline uint64_t RadioSupervisor::silenceWindow() const {
+    uint64_t window = silenceGaps * _meanGap;
+    if (window < silenceMinMicros) window = silenceMinMicros;
+    if (window > silenceMaxMicros) window = silenceMaxMicros;
+    return window << _strikes;
+}
+
+
+inline bool RadioSupervisor::service(uint64_t now, uint32_t otherFault) {
+    _nextCheck = now + checkMicros;
+
+    uint32_t fault = RADIO_FAULT_NONE;
+    if (_spi && !_health.learned()) {
+        if (!_health.learn(*_spi)) fault = _health.fault();   // Never was set up right; it may be now.
+    } else if (_spi && !_health.check(*_spi)) {
+        fault = _health.fault();
+    }
+    if (fault == RADIO_FAULT_NONE && otherFault != RADIO_FAULT_NONE) fault = otherFault << 24;
+    if (fault == RADIO_FAULT_NONE && _packets >= 2 && now - _lastRx > silenceWindow()) fault = (uint32_t)RADIO_FAULT_SILENCE << 24;
+    _fault = fault;
+    if (fault == RADIO_FAULT_NONE) {
+        _retry = retryMinMicros;
+        return false;
+    }
+
+    attempts++;
+    uint64_t t0 = monotonicMicros();
+    bool ok = _setUp() && (!_spi || _health.learn(*_spi));
+    _lastSetUp = monotonicMicros() - t0;
+    if (!ok) {
+        if (_spi) _fault = _health.fault();
+        _nextCheck = now + _retry;
+        _retry = (_retry * 2 < retryMaxMicros) ? _retry * 2 : retryMaxMicros;
+        return false;
+    }
+    recoveries++;
+    _lastCause = fault;
+    _fault = RADIO_FAULT_NONE;
+    _retry = retryMinMicros;
+    if ((fault >> 24) == RADIO_FAULT_SILENCE && _strikes < RADIO_SILENCE_STRIKES) _strikes++;
+    _lastRx = now;                                          // Silence counts from here.
+    return true;
+}
+
+
+inline uint64_t RadioSupervisor::monotonicMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1,630 @@
+// Class: ReceiverCore - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef ReceiverCore_h
+#define ReceiverCore_h
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <fcntl.h>     // open()
+#include <unistd.h>    // write(), fdatasync(), close()
+#include "SensorRegistry.h" // SensorRegistry, SensorState, PowerController, BatteryTracker
+#include "FixedLine.h"      // FixedLine
+#include "LatencyTrace.h"   // TraceStamps, TRACE_STAMP()
+#include "StateFile.h"      // StateFile, StateGlobals
+#include "JournalLog.h"     // JournalLog
+#include "TimeStamp.h"      // TimeStamp
+#include "SensorClock.h"    // SensorClock
+#include "SensorHistory.h"  // SensorHistory
+#include "SensorRollup.h"   // SensorRollup
+
+/************************************************************************************************
+*
+*    PURPOSE: What RPi_CapDataReceive does with a packet once it is off the radio: work out what
+* kind of packet it is, load it into its struct, fold it into what we know about the sensor
+* (power control, battery, boots, diagnostics), pick the next ACK payload, and write the log
+* file. It used to be loose functions and globals in RPi_CapDataReceive.cpp; it is a class so
+* that RPi_GatewaySoak can run the very same code with no radio and a fast-forwarded clock.
+*
+*    USAGE:
+*    1. Construct with the log file path. The payload structs, the sensor registry and the power
+*  controller are public members.
+*    2. For each packet: track() with the raw bytes and their count, setNextAckPayload() to
+*  decide what goes back in ackPayload, then logIfDue(). Pass logIfDue() the packet's
+*  TraceStamps and the formatted, written and fsynced points are stamped if it is logged.
+*  Each sensor is logged on its own logInterval, its 1st reading straight away; sensors the
+*  registry has no room for share one.
+*    3. To keep what is known about the sensors across restarts, openState() before the 1st
+*  packet, with the rollup file's path too to keep their rollups. Each sensor's slot in the
+*  state file is saved as its packets are tracked.
+*    4. On the way out, flush() so the latest reading isn't lost, and logNote() any last words.
+*    5. clock is where the time comes from (seconds, like time(0)). Messages go to journal
+*  (JournalLog.h) as structured entries, with each event type rate-limited; to journal.console
+*  (std::cout) until it is opened.
+*    6. Each reading also goes into history (SensorHistory.h), at the time it was sent by its
+*  sensor's clock, for whatever wants the last few weeks of it, and into rollup (SensorRollup.h)
+*  for longer stretches. RPi_CapDataReceive -q answers from the rollup file.
+*
+*    NOTE:
+*    1. The payload structs MUST match the sensor's RadioComms.h. See the comments on each.
+*    2. Once constructed, nothing on the packet path allocates: log and diagnostic lines are built
+*  in a FixedLine and written with write(), and the rollups are mapped up front. RPi_GatewaySoak
+*  -a checks this, after a warm-up in which every sensor is heard from.
+*    3. openState() reads every slot in the state file, O(slots), once at start up. That is on
+*  purpose: the registry keeps its sensors in slots 0 .. count()-1, so a sensor after an empty
+*  slot is moved down rather than left where it was, and its rollup with it. history is indexed
+*  by slot too, but it is only in RAM and empty until the 1st packet - which is why openState()
+*  refuses once a sensor has been heard from. RPi_GatewaySoak -w times the load, and checks the
+*  rollups come back too.
+*/
+
+#define LOG_INTERVAL 60 * 60 * 2        // Seconds between a sensor's log entries. Was 60 while testing.
+#define BOOT_ACK_BUDGET_MILLIS 10000    // A sensor should be heard from within this long of power-up.
+#define DIAG_STACK_WARN_BYTES 32        // Flag a sensor whose stack has come this close to its static data.
+#define JOURNAL_IDENTIFIER "RPi_CapDataReceive"
+
+    /* Journal event types (EVENT= in each entry), in the order the
+       constructor adds them. EVENT_RADIO on are for RPi_CapDataReceive's own. */
+#define EVENT_LOG_WRITTEN 0             // "log-written"
+#define EVENT_PA_CHANGE 1               // "pa-change"
+#define EVENT_SENSOR_BOOT 2             // "sensor-boot"
+#define EVENT_SENSOR_DIAG 3             // "sensor-diag"
+#define EVENT_RADIO 4                   // "radio": health changes, recoveries.
+#define EVENT_PIPELINE 5                // "pipeline": stats every STATS_INTERVAL.
+#define EVENT_LIFECYCLE 6               // "lifecycle": start up, shut down. Not limited.
+
+
+    /* Struct to hold the data received in
+       from the ATTiny's nRF24
+    */
+struct RxPayloadStruct {
+  float capacitance;
+  uint32_t sensorTime;            // Milliseconds on ATTiny clock at time of transmission.
+  uint32_t ctSuccess;             // count of success Tx attempts tiny84 has seen since boot
+  uint32_t ctErrors;              // count of Tx errors tiny84 saw since last successful transmit
+  uint16_t sensorID;              // Which sensor this came from.
+  uint8_t paLevel;                // PA level the sensor transmitted at (RF24 0-3).
+  uint8_t txRetries;              // Auto-retransmits the sensor's previous reading took.
+  uint16_t vccMillivolts;         // Sensor's supply voltage, 0 if not measured.
+  uint16_t awakeMillis;           // How long the sensor's previous cycle kept it awake.
+  uint16_t bootAckMillis;         // Sensor's boot to 1st ACK time. 0 in the 1st packet after a boot.
+  uint16_t probeCap[3];           // Probes 2..4 in 1/100ths of a pF. 0 = no such probe.
+};
+
+    /* Diagnostic packet from a sensor built with DIAGNOSTIC_BUILD. Told apart
+       from a RxPayloadStruct by its size. MUST match RadioComms::DiagPayloadStruct
+       on the ATTiny side.
+    */
+#define DIAG_PAYLOAD_SIZE 10
+struct DiagPayloadStruct {
+  uint16_t sensorID;
+  uint16_t stackUnused;           // Sensor SRAM never touched by its stack since boot.
+  uint16_t freeNow;               // Sensor SRAM free when it sent this.
+  uint16_t staticBytes;           // Sensor SRAM taken by .data + .bss.
+  uint8_t resetFlags;             // Sensor's MCUSR at boot: 1=power-on 2=external 4=brown-out 8=watchdog.
+};
+
+    /* Structure to store the outgoing ACK payload
+    */
+struct AckPayloadStruct {
+    uint32_t command;
+    uint32_t uliCmdData;
+
+    /*uint8_t command;      // Command ID back to sensor | 1-byte
+    uint8_t uiCmdData;    // Command data field: unsigned int | 1-byte
+    int iCmdData;         // Command data field: signed int | 2-bytes
+    uint32_t uliCmdData;  // Command data field: unsigned long int | 4-bytes
+    float fCmdData;       // Command data field: float | 4-bytes
+    */
+};
+
+    /* Commands that go back to a sensor in AckPayloadStruct.command. The low
+       byte is the command ID, the upper 16 bits the sensorID it is meant for.
+       Every sensor hears every ACK payload, since the payload goes to whichever
+       sensor transmits next; a sensor ignores commands not addressed to it.
+       MUST match the CMD_ defines in the sensor's RadioComms.h. */
+#define CMD_NONE 0
+#define CMD_SET_PA_LEVEL 1              // uliCmdData = RF24 PA level 0-3
+#define CMD_TARGET_SHIFT 16
+
+
+class ReceiverCore {
+
+  public:
+
+    RxPayloadStruct rxPayload;
+    DiagPayloadStruct diagPayload;
+    AckPayloadStruct ackPayload;
+
+        /* What we know about each sensor, and the power control loop that
+           works from it. */
+    SensorRegistry sensors;
+    PowerController powerControl;
+    SensorHistory history;              // Each sensor's last HISTORY_DAYS of readings, by registry slot.
+    SensorRollup rollup;                // ... and summed up by 15 min, hour, 8 hours and week, by slot.
+                                        // Kept in a file if openState() was given one.
+
+    time_t (*clock)() = wallClock;      // Seconds since the epoch.
+    int64_t (*clockMillis)() = wallMillis;  // The same clock, in ms: for SensorClock.
+    JournalLog journal;                 // Messages, as structured journal entries.
+    time_t logInterval = LOG_INTERVAL;
+    bool syncLog = true;                // fdatasync() each log line, so a power cut doesn't lose it.
+
+        /* Counts. */
+    unsigned long readings = 0;         // Reading packets tracked.
+    unsigned long diags = 0;            // Diagnostic packets tracked.
+    unsigned long unregistered = 0;     // Packets from sensors the registry had no room for.
+    unsigned long logEntries = 0;       // Lines written to the log file.
+    unsigned long logBytes = 0;         // Bytes written to the log file.
+
+          /*    PURPOSE: Constructor. */
+    ReceiverCore(const char* logPath, unsigned int maxSensors = MAX_SENSORS);
+
+          /*    PURPOSE: Load a packet off the radio into rxPayload or diagPayload, by its
+           *  size, and track it.
+           *    RETURNS: True if it was a reading, false if a diagnostic packet. */
+    bool track(const uint8_t* bytes, uint8_t width);
+
+          /*    PURPOSE: Pick what goes out in the next ACK payload, into ackPayload. */
+    void setNextAckPayload();
+
+          /*    PURPOSE: Log rxPayload if logInterval has passed since its sensor's last entry. */
+    void logIfDue(TraceStamps* trace = NULL);
+
+          /*    PURPOSE: Keep the sensors' state in a file (StateFile.h), loading back what
+           *  the last run left in it, and their rollups in another if rollupPath is
+           *  given (rollup.isOpen() says if it could be). Before the 1st packet only (note #3).
+           *    RETURNS: Sensors restored; -1 if the state file couldn't be opened, or
+           *  packets have been tracked already. */
+    int openState(const char* path, const char* rollupPath = NULL);
+
+          /*    PURPOSE: Log rxPayload now if it came in since the last entry, so a shutdown
+           *  doesn't lose it.
+           *    RETURNS: False if it couldn't be written. */
+    bool flush();
+
+          /*    PURPOSE: A time-stamped line of our own in the log file, e.g. shutdown stats.
+           *    RETURNS: False if it couldn't be written. */
+    bool logNote(const char* text);
+
+          /*    PURPOSE: Time now, as the log file and console show it. */
+    std::string currTimeFormatted();
+
+          /*    PURPOSE: Add the time now, as currTimeFormatted() has it, to a line.
+           *  Doesn't allocate. */
+    void addTime(FixedLine& line);
+
+    static void loadRxStruct(RxPayloadStruct* pStruct, const uint8_t* pBytes);
+    static void loadDiagStruct(DiagPayloadStruct* pStruct, const uint8_t* pBytes);
+    static time_t wallClock() { return time(0); }
+    static int64_t wallMillis() {
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    }
+
+  private:
+    std::string _logPath;
+    time_t _lastLog;                    // Last entry for a sensor with no registry slot.
+    SensorState* _rxSensor = NULL;      // rxPayload's sensor; NULL if the registry had no room for it.
+    bool _unlogged = false;             // A reading has come in since the last log entry.
+    StateFile _state;
+    FixedLine _line;                    // Log and diagnostic lines are built here.
+
+    SensorState* trackSensor(RxPayloadStruct* rxData);
+    void trackDiag(DiagPayloadStruct* diag);
+    bool logData(RxPayloadStruct* rxData, TraceStamps* trace = NULL);
+    bool appendLog(const FixedLine& line, TraceStamps* trace = NULL);
+    void setAckPayload(uint32_t cmd, uint32_t uliData);
+    void saveState(const SensorState* st);
+    void saveLastLog();
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline ReceiverCore::ReceiverCore(const char* logPath, unsigned int maxSensors)
+    : sensors(maxSensors), history(maxSensors), rollup(maxSensors), journal(JOURNAL_IDENTIFIER), _logPath(logPath) {
+        /* Bursts, then so many a minute. A few of each kind get through a
+           storm - all 500 sensors booting after a power cut, say - and the
+           next one that does says how many were held back. */
+    journal.addType("log-written", 4, 2);
+    journal.addType("pa-change", 20, 10);
+    journal.addType("sensor-boot", 20, 10);
+    journal.addType("sensor-diag", 20, 10);
+    journal.addType("radio", 10, 6);
+    journal.addType("pipeline", 4, 2);
+    journal.addType("lifecycle", 0, 0);
+    journal.console = &std::cout;
+    memset(&rxPayload, 0, sizeof(rxPayload));
+    memset(&diagPayload, 0, sizeof(diagPayload));
+    setAckPayload(CMD_NONE, 0);
+    _lastLog = clock();
+}
+
+
+inline bool ReceiverCore::track(const uint8_t* bytes, uint8_t width) {
+    if (width == DIAG_PAYLOAD_SIZE) {                           // Diagnostic build sensor reporting its SRAM use.
+        loadDiagStruct(&diagPayload, bytes);
+        trackDiag(&diagPayload);
+        diags++;
+        return false;
+    }
+    loadRxStruct(&rxPayload, bytes);                            // Manually' load rxPayload structure from the received bytes.
+    _rxSensor = trackSensor(&rxPayload);                        // Update what we know about this sensor; may queue a command for it.
+    saveState(_rxSensor);
+    readings++;
+    _unlogged = true;
+    return true;
+}
+
+
+inline void ReceiverCore::logIfDue(TraceStamps* trace) {
+    time_t* last = _rxSensor ? &_rxSensor->lastLog : &_lastLog;
+    if (*last && clock() <= *last + logInterval) return;
+    logData(&rxPayload, trace);
+    if (journal.start(EVENT_LOG_WRITTEN)) {
+        journal.field("SENSOR_ID", rxPayload.sensorID).field("LOG_ENTRIES", logEntries)
+               .send("Writing Sensor Readings to Log File.");
+    }
+    *last = clock();
+    _unlogged = false;
+    if (_rxSensor) saveState(_rxSensor);
+    else saveLastLog();
+}
+
+
+inline bool ReceiverCore::flush() {
+    bool ok = true;
+    if (_unlogged) {
+        _unlogged = false;
+        if (_rxSensor) {
+            _rxSensor->lastLog = clock();
+            saveState(_rxSensor);
+        } else {
+            _lastLog = clock();
+            saveLastLog();
+        }
+        ok = logData(&rxPayload);
+    }
+    _state.sync();
+    rollup.sync();
+    return ok;
+}
+
+
+/* Open the state file and load the sensors back from it.
+   ----------------------------------------------------------------------------
+   Sensors go back into the registry in slot order, so normally each keeps
+   its slot number. If one doesn't (a slot was left empty) it is moved in the
+   file to match, and so is its rollup. Rollups of sensors not restored are
+   cleared. A sensor whose command was waiting is queued again. Once there
+   are sensors in the registry, their history and rollup are under slot
+   numbers a move could hand to another sensor, so it isn't done.
+ */
+inline int ReceiverCore::openState(const char* path, const char* rollupPath) {
+    if (sensors.count()) return -1;
+    if (!_state.open(path, sensors.capacity())) return -1;
+    if (rollupPath) rollup.open(rollupPath);
+    StateGlobals g;
+    if (_state.loadGlobals(&g)) _lastLog = g.lastLog;
+
+    int restored = 0;
+    SensorState saved;
+    for (unsigned int slot = 0; slot < _state.slots(); slot++) {
+        if (!_state.load(slot, &saved)) continue;
+        SensorState* st = sensors.lookup(saved.sensorID);
+        if (!st) break;
+        bool queued = saved.commandQueued;
+        memcpy(st, &saved, sizeof(SensorState));
+        st->commandQueued = false;
+        if (queued) sensors.queueCommand(st);
+        if (sensors.indexOf(st) != slot) {
+            _state.clear(slot);
+            saveState(st);
+            rollup.move(slot, sensors.indexOf(st));
+        }
+        restored++;
+    }
+    for (unsigned int slot = 0; slot < rollup.slots(); slot++) {
+        if (slot >= sensors.count() || !rollup.holds(slot, sensors.at(slot)->sensorID)) rollup.clear(slot);
+    }
+    return restored;
+}
+
+
+inline bool ReceiverCore::logNote(const char* text) {
+    _line.clear();
+    addTime(_line);
+    _line.add(": ").add(text).add('\n');
+    return appendLog(_line);
+}
+
+
+/* Manually load the incoming data into a structure.
+   ----------------------------------------------------------------------------
+    REQUIRES: The RxPayloadStruct defintion on this node exactly match the
+              definition created on the transmit node.
+
+    07/19/202: Removed the code that writes the hex output to the console so
+    that this function only loads the structure and does not affect the
+    console display. If console output needs to be reimplemented, go back
+    to MS-06_CapDataReceived_05.cpp.
+ */
+inline void ReceiverCore::loadRxStruct(RxPayloadStruct* pStruct, const uint8_t* pBytes) {
+    size_t offset = 0;
+
+    pStruct->capacitance = *(float *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->capacitance);
+
+    pStruct->sensorTime = *(uint32_t *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->sensorTime);
+
+    pStruct->ctSuccess = *(uint32_t *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->ctSuccess);
+
+    pStruct->ctErrors = *(uint32_t *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->ctErrors);
+
+    pStruct->sensorID = *(uint16_t *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->sensorID);
+
+    pStruct->paLevel = pBytes[offset];
+    offset = offset + sizeof(pStruct->paLevel);
+
+    pStruct->txRetries = pBytes[offset];
+    offset = offset + sizeof(pStruct->txRetries);
+
+    pStruct->vccMillivolts = *(uint16_t *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->vccMillivolts);
+
+    pStruct->awakeMillis = *(uint16_t *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->awakeMillis);
+
+    pStruct->bootAckMillis = *(uint16_t *)&pBytes[offset];
+    offset = offset + sizeof(pStruct->bootAckMillis);
+
+    memcpy(pStruct->probeCap, &pBytes[offset], sizeof(pStruct->probeCap));
+}
+
+
+/* Manually load an incoming diagnostic packet into a structure.
+   ----------------------------------------------------------------------------
+    REQUIRES: The DiagPayloadStruct defintion on this node exactly match
+              RadioComms::DiagPayloadStruct on the transmit node.
+ */
+inline void ReceiverCore::loadDiagStruct(DiagPayloadStruct* pStruct, const uint8_t* pBytes) {
+    memcpy(&pStruct->sensorID, &pBytes[0], sizeof(pStruct->sensorID));
+    memcpy(&pStruct->stackUnused, &pBytes[2], sizeof(pStruct->stackUnused));
+    memcpy(&pStruct->freeNow, &pBytes[4], sizeof(pStruct->freeNow));
+    memcpy(&pStruct->staticBytes, &pBytes[6], sizeof(pStruct->staticBytes));
+    pStruct->resetFlags = pBytes[8];
+}
+
+
+inline void ReceiverCore::setAckPayload(uint32_t cmd, uint32_t uliData) {
+    ackPayload.command = cmd;
+    ackPayload.uliCmdData = uliData;
+}
+
+
+/* Decide what goes out in the next ACK payload.
+   ----------------------------------------------------------------------------
+   If any sensor has a command waiting, the one that has waited longest gets
+   it; else an empty command. We cannot know which sensor will transmit next,
+   so the payload may well be heard (and ignored) by some other sensor. That
+   is fine - the sensor it was meant for will still be reporting its old state
+   on its next packet, and trackSensor() will queue the command again.
+ */
+inline void ReceiverCore::setNextAckPayload() {
+    SensorState* st = sensors.pendingCommand();
+    if (st) {
+        setAckPayload(CMD_SET_PA_LEVEL | ((uint32_t)st->sensorID << CMD_TARGET_SHIFT), st->power.desiredPALevel);
+    } else {
+        setAckPayload(CMD_NONE, 0);
+    }
+}
+
+
+/* Fold a received packet into what we know about the sensor that sent it.
+   ----------------------------------------------------------------------------
+   REQUIRES: loadRxStruct() has already been called.
+   RETURNS:  The sensor's registry slot, or NULL if the registry is full.
+ */
+inline SensorState* ReceiverCore::trackSensor(RxPayloadStruct* rxData) {
+    SensorState* st = sensors.lookup(rxData->sensorID);
+    if (!st) {
+        unregistered++;
+        return NULL;
+    }
+
+        /* ctErrors is a running count on the sensor; it restarts from 0 when
+           the sensor reboots, in which case all of it is new. */
+    bool firstPacket = (st->packets == 0);
+    uint32_t newErrors = 0;
+    if (!firstPacket) {
+        newErrors = (rxData->ctErrors >= st->lastCtErrors) ? rxData->ctErrors - st->lastCtErrors : rxData->ctErrors;
+    }
+
+    time_t now = clock();
+    uint8_t oldLevel = st->power.desiredPALevel;
+    if (powerControl.update(st->power, firstPacket, rxData->paLevel, rxData->txRetries, newErrors)) {
+        sensors.queueCommand(st);
+        if (st->power.desiredPALevel != oldLevel && journal.start(EVENT_PA_CHANGE, LOG_NOTICE)) {
+            _line.clear();
+            _line.add("Sensor ").add(st->sensorID).add(": PA level ").add((unsigned int)rxData->paLevel)
+                 .add(" -> ").add((unsigned int)st->power.desiredPALevel)
+                 .add(" (retransmits/pkt ").add((double)st->power.retransmitsEwma)
+                 .add(", ").add((double)st->power.microJoulesPerPacket).add(" uJ/pkt)");
+            journal.field("SENSOR_ID", st->sensorID).field("PA_FROM", (unsigned int)rxData->paLevel)
+                   .field("PA_TO", (unsigned int)st->power.desiredPALevel)
+                   .field("RETRANSMITS_PER_PACKET", (double)st->power.retransmitsEwma)
+                   .field("UJ_PER_PACKET", (double)st->power.microJoulesPerPacket)
+                   .send(_line.c_str());
+        }
+    }
+
+    BatteryTracker::update(st->battery, now, rxData->vccMillivolts);
+
+        /* A new boot-to-ACK time means the sensor has been re-powered. */
+    if (rxData->bootAckMillis != 0 && rxData->bootAckMillis != st->bootAckMillis) {
+        bool over = rxData->bootAckMillis > BOOT_ACK_BUDGET_MILLIS;
+        if (journal.start(EVENT_SENSOR_BOOT, over ? LOG_WARNING : LOG_INFO)) {
+            _line.clear();
+            _line.add("Sensor ").add(st->sensorID).add(": booted, 1st ACK after ").add(rxData->bootAckMillis).add("ms");
+            if (over) _line.add(" (OVER ").add(BOOT_ACK_BUDGET_MILLIS).add("ms BUDGET)");
+            journal.field("SENSOR_ID", st->sensorID).field("BOOT_ACK_MS", rxData->bootAckMillis)
+                   .send(_line.c_str());
+        }
+    }
+    st->bootAckMillis = rxData->bootAckMillis;
+
+        /* Fit the sensor's clock to ours. bootAckMillis is 0 in the 1st
+           packet after a boot, so if its time
+           went back, millis() has started again. */
+    if (rxData->bootAckMillis == 0 && !firstPacket && st->lastSensorTime > rxData->sensorTime) {
+        SensorClock::restart(st->clock);
+    }
+    int64_t sent = SensorClock::update(st->clock, rxData->sensorTime, clockMillis());
+    history.append(sensors.indexOf(st), (time_t)(sent / 1000), rxData->capacitance);
+    rollup.add(sensors.indexOf(st), st->sensorID, (time_t)(sent / 1000), rxData->capacitance);
+
+    st->packets++;
+    st->lastRxTime = now;
+    st->lastCapacitance = rxData->capacitance;
+    st->lastSensorTime = rxData->sensorTime;
+    st->lastCtSuccess = rxData->ctSuccess;
+    st->lastCtErrors = rxData->ctErrors;
+    return st;
+}
+
+
+/* Report a diagnostic packet to the journal and the log file.
+   ----------------------------------------------------------------------------
+   Diagnostic packets come in rarely (every few reading cycles) so each one is
+   written straight out. stackUnused only ever goes down until the sensor
+   reboots, so the lowest seen is kept to flag a sensor running short.
+ */
+inline void ReceiverCore::trackDiag(DiagPayloadStruct* diag) {
+    SensorState* st = sensors.lookup(diag->sensorID);
+    if (st && (st->stackUnusedMin == 0 || diag->stackUnused < st->stackUnusedMin)) {
+        st->stackUnusedMin = diag->stackUnused;
+        saveState(st);
+    }
+
+    _line.clear();
+    addTime(_line);
+    size_t start = _line.size() + 2;                            // Journal gets the line without the time.
+    _line.add(": Sensor ").add(diag->sensorID).add(" diag: stack unused ").add(diag->stackUnused)
+         .add("B, free now ").add(diag->freeNow).add("B, static ").add(diag->staticBytes)
+         .add("B, reset flags 0x").add((unsigned int)diag->resetFlags, 16);
+    bool low = diag->stackUnused < DIAG_STACK_WARN_BYTES;
+    if (low) _line.add(" (STACK LOW)");
+    if (journal.start(EVENT_SENSOR_DIAG, low ? LOG_WARNING : LOG_INFO)) {
+        journal.field("SENSOR_ID", diag->sensorID).field("STACK_UNUSED", diag->stackUnused)
+               .field("FREE_NOW", diag->freeNow).field("STATIC_BYTES", diag->staticBytes)
+               .field("RESET_FLAGS", (unsigned int)diag->resetFlags).send(_line.c_str() + start);
+    }
+
+    _line.add('\n');
+    appendLog(_line);
+}
+
+
+inline bool ReceiverCore::logData(RxPayloadStruct* rxData, TraceStamps* trace) {
+    FixedLine& line = _line;
+    line.clear();
+
+    // Write the sensor reading and timestamp to the log file
+    //logFile << "Timestamp: " << asctime(localTime);
+    addTime(line);
+    line.add(":");
+    line.add(" Sensor: ").add(rxData->sensorID);
+    line.add(" Moisture: ").add(rxData->capacitance);
+    line.add("  ctSuccess: ").add(rxData->ctSuccess);
+    line.add("  ctErrors: ").add(rxData->ctErrors);
+    line.add("  SensorTime: ").add(rxData->sensorTime);
+    SensorState* st = sensors.lookup(rxData->sensorID);
+    if (st && SensorClock::hasFit(st->clock)) {
+        int64_t sent = SensorClock::toWall(st->clock, rxData->sensorTime);
+        timespec ts = {(time_t)(sent / 1000), (long)(sent % 1000) * 1000000};
+        char buffer[TIMESTAMP_MAX];
+        TimeStamp::iso(ts, buffer);
+        line.add("  SampleTime: ").add(buffer);
+        line.add("  ClockPpm: ").add((long)lroundf(st->clock.skewPpm));
+    }
+    line.add("  PA: ").add((unsigned int)rxData->paLevel);
+    if (st) line.add("  uJ/pkt: ").add(st->power.microJoulesPerPacket);
+    line.add("  VCC: ").add(rxData->vccMillivolts).add("mV");
+    line.add("  Awake: ").add(rxData->awakeMillis).add("ms");
+    line.add("  BootAck: ").add(rxData->bootAckMillis).add("ms");
+    for (int k = 0; k < 3; k++) {
+        if (rxData->probeCap[k]) line.add("  Probe").add(k + 2).add(": ").add(rxData->probeCap[k] / 100.0);
+    }
+    if (st && st->battery.hoursToEmpty >= 0) line.add("  Empty in: ").add(st->battery.hoursToEmpty).add("h");
+    line.add('\n');
+    if (trace) TRACE_STAMP(*trace, TP_FORMATTED);
+
+    return appendLog(line, trace);
+}
+
+
+/* Append a line to the log file.
+   ----------------------------------------------------------------------------
+   The file is opened and closed for each line, since lines are hours apart,
+   and so that the log can be rotated under us. Unless syncLog is off the line
+   is fdatasync()'d before the file is closed.
+ */
+inline bool ReceiverCore::appendLog(const FixedLine& line, TraceStamps* trace) {
+    int fd = open(_logPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Error opening the log file:" << _logPath << std::endl;
+        return false;
+    }
+    ssize_t n = write(fd, line.c_str(), line.size());
+    if (trace) TRACE_STAMP(*trace, TP_WRITTEN);
+    if (syncLog) {
+        fdatasync(fd);
+        if (trace) TRACE_STAMP(*trace, TP_FSYNCED);
+    }
+    close(fd);
+    if (n != (ssize_t)line.size()) return false;
+    logEntries++;
+    logBytes += n;
+    return true;
+}
+
+
+inline void ReceiverCore::addTime(FixedLine& line) {
+    // Get the current time, in a pretty string format.
+    char buffer[TIMESTAMP_MAX];
+    TimeStamp::legacy(clock(), buffer);
+    line.add(buffer);
+}
+
+
+inline std::string ReceiverCore::currTimeFormatted() {
+    FixedLine line;
+    addTime(line);
+    return line.c_str();
+}
+
+inline void ReceiverCore::saveState(const SensorState* st) {
+    if (st && _state.isOpen()) _state.save(sensors.indexOf(st), *st);
+}
+
+
+inline void ReceiverCore::saveLastLog() {
+    StateGlobals g = {_lastLog};
+    _state.saveGlobals(g);
+}
+
+#endif
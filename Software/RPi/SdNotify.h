@@ -0,0 +1,137 @@
+// Class: SdNotify - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SdNotify_h
+#define SdNotify_h
+
+#include <cstddef>          // offsetof
+#include <cstdint>
+#include <cstdio>           // snprintf()
+#include <cstdlib>          // getenv(), strtoull()
+#include <cstring>
+#include <sys/socket.h>     // socket(), sendto()
+#include <sys/un.h>         // sockaddr_un
+#include <unistd.h>         // getpid(), close()
+
+/************************************************************************************************
+*
+*    PURPOSE: Talks to systemd the way sd_notify() does, without linking libsystemd: one
+* datagram to the socket systemd names in NOTIFY_SOCKET. With Type=notify, READY=1 tells it the
+* service is up; with WatchdogSec=, WATCHDOG=1 has to come at least that often or systemd kills
+* the service and (with Restart=) starts it again. Where the ping is sent from decides what the
+* watchdog watches - it should be from the loop doing the work, and only while that work is
+* actually getting done.
+*
+*    USAGE:
+*    1. Construct one. It reads NOTIFY_SOCKET, WATCHDOG_USEC and WATCHDOG_PID from the
+*  environment; when not run by systemd (or not as Type=notify) there is no socket and every
+*  call does nothing.
+*    2. ready() once set up, stopping() when shutting down, status() for a line to show in
+*  systemctl status.
+*    3. keepAlive() as often as you like while all is well. It sends WATCHDOG=1 once half of
+*  WatchdogSec has gone by since the last one, as systemd recommends, so calling it costs
+*  next to nothing.
+*
+*    NOTE:
+*    1. The socket is non-blocking: if systemd isn't reading, a message is lost, never waited for.
+*    2. A NOTIFY_SOCKET starting with '@' is in the abstract namespace, as systemd's are.
+*/
+
+#define SDNOTIFY_STATUS_MAX 200
+
+
+class SdNotify {
+
+  public:
+
+          /*    PURPOSE: Constructor. Finds the socket and watchdog interval. */
+    SdNotify();
+    ~SdNotify();
+
+    SdNotify(const SdNotify&) = delete;
+    SdNotify& operator=(const SdNotify&) = delete;
+
+          /*    PURPOSE: Tells if there is a socket to talk to. */
+    bool enabled() const { return _fd >= 0; }
+
+          /*    PURPOSE: WatchdogSec in microseconds; 0 if there is no watchdog. */
+    uint64_t watchdogMicros() const { return _watchdog; }
+
+          /*    PURPOSE: Send a message as it is, e.g. "READY=1".
+           *    RETURNS: False if not sent. */
+    bool send(const char* state);
+
+    bool ready() { return send("READY=1"); }
+    bool stopping() { return send("STOPPING=1"); }
+    bool status(const char* text);
+
+          /*    PURPOSE: Ping the watchdog if half its interval has gone by.
+           *    RETURNS: True if a WATCHDOG=1 went. */
+    bool keepAlive(uint64_t nowMicros);
+
+    unsigned long pings = 0;
+
+  private:
+    int _fd = -1;
+    sockaddr_un _addr;
+    socklen_t _addrLen = 0;
+    uint64_t _watchdog = 0;
+    uint64_t _lastPing = 0;
+    bool _pinged = false;
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline SdNotify::SdNotify() {
+    const char* path = getenv("NOTIFY_SOCKET");
+    size_t len = path ? strlen(path) : 0;
+    if (len < 2 || len >= sizeof(_addr.sun_path) || (path[0] != '/' && path[0] != '@')) return;
+
+    memset(&_addr, 0, sizeof(_addr));
+    _addr.sun_family = AF_UNIX;
+    memcpy(_addr.sun_path, path, len);
+    if (path[0] == '@') _addr.sun_path[0] = '\0';           // Abstract: no terminating '\0' in the length.
+    _addrLen = offsetof(sockaddr_un, sun_path) + len + (path[0] == '/' ? 1 : 0);
+    _fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+    const char* usec = getenv("WATCHDOG_USEC");
+    const char* pid = getenv("WATCHDOG_PID");
+    if (usec && (!pid || (pid_t)strtoull(pid, NULL, 10) == getpid())) _watchdog = strtoull(usec, NULL, 10);
+}
+
+
+inline SdNotify::~SdNotify() {
+    if (_fd >= 0) close(_fd);
+}
+
+
+inline bool SdNotify::send(const char* state) {
+    if (_fd < 0) return false;
+    return sendto(_fd, state, strlen(state), MSG_NOSIGNAL, (const sockaddr*)&_addr, _addrLen) >= 0;
+}
+
+
+inline bool SdNotify::status(const char* text) {
+    char msg[8 + SDNOTIFY_STATUS_MAX];
+    snprintf(msg, sizeof msg, "STATUS=%s", text);
+    return send(msg);
+}
+
+
+inline bool SdNotify::keepAlive(uint64_t nowMicros) {
+    if (_watchdog == 0 || _fd < 0) return false;
+    if (_pinged && nowMicros - _lastPing < _watchdog / 2) return false;
+    if (!send("WATCHDOG=1")) return false;
+    _lastPing = nowMicros;
+    _pinged = true;
+    pings++;
+    return true;
+}
+
+#endif
@@ -0,0 +1,238 @@
+// Class: SensorClock - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SensorClock_h
+#define SensorClock_h
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>            // fabs()
+#include <algorithm>        // std::nth_element
+
+/************************************************************************************************
+*
+*    PURPOSE: Maps a sensor's clock to the wall clock, so a reading can be given the time it was
+* taken rather than the time it got here. Each payload has sensorTime, the tiny84's millis() when
+* it was sent. That clock runs off the internal RC oscillator, a couple of percent off and
+* wandering with temperature, and wraps every 2^32 ms (49.7 days). A line fitted through the last
+* CLOCK_WINDOW (sensorTime, time received) pairs gives the wall time for any sensorTime near
+* them, and the sensor clock's skew in ppm.
+*
+*    A packet can only arrive later than it was sent, never earlier: retransmits, a queue, a
+* reading the sensor held on to. Most come straight through, a few ms after they were sent, and
+* those that don't would drag a least squares line towards them. So they are found first with a
+* line they can't move, the median of the slopes between every pair of points (Theil-Sen), and
+* left out; least squares fits the rest. The line is then moved to go through the latest of those,
+* which is a truer mark of when it was sent than the line's own value while the clock wanders.
+*
+*    USAGE:
+*    1. Keep one SensorClockState per sensor (it lives in SensorState, see SensorRegistry.h).
+*    2. For each packet, SensorClock::update() with its sensorTime and the wall time it came in,
+*  in ms. It returns the wall time the packet was sent, by the fit (the time received, until
+*  there are CLOCK_MIN_POINTS to fit, or if the fit would have it sent after it came in).
+*    3. toWall() the wall time of any other sensorTime near the latest. skewPpm is how fast the
+*  sensor's clock runs: +ve is fast.
+*    4. When the sensor is known to have rebooted, restart().
+*
+*    NOTE:
+*    1. Wraps are told from reboots by how far the sensor's clock should have gone since the
+*  last packet: if its time is about that far on (mod 2^32), it wrapped if it is smaller; if not,
+*  the sensor rebooted and the window starts again.
+*    2. A packet whose sensorTime is a little behind the latest one - sent before it, arrived
+*  after it - is mapped, but not added to the window.
+*    3. The window is a trade: long enough that a few late packets in it are still picked out,
+*  short enough that the line keeps up with the clock's wander. RPi_GatewaySoak -e measures it.
+*    4. Plain data, no pointers, so it can be kept in the state file. It is about 250 bytes.
+*/
+
+#define CLOCK_WINDOW 12                 // Points fitted: 3 hours of readings at 15 minutes.
+#define CLOCK_MIN_POINTS 3              // Points before there is a fit.
+#define CLOCK_TOLERANCE 0.10            // Sensor clock can be this far off the wall clock's pace ...
+#define CLOCK_TOLERANCE_MS 120000       // ... plus this, as the last packet may have come in late.
+#define CLOCK_BEHIND_MS 3600000         // Up to this far behind the latest is an old packet come late.
+#define CLOCK_LATE_MS 200               // A point this far above the line (and 3 MADs) came in late.
+
+
+struct SensorClockState {
+    int64_t sensorMs[CLOCK_WINDOW];     // Sensor time, wraps undone: ms since the sensor booted.
+    int64_t wallMs[CLOCK_WINDOW];       // Wall time it came in, ms since the epoch.
+    uint16_t points;                    // In the window, up to CLOCK_WINDOW.
+    uint16_t head;                      // Where the next one goes.
+    uint32_t lastRaw;                   // sensorTime of the latest point, as sent.
+    int64_t lastSensorMs;               // ... and with wraps undone.
+    int64_t originSensorMs;             // Fit: wall = originWallMs + slope * (sensor - originSensorMs).
+    double originWallMs;
+    double slope;                       // Wall ms per sensor ms; 0 = no fit yet.
+    float skewPpm;                      // Sensor clock fast (+) or slow (-), parts per million.
+    float residualMs;                   // Median distance of the points from the Theil-Sen line.
+    uint16_t fitted;                    // Points the fit used.
+    uint16_t reboots;                   // Restarts seen, by a jump in its clock or restart().
+    uint32_t wraps;
+};
+
+
+class SensorClock {
+
+  public:
+
+          /*    PURPOSE: Add a packet's sensorTime and the wall time it came in.
+           *    RETURNS: The wall time it was sent, ms since the epoch. */
+    static int64_t update(SensorClockState& st, uint32_t sensorTime, int64_t wallMs);
+
+          /*    PURPOSE: Wall time of a sensorTime near the latest one.
+           *    RETURNS: ms since the epoch; 0 if there is no fit yet. */
+    static int64_t toWall(const SensorClockState& st, uint32_t sensorTime);
+
+    static bool hasFit(const SensorClockState& st) { return st.slope > 0; }
+
+          /*    PURPOSE: The sensor rebooted: its clock starts again. */
+    static void restart(SensorClockState& st);
+
+  private:
+    static void fit(SensorClockState& st);
+    static bool line(const double* x, const double* y, int n, double& slope, double& intercept);
+    static int64_t unwrap(const SensorClockState& st, uint32_t sensorTime);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline void SensorClock::restart(SensorClockState& st) {
+    uint16_t reboots = st.reboots;
+    uint32_t wraps = st.wraps;
+    memset(&st, 0, sizeof(st));
+    st.reboots = reboots + 1;
+    st.wraps = wraps;
+}
+
+
+    /* sensorTime as ms since boot, taking it to be the nearest to the latest
+       (within half a wrap). */
+inline int64_t SensorClock::unwrap(const SensorClockState& st, uint32_t sensorTime) {
+    return st.lastSensorMs + (int32_t)(sensorTime - st.lastRaw);
+}
+
+
+inline int64_t SensorClock::update(SensorClockState& st, uint32_t sensorTime, int64_t wallMs) {
+    int64_t sensorMs = sensorTime;
+    if (st.points > 0) {
+        int64_t lastWall = st.wallMs[(st.head + CLOCK_WINDOW - 1) % CLOCK_WINDOW];
+        uint32_t ahead = sensorTime - st.lastRaw;                   // Mod 2^32.
+        uint32_t behind = st.lastRaw - sensorTime;
+        double pace = hasFit(st) ? 1 / st.slope : 1.0;
+        double expect = (wallMs > lastWall) ? (wallMs - lastWall) * pace : 0;
+        if (behind <= CLOCK_BEHIND_MS && behind != 0 && behind < ahead) {
+            int64_t at = toWall(st, sensorTime);                    // Sent before the latest, came after it.
+            return at ? at : wallMs;
+        }
+        if (ahead <= expect * (1 + CLOCK_TOLERANCE) + CLOCK_TOLERANCE_MS) {
+            if (sensorTime < st.lastRaw) st.wraps++;
+            sensorMs = st.lastSensorMs + ahead;
+        } else {
+            restart(st);                                            // Its clock jumped: it rebooted.
+        }
+    }
+
+    st.sensorMs[st.head] = sensorMs;
+    st.wallMs[st.head] = wallMs;
+    st.head = (st.head + 1) % CLOCK_WINDOW;
+    if (st.points < CLOCK_WINDOW) st.points++;
+    st.lastRaw = sensorTime;
+    st.lastSensorMs = sensorMs;
+    fit(st);
+    int64_t at = toWall(st, sensorTime);
+    return (at && at < wallMs) ? at : wallMs;
+}
+
+
+inline int64_t SensorClock::toWall(const SensorClockState& st, uint32_t sensorTime) {
+    if (!hasFit(st)) return 0;
+    return (int64_t)llround(st.originWallMs + st.slope * (unwrap(st, sensorTime) - st.originSensorMs));
+}
+
+
+    /* Least squares.
+       RETURNS: false if the points are all at the one x. */
+inline bool SensorClock::line(const double* x, const double* y, int n, double& slope, double& intercept) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int k = 0; k < n; k++) {
+        sx += x[k];
+        sy += y[k];
+        sxx += x[k] * x[k];
+        sxy += x[k] * y[k];
+    }
+    double d = n * sxx - sx * sx;
+    if (d <= 0) return false;
+    slope = (n * sxy - sx * sy) / d;
+    intercept = (sy - slope * sx) / n;
+    return true;
+}
+
+
+    /* Theil-Sen through the median point, to find the late points; least
+       squares through the rest. All about the latest point, so the sums stay
+       small. */
+inline void SensorClock::fit(SensorClockState& st) {
+    st.slope = 0;
+    st.fitted = 0;
+    if (st.points < CLOCK_MIN_POINTS) return;
+
+    int64_t x0 = st.lastSensorMs, y0 = st.wallMs[(st.head + CLOCK_WINDOW - 1) % CLOCK_WINDOW];
+    double x[CLOCK_WINDOW], y[CLOCK_WINDOW];
+    int n = st.points;
+    for (int k = 0; k < n; k++) {
+        x[k] = (double)(st.sensorMs[k] - x0);
+        y[k] = (double)(st.wallMs[k] - y0);
+    }
+
+    double pairs[CLOCK_WINDOW * (CLOCK_WINDOW - 1) / 2], r[CLOCK_WINDOW], a[CLOCK_WINDOW];
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            if (x[i] != x[j]) pairs[m++] = (y[j] - y[i]) / (x[j] - x[i]);
+        }
+    }
+    if (m == 0) return;                                             // All at one sensorTime.
+    std::nth_element(pairs, pairs + m / 2, pairs + m);
+    double slope = pairs[m / 2];
+    for (int k = 0; k < n; k++) r[k] = y[k] - slope * x[k];
+    memcpy(a, r, n * sizeof(double));
+    std::nth_element(a, a + n / 2, a + n);
+    double intercept = a[n / 2];
+    for (int k = 0; k < n; k++) a[k] = fabs(r[k] - intercept);
+    std::nth_element(a, a + n / 2, a + n);
+    double mad = a[n / 2];
+    double cut = 3 * mad;                                           // The clock wanders: points spread.
+    if (cut < CLOCK_LATE_MS) cut = CLOCK_LATE_MS;
+
+    int kept = 0;
+    for (int k = 0; k < n; k++) {
+        if (r[k] - intercept > cut) continue;                       // Came in late.
+        x[kept] = x[k];
+        y[kept] = y[k];
+        kept++;
+    }
+    n = kept;
+    if (n < 2 || !line(x, y, n, slope, intercept) || slope <= 0) return;
+
+        /* Through the latest point that came straight through, rather than
+           the line's own intercept: it is only a few ms after it was sent,
+           where the line can be out by more as the sensor's clock wanders. */
+    int latest = 0;
+    for (int k = 1; k < n; k++) {
+        if (x[k] > x[latest]) latest = k;
+    }
+    st.slope = slope;
+    st.fitted = n;
+    st.originSensorMs = x0 + (int64_t)x[latest];
+    st.originWallMs = y0 + y[latest];
+    st.skewPpm = (float)((1 / slope - 1) * 1e6);
+    st.residualMs = (float)mad;
+}
+
+#endif
@@ -0,0 +1,317 @@
+// Class: SensorDashboard - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SensorDashboard_h
+#define SensorDashboard_h
+
+#include <algorithm>        // std::fill
+#include <charconv>         // std::to_chars
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <sys/ioctl.h>      // TIOCGWINSZ
+#include <unistd.h>         // write()
+#include "SensorRegistry.h" // SensorRegistry, SensorState
+
+/************************************************************************************************
+*
+*    PURPOSE: A live table of every sensor for the terminal, one row each: last reading, how
+* long ago, loss, battery, and link margin. An nRF24L01+ has no RSSI; the sensor's PA level and
+* its auto-retransmits per packet (what power control works from) stand in for one - a sensor
+* at high PA that still needs retransmits is on a weak link.
+*
+*    Each frame is drawn into a screen-sized buffer and compared with the one before. Only the
+* runs of characters that changed are sent, each after a cursor move, all in one write(). Frames
+* are drawn no more often than frameMicros, however fast packets come in. With more sensors than
+* rows, the table pages through them every pageMicros.
+*
+*    USAGE:
+*    1. Construct with the file descriptor of the terminal (stdout).
+*    2. From the main loop, when due(), setStatus() any lines to show under the table, then
+*  draw() with the sensor registry and the time.
+*    3. The destructor puts the cursor back under the table.
+*
+*    NOTE:
+*    1. The terminal size is read (TIOCGWINSZ) each frame; a resize redraws all of it. Without a
+*  terminal it is DASH_DEFAULT_ROWS x DASH_DEFAULT_COLS, or whatever resize() set.
+*    2. Buffers are allocated on the 1st frame and on a resize only.
+*/
+
+#define DASH_FRAME_MICROS 200000        // 5 frames a second at most.
+#define DASH_PAGE_MICROS 5000000        // Each page of sensors shows this long.
+#define DASH_STATUS_LINES 3             // Lines under the table for the caller.
+#define DASH_DEFAULT_ROWS 24
+#define DASH_DEFAULT_COLS 80
+#define DASH_MERGE_GAP 6                // Unchanged characters between two changes: rewrite them rather than move the cursor.
+
+
+class SensorDashboard {
+
+  public:
+
+          /*    PURPOSE: Constructor. Draws on fd. */
+    SensorDashboard(int fd = STDOUT_FILENO) : _fd(fd) {}
+    ~SensorDashboard();
+
+    SensorDashboard(const SensorDashboard&) = delete;
+    SensorDashboard& operator=(const SensorDashboard&) = delete;
+
+    uint64_t frameMicros = DASH_FRAME_MICROS;
+    uint64_t pageMicros = DASH_PAGE_MICROS;
+
+          /*    PURPOSE: Tells if it is time for the next frame. */
+    bool due(uint64_t nowMicros) const { return !_drawn || nowMicros - _lastFrame >= frameMicros; }
+
+          /*    PURPOSE: A line to show under the table, 0 .. DASH_STATUS_LINES-1. */
+    void setStatus(unsigned int line, const char* text);
+
+          /*    PURPOSE: Draw a frame: the title, sensor rows and status lines.
+           *  now is the wall clock the sensors' lastRxTime is on. */
+    void draw(SensorRegistry& sensors, time_t now, uint64_t nowMicros);
+
+          /*    PURPOSE: Use this size rather than the terminal's (0 = the terminal's). */
+    void resize(unsigned int rows, unsigned int cols);
+
+        /* Counts. */
+    unsigned long frames = 0;
+    unsigned long writes = 0;
+    unsigned long bytes = 0;            // Written, cursor moves and all.
+
+  private:
+    int _fd;
+    unsigned int _rows = 0, _cols = 0;
+    unsigned int _fixedRows = 0, _fixedCols = 0;
+    std::vector<char> _screen;          // What the terminal shows.
+    std::vector<char> _frame;           // What it should show.
+    std::vector<char> _out;             // The write().
+    size_t _outLen = 0;
+    char _status[DASH_STATUS_LINES][256] = {};
+    bool _drawn = false;
+    uint64_t _lastFrame = 0;
+
+    void checkSize();
+    char* row(unsigned int r) { return &_frame[(size_t)r * _cols]; }
+    void put(unsigned int r, unsigned int col, unsigned int width, const char* text, size_t len, bool right);
+    void putNumber(unsigned int r, unsigned int col, unsigned int width, double v, int decimals);
+    void putSensor(unsigned int r, const SensorState& st, time_t now);
+    void emit(const char* s, size_t len);
+    void emitMove(unsigned int r, unsigned int col);
+    bool flush(bool full);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline SensorDashboard::~SensorDashboard() {
+    if (!_drawn) return;
+    _outLen = 0;
+    emitMove(_rows - 1, 0);
+    emit("\n\033[?25h", 7);                                 // Below the table, cursor back on.
+    if (write(_fd, _out.data(), _outLen) > 0) bytes += _outLen;
+}
+
+
+inline void SensorDashboard::setStatus(unsigned int line, const char* text) {
+    if (line >= DASH_STATUS_LINES) return;
+    size_t len = strnlen(text, sizeof(_status[line]) - 1);
+    memcpy(_status[line], text, len);
+    _status[line][len] = '\0';
+}
+
+
+inline void SensorDashboard::resize(unsigned int rows, unsigned int cols) {
+    _fixedRows = rows;
+    _fixedCols = cols;
+}
+
+
+inline void SensorDashboard::checkSize() {
+    unsigned int rows = _fixedRows, cols = _fixedCols;
+    if (rows == 0 || cols == 0) {
+        winsize ws;
+        if (ioctl(_fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+            rows = ws.ws_row;
+            cols = ws.ws_col;
+        } else {
+            rows = DASH_DEFAULT_ROWS;
+            cols = DASH_DEFAULT_COLS;
+        }
+    }
+    if (rows < DASH_STATUS_LINES + 3) rows = DASH_STATUS_LINES + 3;
+    if (cols < 20) cols = 20;
+    if (rows == _rows && cols == _cols) return;
+    _rows = rows;
+    _cols = cols;
+    _screen.assign((size_t)rows * cols, ' ');
+    _frame.assign((size_t)rows * cols, ' ');
+    _out.resize((size_t)rows * cols * 2 + rows * 16 + 64);  // Worst case: every other character moved to.
+    _drawn = false;
+}
+
+
+    /* Text into a cell of the frame, padded with spaces, cut to fit. */
+inline void SensorDashboard::put(unsigned int r, unsigned int col, unsigned int width, const char* text, size_t len,
+                                 bool right) {
+    if (r >= _rows || col >= _cols) return;
+    if (col + width > _cols) width = _cols - col;
+    if (len > width) len = width;
+    char* p = row(r) + col;
+    memset(p, ' ', width);
+    memcpy(p + (right ? width - len : 0), text, len);
+}
+
+
+inline void SensorDashboard::putNumber(unsigned int r, unsigned int col, unsigned int width, double v, int decimals) {
+    char buf[32];
+    std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, decimals);
+    put(r, col, width, buf, res.ec == std::errc() ? res.ptr - buf : 0, true);
+}
+
+
+    /* Columns, for the heading and putSensor(). */
+#define DASH_HEADING "   ID  reading pF      age  loss %     mV  empty in  PA  retx/pkt    packets"
+
+
+inline void SensorDashboard::putSensor(unsigned int r, const SensorState& st, time_t now) {
+    char buf[32];
+    std::to_chars_result res;
+
+    res = std::to_chars(buf, buf + sizeof(buf), (unsigned int)st.sensorID);
+    put(r, 0, 5, buf, res.ptr - buf, true);
+    putNumber(r, 5, 12, st.lastCapacitance, 2);
+
+        /* Age: seconds, minutes, hours or days, whichever fits. */
+    long age = (now > st.lastRxTime) ? (long)(now - st.lastRxTime) : 0;
+    char unit = 's';
+    if (age >= 2 * 86400) { age /= 86400; unit = 'd'; }
+    else if (age >= 2 * 3600) { age /= 3600; unit = 'h'; }
+    else if (age >= 120) { age /= 60; unit = 'm'; }
+    res = std::to_chars(buf, buf + sizeof(buf) - 1, age);
+    *res.ptr++ = unit;
+    put(r, 17, 9, buf, res.ptr - buf, true);
+
+        /* Loss: transmits the sensor gave up on, of all it tried, since it booted. */
+    uint64_t tried = (uint64_t)st.lastCtSuccess + st.lastCtErrors;
+    putNumber(r, 26, 8, tried ? 100.0 * st.lastCtErrors / tried : 0.0, 1);
+
+    res = std::to_chars(buf, buf + sizeof(buf), (unsigned int)st.battery.lastMillivolts);
+    put(r, 34, 7, buf, res.ptr - buf, true);
+    if (st.battery.hoursToEmpty < 0) put(r, 41, 10, "--", 2, true);
+    else {
+        res = std::to_chars(buf, buf + sizeof(buf) - 1, (long)(st.battery.hoursToEmpty / 24));
+        *res.ptr++ = 'd';
+        put(r, 41, 10, buf, res.ptr - buf, true);
+    }
+
+    res = std::to_chars(buf, buf + sizeof(buf), (unsigned int)st.power.desiredPALevel);
+    put(r, 51, 4, buf, res.ptr - buf, true);
+    putNumber(r, 55, 10, st.power.retransmitsEwma, 2);
+    res = std::to_chars(buf, buf + sizeof(buf), st.packets);
+    put(r, 65, 11, buf, res.ptr - buf, true);
+}
+
+
+inline void SensorDashboard::draw(SensorRegistry& sensors, time_t now, uint64_t nowMicros) {
+    checkSize();
+    _lastFrame = nowMicros;
+    frames++;
+
+        /* Title, heading, as many sensor rows as fit, status lines. */
+    unsigned int tableRows = _rows - 2 - DASH_STATUS_LINES;
+    unsigned int count = sensors.count();
+    unsigned int pages = (count + tableRows - 1) / tableRows;
+    unsigned int page = (pages > 1) ? (unsigned int)((nowMicros / pageMicros) % pages) : 0;
+    unsigned int first = page * tableRows;
+
+    char title[128];
+    struct tm tmNow;
+    localtime_r(&now, &tmNow);
+    size_t len = strftime(title, 40, "%a %R:%S %F  ", &tmNow);
+    char* p = title + len;
+    p = std::to_chars(p, title + 80, count).ptr;
+    memcpy(p, " sensors", 8);
+    p += 8;
+    if (pages > 1) {
+        memcpy(p, ", page ", 7);
+        p = std::to_chars(p + 7, title + 100, page + 1).ptr;
+        *p++ = '/';
+        p = std::to_chars(p, title + 110, pages).ptr;
+    }
+    put(0, 0, _cols, title, p - title, false);
+    put(1, 0, _cols, DASH_HEADING, sizeof(DASH_HEADING) - 1, false);
+
+    for (unsigned int k = 0; k < tableRows; k++) {
+        if (first + k < count) putSensor(2 + k, *sensors.at(first + k), now);
+        else memset(row(2 + k), ' ', _cols);
+    }
+    for (unsigned int k = 0; k < DASH_STATUS_LINES; k++) {
+        put(_rows - DASH_STATUS_LINES + k, 0, _cols, _status[k], strlen(_status[k]), false);
+    }
+
+    _drawn = flush(!_drawn);
+}
+
+
+inline void SensorDashboard::emit(const char* s, size_t len) {
+    memcpy(&_out[_outLen], s, len);
+    _outLen += len;
+}
+
+
+    /* ESC [ row ; col H, 1-based. */
+inline void SensorDashboard::emitMove(unsigned int r, unsigned int col) {
+    char buf[16] = "\033[";
+    char* p = std::to_chars(buf + 2, buf + 8, r + 1).ptr;
+    *p++ = ';';
+    p = std::to_chars(p, buf + 14, col + 1).ptr;
+    *p++ = 'H';
+    emit(buf, p - buf);
+}
+
+
+    /* Send what differs between the frame and the screen, in one write().
+       False if it didn't all go (e.g. EAGAIN): all of it next time. */
+inline bool SensorDashboard::flush(bool full) {
+    _outLen = 0;
+    if (full) {
+        emit("\033[?25l\033[2J", 10);                       // Cursor off, clear.
+        std::fill(_screen.begin(), _screen.end(), ' ');
+    }
+    for (unsigned int r = 0; r < _rows; r++) {
+        char* want = &_frame[(size_t)r * _cols];
+        char* have = &_screen[(size_t)r * _cols];
+        unsigned int col = 0;
+        while (col < _cols) {
+            if (want[col] == have[col]) {
+                col++;
+                continue;
+            }
+            unsigned int start = col, end = col + 1, same = 0;  // A run of changes, through short gaps.
+            for (unsigned int c = end; c < _cols && same < DASH_MERGE_GAP; c++) {
+                if (want[c] != have[c]) {
+                    end = c + 1;
+                    same = 0;
+                } else {
+                    same++;
+                }
+            }
+            emitMove(r, start);
+            emit(want + start, end - start);
+            memcpy(have + start, want + start, end - start);
+            col = end;
+        }
+    }
+    if (_outLen == 0) return true;
+    ssize_t n = write(_fd, _out.data(), _outLen);
+    writes++;
+    if (n > 0) bytes += n;
+    return n == (ssize_t)_outLen;
+}
+
+#endif
@@ -0,0 +1,67 @@
+// The tiny84 sensor sketch, built twice for RPi_RadioSim - RF24 and NRF24_LITE
+//=================================================================================================
+
+#ifndef SensorFirmware_h
+#define SensorFirmware_h
+
+#include "ArduinoSim/Arduino.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: Pulls the sensor sketch's own source (/Software/tiny84/tiny84_SensorAsSlave) in,
+* unchanged, on top of the Arduino stand-in (ArduinoSim/), once for each radio driver:
+*    > tinyRF24::  RadioComms on the RF24 library (ArduinoSim/RF24.h stands in for it).
+*    > tinyLite::  RadioComms on Nrf24Lite (NRF24_LITE).
+* Each namespace is one whole sensor: its globals (radio, capSensor, dispatcher, ...), setup()
+* and loop(), as the Arduino IDE would build them.
+*
+*    USAGE:
+*    1. Build with -IArduinoSim.
+*    2. Set arduinoBoard to a board whose chip is wired to CE_PIN/CSN_PIN, then call e.g.
+*  tinyLite::setup() once and tinyLite::loop() over and over.
+*
+*    NOTE:
+*    1. The sketch is written for one sensor per CPU - its objects are globals - so each build
+*  can only be run as one sensor, once, per process.
+*    2. The headers' include guards are lifted between the two builds so the 2nd one gets its
+*  own copy of every class.
+*    3. The sketch's VERSION is put aside, so the including program keeps its own.
+*/
+
+#pragma push_macro("VERSION")
+#undef VERSION
+
+namespace tinyRF24 {
+#include "../tiny84/tiny84_SensorAsSlave/tiny84_SensorAsSlave.ino"
+#include "../tiny84/tiny84_SensorAsSlave/HeartBeat.ino"
+#include "../tiny84/tiny84_SensorAsSlave/ErrorFlash.ino"
+#include "../tiny84/tiny84_SensorAsSlave/CapSensor.ino"
+#include "../tiny84/tiny84_SensorAsSlave/RadioComms.ino"
+#include "../tiny84/tiny84_SensorAsSlave/Dispatcher.ino"
+#include "../tiny84/tiny84_SensorAsSlave/MemDiag.ino"
+}
+
+#undef HeartBeat_h
+#undef ErrorFlash_h
+#undef CapSensor_h
+#undef RadioComms_h
+#undef Dispatcher_h
+#undef MemDiag_h
+#define NRF24_LITE
+
+namespace tinyLite {
+#include "../tiny84/tiny84_SensorAsSlave/tiny84_SensorAsSlave.ino"
+#include "../tiny84/tiny84_SensorAsSlave/HeartBeat.ino"
+#include "../tiny84/tiny84_SensorAsSlave/ErrorFlash.ino"
+#include "../tiny84/tiny84_SensorAsSlave/CapSensor.ino"
+#include "../tiny84/tiny84_SensorAsSlave/RadioComms.ino"
+#include "../tiny84/tiny84_SensorAsSlave/Dispatcher.ino"
+#include "../tiny84/tiny84_SensorAsSlave/MemDiag.ino"
+#include "../tiny84/tiny84_SensorAsSlave/Nrf24Lite.ino"
+}
+
+#undef NRF24_LITE
+#undef VERSION
+#pragma pop_macro("VERSION")
+
+#endif
@@ -0,0 +1,348 @@
+// Class: SensorHistory - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SensorHistory_h
+#define SensorHistory_h
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>           // std::unique_ptr
+#include <vector>
+
+/************************************************************************************************
+*
+*    PURPOSE: The last HISTORY_DAYS of every sensor's readings, in RAM, so recent history can be
+* plotted or worked over without reading the log file back. Points are packed as Facebook's
+* Gorilla time series database packs them, about 2 bytes a point:
+*       > Time: the change in the gap since the last point (delta of delta), in seconds. Readings
+*         come at a steady interval, so it is mostly 0 (1 bit) or a few seconds (9 bits).
+*       > Capacitance: the float's bits XORed with the last one's. Readings change slowly, so
+*         the sign, exponent and top of the mantissa are mostly the same and the XOR has long
+*         runs of 0s; only the bits between them are kept, in the same window as last time
+*         if they fit it.
+*  Each sensor's points go in a chain of HISTORY_BLOCK_BYTES blocks. A block starts with its
+*  first point in full, so it can be read without the ones before it, and the oldest block is
+*  dropped whole as it ages out.
+*
+*    USAGE:
+*    1. Construct with the number of sensor slots (SensorRegistry's) and the days to keep. The
+*  blocks are all allocated then; memory is only touched as they are used.
+*    2. append() each reading, with its sensor's slot, time and capacitance.
+*    3. forEach() the points of a slot in a time range, oldest first.
+*
+*    NOTE:
+*    1. Capacitance is kept as sent: all 23 mantissa bits (HISTORY_MANTISSA_BITS), ~4 bytes a
+*  point with the tiny84's averaged readings. Setting mantissaBits to fewer is opt-in and lossy:
+*  HISTORY_LOSSY_MANTISSA_BITS (14, about 1 part in 16000 or 0.01pF at 100pF - finer than the
+*  sensor's ADC tells apart after averaging) rounds off the noisy low bits, for ~2.8 bytes a point.
+*  RPi_GatewaySoak -p shows both.
+*    2. The pool is sized for a reading every HISTORY_INTERVAL_SECONDS at HISTORY_POINT_BYTES.
+*  A sensor sending more often than that runs out of its share, and then its own oldest block
+*  goes to make room: it keeps fewer days rather than taking others' blocks.
+*    3. append() doesn't allocate.
+*/
+
+#define HISTORY_DAYS 30                 // Days of readings kept.
+#define HISTORY_BLOCK_BYTES 512
+#define HISTORY_INTERVAL_SECONDS 900    // Dispatcher's reading interval, for sizing the pool.
+#define HISTORY_POINT_BYTES 5           // For sizing the pool: a little over what a point takes.
+#define HISTORY_MANTISSA_BITS 23        // Capacitance mantissa bits kept: all of them.
+#define HISTORY_LOSSY_MANTISSA_BITS 14  // Opt-in: fewer bits, fewer bytes, to within 1 part in 16000.
+
+
+class SensorHistory {
+
+  public:
+
+          /*    PURPOSE: Constructor. Allocates the block pool. */
+    SensorHistory(unsigned int slots, unsigned int days = HISTORY_DAYS);
+
+          /*    PURPOSE: Add a reading to a sensor's history.
+           *    RETURNS: False if there was no room for it (its slot out of range, or no
+           *  block to be had). */
+    bool append(unsigned int slot, time_t t, float capacitance);
+
+          /*    PURPOSE: Call visit(time_t, float) for each of a slot's points from .. to,
+           *  oldest first.
+           *    RETURNS: The number of points visited. */
+    template <typename F> unsigned long forEach(unsigned int slot, time_t from, time_t to, F visit) const;
+
+          /*    PURPOSE: Points held for a slot. */
+    unsigned long points(unsigned int slot) const { return slot < _series.size() ? _series[slot].points : 0; }
+
+          /*    PURPOSE: Bytes the packed points take, across all slots; blocks in use. */
+    size_t bytes() const { return (_bits + 7) / 8; }
+    unsigned int blocksInUse() const { return _blocksInUse; }
+    unsigned int blocks() const { return _blockCount; }
+
+    unsigned int mantissaBits = HISTORY_MANTISSA_BITS;
+
+        /* Counts. */
+    unsigned long appended = 0;
+    unsigned long dropped = 0;          // Points there was no room for.
+    unsigned long reclaimed = 0;        // Blocks taken back from a sensor short of room.
+
+  private:
+    static constexpr uint32_t NO_BLOCK = 0xFFFFFFFF;
+    static constexpr unsigned int BLOCK_WORDS = (HISTORY_BLOCK_BYTES - 16) / 8;
+    static constexpr unsigned int BLOCK_BITS = (BLOCK_WORDS - 1) * 64;     // Last word is padding for reads.
+    static constexpr unsigned int MAX_POINT_BITS = 4 + 32 + 2 + 5 + 5 + 32;
+
+    struct Block {
+        uint32_t next;                  // Newer block of the same sensor.
+        uint32_t firstTime;
+        uint32_t lastTime;
+        uint16_t count;                 // Points in it.
+        uint16_t bits;                  // Of words[] written.
+        uint64_t words[BLOCK_WORDS];    // Bits, first from the top of words[0].
+    };
+
+        /* A sensor's chain of blocks, and what the next point is packed
+           against. */
+    struct Series {
+        uint32_t head = NO_BLOCK;       // Oldest block.
+        uint32_t tail = NO_BLOCK;       // Block being filled.
+        unsigned long points = 0;
+        uint32_t lastTime = 0;
+        int32_t lastDelta = 0;
+        uint32_t lastValue = 0;
+        uint8_t lastLeading = 0;        // XOR window: 0s above and below the kept bits.
+        uint8_t lastTrailing = 0;
+    };
+
+    std::unique_ptr<Block[]> _blocks;
+    unsigned int _blockCount;
+    unsigned int _blocksInUse = 0;
+    unsigned int _fresh = 0;            // Blocks never used yet start here.
+    uint32_t _free = NO_BLOCK;          // Chain of blocks given back.
+    std::vector<Series> _series;
+    time_t _keepSeconds;
+    size_t _bits = 0;
+
+    uint32_t takeBlock(Series& s);
+    void dropHead(Series& s);
+    uint32_t trim(float v) const;
+
+    static void put(Block& b, uint64_t v, unsigned int n);
+
+        /* Bits out of a block, from the top down. */
+    struct Reader {
+        const uint64_t* w;
+        unsigned int pos;
+        uint64_t peek(unsigned int n) const {
+            unsigned int word = pos >> 6, off = pos & 63;
+            uint64_t v = w[word] << off;
+            if (off) v |= w[word + 1] >> (64 - off);
+            return v >> (64 - n);
+        }
+        uint64_t take(unsigned int n) {
+            uint64_t v = peek(n);
+            pos += n;
+            return v;
+        }
+    };
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline SensorHistory::SensorHistory(unsigned int slots, unsigned int days)
+    : _series(slots), _keepSeconds((time_t)days * 86400) {
+    size_t perSensor = ((size_t)days * 86400 / HISTORY_INTERVAL_SECONDS * HISTORY_POINT_BYTES + BLOCK_BITS / 8 - 1)
+                     / (BLOCK_BITS / 8) + 1;
+    _blockCount = (unsigned int)(perSensor * slots);
+    _blocks.reset(new Block[_blockCount]);                          // Not zeroed: untouched till used.
+}
+
+
+    /* Write the low n bits of v (n 1..64). The words ahead are zeroed when
+       the block is taken. */
+inline void SensorHistory::put(Block& b, uint64_t v, unsigned int n) {
+    unsigned int word = b.bits >> 6, room = 64 - (b.bits & 63);
+    if (n < 64) v &= (1ULL << n) - 1;
+    if (n <= room) {
+        b.words[word] |= v << (room - n);
+    } else {
+        b.words[word] |= v >> (n - room);
+        b.words[word + 1] |= v << (64 - (n - room));
+    }
+    b.bits += n;
+}
+
+
+    /* The float's bits, rounded to mantissaBits. */
+inline uint32_t SensorHistory::trim(float v) const {
+    uint32_t bits;
+    memcpy(&bits, &v, 4);
+    unsigned int drop = (mantissaBits < 23) ? 23 - mantissaBits : 0;
+    if (drop && (bits & 0x7F800000) != 0x7F800000) {               // Not inf or NaN.
+        bits += 1u << (drop - 1);                                   // Carrying into the exponent is right.
+        bits &= ~((1u << drop) - 1);
+    }
+    return bits;
+}
+
+
+inline void SensorHistory::dropHead(Series& s) {
+    uint32_t k = s.head;
+    Block& b = _blocks[k];
+    s.head = b.next;
+    s.points -= b.count;
+    _bits -= b.bits;
+    b.next = _free;
+    _free = k;
+    _blocksInUse--;
+}
+
+
+    /* A block for s to fill: a fresh one, one given back, or s's own oldest. */
+inline uint32_t SensorHistory::takeBlock(Series& s) {
+    uint32_t k;
+    if (_free != NO_BLOCK) {
+        k = _free;
+        _free = _blocks[k].next;
+    } else if (_fresh < _blockCount) {
+        k = _fresh++;
+    } else if (s.head != s.tail) {
+        k = s.head;
+        dropHead(s);
+        _free = _blocks[k].next;
+        reclaimed++;
+    } else {
+        return NO_BLOCK;
+    }
+    Block& b = _blocks[k];
+    b.next = NO_BLOCK;
+    b.count = 0;
+    b.bits = 0;
+    memset(b.words, 0, sizeof(b.words));
+    if (s.tail != NO_BLOCK) _blocks[s.tail].next = k;
+    else s.head = k;
+    s.tail = k;
+    _blocksInUse++;
+    return k;
+}
+
+
+inline bool SensorHistory::append(unsigned int slot, time_t t, float capacitance) {
+    if (slot >= _series.size()) {
+        dropped++;
+        return false;
+    }
+    Series& s = _series[slot];
+    uint32_t time = (uint32_t)t;
+    uint32_t value = trim(capacitance);
+
+        /* Let go of what has aged out; the block being filled stays. */
+    while (s.head != s.tail && (time_t)_blocks[s.head].lastTime + _keepSeconds < t) dropHead(s);
+
+    if (s.tail == NO_BLOCK || _blocks[s.tail].bits + MAX_POINT_BITS > BLOCK_BITS) {
+        if (takeBlock(s) == NO_BLOCK) {
+            dropped++;
+            return false;
+        }
+    }
+    Block& b = _blocks[s.tail];
+    unsigned int bits0 = b.bits;
+
+    if (b.count == 0) {                                             // 1st point of a block: in full.
+        b.firstTime = time;
+        put(b, ((uint64_t)time << 32) | value, 64);
+        s.lastDelta = 0;
+        s.lastLeading = 0;
+        s.lastTrailing = 0;
+    } else {
+            /* Time: delta of delta, in 1, 9, 12, 16 or 36 bits. */
+        int32_t delta = (int32_t)(time - s.lastTime);
+        int64_t dod = (int64_t)delta - s.lastDelta;
+        if (dod == 0) put(b, 0, 1);
+        else if (dod >= -63 && dod <= 64) put(b, (0x2ULL << 7) | (uint64_t)(dod + 63), 9);
+        else if (dod >= -255 && dod <= 256) put(b, (0x6ULL << 9) | (uint64_t)(dod + 255), 12);
+        else if (dod >= -2047 && dod <= 2048) put(b, (0xEULL << 12) | (uint64_t)(dod + 2047), 16);
+        else put(b, (0xFULL << 32) | (uint32_t)(int32_t)dod, 36);
+        s.lastDelta = delta;
+
+            /* Value: XOR with the last, the bits between its 0s. */
+        uint32_t x = value ^ s.lastValue;
+        if (x == 0) {
+            put(b, 0, 1);
+        } else {
+            unsigned int leading = __builtin_clz(x), trailing = __builtin_ctz(x);
+            if (s.lastLeading + s.lastTrailing > 0 && leading >= s.lastLeading && trailing >= s.lastTrailing) {
+                unsigned int n = 32 - s.lastLeading - s.lastTrailing;
+                put(b, (0x2ULL << n) | (x >> s.lastTrailing), n + 2);
+            } else {
+                unsigned int n = 32 - leading - trailing;
+                put(b, (0x3ULL << 10) | (leading << 5) | (n - 1), 12);
+                put(b, x >> trailing, n);
+                s.lastLeading = leading;
+                s.lastTrailing = trailing;
+            }
+        }
+    }
+    b.count++;
+    b.lastTime = time;
+    s.lastTime = time;
+    s.lastValue = value;
+    s.points++;
+    _bits += b.bits - bits0;
+    appended++;
+    return true;
+}
+
+
+template <typename F> unsigned long SensorHistory::forEach(unsigned int slot, time_t from, time_t to, F visit) const {
+    if (slot >= _series.size()) return 0;
+    unsigned long n = 0;
+    for (uint32_t k = _series[slot].head; k != NO_BLOCK; k = _blocks[k].next) {
+        const Block& b = _blocks[k];
+        if ((time_t)b.lastTime < from) continue;
+        if ((time_t)b.firstTime > to) break;
+
+        Reader r = {b.words, 0};
+        uint32_t time = (uint32_t)r.take(32);
+        uint32_t value = (uint32_t)r.take(32);
+        int32_t delta = 0;
+        unsigned int leading = 0, trailing = 0;
+        for (unsigned int i = 0;;) {
+            if ((time_t)time >= from) {
+                if ((time_t)time > to) return n;
+                float v;
+                memcpy(&v, &value, 4);
+                visit((time_t)time, v);
+                n++;
+            }
+            if (++i == b.count) break;
+
+            uint64_t c = r.peek(4);
+            if (c < 8) r.pos += 1;
+            else if (c < 12) delta += (int32_t)r.take(9) - (0x2 << 7) - 63;
+            else if (c < 14) delta += (int32_t)r.take(12) - (0x6 << 9) - 255;
+            else if (c < 15) delta += (int32_t)r.take(16) - (0xE << 12) - 2047;
+            else delta += (int32_t)(uint32_t)(r.take(36) & 0xFFFFFFFF);
+            time += delta;
+
+            if (r.take(1)) {
+                if (r.take(1) == 0) {
+                    unsigned int bits = 32 - leading - trailing;
+                    value ^= (uint32_t)r.take(bits) << trailing;
+                } else {
+                    uint64_t h = r.take(10);
+                    leading = (unsigned int)(h >> 5);
+                    unsigned int bits = (unsigned int)(h & 31) + 1;
+                    trailing = 32 - leading - bits;
+                    value ^= (uint32_t)r.take(bits) << trailing;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+#endif
@@ -0,0 +1,140 @@
+// Class: SensorRegistry - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SensorRegistry_h
+#define SensorRegistry_h
+
+#include <cstdint>
+#include <ctime>
+#include <cstring>
+#include <vector>
+#include "PowerControl.h"
+#include "BatteryTracker.h"
+#include "SensorClock.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: Keeps what the RPi knows about each sensor, keyed by the sensorID the sensor puts
+* in its payload. Up until now there was one sensor and one global rxPayload; anything that has
+* to remember a sensor's history from one packet to the next (power control, loss counts, etc.)
+* keeps its per sensor data in a SensorState slot here.
+*
+*    USAGE:
+*    1. Declare one SensorRegistry. All slots are allocated up front by the constructor, so
+*  nothing is allocated once packets start coming in.
+*    2. Call lookup() with a packet's sensorID to get that sensor's slot. The first time an ID is
+*  seen a slot is handed out and SensorState.packets is 0.
+*    3. Call pendingCommand()/queueCommand() to manage which sensor the next ACK payload is for.
+*
+*    NOTE:
+*    1. SensorState is kept as plain data (no pointers, no std::string) on purpose.
+*/
+
+#define MAX_SENSORS 1024                // Slots allocated at startup.
+#define MAX_SENSOR_ID 0xFFFF            // sensorID is a uint16_t in the payload.
+#define NO_SLOT 0xFFFF
+#define PENDING_QUEUE_SIZE 64           // Sensors that can be waiting on a command at once.
+
+
+struct SensorState {
+    uint16_t sensorID;
+    bool commandQueued;                 // On the pending command queue already.
+    uint32_t packets;                   // Packets received from this sensor (kept across restarts with a StateFile).
+    time_t lastRxTime;                  // RPi time of the last packet.
+    time_t lastLog;                     // RPi time of its last log entry, 0 = none yet.
+    float lastCapacitance;
+    uint32_t lastSensorTime;
+    uint32_t lastCtSuccess;
+    uint32_t lastCtErrors;
+    uint16_t bootAckMillis;             // Sensor's boot to 1st ACK time, as last reported.
+    uint16_t stackUnusedMin;            // Lowest unused stack a diagnostic build has reported, 0 = none yet.
+    PowerControlState power;
+    BatteryState battery;
+    SensorClockState clock;             // sensorTime to wall time (SensorClock.h).
+};
+
+
+class SensorRegistry {
+
+  public:
+
+          /*    PURPOSE: Constructor. Allocates all the sensor slots. */
+    SensorRegistry(unsigned int maxSensors = MAX_SENSORS);
+
+          /*    PURPOSE: Find the slot for a sensor, handing out a new one the 1st time
+           *  we hear from it.
+           *    RETURNS: Pointer to the slot; NULL if the registry is full. */
+    SensorState* lookup(uint16_t sensorID);
+
+          /*    PURPOSE: Number of distinct sensors heard from. */
+    unsigned int count() const { return _used; }
+
+          /*    PURPOSE: Slot by index, 0 .. count()-1. For walking all the sensors. */
+    SensorState* at(unsigned int i) { return &_slots[i]; }
+    unsigned int indexOf(const SensorState* st) const { return st - _slots.data(); }
+    unsigned int capacity() const { return _slots.size(); }
+
+          /*    PURPOSE: Put a sensor on the queue of those with a command waiting
+           *  to go out in an ACK payload. Does nothing if it is already there. */
+    void queueCommand(SensorState* st);
+
+          /*    PURPOSE: Take the sensor whose command has waited longest off the
+           *  queue. RETURNS: NULL if no commands are waiting. */
+    SensorState* pendingCommand();
+
+          /*    PURPOSE: Number of sensors with a command waiting. */
+    unsigned int pendingCount() const { return _pendingCount; }
+
+  private:
+    std::vector<SensorState> _slots;
+    std::vector<uint16_t> _index;       // sensorID -> slot number, or NO_SLOT
+    unsigned int _used = 0;
+    uint16_t _pending[PENDING_QUEUE_SIZE];
+    unsigned int _pendingHead = 0;
+    unsigned int _pendingCount = 0;
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline SensorRegistry::SensorRegistry(unsigned int maxSensors)
+    : _slots(maxSensors), _index(MAX_SENSOR_ID + 1, NO_SLOT) {
+    memset(_slots.data(), 0, _slots.size() * sizeof(SensorState));
+}
+
+
+inline SensorState* SensorRegistry::lookup(uint16_t sensorID) {
+    uint16_t slot = _index[sensorID];
+    if (slot != NO_SLOT) return &_slots[slot];
+    if (_used >= _slots.size()) return NULL;
+
+    slot = _used++;
+    _index[sensorID] = slot;
+    _slots[slot].sensorID = sensorID;
+    return &_slots[slot];
+}
+
+
+inline void SensorRegistry::queueCommand(SensorState* st) {
+    if (st->commandQueued || _pendingCount >= PENDING_QUEUE_SIZE) return;
+    _pending[(_pendingHead + _pendingCount) % PENDING_QUEUE_SIZE] = st->sensorID;
+    _pendingCount++;
+    st->commandQueued = true;
+}
+
+
+inline SensorState* SensorRegistry::pendingCommand() {
+    if (_pendingCount == 0) return NULL;
+    SensorState* st = &_slots[_index[_pending[_pendingHead]]];
+    _pendingHead = (_pendingHead + 1) % PENDING_QUEUE_SIZE;
+    _pendingCount--;
+    st->commandQueued = false;
+    return st;
+}
+
+#endif
@@ -0,0 +1,440 @@
+// Class: SensorRollup - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SensorRollup_h
+#define SensorRollup_h
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>            // sqrt()
+#include <ctime>
+#include <fcntl.h>          // open()
+#include <sys/mman.h>       // mmap(), msync()
+#include <sys/stat.h>       // fstat()
+#include <unistd.h>         // ftruncate(), close()
+
+/************************************************************************************************
+*
+*    PURPOSE: Each sensor's readings summed up over 15 minutes, an hour, 8 hours and a week, so a
+* question like "the last year for pot 12" is answered from a thousand sums rather than every
+* reading. Each bucket has the count, min, max, sum and sum of squares of its readings, which
+* give the mean and standard deviation too, and two buckets merge into one by adding them.
+* Each level is a ring of buckets, updated as each reading comes in: four buckets touched, the
+* same work however long the history.
+*
+*         Level     Bucket   Kept
+*           0      15 min    ROLLUP_15MIN_BUCKETS (2 days)
+*           1       1 hour   ROLLUP_HOUR_BUCKETS (a month)
+*           2       8 hours  ROLLUP_8HOUR_BUCKETS (a year: a year in 1000 points is ~1095 of them)
+*           3       1 week   ROLLUP_WEEK_BUCKETS (5 years)
+*
+*    A slot is slotBytes(), 72KB: 72MB for MAX_SENSORS. The slots are one mapping, in a file if
+* open() was given one, so they outlast the process - a restart, kill -9 or the watchdog's
+* included - and the kernel keeps in RAM only the pages in use: a sensor's newest bucket of each
+* level as readings come in (~20MB for MAX_SENSORS), the rest while it is queried. Without a
+* file it is anonymous memory, touched only as used.
+*
+*    USAGE:
+*    1. Construct with the number of sensor slots (SensorRegistry's), then open() the file, if
+*  it is to be kept, before the 1st add(). A missing file, or one made for other levels or slot
+*  count, is started over (fresh() says so).
+*    2. add() each reading, with its sensor's slot and ID, time and capacitance. A slot holding
+*  another sensor's readings is cleared first. move() a slot whose sensor has moved in the
+*  registry; clear() one no longer used. sync() to have it all on the disk now.
+*    3. query() a slot from .. to in about so many points: each point is a RollupPoint, the
+*  merged buckets of the coarsest level fine enough for that many points, of those that still
+*  go back to from. If none does, the finest that does. levelFor() says which it would be.
+*  slotOf() finds a sensor's slot; holds() says if a slot is a sensor's.
+*    4. Another process can open() the same file read only, to query() it while the receiver
+*  adds to it.
+*
+*    NOTE:
+*    1. Buckets are on UTC boundaries; weeks start on Monday.
+*    2. A reading older than its level's ring goes back is not added to that level. A reading
+*  in a bucket that has been passed, but is still in the ring, is: late readings count.
+*    3. Neither add() nor query() allocates or makes a system call.
+*    4. A bucket is not updated atomically. Killed part way through an add(), a sensor's newest
+*  buckets may have that reading in some levels and not others, or in a bucket's count and not
+*  its sum. It is one reading, so it is left at that. After a power cut, buckets written since
+*  the kernel last wrote them back may be as they were.
+*/
+
+#define ROLLUP_LEVELS 4
+#define ROLLUP_15MIN_BUCKETS (4 * 24 * 2)
+#define ROLLUP_HOUR_BUCKETS (24 * 31)
+#define ROLLUP_8HOUR_BUCKETS (3 * 366)
+#define ROLLUP_WEEK_BUCKETS (52 * 5 + 2)
+#define ROLLUP_FILE_MAGIC "CAPROLUP"
+#define ROLLUP_FILE_VERSION 1
+
+
+    /* count readings, or merged buckets' worth, from start for seconds. */
+struct RollupPoint {
+    time_t start;
+    time_t seconds;
+    uint32_t count;
+    float min;
+    float max;
+    double sum;
+    double sumSquares;
+
+    double mean() const { return count ? sum / count : 0; }
+    double stddev() const {
+        if (count < 2) return 0;
+        double v = (sumSquares - sum * sum / count) / (count - 1);
+        return v > 0 ? sqrt(v) : 0;
+    }
+};
+
+
+class SensorRollup {
+
+  public:
+
+          /*    PURPOSE: Constructor. Maps anonymous memory for the slots; nothing is
+           *  touched until it is used. */
+    SensorRollup(unsigned int slots);
+    ~SensorRollup();
+
+    SensorRollup(const SensorRollup&) = delete;
+    SensorRollup& operator=(const SensorRollup&) = delete;
+
+          /*    PURPOSE: Keep the slots in a file from now on, picking up what is in it.
+           *  Anything add()ed before is dropped. Read only, a file that doesn't match
+           *  is left alone.
+           *    RETURNS: False if it couldn't be opened (or didn't match, read only). */
+    bool open(const char* path, bool readOnly = false);
+
+    bool isOpen() const { return _fd >= 0; }
+    bool fresh() const { return _fresh; }
+
+          /*    PURPOSE: Add a reading to every level of a sensor's rollups.
+           *    RETURNS: False if the slot is out of range, or read only. */
+    bool add(unsigned int slot, uint16_t sensorID, time_t t, float capacitance);
+
+          /*    PURPOSE: A slot's readings from .. to, in about points RollupPoints, oldest first,
+           *  each to visit(const RollupPoint&). Empty stretches have none.
+           *    RETURNS: The number of points visited. */
+    template <typename F> unsigned int query(unsigned int slot, time_t from, time_t to, unsigned int points,
+                                             F visit) const;
+
+          /*    PURPOSE: The level query() would use.
+           *    RETURNS: 0 .. ROLLUP_LEVELS-1; -1 if the slot has no readings. */
+    int levelFor(unsigned int slot, time_t from, time_t to, unsigned int points) const;
+
+          /*    PURPOSE: The slot with a sensor's readings.
+           *    RETURNS: -1 if there isn't one. */
+    int slotOf(uint16_t sensorID) const;
+    bool holds(unsigned int slot, uint16_t sensorID) const {
+        return slot < _slots && series(slot)->inUse && series(slot)->sensorID == sensorID;
+    }
+
+    void move(unsigned int from, unsigned int to);
+    void clear(unsigned int slot);
+
+          /*    PURPOSE: Write everything out to the disk, and wait for it. */
+    void sync();
+
+    static time_t bucketSeconds(int level) { return LEVEL_SECONDS[level]; }
+    static unsigned int bucketsKept(int level) { return LEVEL_BUCKETS[level]; }
+    static size_t slotBytes() { return SLOT_BYTES; }
+
+          /*    PURPOSE: Slots with readings in them; their bytes. */
+    unsigned int slots() const { return _slots; }
+    unsigned int slotsInUse() const { return _slotsInUse; }
+    size_t bytes() const { return _slotsInUse * slotBytes(); }
+
+        /* Counts. */
+    unsigned long added = 0;
+    unsigned long tooOld = 0;           // Level updates skipped: older than the ring.
+
+  private:
+    static constexpr int WEEK_LEVEL = ROLLUP_LEVELS - 1;
+    static constexpr time_t LEVEL_SECONDS[ROLLUP_LEVELS] = {15 * 60, 60 * 60, 8 * 60 * 60, 7 * 24 * 60 * 60};
+    static constexpr unsigned int LEVEL_BUCKETS[ROLLUP_LEVELS] = {ROLLUP_15MIN_BUCKETS, ROLLUP_HOUR_BUCKETS,
+                                                                  ROLLUP_8HOUR_BUCKETS, ROLLUP_WEEK_BUCKETS};
+    static constexpr unsigned int SLOT_BUCKETS = ROLLUP_15MIN_BUCKETS + ROLLUP_HOUR_BUCKETS + ROLLUP_8HOUR_BUCKETS
+                                               + ROLLUP_WEEK_BUCKETS;
+    static constexpr time_t WEEK_OFFSET = 3 * 24 * 60 * 60;         // 1/1/1970 was a Thursday.
+    static constexpr size_t PAGE_BYTES = 4096;
+
+    struct Bucket {
+        double sum;
+        double sumSquares;
+        float min;
+        float max;
+        uint32_t count;
+        uint32_t number;                // Which bucket since the epoch it holds; its start / width.
+    };
+
+        /* The start of a slot, followed by its buckets, all levels' rings
+           one after another. */
+    struct Series {
+        uint16_t sensorID;
+        uint16_t inUse;                 // 0 = no readings, and every bucket is zeros.
+        uint32_t reserved;
+        int64_t first;                  // Earliest reading.
+        uint32_t newest[ROLLUP_LEVELS]; // Newest bucket number each level has seen.
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t slots;
+        uint32_t slotBytes;
+        uint32_t levelSeconds[ROLLUP_LEVELS];
+        uint32_t levelBuckets[ROLLUP_LEVELS];
+    };
+
+        /* Slots are whole pages, so each sensor's are its own. */
+    static constexpr size_t BUCKETS_OFFSET = (sizeof(Series) + sizeof(Bucket) - 1) / sizeof(Bucket) * sizeof(Bucket);
+    static constexpr size_t SLOT_BYTES = (BUCKETS_OFFSET + SLOT_BUCKETS * sizeof(Bucket) + PAGE_BYTES - 1)
+                                         / PAGE_BYTES * PAGE_BYTES;
+    static constexpr size_t SLOTS_OFFSET = (sizeof(Header) + PAGE_BYTES - 1) / PAGE_BYTES * PAGE_BYTES;
+
+    uint8_t* _map = NULL;
+    size_t _size = 0;
+    int _fd = -1;
+    unsigned int _slots;
+    unsigned int _slotsInUse = 0;
+    unsigned int _levelStart[ROLLUP_LEVELS];
+    bool _fresh = false;
+    bool _readOnly = false;
+
+    static uint32_t number(int level, time_t t) {
+        return (uint32_t)((t + (level == WEEK_LEVEL ? WEEK_OFFSET : 0)) / LEVEL_SECONDS[level]);
+    }
+    static time_t startOf(int level, uint32_t n) {
+        return (time_t)n * LEVEL_SECONDS[level] - (level == WEEK_LEVEL ? WEEK_OFFSET : 0);
+    }
+    Series* series(unsigned int slot) const { return (Series*)(_map + SLOTS_OFFSET + slot * SLOT_BYTES); }
+    Bucket* ring(unsigned int slot, int level) const {
+        return (Bucket*)((uint8_t*)series(slot) + BUCKETS_OFFSET) + _levelStart[level];
+    }
+    bool matches(const Header& h) const;
+    bool covers(const Series& s, int level, time_t from) const;
+    void countInUse();
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline SensorRollup::SensorRollup(unsigned int slots) : _slots(slots) {
+    unsigned int at = 0;
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        _levelStart[level] = at;
+        at += LEVEL_BUCKETS[level];
+    }
+    _size = SLOTS_OFFSET + (size_t)slots * SLOT_BYTES;
+    void* map = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    _map = (map == MAP_FAILED) ? NULL : (uint8_t*)map;
+    if (!_map) _slots = 0;
+}
+
+
+inline SensorRollup::~SensorRollup() {
+    if (_map) munmap(_map, _size);
+    if (_fd >= 0) close(_fd);
+}
+
+
+inline bool SensorRollup::matches(const Header& h) const {
+    bool ok = memcmp(h.magic, ROLLUP_FILE_MAGIC, 8) == 0 && h.version == ROLLUP_FILE_VERSION && h.slots == _slots
+              && h.slotBytes == SLOT_BYTES;
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        ok = ok && h.levelSeconds[level] == LEVEL_SECONDS[level] && h.levelBuckets[level] == LEVEL_BUCKETS[level];
+    }
+    return ok;
+}
+
+
+    /* As StateFile::open(). The anonymous mapping is swapped for the
+       file's; a fresh file is all zeros, and sparse until used. */
+inline bool SensorRollup::open(const char* path, bool readOnly) {
+    if (!_map || _fd >= 0) return false;
+    int fd = ::open(path, (readOnly ? O_RDONLY : O_RDWR | O_CREAT) | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    struct stat sb;
+    Header h;
+    bool ok = fstat(fd, &sb) == 0 && (size_t)sb.st_size == _size && pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h)
+              && matches(h);
+    if (!ok && (readOnly || ftruncate(fd, 0) != 0 || ftruncate(fd, _size) != 0)) {
+        close(fd);
+        return false;
+    }
+
+    void* map = mmap(NULL, _size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    munmap(_map, _size);
+    _map = (uint8_t*)map;
+    _fd = fd;
+    _fresh = !ok;
+    _readOnly = readOnly;
+    if (_fresh) {
+        Header* hdr = (Header*)_map;
+        memcpy(hdr->magic, ROLLUP_FILE_MAGIC, 8);
+        hdr->version = ROLLUP_FILE_VERSION;
+        hdr->slots = _slots;
+        hdr->slotBytes = SLOT_BYTES;
+        for (int level = 0; level < ROLLUP_LEVELS; level++) {
+            hdr->levelSeconds[level] = LEVEL_SECONDS[level];
+            hdr->levelBuckets[level] = LEVEL_BUCKETS[level];
+        }
+        sync();
+    }
+    countInUse();
+    return true;
+}
+
+
+inline void SensorRollup::countInUse() {
+    _slotsInUse = 0;
+    for (unsigned int slot = 0; slot < _slots; slot++) {
+        if (series(slot)->inUse) _slotsInUse++;
+    }
+}
+
+
+inline bool SensorRollup::add(unsigned int slot, uint16_t sensorID, time_t t, float capacitance) {
+    if (slot >= _slots || _readOnly) return false;
+    Series& s = *series(slot);
+    if (s.inUse && s.sensorID != sensorID) clear(slot);             // Another sensor's, from before a restart.
+    if (!s.inUse) {
+        s.sensorID = sensorID;
+        s.first = t;
+        s.inUse = 1;
+        _slotsInUse++;
+    }
+    if (t < s.first) s.first = t;
+
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {
+        uint32_t n = number(level, t);
+        if (n > s.newest[level]) s.newest[level] = n;
+        else if (s.newest[level] - n >= LEVEL_BUCKETS[level]) {
+            tooOld++;
+            continue;
+        }
+        Bucket& b = ring(slot, level)[n % LEVEL_BUCKETS[level]];
+        if (b.number != n || b.count == 0) {                        // Starting it, over what it held a lap ago.
+            b.number = n;
+            b.count = 0;
+            b.sum = 0;
+            b.sumSquares = 0;
+            b.min = capacitance;
+            b.max = capacitance;
+        }
+        b.count++;
+        b.sum += capacitance;
+        b.sumSquares += (double)capacitance * capacitance;
+        if (capacitance < b.min) b.min = capacitance;
+        if (capacitance > b.max) b.max = capacitance;
+    }
+    added++;
+    return true;
+}
+
+
+inline int SensorRollup::slotOf(uint16_t sensorID) const {
+    for (unsigned int slot = 0; slot < _slots; slot++) {
+        const Series& s = *series(slot);
+        if (s.inUse && s.sensorID == sensorID) return (int)slot;
+    }
+    return -1;
+}
+
+
+inline void SensorRollup::move(unsigned int from, unsigned int to) {
+    if (from >= _slots || to >= _slots || from == to || _readOnly) return;
+    clear(to);
+    if (!series(from)->inUse) return;
+    memcpy(series(to), series(from), SLOT_BYTES);
+    _slotsInUse++;
+    clear(from);
+}
+
+
+    /* Only a slot in use is written to, so the pages of one that never
+       was stay untouched. */
+inline void SensorRollup::clear(unsigned int slot) {
+    if (slot >= _slots || _readOnly || !series(slot)->inUse) return;
+    memset(series(slot), 0, SLOT_BYTES);
+    _slotsInUse--;
+}
+
+
+inline void SensorRollup::sync() {
+    if (_fd >= 0 && !_readOnly) msync(_map, _size, MS_SYNC);
+}
+
+
+    /* Does a level still go back to from, or to the sensor's 1st reading
+       if that is later? */
+inline bool SensorRollup::covers(const Series& s, int level, time_t from) const {
+    uint32_t newest = s.newest[level];
+    uint32_t oldest = (newest >= LEVEL_BUCKETS[level]) ? newest - LEVEL_BUCKETS[level] + 1 : 0;
+    time_t need = (from > s.first) ? from : (time_t)s.first;
+    return number(level, need) >= oldest;
+}
+
+
+inline int SensorRollup::levelFor(unsigned int slot, time_t from, time_t to, unsigned int points) const {
+    if (slot >= _slots || !series(slot)->inUse) return -1;
+    const Series& s = *series(slot);
+    time_t step = (points && to > from) ? (to - from) / points : 0;
+    for (int level = ROLLUP_LEVELS - 1; level >= 0; level--) {      // Coarsest fine enough.
+        if (LEVEL_SECONDS[level] <= step && covers(s, level, from)) return level;
+    }
+    for (int level = 0; level < ROLLUP_LEVELS; level++) {           // Else finest that goes back far enough.
+        if (covers(s, level, from)) return level;
+    }
+    return ROLLUP_LEVELS - 1;
+}
+
+
+    /* Buckets of the level are merged in runs of as many as fit a step,
+       starting from the bucket from is in. */
+template <typename F> unsigned int SensorRollup::query(unsigned int slot, time_t from, time_t to, unsigned int points,
+                                                       F visit) const {
+    int level = levelFor(slot, from, to, points);
+    if (level < 0 || to < from) return 0;
+    const Series& s = *series(slot);
+    const Bucket* buckets = ring(slot, level);
+    unsigned int kept = LEVEL_BUCKETS[level];
+
+    uint32_t first = number(level, from), last = number(level, to);
+    if (last > s.newest[level]) last = s.newest[level];
+    if (s.newest[level] >= kept && first < s.newest[level] - kept + 1) first = s.newest[level] - kept + 1;
+    time_t step = (points && to > from) ? (to - from) / points : 0;
+    uint32_t run = (step > LEVEL_SECONDS[level]) ? (uint32_t)(step / LEVEL_SECONDS[level]) : 1;
+
+    unsigned int visited = 0;
+    for (uint32_t n = first; n <= last && last >= first; n += run) {
+        RollupPoint p = {startOf(level, n), (time_t)run * LEVEL_SECONDS[level], 0, 0, 0, 0, 0};
+        uint32_t end = (last - n < run) ? last + 1 : n + run;
+        for (uint32_t k = n; k < end; k++) {
+            const Bucket& b = buckets[k % kept];
+            if (b.number != k || b.count == 0) continue;
+            if (p.count == 0 || b.min < p.min) p.min = b.min;
+            if (p.count == 0 || b.max > p.max) p.max = b.max;
+            p.count += b.count;
+            p.sum += b.sum;
+            p.sumSquares += b.sumSquares;
+        }
+        if (p.count) {
+            visit(p);
+            visited++;
+        }
+    }
+    return visited;
+}
+
+#endif
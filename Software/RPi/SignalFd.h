@@ -0,0 +1,106 @@
+// Class: SignalFd - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SignalFd_h
+#define SignalFd_h
+
+#include <csignal>
+#include <cstdint>
+#include <initializer_list>
+#include <poll.h>           // ppoll()
+#include <signal.h>         // sigprocmask(), sigset_t
+#include <sys/signalfd.h>   // signalfd()
+#include <unistd.h>         // read(), close()
+
+/************************************************************************************************
+*
+*    PURPOSE: Takes signals (SIGTERM, SIGINT, SIGUSR1, ...) as something to read from a file
+* descriptor rather than as a handler that can go off in the middle of anything. A loop checks
+* for them when it suits it - between packets, or while it naps with nothing to do - and so
+* can wind down in order: stop the radio, finish what is queued, flush the log. The fd can
+* also go in a poll() with others.
+*
+*    USAGE:
+*    1. Construct with the signals wanted, in the main thread, BEFORE starting any other
+*  thread. The signals are blocked, and threads started afterwards inherit that, so they all
+*  end up here instead of killing the process.
+*    2. take() returns the next one waiting, without waiting; 0 if none.
+*    3. wait() naps for up to the given microseconds, ending early if a signal comes in,
+*  and returns it; 0 if none. Use it in place of usleep() in an idle loop.
+*
+*    NOTE:
+*    1. If the signalfd can't be opened (isOpen() false) the signals are left as they were.
+*    2. A signal sent twice before it is read is only seen once.
+*/
+
+
+class SignalFd {
+
+  public:
+
+          /*    PURPOSE: Constructor. Blocks the signals and opens the fd. */
+    SignalFd(std::initializer_list<int> signals);
+    ~SignalFd();
+
+    SignalFd(const SignalFd&) = delete;
+    SignalFd& operator=(const SignalFd&) = delete;
+
+    bool isOpen() const { return _fd >= 0; }
+    int fd() const { return _fd; }
+
+          /*    PURPOSE: Next signal waiting, without waiting.
+           *    RETURNS: The signal number, 0 if none. */
+    int take();
+
+          /*    PURPOSE: Wait up to micros for a signal.
+           *    RETURNS: The signal number, 0 if none came. */
+    int wait(long micros);
+
+  private:
+    int _fd;
+    sigset_t _mask;
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline SignalFd::SignalFd(std::initializer_list<int> signals) {
+    sigemptyset(&_mask);
+    for (int sig : signals) sigaddset(&_mask, sig);
+    _fd = signalfd(-1, &_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (_fd >= 0) sigprocmask(SIG_BLOCK, &_mask, NULL);
+}
+
+
+inline SignalFd::~SignalFd() {
+    if (_fd < 0) return;
+    close(_fd);
+    sigprocmask(SIG_UNBLOCK, &_mask, NULL);
+}
+
+
+inline int SignalFd::take() {
+    if (_fd < 0) return 0;
+    signalfd_siginfo info;
+    if (read(_fd, &info, sizeof(info)) != sizeof(info)) return 0;
+    return info.ssi_signo;
+}
+
+
+inline int SignalFd::wait(long micros) {
+    if (_fd < 0) {
+        usleep(micros);
+        return 0;
+    }
+    pollfd pfd = {_fd, POLLIN, 0};
+    timespec timeout = {micros / 1000000, (micros % 1000000) * 1000};
+    if (ppoll(&pfd, 1, &timeout, NULL) <= 0) return 0;
+    return take();
+}
+
+#endif
@@ -0,0 +1,236 @@
+// Class: NrfSpiBatch - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SpiBatch_h
+#define SpiBatch_h
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+
+/************************************************************************************************
+*
+*    PURPOSE: Receives a packet from the nRF24L01+ in as few system calls as possible. Through
+* the RF24 library, taking a packet off the radio is a string of separate SPI transactions -
+* FIFO status, STATUS, payload width, the payload, clearing RX_DR, and loading the next ACK
+* payload - and on the RPi each one is its own ioctl() into the spidev driver. This class puts
+* all of them into one SPI_IOC_MESSAGE ioctl, with chip select toggled between the commands.
+*
+*    USAGE:
+*    1. Set the radio up with RF24 as always. Then construct an NrfSpiBatch on the same spidev
+*  device (RF24 radio(22, 0) is /dev/spidev0.0). It opens its own file handle on the device.
+*    2. Poll with rxPipe(): one ioctl, one byte on the bus.
+*    3. When it says there is a packet, readAndReload() takes the payload and loads the next
+*  ACK payload in one ioctl. Each ack it takes leaves exactly that one ACK payload loaded -
+*  whatever came off the FIFO - so the next sensor always gets one back. When it returns -1
+*  it hasn't taken the ack: the caller keeps it for the next call.
+*    4. Constructed with an SpiTransport instead of a device name, the same transfers go to it
+*  instead of the spidev driver - ioctls are still counted as if they were real. NrfSimSpi.h
+*  is the one for the simulated chip; this header doesn't pull the simulator in.
+*    5. ioctls() and packets() give the per-packet figure: the poll that found the packet
+*  plus the batch. Polls that find nothing aren't counted.
+*    6. readRegister() reads any one register, e.g. to check the radio is still set up as it
+*  was (RadioHealth.h). It is not for the packet path.
+*
+*    NOTE:
+*    1. The payload width isn't known until the batch has run, so the whole 32 bytes are always
+*  clocked out. Any bytes past the width are junk; the caller uses the width it gets back.
+*    2. RF24 is still used for set up, and for anything unusual.
+*    3. readAndReload() only finds out the FIFO was empty, or the width bad, after the ACK
+*  payload has gone in. A 2nd ioctl then puts things right, always ending with the ack loaded
+*  again on its own: FLUSH_TX and the ack (empty FIFO), or FLUSH_RX, FLUSH_TX and the ack (bad
+*  width - the data sheet says to flush the payload). It flushes before it loads, so it can be
+*  run again after a failure, and is, once. Neither happens in normal running; RPi_RadioSim -S
+*  checks both, and a failed 2nd ioctl.
+*/
+
+#define SPIB_SPEED_HZ 10000000            // As RF24's RF24_SPI_SPEED.
+#define SPIB_MAX_PAYLOAD 32
+#define SPIB_MAX_ACK 32
+
+    /* nRF24L01+ SPI commands and registers (Product Specification v1.0, section 8.3.1). */
+#define SPIB_R_RX_PL_WID 0x60
+#define SPIB_R_RX_PAYLOAD 0x61
+#define SPIB_W_ACK_PAYLOAD 0xA8           // | pipe
+#define SPIB_FLUSH_TX 0xE1
+#define SPIB_FLUSH_RX 0xE2
+#define SPIB_R_REGISTER 0x00              // | register
+#define SPIB_W_REGISTER 0x20
+#define SPIB_STATUS 0x07
+#define SPIB_RX_DR 0x40
+#define SPIB_NOP 0xFF
+
+
+    /* Somewhere other than spidev for the transfers to go, e.g. NrfSimSpi.h. message() is
+       SPI_IOC_MESSAGE(n): run the n transfers in order and return the bytes moved, or -1. */
+class SpiTransport {
+  public:
+    virtual ~SpiTransport() {}
+    virtual int message(const struct spi_ioc_transfer* xfer, int n) = 0;
+};
+
+
+class NrfSpiBatch {
+
+  public:
+
+          /*    PURPOSE: Constructor. Opens the spidev device. */
+    NrfSpiBatch(const char* device = "/dev/spidev0.0");
+    NrfSpiBatch(SpiTransport* transport);
+    ~NrfSpiBatch();
+
+          /*    PURPOSE: Tells if the device opened. If not, stay with RF24 calls. */
+    bool isOpen() const { return _fd >= 0 || _transport; }
+
+          /*    PURPOSE: Which pipe the next RX payload came in on.
+           *    RETURNS: Pipe 0-5; -1 if the RX FIFO is empty or the ioctl failed. */
+    int rxPipe();
+
+          /*    PURPOSE: Read the next RX payload, clear RX_DR and load an ACK payload
+           *  for ackPipe - all in one ioctl.
+           *    RETURNS: The payload width, with the payload in buf (SPIB_MAX_PAYLOAD
+           *  bytes), and ack loaded; 0 if there was no payload to be had - the FIFO was
+           *  empty, or its width bad (> 32) and it has been flushed - and ack is loaded,
+           *  in place of whatever was; -1 if the ioctl failed. On -1 the ack hasn't been
+           *  taken: pass the same ack to the next call. */
+    int readAndReload(uint8_t* buf, uint8_t ackPipe, const void* ack, uint8_t ackLen);
+
+          /*    PURPOSE: Read one register. STATUS comes back in *status if asked for.
+           *    RETURNS: The register's value; -1 if the ioctl failed. */
+    int readRegister(uint8_t reg, uint8_t* status = NULL);
+
+    unsigned long ioctls() const { return _ioctls; }
+    unsigned long packets() const { return _packets; }
+    unsigned long badWidths() const { return _badWidths; }
+
+  private:
+    int _fd;
+    SpiTransport* _transport = NULL;
+    unsigned long _ioctls = 0;
+    unsigned long _packets = 0;
+    unsigned long _badWidths = 0;
+
+        /* Transfer buffers, kept between calls so nothing is allocated per packet. */
+    uint8_t _txWidth[2], _rxWidth[2];
+    uint8_t _txPayload[1 + SPIB_MAX_PAYLOAD], _rxPayload[1 + SPIB_MAX_PAYLOAD];
+    uint8_t _txAck[1 + SPIB_MAX_ACK];
+    uint8_t _txStatus[2];
+    uint8_t _txFlushTx, _txFlushRx;
+    struct spi_ioc_transfer _xfer[4];
+
+    void setXfer(int i, const uint8_t* tx, uint8_t* rx, uint32_t len, bool csChange);
+    int runXfers(unsigned long request, int n);
+    int fixUp(unsigned long request, int n);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline NrfSpiBatch::NrfSpiBatch(SpiTransport* transport) : NrfSpiBatch("") {
+    _transport = transport;
+}
+
+
+inline NrfSpiBatch::NrfSpiBatch(const char* device) {
+    _fd = device[0] ? open(device, O_RDWR) : -1;
+    memset(_xfer, 0, sizeof(_xfer));
+    _txWidth[0] = SPIB_R_RX_PL_WID;
+    _txWidth[1] = SPIB_NOP;
+    memset(_txPayload, SPIB_NOP, sizeof(_txPayload));
+    _txPayload[0] = SPIB_R_RX_PAYLOAD;
+    _txStatus[0] = SPIB_W_REGISTER | SPIB_STATUS;
+    _txStatus[1] = SPIB_RX_DR;
+    _txFlushTx = SPIB_FLUSH_TX;
+    _txFlushRx = SPIB_FLUSH_RX;
+}
+
+
+inline NrfSpiBatch::~NrfSpiBatch() {
+    if (_fd >= 0) close(_fd);
+}
+
+
+inline void NrfSpiBatch::setXfer(int i, const uint8_t* tx, uint8_t* rx, uint32_t len, bool csChange) {
+    _xfer[i].tx_buf = (unsigned long)tx;
+    _xfer[i].rx_buf = (unsigned long)rx;
+    _xfer[i].len = len;
+    _xfer[i].speed_hz = SPIB_SPEED_HZ;
+    _xfer[i].bits_per_word = 8;
+    _xfer[i].cs_change = csChange;          // Deselect between commands; the chip acts on CSN going high.
+}
+
+
+inline int NrfSpiBatch::runXfers(unsigned long request, int n) {
+    if (_transport) return _transport->message(_xfer, n);
+    return ioctl(_fd, request, _xfer);
+}
+
+
+    /* Run the fix-up transfers set up in _xfer; once more if they fail (note #3). */
+inline int NrfSpiBatch::fixUp(unsigned long request, int n) {
+    for (int tries = 0; tries < 2; tries++) {
+        _ioctls++;
+        if (runXfers(request, n) >= 1) return 0;
+    }
+    return -1;
+}
+
+
+inline int NrfSpiBatch::rxPipe() {
+    uint8_t tx = SPIB_NOP, status = 0;
+    setXfer(0, &tx, &status, 1, false);
+    if (runXfers(SPI_IOC_MESSAGE(1), 1) < 1) return -1;
+    int pipe = (status >> 1) & 0x07;        // STATUS RX_P_NO; 7 = RX FIFO empty.
+    if (pipe > 5) return -1;
+    _ioctls++;                              // Only the poll that finds a packet counts towards it.
+    return pipe;
+}
+
+
+inline int NrfSpiBatch::readAndReload(uint8_t* buf, uint8_t ackPipe, const void* ack, uint8_t ackLen) {
+    if (ackLen > SPIB_MAX_ACK) ackLen = SPIB_MAX_ACK;
+    _txAck[0] = SPIB_W_ACK_PAYLOAD | (ackPipe & 0x07);
+    memcpy(&_txAck[1], ack, ackLen);
+
+    setXfer(0, _txWidth, _rxWidth, sizeof(_txWidth), true);
+    setXfer(1, _txPayload, _rxPayload, sizeof(_txPayload), true);
+    setXfer(2, _txAck, NULL, 1 + ackLen, true);
+    setXfer(3, _txStatus, NULL, sizeof(_txStatus), false);
+    _ioctls++;
+    if (runXfers(SPI_IOC_MESSAGE(4), 4) < 1) return -1;
+
+    if (((_rxWidth[0] >> 1) & 0x07) > 5) {              // FIFO was empty after all. See note #3.
+        setXfer(0, &_txFlushTx, NULL, 1, true);
+        setXfer(1, _txAck, NULL, 1 + ackLen, false);
+        return fixUp(SPI_IOC_MESSAGE(2), 2);
+    }
+    _packets++;
+    uint8_t width = _rxWidth[1];
+    if (width > SPIB_MAX_PAYLOAD) {
+        _badWidths++;
+        setXfer(0, &_txFlushRx, NULL, 1, true);
+        setXfer(1, &_txFlushTx, NULL, 1, true);
+        setXfer(2, _txAck, NULL, 1 + ackLen, false);
+        return fixUp(SPI_IOC_MESSAGE(3), 3);
+    }
+    memcpy(buf, &_rxPayload[1], SPIB_MAX_PAYLOAD);
+    return width;
+}
+
+inline int NrfSpiBatch::readRegister(uint8_t reg, uint8_t* status) {
+    uint8_t tx[2] = {(uint8_t)(SPIB_R_REGISTER | (reg & 0x1F)), SPIB_NOP}, rx[2] = {0, 0};
+    setXfer(0, tx, rx, sizeof(tx), false);
+    if (runXfers(SPI_IOC_MESSAGE(1), 1) < 1) return -1;
+    if (status) *status = rx[0];
+    return rx[1];
+}
+
+#endif
@@ -0,0 +1,89 @@
+// Class: SpscRing - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef SpscRing_h
+#define SpscRing_h
+
+#include <atomic>
+
+/************************************************************************************************
+*
+*    PURPOSE: A fixed size queue between exactly two threads: one pushes, the other pops. No
+* locks and no allocation - each side owns one index and only reads the other's, so a push or
+* a pop is a copy and one atomic store. It is how RPi_CapDataReceive's radio thread hands frames
+* to the thread that processes them, and how commands for the ACK payloads go back the other way.
+*
+*    USAGE:
+*    1. Declare one SpscRing<T, SIZE> shared by the two threads. SIZE must be a power of two.
+*    2. The producer thread calls push(); it returns false, and stores nothing, if the ring is
+*  full. What to do then is up to the producer (RPi_CapDataReceive counts a drop).
+*    3. The consumer thread calls pop(); it returns false if the ring is empty.
+*    4. depth() can be called from either thread; it is exact only on the calling side.
+*
+*    NOTE:
+*    1. T should be plain data; it is copied in and out.
+*    2. The two indices sit on their own cache lines so the two threads don't keep taking the
+*  line off each other.
+*/
+
+template <typename T, unsigned int SIZE>
+class SpscRing {
+    static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SpscRing SIZE must be a power of two");
+
+  public:
+
+          /*    PURPOSE: Producer side. Copy item in. RETURNS: False if full. */
+    bool push(const T& item);
+
+          /*    PURPOSE: Consumer side. Copy the oldest item out. RETURNS: False if empty. */
+    bool pop(T& item);
+
+          /*    PURPOSE: Items waiting. */
+    unsigned int depth() const;
+
+    bool full() const { return depth() >= SIZE; }
+    static constexpr unsigned int capacity() { return SIZE; }
+
+  private:
+    alignas(64) std::atomic<unsigned int> _head{0};     // Next to pop. Written by the consumer.
+    alignas(64) std::atomic<unsigned int> _tail{0};     // Next to push. Written by the producer.
+    alignas(64) T _items[SIZE];
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+    /* Indexes run freely and wrap at 2^32; SIZE divides 2^32 so the slot is
+       always index & (SIZE - 1), and tail - head is the depth even across a wrap. */
+
+template <typename T, unsigned int SIZE>
+inline bool SpscRing<T, SIZE>::push(const T& item) {
+    unsigned int tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) >= SIZE) return false;
+    _items[tail & (SIZE - 1)] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+
+template <typename T, unsigned int SIZE>
+inline bool SpscRing<T, SIZE>::pop(T& item) {
+    unsigned int head = _head.load(std::memory_order_relaxed);
+    if (_tail.load(std::memory_order_acquire) == head) return false;
+    item = _items[head & (SIZE - 1)];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+
+template <typename T, unsigned int SIZE>
+inline unsigned int SpscRing<T, SIZE>::depth() const {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+}
+
+#endif
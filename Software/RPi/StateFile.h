@@ -0,0 +1,247 @@
+// Class: StateFile - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef StateFile_h
+#define StateFile_h
+
+#include <atomic>           // std::atomic_signal_fence
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>          // open()
+#include <sys/mman.h>       // mmap(), msync()
+#include <sys/stat.h>       // fstat()
+#include <unistd.h>         // ftruncate(), close()
+#include "SensorRegistry.h" // SensorState
+
+/************************************************************************************************
+*
+*    PURPOSE: Keeps every sensor's SensorState in a file, so a restarted receiver picks up where
+* the last one left off - power control, battery curve, counts, pending commands - instead of
+* starting from nothing or re-reading the log. The file is mmap()'d; saving a slot is a copy
+* into the mapping, no system call, and the kernel writes it back in its own time. Loading it
+* back is mapping it again.
+*
+*    Each slot holds two copies of its SensorState, each with a sequence number and checksum. A
+* save writes the older copy, and only then its sequence number; a load takes the newer copy
+* whose checksum is good. So a slot is always either as it was or as it is now, whatever moment
+* the process is killed at - kill -9 included, as the mapping's pages belong to the kernel. After
+* a power cut, slots written since the last sync() may be as they were.
+*
+*    Besides the slots there is one StateGlobals record, kept the same way.
+*
+*    USAGE:
+*    1. open() the file with the number of slots. A missing file, or one made for a different
+*  SensorState or slot count, is started over (fresh() says so).
+*    2. load() each slot to get back what was saved; save() a slot whenever its sensor's state
+*  changes; clear() one that is no longer used. loadGlobals()/saveGlobals() likewise.
+*    3. sync() to have it all on the disk now, e.g. at shutdown.
+*
+*    NOTE:
+*    1. Only one process should have the file open.
+*    2. Slots are saved from one thread.
+*/
+
+#define STATE_FILE_MAGIC "CAPSTATE"
+#define STATE_FILE_VERSION 1
+
+struct StateGlobals {
+    time_t lastLog;                     // Last log entry for a sensor with no registry slot (they share one).
+};
+
+
+class StateFile {
+
+  public:
+
+    StateFile() {}
+    ~StateFile();
+
+    StateFile(const StateFile&) = delete;
+    StateFile& operator=(const StateFile&) = delete;
+
+          /*    PURPOSE: Open and map the file, making or starting it over if need be.
+           *    RETURNS: False if it couldn't be. */
+    bool open(const char* path, unsigned int slots);
+
+    bool isOpen() const { return _map != NULL; }
+    bool fresh() const { return _fresh; }
+    unsigned int slots() const { return _slots; }
+
+          /*    PURPOSE: What was last saved in a slot.
+           *    RETURNS: False if nothing has been. */
+    bool load(unsigned int slot, SensorState* st) const;
+
+    void save(unsigned int slot, const SensorState& st);
+    void clear(unsigned int slot);
+
+    bool loadGlobals(StateGlobals* g) const;
+    void saveGlobals(const StateGlobals& g);
+
+          /*    PURPOSE: Write everything saved out to the disk, and wait for it. */
+    void sync();
+
+  private:
+
+    template <typename T>
+    struct Copy {
+        uint32_t seq;                   // 0 = never written.
+        uint32_t sum;
+        T data;
+    };
+
+    template <typename T>
+    struct Pair {
+        Copy<T> copy[2];
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t stateBytes;            // sizeof(SensorState) it was made with.
+        uint32_t slots;
+        uint32_t reserved;
+        Pair<StateGlobals> globals;
+    };
+
+    int _fd = -1;
+    uint8_t* _map = NULL;
+    size_t _size = 0;
+    unsigned int _slots = 0;
+    bool _fresh = false;
+
+    Header* header() const { return (Header*)_map; }
+    Pair<SensorState>* pair(unsigned int slot) const { return (Pair<SensorState>*)(_map + slotsOffset()) + slot; }
+    static size_t slotsOffset() { return (sizeof(Header) + 63) & ~(size_t)63; }
+
+    template <typename T> static bool read(const Pair<T>& p, T* out);
+    template <typename T> static void write(Pair<T>& p, const T& data);
+    static uint32_t checksum(uint32_t seq, const void* data, size_t bytes);
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+inline StateFile::~StateFile() {
+    if (_map) munmap(_map, _size);
+    if (_fd >= 0) close(_fd);
+}
+
+
+inline bool StateFile::open(const char* path, unsigned int slots) {
+    _slots = slots;
+    _size = slotsOffset() + (size_t)slots * sizeof(Pair<SensorState>);
+    _fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (_fd < 0) return false;
+
+    struct stat sb;
+    Header h;
+    bool ok = fstat(_fd, &sb) == 0 && (size_t)sb.st_size == _size && pread(_fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+              memcmp(h.magic, STATE_FILE_MAGIC, 8) == 0 && h.version == STATE_FILE_VERSION &&
+              h.stateBytes == sizeof(SensorState) && h.slots == slots;
+    _fresh = !ok;
+    if (_fresh && (ftruncate(_fd, 0) != 0 || ftruncate(_fd, _size) != 0)) {     // All zeros: nothing saved.
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+
+    void* map = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (map == MAP_FAILED) {
+        close(_fd);
+        _fd = -1;
+        return false;
+    }
+    _map = (uint8_t*)map;
+    if (_fresh) {
+        Header* hdr = header();
+        memcpy(hdr->magic, STATE_FILE_MAGIC, 8);
+        hdr->version = STATE_FILE_VERSION;
+        hdr->stateBytes = sizeof(SensorState);
+        hdr->slots = slots;
+        sync();
+    }
+    return true;
+}
+
+
+inline bool StateFile::load(unsigned int slot, SensorState* st) const {
+    return slot < _slots && read(*pair(slot), st);
+}
+
+
+inline void StateFile::save(unsigned int slot, const SensorState& st) {
+    if (slot < _slots) write(*pair(slot), st);
+}
+
+
+inline void StateFile::clear(unsigned int slot) {
+    if (slot < _slots) memset(pair(slot), 0, sizeof(Pair<SensorState>));
+}
+
+
+inline bool StateFile::loadGlobals(StateGlobals* g) const {
+    return _map && read(header()->globals, g);
+}
+
+
+inline void StateFile::saveGlobals(const StateGlobals& g) {
+    if (_map) write(header()->globals, g);
+}
+
+
+inline void StateFile::sync() {
+    if (_map) msync(_map, _size, MS_SYNC);
+}
+
+
+template <typename T>
+inline bool StateFile::read(const Pair<T>& p, T* out) {
+    int best = -1;
+    for (int k = 0; k < 2; k++) {
+        const Copy<T>& c = p.copy[k];
+        if (c.seq == 0 || c.sum != checksum(c.seq, &c.data, sizeof(T))) continue;
+        if (best < 0 || (int32_t)(c.seq - p.copy[best].seq) > 0) best = k;
+    }
+    if (best < 0) return false;
+    memcpy(out, &p.copy[best].data, sizeof(T));
+    return true;
+}
+
+
+    /* The older copy is overwritten and its seq set last, so until then the
+       newer one stands. seq is never 0 once written, even after a wrap. */
+template <typename T>
+inline void StateFile::write(Pair<T>& p, const T& data) {
+    uint32_t seq0 = p.copy[0].seq, seq1 = p.copy[1].seq;
+    int older = ((int32_t)(seq0 - seq1) < 0) ? 0 : 1;
+    uint32_t seq = (older ? seq0 : seq1) + 1;
+    if (seq == 0) seq = 1;
+    Copy<T>& c = p.copy[older];
+    c.seq = 0;                                                  // Invalid while it is being written.
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    memcpy(&c.data, &data, sizeof(T));
+    c.sum = checksum(seq, &c.data, sizeof(T));
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    c.seq = seq;
+}
+
+
+    /* FNV-1a over 32-bit words. The structs are all multiples of 4 bytes. */
+inline uint32_t StateFile::checksum(uint32_t seq, const void* data, size_t bytes) {
+    uint32_t h = 2166136261u ^ seq;
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t k = 0; k + 4 <= bytes; k += 4) {
+        uint32_t w;
+        memcpy(&w, p + k, 4);
+        h = (h ^ w) * 16777619u;
+    }
+    return h;
+}
+
+#endif
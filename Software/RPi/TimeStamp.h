@@ -0,0 +1,129 @@
+// Class: TimeStamp - Class Definition and Function Definitions
+//=================================================================================================
+
+#ifndef TimeStamp_h
+#define TimeStamp_h
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>            // localtime_r(), strftime()
+#include <time.h>           // clock_gettime(), CLOCK_REALTIME
+
+/************************************************************************************************
+*
+*    PURPOSE: Wall clock time stamps for log lines and messages, without a localtime() and
+* strftime() per line. The local time only changes in a way that needs the time zone once a
+* minute (a DST change is always on a minute), so each thread keeps the current minute already
+* formatted, and a call copies it and patches in the seconds and milliseconds. Two formats:
+*       > legacy:   "Mon 09:12 2026-10-19" - strftime's "%a %R %F", as the log files have always had.
+*       > ISO 8601: "2026-10-19T09:12:45.123+01:00" - local time, milliseconds, UTC offset.
+*
+*    USAGE:
+*    1. TimeStamp::legacy(t, buf) or TimeStamp::iso(ts, buf) format a given time; legacyNow()
+*  and isoNow() the time now. buf must hold TIMESTAMP_MAX bytes; the length is returned and
+*  the text '\0' terminated.
+*    2. Call from any thread.
+*
+*    NOTE:
+*    1. There are no locks: the cache is thread_local, so each thread formats its own minute.
+*  The cost is one localtime_r() and two strftime()s per thread per minute.
+*    2. A change to TZ is seen at the next minute, or at once after reset() on that thread.
+*/
+
+#define TIMESTAMP_MAX 40                // Buffer size for either format.
+#define TIMESTAMP_ISO_LEN 29            // "2026-10-19T09:12:45.123+01:00"
+
+
+class TimeStamp {
+
+  public:
+
+          /*    PURPOSE: "%a %R %F" of t, into buf.
+           *    RETURNS: Its length. */
+    static size_t legacy(time_t t, char* buf);
+    static size_t legacyNow(char* buf) { return legacy(time(0), buf); }
+
+          /*    PURPOSE: ISO 8601 local time of ts, to the millisecond, into buf.
+           *    RETURNS: Its length, TIMESTAMP_ISO_LEN. */
+    static size_t iso(const timespec& ts, char* buf);
+    static size_t isoNow(char* buf);
+
+          /*    PURPOSE: Forget this thread's cached minute. */
+    static void reset() { cache().minute = NO_MINUTE; }
+
+  private:
+    static constexpr int64_t NO_MINUTE = INT64_MIN;
+
+    struct Minute {
+        int64_t minute = NO_MINUTE;     // Seconds since the epoch / 60.
+        char iso[TIMESTAMP_MAX];        // "2026-10-19T09:12:00.000+01:00"
+        char legacy[TIMESTAMP_MAX];
+        size_t legacyLen = 0;
+    };
+
+    static Minute& cache() {
+        thread_local Minute m;
+        return m;
+    }
+    static const Minute& at(int64_t minute);
+    static void digits2(char* p, unsigned int v) { p[0] = '0' + v / 10; p[1] = '0' + v % 10; }
+
+};
+
+
+
+/* =============================================================================
+   Function Definitions
+   =============================================================================
+*/
+
+    /* This thread's formatted minute, made afresh if it isn't this one. */
+inline const TimeStamp::Minute& TimeStamp::at(int64_t minute) {
+    Minute& m = cache();
+    if (m.minute == minute) return m;
+
+    time_t t = (time_t)(minute * 60);
+    tm local;
+    localtime_r(&t, &local);
+    m.legacyLen = strftime(m.legacy, sizeof(m.legacy), "%a %R %F", &local);
+    strftime(m.iso, sizeof(m.iso), "%Y-%m-%dT%H:%M:00.000", &local);
+    long offset = local.tm_gmtoff / 60;                         // Minutes east of UTC.
+    char* p = m.iso + 23;
+    *p++ = offset < 0 ? '-' : '+';
+    if (offset < 0) offset = -offset;
+    digits2(p, offset / 60);
+    p[2] = ':';
+    digits2(p + 3, offset % 60);
+    p[5] = '\0';
+    m.minute = minute;
+    return m;
+}
+
+
+inline size_t TimeStamp::legacy(time_t t, char* buf) {
+    int64_t minute = (t >= 0) ? t / 60 : (t - 59) / 60;
+    const Minute& m = at(minute);
+    memcpy(buf, m.legacy, m.legacyLen + 1);
+    return m.legacyLen;
+}
+
+
+inline size_t TimeStamp::iso(const timespec& ts, char* buf) {
+    int64_t minute = (ts.tv_sec >= 0) ? ts.tv_sec / 60 : (ts.tv_sec - 59) / 60;
+    const Minute& m = at(minute);
+    memcpy(buf, m.iso, TIMESTAMP_ISO_LEN + 1);
+    digits2(buf + 17, (unsigned int)(ts.tv_sec - minute * 60));
+    unsigned int ms = ts.tv_nsec / 1000000;
+    buf[20] = '0' + ms / 100;
+    digits2(buf + 21, ms % 100);
+    return TIMESTAMP_ISO_LEN;
+}
+
+
+inline size_t TimeStamp::isoNow(char* buf) {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return iso(ts, buf);
+}
+
+#endif
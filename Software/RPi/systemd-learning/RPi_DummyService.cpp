@@ -3,8 +3,15 @@
  *
  *  C++ program to create as simple a dummy service as I can thing of.
  *
+ *  Build --:
+ *      g++ -O2 -std=c++17 -o RPi_DummyService RPi_DummyService.cpp
+ *
+ * 10/19/2026-rel02:
+ *      > getCurrTimeFormatted() uses TimeStamp (../TimeStamp.h), as RPi_CapDataReceive does,
+ *        in place of its own localtime()/strftime(). Same text.
+ *
  */
-#define VERSION "12-09-2023 rel 01"
+#define VERSION "10-19-2026 rel 02"
 
 //#define LOG_FILEPATH "/home/dmyservice-log.txt"
 #define LOG_FILEPATH "/home/jroc/Dropbox/projects/MoistureSensor/Software/RPi/systemd-learning/dmyservice-log.txt"
@@ -21,6 +28,7 @@
 #include <time.h>      // CLOCK_MONOTONIC_RAW, timespec, clock_gettime()
 #include <fstream>     // For writing a log text file.
 #include <unistd.h>    // For the sleep() function.
+#include "../TimeStamp.h"  // TimeStamp
 
 
 # define TIMEBUFFERSIZE 80
@@ -102,15 +110,10 @@ int main(int argc, char** argv) {
 */
 
 string getCurrTimeFormatted() {
-    string formattedTime;
-
     // Get the current time, in a pretty string format.
-    time_t now = time(0);
-    tm* localTime = localtime(&now);
-    char buffer[80];
-    strftime(buffer,80, "%a %R %F", localTime);
-    formattedTime = buffer;
-    return formattedTime;
+    char buffer[TIMESTAMP_MAX];
+    TimeStamp::legacyNow(buffer);
+    return buffer;
 }
 
 bool logData(string strEntry) {
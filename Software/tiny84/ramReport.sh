@@ -0,0 +1,40 @@
+#!/bin/sh
+#   PURPOSE: Report the static SRAM (.data + .bss) each object in a tiny84 sketch takes, biggest
+# first, against the ATTiny84's 512 bytes. Companion to MemDiag in tiny84_SensorAsSlave, which
+# reports what is left over for the stack at run time.
+#
+#   USAGE: ramReport.sh <sketch.elf>
+#   Get the .elf with Arduino IDE > Sketch > Export Compiled Binary (it lands in the sketch's
+# build/ folder), or from the temp build folder shown with verbose compile output turned on.
+# Needs avr-nm and avr-size (in the IDE's avr-gcc tools folder, or 'apt install binutils-avr').
+#
+#   NOTE: Symbols are C++ demangled. Objects in .data also take the same room in flash for
+# their initial values. The RF24 object shows up under the RadioComms global (radio).
+
+ELF=$1
+RAM_BYTES=512
+if [ -z "$ELF" ] || [ ! -f "$ELF" ]; then
+  echo "usage: $0 <sketch.elf>" >&2
+  exit 1
+fi
+
+echo "Static SRAM by object ($ELF):"
+echo
+printf "%6s  %-5s  %s\n" "Bytes" "Sect" "Symbol"
+avr-nm --size-sort --reverse-sort --print-size --radix=d --demangle "$ELF" |
+  awk -v ram=$RAM_BYTES '
+    # Fields: address size type name... ; b/B = .bss, d/D = .data
+    $3 ~ /^[bBdD]$/ {
+      size = $2 + 0
+      sect = ($3 ~ /[dD]/) ? ".data" : ".bss"
+      name = $4
+      for (i = 5; i <= NF; i++) name = name " " $i
+      printf "%6d  %-5s  %s\n", size, sect, name
+      total += size
+    }
+    END {
+      printf "------\n%6d  bytes in named objects (%d%% of %d)\n", total, total * 100 / ram, ram
+    }'
+echo
+avr-size -A "$ELF" | awk '$1 == ".data" || $1 == ".bss" || $1 == ".noinit" { printf "%-8s %5d\n", $1, $2; t += $2 }
+  END { printf "%-8s %5d  -> %d bytes left for the stack\n", "total", t, '$RAM_BYTES' - t }'
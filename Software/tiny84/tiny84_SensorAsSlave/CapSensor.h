@@ -8,7 +8,10 @@
 
 /************************************************************************************************
 *
-*    PURPOSE: Manages the soil sensor capacitor.
+*    PURPOSE: Manages the soil sensor capacitor(s). One CapSensor can look after up to 
+*  CAP_MAX_PROBES probes (e.g., a shallow and a deep probe in a big container), each on its own
+*  charge pin and ADC pin. The probes' measurements are interleaved - see footnote #4 in
+*  CapSensor.ino - so N probes take about the same time to read as one.
 *
 *    USAGE:
 *    1. CapSensor object must be created (declared) using the pin# reference that the sensor
@@ -20,6 +23,8 @@
 *  error LED to be responsive to a reported error.
 *    4. To report an error, call the setError() function.
 *
+*    5. For more probes, call .addProbe() with the probe's pins before .setup().
+*
 *    NOTE:
 *    1. By design, this class is non-blocking.
 */
@@ -29,19 +34,26 @@
 #define MAX_ADC_VALUE 1023            // Fixed by the microprocessor model & specs. This for ATTiny84.
 #define NUM_READINGS_TO_AVERAGE 10    // How many readings to take and compute a 'final' average reading for.
 #define INTER_MEASUREMENT_DELAY 300   // Minimum number of milliseconds to wait between successive cap readings to accumulate an average.
+#define BANDGAP_MILLIVOLTS 1100       // Internal bandgap reference. Nominally 1.1V but +/-10% chip to chip; adjust this value to calibrate VCC readings.
+#define ADMUX_BANDGAP (_BV(MUX5) | _BV(MUX0))   // tiny84 ADMUX for 'measure the 1.1V bandgap, VCC as reference.'
+#define CAP_MAX_PROBES 2              // Probes one CapSensor can manage. The payload has room for 4; each costs 10 bytes of SRAM.
 
 class CapSensor {
 
   private:
-    int _chargePin;                   // Pin number 1st lead of cap is wired to.
-    int _voltReadPin;                 // Pin number 2nd lead of cap is wired to.
+    uint8_t _chargePin[CAP_MAX_PROBES];     // Pin number 1st lead of each cap is wired to.
+    uint8_t _voltReadPin[CAP_MAX_PROBES];   // Pin number 2nd lead of each cap is wired to.
+    uint8_t _numProbes;               // How many probes are wired up.
+    uint8_t _probe;                   // Probe the next measurement is for.
     short int _measurePhase;          // Were we are in the measure protocol 0:No Measurement. 1:Pluse, Read & Clear. 2: Calculate. 3: Take Average. 4: Measurement Available.
-    float _capacitance;               // Measured capacitance value.
+    float _capacitance[CAP_MAX_PROBES];     // Measured capacitance value of each probe.
     bool _readingAvailable;           // Will be TRUE if a sensor capacitance reading has completed.
     short int _ReadingsRemain;        // The number of readings remaining in the total number we're averaging over.
-    float _capAccumulator;            // Will accumulate multiple cap readings so we can take an average for the final value.
+    float _capAccumulator[CAP_MAX_PROBES];  // Will accumulate multiple cap readings so we can take an average for the final value.
     unsigned long _nextMeasureMillis; // Wait until at least this time to take another reading.
     int _tempVolts;                   // Stores voltage reading between Phase-1 and Phase-2.
+    bool _vccPending;                 // Bandgap is selected on the ADC and settling; read it before the next cap pulse.
+    uint16_t _vccMillivolts;          // Supply voltage measured during the last reading.
 
 
   public:
@@ -50,6 +62,13 @@ class CapSensor {
        *  Used to set the pin#/reference that the sensing capacitor is wired up to. */
     CapSensor(int chargePin, int voltReadPin);
 
+          /*    PURPOSE: Add another probe, wired to a spare ADC pin.
+           *    RETURNS: False if there is no room for another probe. */
+    bool addProbe(int chargePin, int voltReadPin);
+
+          /*    PURPOSE: How many probes are wired up. */
+    uint8_t getNumProbes();
+
           /*    PURPOSE: Initilize the sensor to enable readings. */
     void setup();
 
@@ -71,12 +90,18 @@ class CapSensor {
     bool readingAvailable();
 
 
-          /*    PURPOSE: Obtain last read value of the sensor capacitance. */
-    float getCapacitance();
+          /*    PURPOSE: Obtain last read value of the sensor capacitance. Probe 0 is
+           *  the one given to the constructor; the rest in addProbe() order. */
+    float getCapacitance(uint8_t probe = 0);
+
+          /*    PURPOSE: Obtain the supply voltage, in millivolts, measured during
+           *  the last reading. Is 0 until the 1st reading completes. */
+    uint16_t getVccMillivolts();
 
 
   private:
     void pulseAndReadVolts();
+    void readVcc();
 
 };
 #endif
\ No newline at end of file
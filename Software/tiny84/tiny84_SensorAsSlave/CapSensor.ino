@@ -4,6 +4,15 @@
  *  detailed info and documentation that I didn't want to clutter up the code with; but which
  *  I am likely to want to remember when I come back to this in 6 months.
  *
+ *      10/19/2026: Multi-probe support. addProbe() adds probes on spare ADC pins, and the 
+ * measurements of all probes are interleaved (footnote #4) so the whole reading takes about as 
+ * long as it did for one probe.
+ *
+ *      10/19/2026: Each reading now also measures VCC against the internal 1.1V bandgap. The
+ * bandgap is switched onto the ADC right after the 1st cap measurement, so it settles during
+ * the 300ms inter-measurement wait, and is read just before the 2nd pulse. Costs one extra
+ * ADC conversion (~100us) per reading. See footnote #3.
+ *
  *      09/25/2023: Fixed some logic flow in transitioning between phases which blocked us
  * from getting into phase-3. Also note that the 'inf' cap reading value error was fixed - this 
  * was caused by putting the parameters in the reverse order in the CapSensor capSensor() 
@@ -27,23 +36,43 @@ CapSensor::CapSensor(int chargePin, int voltReadPin) {
       /*      PURPOSE: Constructor. 
        *  Used to set the pin#/reference that the soil capacitor sensor is wired up to. */
 
-  _chargePin = chargePin;                     // Set the pins the sensor leads are wired up to.
-  _voltReadPin = voltReadPin; 
+  _chargePin[0] = chargePin;                  // Set the pins the sensor leads are wired up to.
+  _voltReadPin[0] = voltReadPin; 
+  _numProbes = 1;
 
-  _capacitance = 0;
+  _capacitance[0] = 0;
   _readingAvailable = false;
   _measurePhase = 0;
+  _vccPending = false;
+  _vccMillivolts = 0;
 
 } // END CapSensor (constructor method)
 
 
+bool CapSensor::addProbe(int chargePin, int voltReadPin) {
+          /*    PURPOSE: Add another probe, wired to a spare ADC pin. */
+  if(_numProbes >= CAP_MAX_PROBES) return(false);
+  _chargePin[_numProbes] = chargePin;
+  _voltReadPin[_numProbes] = voltReadPin;
+  _capacitance[_numProbes] = 0;
+  _numProbes++;
+  return(true);
+}
+
+
+uint8_t CapSensor::getNumProbes() {
+  return(_numProbes);
+}
+
+
 void CapSensor::setup() {
           /*    PURPOSE: Initilize the sensor to enable readings. */
-  pinMode(_chargePin, OUTPUT);
-  digitalWrite(_chargePin, LOW);              // Start with 0 volts on charge pin.
-  pinMode(_voltReadPin, OUTPUT);
-  digitalWrite(_voltReadPin, LOW);            // Start with the analog pin low, 0 volts.
-
+  for(uint8_t p = 0; p < _numProbes; p++) {
+    pinMode(_chargePin[p], OUTPUT);
+    digitalWrite(_chargePin[p], LOW);         // Start with 0 volts on charge pin.
+    pinMode(_voltReadPin[p], OUTPUT);
+    digitalWrite(_voltReadPin[p], LOW);       // Start with the analog pin low, 0 volts.
+  }
 }
 
 
@@ -52,8 +81,11 @@ void CapSensor::initiateSensorReading() {
            *  capacitance readings, which we will average out when done into a 'final' 
            *  reading of the sensor's capacitance value. */
 
-  _capacitance = 0;                           // Clear out prior reading.
-  _capAccumulator = 0;
+  for(uint8_t p = 0; p < _numProbes; p++) {
+    _capacitance[p] = 0;                      // Clear out prior reading.
+    _capAccumulator[p] = 0;
+  }
+  _probe = 0;
   _readingAvailable = false;
   _ReadingsRemain = NUM_READINGS_TO_AVERAGE;  // Establish number of measurements to average over.
   _nextMeasureMillis = 0;
@@ -67,15 +99,23 @@ bool CapSensor::readingAvailable() {
   switch(_measurePhase) {
     case 1:                                   // Phase-1: Pulse, Read & Clear.
       if(millis()>_nextMeasureMillis) {       // But only if hard-coded inter-measurement 'rest time' has elapsed.
+        if(_vccPending) readVcc();            // Bandgap has had the whole rest time to settle.
         pulseAndReadVolts();
         _measurePhase = 2;
       }
       break;
 
     case 2:                                   // Phase-2: Calculate Capacitance.
-      _capAccumulator +=  (float)(_tempVolts * IN_STRAY_CAP_TO_GND) / (float)(MAX_ADC_VALUE - _tempVolts);
-      _ReadingsRemain--;
-      _nextMeasureMillis = millis() + INTER_MEASUREMENT_DELAY;
+      _capAccumulator[_probe] +=  (float)(_tempVolts * IN_STRAY_CAP_TO_GND) / (float)(MAX_ADC_VALUE - _tempVolts);
+      _nextMeasureMillis = millis() + INTER_MEASUREMENT_DELAY / _numProbes;   // Each probe still rests the full delay. See footnote #4.
+      if(++_probe >= _numProbes) {            // Every probe has had a measurement this round.
+        _probe = 0;
+        _ReadingsRemain--;
+        if(_ReadingsRemain == NUM_READINGS_TO_AVERAGE - 1) {
+          ADMUX = ADMUX_BANDGAP;              // Start the bandgap settling for readVcc().
+          _vccPending = true;
+        }
+      }
       if(_ReadingsRemain) {
         _measurePhase = 1;
       } else {
@@ -84,7 +124,9 @@ bool CapSensor::readingAvailable() {
       break;
 
     case 3:                                   // Phase-3: Take Average.
-      _capacitance = _capAccumulator / NUM_READINGS_TO_AVERAGE;
+      for(uint8_t p = 0; p < _numProbes; p++) {
+        _capacitance[p] = _capAccumulator[p] / NUM_READINGS_TO_AVERAGE;
+      }
       _readingAvailable = true;
       _measurePhase = 4;
       break;
@@ -97,21 +139,38 @@ bool CapSensor::readingAvailable() {
 }
 
 
-float CapSensor::getCapacitance() {
-          /*    PURPOSE: Obtain last read value of the sensor capacitance. */
-  return(_capacitance);
+float CapSensor::getCapacitance(uint8_t probe) {
+          /*    PURPOSE: Obtain last read value of a probe's capacitance. */
+  if(probe >= _numProbes) return(0);
+  return(_capacitance[probe]);
+}
+
+uint16_t CapSensor::getVccMillivolts() {
+          /*    PURPOSE: Supply voltage measured during the last reading. */
+  return(_vccMillivolts);
+}
+
+void CapSensor::readVcc() {
+          /*    PURPOSE: Private function. The bandgap was put on the ADC input back in Phase-2,
+           *  so just run one conversion. With VCC as the reference the ADC reads 
+           *  1023 * 1.1V / VCC; turn that around to get VCC. */
+  ADCSRA |= _BV(ADSC);                        // Start conversion.
+  while(bit_is_set(ADCSRA, ADSC));            // ~100us at the core's ADC clock.
+  uint16_t adc = ADC;
+  if(adc) _vccMillivolts = ((uint32_t)BANDGAP_MILLIVOLTS * MAX_ADC_VALUE) / adc;
+  _vccPending = false;                        // analogRead() in the next pulse puts the mux back.
 }
 
 void CapSensor::pulseAndReadVolts() {
           /*    PURPOSE: Private function. Performs the Phase-1 step of taking one measurement of
            *  the voltage between 'C1' and C-test -> i.e., the sensor's capacitance. */
 
-  pinMode(_voltReadPin, INPUT);         // Get ready to measure voltage.
-  digitalWrite(_chargePin, HIGH);       // Send voltage pulse to cap under test.
-  _tempVolts = analogRead(_voltReadPin);   // Read voltage at point between 'C1' and C-test.
-                                        // -- Clear everything for next measurement --
-  digitalWrite(_chargePin, LOW);        // Remove voltage from caps and short C-test to ground.
-  pinMode(_voltReadPin, OUTPUT);        // Block C-test & 'C1' short-circut path through voltRead pin in prep for next charge cycle.
+  pinMode(_voltReadPin[_probe], INPUT);         // Get ready to measure voltage.
+  digitalWrite(_chargePin[_probe], HIGH);       // Send voltage pulse to cap under test.
+  _tempVolts = analogRead(_voltReadPin[_probe]);   // Read voltage at point between 'C1' and C-test.
+                                                // -- Clear everything for next measurement --
+  digitalWrite(_chargePin[_probe], LOW);        // Remove voltage from caps and short C-test to ground.
+  pinMode(_voltReadPin[_probe], OUTPUT);        // Block C-test & 'C1' short-circut path through voltRead pin in prep for next charge cycle.
 }
 
 
@@ -130,4 +189,21 @@ void CapSensor::pulseAndReadVolts() {
 /*   2. Also reference documentation in: /Software/Documentation/CapSensor_MeasurementProtocol.odg.
 */
 
+/*   3. VCC measurement. Both the cap measurement and the bandgap measurement use VCC as the ADC
+  reference, so switching between them only changes the input mux - no reference settling. The
+  bandgap needs ~1ms after being selected before it reads true; we give it the full
+  INTER_MEASUREMENT_DELAY. analogRead() rewrites all of ADMUX, so nothing needs restoring after.
+  The ATTiny84 datasheet gives the bandgap as 1.0-1.2V, so expect up to +/-10% error unless
+  BANDGAP_MILLIVOLTS is calibrated against a meter for the particular chip.
+*/
+
+/*   4. Interleaving of probes. Each measurement leaves that probe's cap shorted to ground by its
+  charge pin, and it needs INTER_MEASUREMENT_DELAY to fully discharge before it is measured again.
+  Rather than measuring probe A ten times, then probe B ten times, we go A, B, A, B, ... and wait
+  only INTER_MEASUREMENT_DELAY / numProbes between measurements. So while probe A is resting,
+  probe B is being measured, every probe still gets its full rest, and the whole reading takes
+  NUM_READINGS_TO_AVERAGE * INTER_MEASUREMENT_DELAY regardless of the number of probes.
+  The probes must each have their own charge pin, so that pulsing one doesn't disturb another.
+*/
+
 
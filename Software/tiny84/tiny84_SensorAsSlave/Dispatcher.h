@@ -28,6 +28,13 @@
 
 #define CAP_READ_INTERVAL 60000*15             // 60,000 milliseconds is one minute.
 
+    /* As the supply voltage drops we read less often to make the battery last. Each
+     * step down doubles the interval. Today's supply is a 3.3V regulator, so VCC stays
+     * at ~3.3V until the battery feeding it gets too low for the regulator to hold it. */
+#define VCC_STRETCH_1_MV 3200                  // Below this: 2x CAP_READ_INTERVAL.
+#define VCC_STRETCH_2_MV 3000                  // Below this: 4x.
+#define VCC_STRETCH_3_MV 2800                  // Below this: 8x.
+
 class Dispatcher {
 
   private:
@@ -37,13 +44,19 @@ class Dispatcher {
     bool _radioAvailable = false;
     short int _phase = 0;
     RadioComms::RxPayloadStruct* _ackPayloadPtr;
+#ifdef DIAGNOSTIC_BUILD
+    uint8_t _diagCycles = 0;
+#endif
 
   public:
 
           /*    PURPOSE: Constructor. */
     //Dispatcher();
 
-          /*    PURPOSE: Start sensor reading process. */
+          /*    PURPOSE: Start sensor reading process. The 1st reading is
+           *  taken and sent straight away rather than after a full
+           *  CAP_READ_INTERVAL, so a freshly installed (or re-powered) sensor
+           *  shows up on the RPi within a few seconds. Call after radio.setup(). */
     void begin();
 
           /*    PURPOSE: Assesses changed states and new inputs and uses that 
@@ -51,5 +64,20 @@ class Dispatcher {
            *  Intended to be called once each loop() cycle. */
     void dispatch();
 
+  private:
+          /*    PURPOSE: Carry out a command from the master that came in
+           *  on an ACK payload. */
+    void handleCommand(RadioComms::RxPayloadStruct* cmd);
+
+          /*    PURPOSE: Work out how long to wait until the next reading
+           *  given the supply voltage just measured. */
+    unsigned long intervalForVcc(uint16_t vccMillivolts);
+
+#ifdef DIAGNOSTIC_BUILD
+          /*    PURPOSE: Every DIAG_EVERY_N_CYCLES cycles send the RPi
+           *  a packet with our SRAM use. Radio must still be awake. */
+    void sendDiagnostic();
+#endif
+
 };
 #endif
@@ -4,6 +4,26 @@
  *  detailed info and documentation that I didn't want to clutter up the code with; but which
  *  I am likely to want to remember when I come back to this in 6 months.  : ) 
  *   
+ * 10/19/2026:
+ *    > Phase-4 now carries out the master's command from the ACK payload. First command is
+ *      CMD_SET_PA_LEVEL, sent by the RPi's transmit power control loop.
+ *    > The supply voltage measured with each reading is sent along with it, and sets how long
+ *      to wait until the next reading (intervalForVcc()).
+ *    > Pipelined the cycle: the radio is woken (powered up and configured) at the start of a
+ *      reading, in parallel with the sensor measurements, and put back to sleep after the ACK
+ *      is handled. The transmit starts on the same pass the average becomes available. The
+ *      awake time for each cycle goes out with the next reading.
+ *    > Fast boot: begin() starts the 1st read-Tx cycle right away instead of waiting out a
+ *      full 15 minute interval, and picks up the radio state from the sketch's setup() rather
+ *      than initializing the chip a 2nd time. After the 1st cycle the regular schedule runs
+ *      from the time of that 1st reading.
+ *    > All of the CapSensor's probes go out in the one packet.
+ *    > Diagnostic build (DIAGNOSTIC_BUILD in RadioComms.h): every DIAG_EVERY_N_CYCLES cycles a
+ *      2nd packet with the SRAM high-water mark goes out after the ACK is handled.
+ *    > Phase-3 no longer hangs when the ACK comes back without a payload (radio error #3). It
+ *      waits for the transmit cycle to end (radio.isBusy()), and phase-4 goes back to sleep as
+ *      usual, with no command to carry out. See footnote #4.
+ *
  * 09/27/2023: 
  *    > Changed the sensor-read/Transmit cycle to once every 15 minutes.
  *    > This is my 1st version for 'beta testing' in a live flower pot.
@@ -23,6 +43,7 @@
 #include "ErrorFlash.h"
 #include "CapSensor.h"
 #include "RadioComms.h"
+#include "MemDiag.h"
 
 //*************************************************************************************************
 
@@ -32,7 +53,8 @@
 // }
 
 void Dispatcher::begin() {
-  // Nothing to do at the moment.
+  _radioAvailable = radio.isAvailable();   // setup() already tried; if it failed dispatch() will retry.
+  _phase = 1;                              // Go straight to a reading. The radio is awake from setup().
 }
 
 void Dispatcher::dispatch() {
@@ -76,26 +98,35 @@ void Dispatcher::dispatch() {
     case 1: // Initiate sensor reading.
       _capReadingStartTime = millis();
       capSensor.initiateSensorReading();
+      radio.wake();                        // Radio comes up while the sensor takes its readings.
       _phase = 2;
       break;
 
     case 2: // Wait for and fetch sensor reading, then initiate transmission.
-      if(capSensor.readingAvailable()) {   // This gives a slice of CPU time to CapSensor object.
-        radio.setTxPayload(capSensor.getCapacitance());
+      if(capSensor.readingAvailable() && radio.isAwake()) {   // This gives a slice of CPU time to CapSensor object.
+        radio.setTxPayload(capSensor.getCapacitance(0), capSensor.getVccMillivolts());
+        for(uint8_t p = 1; p < capSensor.getNumProbes(); p++) {
+          radio.setProbeCapacitance(p, capSensor.getCapacitance(p));
+        }
+        _capReadingInterval = intervalForVcc(capSensor.getVccMillivolts());
         _phase = 3;
       }
       break;
 
-    case 3: // Wait for and fetch ACK payload.
-      if(radio.ackAvailable()) {
-        _ackPayloadPtr = radio.getAckPayload();
+    case 3: // Wait for the transmit cycle to end, and fetch the ACK payload if there is one.
+      if(!radio.isBusy()) {
+        _ackPayloadPtr = radio.ackAvailable() ? radio.getAckPayload() : NULL;
         _phase = 4;
       }
       break;
 
-    case 4: // Handle master's command back to me.
-      // Master command handler here....
-      // For now tho, do a pseudo sleep state.
+    case 4: // Handle master's command back to me, then do a pseudo sleep state.
+      if(_ackPayloadPtr) handleCommand(_ackPayloadPtr);
+#ifdef DIAGNOSTIC_BUILD
+      sendDiagnostic();
+#endif
+      radio.sleep();
+      radio.setAwakeMillis(millis() - _capReadingStartTime);
       _phase = 0;
       break;
   }
@@ -108,6 +139,46 @@ void Dispatcher::dispatch() {
 }
 
 
+#ifdef DIAGNOSTIC_BUILD
+void Dispatcher::sendDiagnostic() {
+  if(++_diagCycles < DIAG_EVERY_N_CYCLES) return;
+  _diagCycles = 0;
+  RadioComms::DiagPayloadStruct diag;         // On the stack on purpose - it's part of what we measure.
+  diag.stackUnused = MemDiag::stackUnused();
+  diag.freeNow = MemDiag::freeNow();
+  diag.staticBytes = MemDiag::staticBytes();
+  diag.resetFlags = MemDiag::resetFlags();
+  radio.sendDiagnostic(&diag);
+}
+#endif
+
+
+unsigned long Dispatcher::intervalForVcc(uint16_t vccMillivolts) {
+  unsigned long interval = CAP_READ_INTERVAL;
+  if(vccMillivolts == 0) return(interval);   // No measurement. Don't guess.
+  if(vccMillivolts < VCC_STRETCH_1_MV) interval *= 2;
+  if(vccMillivolts < VCC_STRETCH_2_MV) interval *= 2;
+  if(vccMillivolts < VCC_STRETCH_3_MV) interval *= 2;
+  return(interval);
+}
+
+
+void Dispatcher::handleCommand(RadioComms::RxPayloadStruct* cmd) {
+  /* Every sensor hears the RPi's ACK payloads, so first make sure
+   * the command is for us. See footnote #3. */
+  if((cmd->command >> CMD_TARGET_SHIFT) != SENSOR_ID) return;
+
+  switch (cmd->command & 0xFF) {
+    case CMD_SET_PA_LEVEL:
+      radio.setPALevel(cmd->uliCmdData);
+      break;
+
+    default:                                // CMD_NONE, or one we don't know. Nothing to do.
+      break;
+  }
+}
+
+
 /**************************************************************************************************
 // FOOTNOTES
 //*************************************************************************************************
@@ -120,3 +191,13 @@ void Dispatcher::dispatch() {
   declared as global so that they are accessable here.
 */
 
+/*   3. The RPi loads the ACK payload for the *next* packet it will receive before it knows who
+  will send it. So a command meant for one sensor can land on another. The RPi keeps re-sending
+  a command until the sensor's payloads show it has been carried out, so ignoring a command that
+  isn't ours is all we need to do here.
+*/
+
+/*   4. An ACK with no payload (RadioComms error #3) still means the RPi has the reading, so
+  it isn't sent again. Any command the RPi has for us comes with the next cycle's ACK instead.
+*/
+
@@ -0,0 +1,53 @@
+// Class: MemDiag - Class Definition
+//=================================================================================================
+
+#ifndef MemDiag_h
+#define MemDiag_h
+
+#include "Arduino.h"
+
+/************************************************************************************************
+*
+*    PURPOSE: SRAM diagnostics for the diagnostic build. The ATTiny84 has 512 bytes of SRAM and
+*  between the RF24 object, the payload structs, the global objects and float math we have no
+*  real idea how close the stack comes to running into our static data. ISSUE-1 (the corrupted
+*  struct) looked a lot like exactly that. This class answers the question.
+*
+*    At power-up, before any constructors run, all of the free SRAM between the end of static
+*  data and the top of the stack is 'painted' with STACK_CANARY. Any byte the stack ever uses
+*  gets overwritten, so later on counting the canary bytes still intact (from the bottom up)
+*  gives the smallest amount of free SRAM there has ever been - the high-water mark.
+*
+*    USAGE:
+*    1. Uncomment #define DIAGNOSTIC_BUILD in RadioComms.h. Without it this class compiles to
+*  nothing and the painting code isn't linked in.
+*    2. Call the static functions any time. The Dispatcher sends them to the RPi every
+*  DIAG_EVERY_N_CYCLES cycles in a DiagPayloadStruct packet.
+*    3. For the static RAM used by each object, see /Software/tiny84/ramReport.sh.
+*
+*    NOTE:
+*    1. The stack painting runs in the .init3 section, see footnote #1 in MemDiag.ino.
+*/
+
+#define STACK_CANARY 0xC5
+
+class MemDiag {
+
+  public:
+
+          /*    PURPOSE: Bytes of SRAM the stack has never touched since boot. */
+    static uint16_t stackUnused();
+
+          /*    PURPOSE: Bytes free right now between the heap (or static data if the
+           *  heap is unused) and the stack pointer. */
+    static uint16_t freeNow();
+
+          /*    PURPOSE: Bytes of SRAM taken by .data and .bss. */
+    static uint16_t staticBytes();
+
+          /*    PURPOSE: MCUSR as it was at boot - tells why we last reset
+           *  (bit 0 power-on, 1 external, 2 brown-out, 3 watchdog). */
+    static uint8_t resetFlags();
+
+};
+#endif
@@ -0,0 +1,88 @@
+// Class: MemDiag - Function Definitions
+//=================================================================================================
+/*    FOOTNOTES: Note that there are 'footnotes' at the bottom of this file that provide more
+ *  detailed info and documentation that I didn't want to clutter up the code with; but which
+ *  I am likely to want to remember when I come back to this in 6 months.
+ *
+ *      10/19/2026: Initial version, for the diagnostic build.
+ *
+ */
+//=================================================================================================
+
+#include "Arduino.h"
+#include "MemDiag.h"
+#include "RadioComms.h"               // For DIAGNOSTIC_BUILD.
+
+#ifdef DIAGNOSTIC_BUILD
+
+//*************************************************************************************************
+
+extern uint8_t __heap_start;          // From the linker: first byte after .bss (and .noinit).
+extern uint8_t __stack;               // From the linker: top of SRAM, RAMEND.
+extern char* __brkval;                // From avr-libc malloc(): top of the heap, 0 if never used.
+
+uint8_t memDiagResetFlags __attribute__ ((section (".noinit")));
+
+
+void memDiagPaint(void) __attribute__ ((naked, used, section (".init3")));
+void memDiagPaint(void) {
+      /*      PURPOSE: Paint free SRAM with the canary. Not called - the linker drops it in line
+       *  into the start up code. See footnote #1. */
+  memDiagResetFlags = MCUSR;
+  MCUSR = 0;
+  uint8_t* p = &__heap_start;
+  while(p <= &__stack) {
+    *p++ = STACK_CANARY;
+  }
+}
+
+
+uint16_t MemDiag::stackUnused() {
+  const uint8_t* p = (__brkval ? (const uint8_t*)__brkval : &__heap_start);
+  uint16_t count = 0;
+  while(p <= &__stack && *p == STACK_CANARY) {
+    p++;
+    count++;
+  }
+  return(count);
+}
+
+
+uint16_t MemDiag::freeNow() {
+  uint8_t top;                        // Lives at (about) the current stack pointer.
+  const uint8_t* heapEnd = (__brkval ? (const uint8_t*)__brkval : &__heap_start);
+  return((uint16_t)(&top - heapEnd));
+}
+
+
+uint16_t MemDiag::staticBytes() {
+  return((uint16_t)(&__heap_start - (uint8_t*)RAMSTART));
+}
+
+
+uint8_t MemDiag::resetFlags() {
+  return(memDiagResetFlags);
+}
+
+#endif
+
+
+
+/**************************************************************************************************
+// FOOTNOTES
+//*************************************************************************************************
+
+/*   1. Functions put in the .initN sections are not called; avr-gcc's start up code falls through
+  them in order. .init2 sets up the stack pointer and zeroes r1, which compiled C code relies on;
+  .init4 copies .data in and clears .bss. So .init3 is the spot: the C code here is safe to run,
+  and nothing has been put in SRAM yet that painting could wipe out. It has to be 'naked' (no
+  prologue/epilogue, and no 'ret' at the end) and 'used' (so the linker doesn't throw it away as
+  nothing calls it). The reset flags are grabbed here too, before anything else clears MCUSR,
+  and kept in .noinit, which sits below __heap_start so it isn't painted or cleared.
+*/
+
+/*   2. stackUnused() counts up from the bottom of free SRAM. A stack that ever reached down to
+  a byte will have overwritten it (with something that is very unlikely to be exactly 0xC5), so
+  the first non-canary byte is the deepest the stack has been. If it ever reports 0 then the
+  stack has run into the heap or static data at some point - a crash waiting to happen.
+*/
@@ -0,0 +1,106 @@
+// Class: Nrf24Lite - Class Definition
+//=================================================================================================
+
+#ifndef Nrf24Lite_h
+#define Nrf24Lite_h
+
+#include "Arduino.h"
+#include <SPI.h>
+
+/************************************************************************************************
+*
+*    PURPOSE: A minimal nRF24L01+ driver, talking straight to the chip's registers, as a drop-in
+* for the RF24 library in RadioComms. The RF24 library covers every feature of the chip, and on
+* the ATTiny84 it takes a big share of the 8K of flash. We only use a small part of it: transmit
+* with auto-ack, dynamic payloads, reading back the ACK payload, and power down. This class does
+* just that, with the same function names RadioComms already calls.
+*
+*    Savings come from:
+*    1. Configuration is fixed at compile time (the NRF_CFG_ defines below) and written from one
+*  table in flash by begin(). The RF24 functions that would set each of these at run time are
+*  not linked in.
+*    2. Every SPI command clocks the STATUS register out on its 1st byte. We keep that and use
+*  it, rather than spending a separate transaction to read STATUS. available() and the wait for
+*  a write() to finish are one byte each on the bus.
+*    3. CONFIG is cached in _config, so power up/down is one register write, not read-modify-write.
+*    4. Multi-byte writes and reads (payloads, addresses) are one CSN-low transaction each.
+*
+*    USAGE:
+*    1. #define NRF24_LITE in RadioComms.h. RadioComms then uses this class instead of RF24.
+*    2. Settings that RF24 takes at run time (channel, data rate, CRC, retries) are the
+*  NRF_CFG_ defines. They are RF24's defaults, and MUST match the RPi, which still uses RF24.
+*
+*    NOTE:
+*    1. PTX (transmit) mode only; startListening() is not provided. ACK payloads come back
+*  on pipe 0 and are read with available()/read() as with RF24.
+*    2. enableDynamicPayloads(), enableAckPayload() and stopListening() are kept so RadioComms
+*  compiles either way, but do nothing: begin() already set that up.
+*/
+
+    /* Compile-time configuration. RF24 library defaults, as the RPi uses. */
+#define NRF_CFG_CHANNEL 76                // RF_CH
+#define NRF_CFG_RETRIES 0x5F              // SETUP_RETR: ARD 1500us, ARC 15. RF24 begin() sets (5, 15).
+#define NRF_CFG_PA_LEVEL 1                // RF24_PA_LOW until setPALevel() says otherwise.
+#define NRF_WRITE_TIMEOUT 95              // ms to wait for TX_DS/MAX_RT before giving up. As RF24.
+#define NRF_POWERUP_DELAY 5000            // us, power down -> standby (Tpd2stby). As RF24.
+#define NRF_MAX_PAYLOAD 32
+
+    /* RF24's PA level names, as RF24.h is not included with NRF24_LITE. */
+#define RF24_PA_MIN 0
+#define RF24_PA_LOW 1
+#define RF24_PA_HIGH 2
+#define RF24_PA_MAX 3
+
+class Nrf24Lite {
+
+  private:
+    uint8_t _cePin;
+    uint8_t _csnPin;
+    uint8_t _config;                      // Cached CONFIG register.
+    uint8_t _rfSetup;                     // Cached RF_SETUP register.
+
+    uint8_t command(uint8_t cmd);
+    uint8_t writeRegister(uint8_t reg, uint8_t value);
+    uint8_t writeBuffer(uint8_t cmd, const uint8_t* buf, uint8_t len);
+    uint8_t readBuffer(uint8_t cmd, uint8_t* buf, uint8_t len);
+    uint8_t readRegister(uint8_t reg);
+
+  public:
+
+          /*    PURPOSE: Constructor. Params are the CE and CSN pins. */
+    Nrf24Lite(uint8_t cePin, uint8_t csnPin);
+
+          /*    PURPOSE: Set up SPI and write the compile-time configuration.
+           *    RETURNS: False if the chip didn't read back what we wrote (not
+           *  connected, or not powered). */
+    bool begin();
+
+          /*    PURPOSE: Transmit one payload and wait for its ACK (or for the chip
+           *  to give up after NRF_CFG_RETRIES). Blocks, as RF24::write() does.
+           *    RETURNS: True if ACK'd. */
+    bool write(const void* buf, uint8_t len);
+
+          /*    PURPOSE: Retransmits the last write() took (ARC_CNT, 0-15). */
+    uint8_t getARC();
+
+          /*    PURPOSE: Tells if there is a payload (our ACK payload) in the RX FIFO,
+           *  and which pipe it came in on. */
+    bool available(uint8_t* pipe);
+
+          /*    PURPOSE: Read up to len bytes of the next RX payload. */
+    void read(void* buf, uint8_t len);
+
+    void setPALevel(uint8_t level);
+    void openWritingPipe(const uint8_t* address);
+    void openReadingPipe(uint8_t pipe, const uint8_t* address);
+    void powerUp();
+    void powerDown();
+    uint8_t flush_tx();
+    uint8_t flush_rx();
+
+    void enableDynamicPayloads() {}
+    void enableAckPayload() {}
+    void stopListening() {}
+
+};
+#endif
@@ -0,0 +1,265 @@
+// Class: Nrf24Lite - Function Definitions
+//=================================================================================================
+/*    FOOTNOTES: Note that there are 'footnotes' at the bottom of this file that provide more
+ *  detailed info and documentation that I didn't want to clutter up the code with; but which
+ *  I am likely to want to remember when I come back to this in 6 months.
+ *
+ *      10/19/2026: Initial version. Register names and bits from the nRF24L01+ Product
+ *  Specification v1.0, section 9.
+ *      10/19/2026: write() no longer says a chip that has gone away (SPI reads 0xFF, so TX_DS
+ *  and MAX_RT both look set) took the payload. Checked by RPi_RadioSim -D.
+ *
+ */
+//=================================================================================================
+
+#include "Arduino.h"
+#include "RadioComms.h"               // For NRF24_LITE, which pulls in Nrf24Lite.h.
+
+#ifdef NRF24_LITE
+
+    /* SPI commands. */
+#define NRF_R_REGISTER    0x00
+#define NRF_W_REGISTER    0x20
+#define NRF_R_RX_PAYLOAD  0x61
+#define NRF_W_TX_PAYLOAD  0xA0
+#define NRF_FLUSH_TX      0xE1
+#define NRF_FLUSH_RX      0xE2
+#define NRF_R_RX_PL_WID   0x60
+#define NRF_NOP           0xFF
+
+    /* Registers. */
+#define NRF_CONFIG        0x00
+#define NRF_EN_AA         0x01
+#define NRF_EN_RXADDR     0x02
+#define NRF_SETUP_AW      0x03
+#define NRF_SETUP_RETR    0x04
+#define NRF_RF_CH         0x05
+#define NRF_RF_SETUP      0x06
+#define NRF_STATUS        0x07
+#define NRF_OBSERVE_TX    0x08
+#define NRF_RX_ADDR_P0    0x0A
+#define NRF_TX_ADDR       0x10
+#define NRF_DYNPD         0x1C
+#define NRF_FEATURE       0x1D
+
+    /* Bits. */
+#define NRF_EN_CRC        0x08
+#define NRF_CRCO          0x04            // 2 byte CRC.
+#define NRF_PWR_UP        0x02
+#define NRF_RX_DR         0x40
+#define NRF_TX_DS         0x20
+#define NRF_MAX_RT        0x10
+#define NRF_EN_DPL        0x04
+#define NRF_EN_ACK_PAY    0x02
+#define NRF_LNA_HCURR     0x01            // RF24 always sets this along with the PA level.
+#define NRF_ADDR_WIDTH    5
+
+    /* Everything begin() sets, as register/value pairs. CONFIG is written
+     * last, powered down; powerUp() brings the chip up when it is needed. */
+static const uint8_t NRF_INIT_TABLE[][2] PROGMEM = {
+  {NRF_SETUP_AW,   NRF_ADDR_WIDTH - 2},
+  {NRF_SETUP_RETR, NRF_CFG_RETRIES},
+  {NRF_RF_CH,      NRF_CFG_CHANNEL},
+  {NRF_RF_SETUP,   (NRF_CFG_PA_LEVEL << 1) | NRF_LNA_HCURR},      // 1Mbps
+  {NRF_EN_AA,      0x3F},
+  {NRF_EN_RXADDR,  0x03},                                         // Pipes 0 (ACKs) and 1.
+  {NRF_FEATURE,    NRF_EN_DPL | NRF_EN_ACK_PAY},
+  {NRF_DYNPD,      0x3F},
+  {NRF_STATUS,     NRF_RX_DR | NRF_TX_DS | NRF_MAX_RT},           // Clear any flags left over.
+  {NRF_CONFIG,     NRF_EN_CRC | NRF_CRCO},
+};
+
+
+Nrf24Lite::Nrf24Lite(uint8_t cePin, uint8_t csnPin) : _cePin(cePin), _csnPin(csnPin) {
+}
+
+
+bool Nrf24Lite::begin() {
+  pinMode(_cePin, OUTPUT);
+  pinMode(_csnPin, OUTPUT);
+  digitalWrite(_cePin, LOW);
+  digitalWrite(_csnPin, HIGH);
+  SPI.begin();
+  delay(5);                                         // Chip's power on reset. See footnote #1.
+
+  for(uint8_t i = 0; i < sizeof(NRF_INIT_TABLE) / 2; i++) {
+    writeRegister(pgm_read_byte(&NRF_INIT_TABLE[i][0]), pgm_read_byte(&NRF_INIT_TABLE[i][1]));
+  }
+  _config = NRF_EN_CRC | NRF_CRCO;
+  _rfSetup = (NRF_CFG_PA_LEVEL << 1) | NRF_LNA_HCURR;
+  flush_rx();
+  flush_tx();
+  powerUp();
+
+  return(readRegister(NRF_RF_SETUP) == _rfSetup && readRegister(NRF_SETUP_AW) == NRF_ADDR_WIDTH - 2);
+}
+
+
+bool Nrf24Lite::write(const void* buf, uint8_t len) {
+  if(len > NRF_MAX_PAYLOAD) len = NRF_MAX_PAYLOAD;
+  writeBuffer(NRF_W_TX_PAYLOAD, (const uint8_t*)buf, len);
+  digitalWrite(_cePin, HIGH);                       // Go. Held high until done - see footnote #2.
+
+  uint8_t status;
+  unsigned long start = millis();
+  do {
+    status = command(NRF_NOP);
+  } while(!(status & (NRF_TX_DS | NRF_MAX_RT)) && millis() - start < NRF_WRITE_TIMEOUT);
+  digitalWrite(_cePin, LOW);
+
+  writeRegister(NRF_STATUS, NRF_TX_DS | NRF_MAX_RT);  // Leave RX_DR for available().
+  if((status & (NRF_TX_DS | NRF_MAX_RT)) != NRF_TX_DS) {     // MAX_RT, timed out, or no chip: the payload is still in the FIFO.
+    flush_tx();
+    return(false);
+  }
+  return(true);
+}
+
+
+uint8_t Nrf24Lite::getARC() {
+  return(readRegister(NRF_OBSERVE_TX) & 0x0F);
+}
+
+
+bool Nrf24Lite::available(uint8_t* pipe) {
+  uint8_t rxPipe = (command(NRF_NOP) >> 1) & 0x07;  // STATUS RX_P_NO; 7 when the RX FIFO is empty.
+  if(rxPipe > 5) return(false);
+  if(pipe) *pipe = rxPipe;
+  return(true);
+}
+
+
+void Nrf24Lite::read(void* buf, uint8_t len) {
+  uint8_t width;
+  readBuffer(NRF_R_RX_PL_WID, &width, 1);
+  if(width > NRF_MAX_PAYLOAD) {                     // Corrupt - the data sheet says flush it.
+    flush_rx();
+    width = 0;
+  }
+  if(len > width) {
+    memset((uint8_t*)buf + width, 0, len - width);
+    len = width;
+  }
+  if(len) readBuffer(NRF_R_RX_PAYLOAD, (uint8_t*)buf, len);   // Reading any of it pops the payload.
+  writeRegister(NRF_STATUS, NRF_RX_DR);
+}
+
+
+void Nrf24Lite::setPALevel(uint8_t level) {
+  if(level > RF24_PA_MAX) level = RF24_PA_MAX;
+  _rfSetup = (_rfSetup & ~0x06) | (level << 1);
+  writeRegister(NRF_RF_SETUP, _rfSetup);
+}
+
+
+void Nrf24Lite::openWritingPipe(const uint8_t* address) {
+  writeBuffer(NRF_W_REGISTER | NRF_RX_ADDR_P0, address, NRF_ADDR_WIDTH);   // Pipe 0 has to match to get the ACK.
+  writeBuffer(NRF_W_REGISTER | NRF_TX_ADDR, address, NRF_ADDR_WIDTH);
+}
+
+
+void Nrf24Lite::openReadingPipe(uint8_t pipe, const uint8_t* address) {
+  if(pipe < 1 || pipe > 5) return;                  // Pipe 0 belongs to the writing pipe.
+  writeBuffer(NRF_W_REGISTER | (NRF_RX_ADDR_P0 + pipe), address, (pipe == 1) ? NRF_ADDR_WIDTH : 1);
+}
+
+
+void Nrf24Lite::powerUp() {
+  if(_config & NRF_PWR_UP) return;
+  _config |= NRF_PWR_UP;
+  writeRegister(NRF_CONFIG, _config);
+  delayMicroseconds(NRF_POWERUP_DELAY);
+}
+
+
+void Nrf24Lite::powerDown() {
+  digitalWrite(_cePin, LOW);
+  _config &= ~NRF_PWR_UP;
+  writeRegister(NRF_CONFIG, _config);
+}
+
+
+uint8_t Nrf24Lite::flush_tx() {
+  return(command(NRF_FLUSH_TX));
+}
+
+
+uint8_t Nrf24Lite::flush_rx() {
+  return(command(NRF_FLUSH_RX));
+}
+
+
+//*************************************************************************************************
+//  SPI. Every transaction returns STATUS, which the chip clocks out with the command byte.
+
+uint8_t Nrf24Lite::command(uint8_t cmd) {
+  digitalWrite(_csnPin, LOW);
+  uint8_t status = SPI.transfer(cmd);
+  digitalWrite(_csnPin, HIGH);
+  return(status);
+}
+
+
+uint8_t Nrf24Lite::writeRegister(uint8_t reg, uint8_t value) {
+  digitalWrite(_csnPin, LOW);
+  uint8_t status = SPI.transfer(NRF_W_REGISTER | reg);
+  SPI.transfer(value);
+  digitalWrite(_csnPin, HIGH);
+  return(status);
+}
+
+
+uint8_t Nrf24Lite::readRegister(uint8_t reg) {
+  uint8_t value;
+  readBuffer(NRF_R_REGISTER | reg, &value, 1);
+  return(value);
+}
+
+
+uint8_t Nrf24Lite::writeBuffer(uint8_t cmd, const uint8_t* buf, uint8_t len) {
+  digitalWrite(_csnPin, LOW);
+  uint8_t status = SPI.transfer(cmd);
+  while(len--) SPI.transfer(*buf++);
+  digitalWrite(_csnPin, HIGH);
+  return(status);
+}
+
+
+uint8_t Nrf24Lite::readBuffer(uint8_t cmd, uint8_t* buf, uint8_t len) {
+  digitalWrite(_csnPin, LOW);
+  uint8_t status = SPI.transfer(cmd);
+  while(len--) *buf++ = SPI.transfer(NRF_NOP);
+  digitalWrite(_csnPin, HIGH);
+  return(status);
+}
+
+#endif
+
+
+
+/**************************************************************************************************
+// FOOTNOTES
+//*************************************************************************************************
+
+/*   1. The data sheet gives the chip 100ms from VCC reaching 1.9V to be ready for SPI. The
+  sketch's setup() has long passed that by the time radio.setup() runs (RF24 also only waits
+  5ms here). begin() leaves the chip in standby-I (powered up, CE low) as RF24 does.
+*/
+
+/*   2. CE only needs a 10us pulse to send one payload, but holding it high until TX_DS/MAX_RT
+  covers the auto-retransmits too, the same as RF24::write(). The wait is polled with NOP,
+  which is a single byte on the bus and hands back STATUS. At 1Mbps with 15 retries at 1500us
+  the worst case is ~30ms (the retry delays plus 16 settle + air times); NRF_WRITE_TIMEOUT is
+  only there in case the chip has gone away.
+*/
+
+/*   3. Comparing against RF24: build the sketch with and without NRF24_LITE and compare
+  avr-size (flash and .data/.bss) and ../ramReport.sh (the radio object's size). The bus
+  traffic per operation here is:
+    write()      1 transaction (cmd + payload), 1 byte per poll, 1 STATUS clear.
+    available()  1 byte.
+    read()       R_RX_PL_WID (2 bytes), payload (1 + len bytes), 1 STATUS clear.
+    powerUp()/powerDown()/setPALevel()  1 register write each, no read back.
+  RPi_RadioSim -D runs both drivers against the simulated chip and prints each call's bus
+  transactions, bytes and time side by side.
+*/
@@ -4,9 +4,17 @@
 #ifndef RadioComms_h
 #define RadioComms_h
 
+//#define NRF24_LITE                  // Uncomment to use our own lean driver instead of the RF24 library. See Nrf24Lite.h.
+
 #include "Arduino.h"
 #include <SPI.h>
-#include "RF24.h"
+#ifdef NRF24_LITE
+  #include "Nrf24Lite.h"
+  typedef Nrf24Lite RadioChip;
+#else
+  #include "RF24.h"
+  typedef RF24 RadioChip;
+#endif
 
 
 /************************************************************************************************
@@ -25,10 +33,33 @@
 * hard not to keep an exclusive hold over the processor so that other operations can run
 * in between comms activities.
 *
+*    4. Between readings call .sleep() to power the chip down, and .wake() at the start of
+* the next reading. Waking runs in the background (phases 10 and 11 of update()) so it can
+* overlap the CapSensor's inter-measurement waits; .isAwake() tells when it is done.
+*
 *    NOTE:
 *    1. By design, this class is non-blocking.
+*    2. SENSOR_ID must be unique for each sensor talking to the same RPi. It goes out in
+* every payload, and the RPi addresses its commands back to us with it.
 */
 
+#define SENSOR_ID 1
+
+//#define DIAGNOSTIC_BUILD            // Uncomment to send SRAM diagnostics to the RPi. See MemDiag.h.
+#define DIAG_EVERY_N_CYCLES 4         // Diagnostic build: send a DiagPayloadStruct every Nth cycle.
+
+    /* Commands the RPi can send back in the ACK payload. The low byte of
+     * RxPayloadStruct.command is the command ID, the upper 16 bits the sensor
+     * ID the command is meant for. MUST match the CMD_ defines on the RPi side. */
+#define CMD_NONE 0
+#define CMD_SET_PA_LEVEL 1            // uliCmdData = RF24 PA level 0-3
+#define CMD_TARGET_SHIFT 16
+
+#define PAYLOAD_EXTRA_PROBES 3        // Probes beyond the 1st that fit in the payload.
+
+#define RADIO_PHASE_WAKE 10           // update() phase: power the chip up.
+#define RADIO_PHASE_CONFIG 11         // update() phase: re-assert the config, clear stale FIFO data.
+
 
 class RadioComms {
 
@@ -50,8 +81,20 @@ class RadioComms {
       */
     };
 
+      /*    Diagnostic build only: SRAM use, sent as its own packet. The
+       * RPi tells it from a reading by its size (10 bytes vs 32). MUST
+       * match DiagPayloadStruct on the RPi side. */
+    struct DiagPayloadStruct {
+      uint16_t sensorID = SENSOR_ID;
+      uint16_t stackUnused;       // SRAM never touched by the stack since boot.
+      uint16_t freeNow;           // SRAM free at the time of sending.
+      uint16_t staticBytes;       // SRAM taken by .data + .bss.
+      uint8_t resetFlags;         // MCUSR at boot.
+      uint8_t reserved = 0;
+    };
+
   private:
-    RF24 _radioChip;                        // The nRF24 radio object (defined in the RF25.h library).
+    RadioChip _radioChip;                   // The nRF24 radio object (RF24 library, or Nrf24Lite).
     int _cePin;                             // 'Chip Enable.' CE pin nRF24 is wired to.
     int _csnPin;                            // 'Chip Select Not.' SPI chip select pin nFR24 is wired to.
     const char * _addressMaster = "1Node";  // Address of the my master. I send messages to this address.
@@ -62,14 +105,20 @@ class RadioComms {
     short int _phase = 0;                   // Comms phase we are in.
     bool _rxPayloadAvailable;               // We have a received payload.
     bool _radioAvail = false;               // True if the radio is up and running.
+    bool _asleep = false;                   // True if the chip is powered down.
 
     struct TxPayloadStruct {                // struct to accumulate txPayload data.
       float capacitance;
       uint32_t sensorTime = 0;   // Time on ATTiny clock at transmit attempt.
       uint32_t ctSuccess = 0;    // count of success Tx attempts tiny84 has seen since boot
       uint32_t ctErrors = 0;     // count of Tx errors tiny84 saw since last successful transmit
-      char units[4];             // nFD, mFD, FD
-      char statusText[12];       // For use in debugging. Be sure there is space for a NULL terminating char
+      uint16_t sensorID = SENSOR_ID;
+      uint8_t paLevel = RF24_PA_LOW;  // PA level we are transmitting at.
+      uint8_t txRetries = 0;     // Auto-retransmits the previous reading took to get through.
+      uint16_t vccMillivolts = 0;     // Our supply voltage.
+      uint16_t awakeMillis = 0;  // How long the previous read-Tx-ACK cycle kept us awake.
+      uint16_t bootAckMillis = 0;     // Boot to 1st ACK'd transmit, 0 until that has happened.
+      uint16_t probeCap[PAYLOAD_EXTRA_PROBES] = {0};  // Probes 2..4, in 1/100ths of a pF. 0 = no probe.
     };
     TxPayloadStruct _txPayload;
 
@@ -95,17 +144,56 @@ class RadioComms {
     short int update();
 
 
+          /*    PURPOSE: Tells if setup() got the radio chip going. */
+    bool isAvailable();
+
           /*    PURPOSE: Set the data to transmit in next transmit cycle. */
-    void setTxPayload(float fCap);
+    void setTxPayload(float fCap, uint16_t vccMillivolts);
+
+          /*    PURPOSE: Set the reading of one of the extra probes (probe 1 and up;
+           * probe 0 goes in via setTxPayload()) for the next transmit cycle. */
+    void setProbeCapacitance(uint8_t probe, float fCap);
 
           /*    PURPOSE: Tells caller if an ACK payload is available.
-           * So, in effect, tells if the latest transmission attmept
-           * has completed. */
+           * Only once isBusy() is false: the ACK can come back empty (error #3),
+           * and then there is none to wait for. */
     bool ackAvailable();
 
+          /*    PURPOSE: Tells if the transmit cycle started by setTxPayload() is
+           * still going (phases 1 and 2). Once it isn't, ackAvailable() says
+           * whether the RPi's ACK brought a payload with it. */
+    bool isBusy();
+
           /*    PURPOSE: Returns pointer to last received ack payload. */
     RxPayloadStruct* getAckPayload();
 
+          /*    PURPOSE: Change the radio's PA level (RF24_PA_MIN .. RF24_PA_MAX).
+           * The level in use is reported to the RPi in every payload. */
+    void setPALevel(uint8_t level);
+
+          /*    PURPOSE: Start bringing the radio up from sleep, ready to transmit.
+           * Non-blocking; the work is done in update(). */
+    void wake();
+
+          /*    PURPOSE: Tells if the radio is powered up and configured, so that
+           * setTxPayload() can start a transmission straight away. */
+    bool isAwake();
+
+          /*    PURPOSE: Power the radio chip down until the next wake(). */
+    void sleep();
+
+          /*    PURPOSE: Record how long the last cycle was awake. Goes out with
+           * the next reading. */
+    void setAwakeMillis(uint16_t awakeMillis);
+
+#ifdef DIAGNOSTIC_BUILD
+          /*    PURPOSE: Send a diagnostic packet. Radio must be awake. Blocks for
+           * the one write() (as phase-1 does); any ACK payload it brings back is
+           * dropped - the RPi keeps re-sending commands until they are acted on.
+           *    RETURNS: True if it was ACK'd. */
+    bool sendDiagnostic(DiagPayloadStruct* diag);
+#endif
+
 
 };
 #endif
\ No newline at end of file
@@ -4,6 +4,29 @@
  *  detailed info and documentation that I didn't want to clutter up the code with; but which
  *  I am likely to want to remember when I come back to this in 6 months.
  *
+ * 10/19/2026:
+ *    > Replaced units[] in TxPayloadStruct with sensorID, paLevel and txRetries so the RPi can
+ *      run closed-loop power control. txRetries is the number of auto-retransmits (from the
+ *      chip's ARC count) the previous successful write took. Failed writes already show up in
+ *      ctErrors.
+ *    > Added setPALevel() so the RPi's power control command can be carried out.
+ *    > Added vccMillivolts to TxPayloadStruct (statusText shortened to 10 to keep the payload
+ *      at 32 bytes).
+ *    > Added wake()/sleep(). The radio is now powered down between readings. Waking is done in
+ *      update() phases 10 (power up) and 11 (re-assert PA level and pipes, flush stale FIFO
+ *      data) so it runs while CapSensor is waiting between measurements, instead of after it.
+ *      The length of each cycle's awake window is reported in the next payload (awakeMillis,
+ *      statusText now 8 bytes).
+ *    > Added bootAckMillis to TxPayloadStruct: milliseconds from boot to the first transmit
+ *      that was ACK'd. statusText now 6 bytes, and holds "test" rather than "testing".
+ *    > Added isAvailable() so the Dispatcher doesn't need to set the radio up a 2nd time.
+ *    > Replaced statusText[] with probeCap[3] to carry the readings of up to 3 more probes in
+ *      the same packet, as 1/100ths of a pF (0 - 655.35pF) to fit. See setProbeCapacitance().
+ *    > Added sendDiagnostic() for the diagnostic build (DIAGNOSTIC_BUILD).
+ *    > _radioChip can be our own lean Nrf24Lite driver instead of the RF24 library (NRF24_LITE).
+ *    > Added isBusy(). An ACK without a payload (error #3) ends the transmit cycle with
+ *      ackAvailable() false, so the Dispatcher can't wait on ackAvailable() alone. See footnote #4.
+ *
  * 09/26/2023:
  *    > Changed field chargeTime to sensorTime in TxPayloadStruct.
  *
@@ -47,7 +70,7 @@ bool RadioComms::setup() {
 
   result = _radioChip.begin();            // Instantiate the nRF24L01 transceiver.
   if(result) {
-    _radioChip.setPALevel(RF24_PA_LOW);                 // RF24_PA_MAX is default.
+    _radioChip.setPALevel(_txPayload.paLevel);          // RF24_PA_MAX is default. Starts at RF24_PA_LOW, the RPi may change it.
     _radioChip.enableDynamicPayloads();                 // To use ACK payloads, we need to enable dynamic payload lengths for all nodes.
     _radioChip.enableAckPayload();                      // Enable for all nodes so we can get ACK payloads back from the RPi.
     _radioChip.openWritingPipe((const uint8_t *)_addressMaster);         // Load the 'masters' address into the transmit pipe.
@@ -61,13 +84,12 @@ bool RadioComms::setup() {
 } // END setup()
 
 
-void RadioComms::setTxPayload(float fCap) {
+void RadioComms::setTxPayload(float fCap, uint16_t vccMillivolts) {
 
   /* To get us started with testing our concept out, let's just dummy up some data to transmit. */
   _txPayload.capacitance = fCap;                     // calculated capacitance
   _txPayload.sensorTime = millis();                  // Load current CPU time to payload.
-  memcpy(_txPayload.units, "---", 3);                // capacitance units
-  memcpy(_txPayload.statusText, "testing", 7);
+  _txPayload.vccMillivolts = vccMillivolts;          // Supply voltage, from the bandgap measurement.
 
   _rxPayloadAvailable = false;                       // Make sure we 'reset' from any prior Tx cycle.
 
@@ -85,6 +107,11 @@ short int RadioComms::update() {
         bool report = _radioChip.write(&_txPayload, sizeof(_txPayload)); 
         if(report) {
           _txPayload.ctSuccess++;
+          _txPayload.txRetries = _radioChip.getARC();               // Reported with the next reading. See footnote #1.
+          if(_txPayload.bootAckMillis == 0) {                       // 1st ACK since boot. Reported from the next reading on.
+            unsigned long now = millis();
+            _txPayload.bootAckMillis = (now > 65535) ? 65535 : (now ? now : 1);
+          }
           _phase = 2;
         } else {
           _txPayload.ctErrors++;
@@ -109,6 +136,20 @@ short int RadioComms::update() {
       }
       break;
 
+    case RADIO_PHASE_WAKE:          // Phase-10: Power up. See footnote #3.
+      _radioChip.powerUp();
+      _asleep = false;
+      _phase = RADIO_PHASE_CONFIG;
+      break;
+
+    case RADIO_PHASE_CONFIG:        // Phase-11: Make sure the chip is set up as we left it, and clear out stale data.
+      _radioChip.setPALevel(_txPayload.paLevel);
+      _radioChip.openWritingPipe((const uint8_t *)_addressMaster);
+      _radioChip.flush_tx();
+      _radioChip.flush_rx();                                        // Any ACK payload left from a prior cycle.
+      _phase = 0;
+      break;
+
     default:                        // Phase-0: Do nothing.
       _lastMillis = millis();
       break;
@@ -117,26 +158,97 @@ short int RadioComms::update() {
 }
 
 
+void RadioComms::setProbeCapacitance(uint8_t probe, float fCap) {
+  if(probe < 1 || probe > PAYLOAD_EXTRA_PROBES) return;
+  float centiPF = fCap * 100.0 + 0.5;
+  if(centiPF < 0) centiPF = 0;
+  if(centiPF > 65535) centiPF = 65535;
+  _txPayload.probeCap[probe - 1] = (uint16_t)centiPF;
+}
+
+
+bool RadioComms::isAvailable() {
+  return(_radioAvail);
+}
+
+
 bool RadioComms::ackAvailable() {
   return(_rxPayloadAvailable);
 }
 
 
+bool RadioComms::isBusy() {
+  return(_phase == 1 || _phase == 2);
+}
+
+
 RadioComms::RxPayloadStruct* RadioComms::getAckPayload() {
   return(&_rxAckPayload);
 }
 
 
+void RadioComms::wake() {
+  _phase = _asleep ? RADIO_PHASE_WAKE : RADIO_PHASE_CONFIG;
+}
+
+
+bool RadioComms::isAwake() {
+  return(!_asleep && _phase != RADIO_PHASE_WAKE && _phase != RADIO_PHASE_CONFIG);
+}
+
+
+void RadioComms::sleep() {
+  _radioChip.powerDown();                             // ~900nA vs ~26uA in standby.
+  _asleep = true;
+  _phase = 0;
+}
+
+
+void RadioComms::setAwakeMillis(uint16_t awakeMillis) {
+  _txPayload.awakeMillis = awakeMillis;
+}
+
+
+void RadioComms::setPALevel(uint8_t level) {
+  if(level > RF24_PA_MAX) return;
+  _radioChip.setPALevel(level);
+  _txPayload.paLevel = level;
+}
+
+
+
+#ifdef DIAGNOSTIC_BUILD
+bool RadioComms::sendDiagnostic(DiagPayloadStruct* diag) {
+  bool report = _radioChip.write(diag, sizeof(*diag));
+  _radioChip.flush_rx();
+  return(report);
+}
+#endif
 
 
 /**************************************************************************************************
 // FOOTNOTES
 //*************************************************************************************************
 
-/*   1.   
+/*   1. getARC() is the chip's ARC_CNT - retransmits of the last packet only, 0-15. It is reset
+  at the start of each new write, so it has to be read right after write() returns. Only the
+  count for the write that got through is sent; the RPi counts each failed write (seen as an
+  increase in ctErrors) as a full set of retransmits.
 */
 
 /*   2. Also reference documentation in: /Software/Documentation/RadioComms_ConverseProtocol.odg.
 */
 
+/*   3. RF24::powerUp() waits out the chip's power down -> standby start up time (Tpd2stby,
+  up to 5ms) itself, with a delay. We can't avoid that, but because Dispatcher calls wake() at
+  the same time it starts a sensor reading, the wait happens inside CapSensor's 300ms rest
+  between measurements rather than adding to the time we're awake. The power down registers
+  are retained, so phase-11 is belt-and-braces against a brown-out having reset the chip.
+*/
+
+/*   4. The packet got through but the ACK came back empty: the RPi had no ACK payload loaded
+  (e.g. it was restarting, or its reload after the last packet failed). That's error #3. The
+  reading is in, so there is nothing to send again; the cycle just ends with no command for us.
+*/
+
 
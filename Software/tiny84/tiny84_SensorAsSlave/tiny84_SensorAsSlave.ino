@@ -1,6 +1,6 @@
 //Moisture Sensor Project - ATTiny84 Code
 
-#define VERSION "SEN_092723"
+#define VERSION "SEN_101926"
 /*    DESCRIPTION: Arduino sketch to make the ATTiny84 MCU serve as a Slave sensor, with 
  * a Raspberry Pi as the Master - i.e., sensor server.
  *
@@ -8,6 +8,25 @@
  *  detailed info and documentation that I didn't want to clutter up the code with; but which
  *  I am likely to want to remember when I come back to this in 6 months.  : ) 
  *
+ *      10/19/2026: Payload changed for transmit power control (see RadioComms.ino), so it no
+ * longer matches RPi_CapDataReceive versions before 10-19-2026. Each sensor now needs its own
+ * SENSOR_ID, set in RadioComms.h.
+ *
+ *      10/19/2026: The 1st reading now goes out within a few seconds of power-up instead of
+ * 15 minutes later (see Dispatcher::begin()), and the time from boot to the 1st ACK is sent
+ * as a diagnostic field in each payload.
+ *
+ *      10/19/2026: Optional 2nd soil probe (CAP2_ pins). Both probes are read together and go
+ * out in the same packet.
+ *
+ *      10/19/2026: Diagnostic build option (DIAGNOSTIC_BUILD in RadioComms.h) that reports the
+ * stack high-water mark and free SRAM to the RPi. See MemDiag.h, and ../ramReport.sh for the
+ * static RAM taken by each object.
+ *
+ *      10/19/2026: Option to use our own lean nRF24 driver (NRF24_LITE in RadioComms.h, see
+ * Nrf24Lite.h) in place of the RF24 library, to free up flash. RF24 is still the default until
+ * the lean driver has been through the TC03 transmit tests on real hardware.
+ *
  *      09/27/2023: No changes to this particular file. One change made in Dispatcher.h 
  * to set the cap reading interval to 15 minutes. And with that change this version is
  * my 'beta' release for testing in a real plant pot to see how it goes.
@@ -30,6 +49,7 @@
   #include "CapSensor.h"
   #include "RadioComms.h"
   #include "Dispatcher.h"
+  #include "MemDiag.h"
 
 // ==== PROTOTYPES FOR CLASSES AND FUNCTIONS DEFINED IN THIS SOURCE FILE =========================
 // END Prototypes
@@ -50,6 +70,10 @@
   #define CAP_VOLTREAD_PIN A0        // Physical pin#13 - analog 'channel 0' for measuring voltage
   #define CAP_CHARGE_PIN   PIN_PB1   // Physical pin#3 - pin to charge the capacitor - connected to one end of the charging resistor
 
+    /* Optional 2nd (e.g., deep) probe on the spare pins. Uncomment to use. */
+  //#define CAP2_VOLTREAD_PIN A7       // Physical pin#6 - analog 'channel 7'
+  //#define CAP2_CHARGE_PIN   PIN_PB0  // Physical pin#2
+
 // END Pin References
 
 // DECLARE GLOBAL VARIABLES =======================================================================
@@ -70,6 +94,9 @@ void setup() {
 
   heartBeat.begin();                            // Start the heartbeat LED. Keep it lit for entire setup() process.
   errorFlash.begin();                           // Start the error reporting-out-by-flashing-LED process.
+#ifdef CAP2_CHARGE_PIN
+  capSensor.addProbe(CAP2_CHARGE_PIN, CAP2_VOLTREAD_PIN);
+#endif
   capSensor.setup();
   if (!radio.setup()) errorFlash.setError(9);   // If radio chip isn't there, set errorID 9.
   dispatcher.begin();